@@ -0,0 +1,60 @@
+# - Try to find the FFmpeg libraries used for video logging
+#
+# Once done this will define
+#
+#  FFmpeg_FOUND         - System has libavcodec, libavformat, libavutil and libswscale
+#  FFmpeg_INCLUDE_DIRS  - The FFmpeg include directories
+#  FFmpeg_LIBRARIES     - The libraries needed to use FFmpeg
+#
+# ------------------------------------------------------------------------------
+
+if (WIN32)
+    set(typical_ffmpeg_dir "C:/ffmpeg")
+else()
+    set(typical_ffmpeg_dir "/usr")
+endif()
+set(typical_ffmpeg_lib_dir "${typical_ffmpeg_dir}/lib")
+set(typical_ffmpeg_inc_dir "${typical_ffmpeg_dir}/include")
+
+message(STATUS "finding include dir")
+find_path(
+    FFmpeg_INCLUDE_DIR 
+    "libavcodec/avcodec.h"
+    HINTS ${typical_ffmpeg_inc_dir}
+    PATH_SUFFIXES ffmpeg
+    )
+message(STATUS "FFmpeg_INCLUDE_DIR: " ${FFmpeg_INCLUDE_DIR})
+
+message(STATUS "finding libraries")
+find_library(FFmpeg_AVCODEC_LIBRARY NAMES avcodec HINTS ${typical_ffmpeg_lib_dir})
+find_library(FFmpeg_AVFORMAT_LIBRARY NAMES avformat HINTS ${typical_ffmpeg_lib_dir})
+find_library(FFmpeg_AVUTIL_LIBRARY NAMES avutil HINTS ${typical_ffmpeg_lib_dir})
+find_library(FFmpeg_SWSCALE_LIBRARY NAMES swscale HINTS ${typical_ffmpeg_lib_dir})
+
+set(FFmpeg_LIBRARIES 
+    ${FFmpeg_AVFORMAT_LIBRARY} 
+    ${FFmpeg_AVCODEC_LIBRARY} 
+    ${FFmpeg_SWSCALE_LIBRARY} 
+    ${FFmpeg_AVUTIL_LIBRARY} 
+    )
+set(FFmpeg_INCLUDE_DIRS ${FFmpeg_INCLUDE_DIR} )
+
+include(FindPackageHandleStandardArgs)
+# handle the QUIETLY and REQUIRED arguments and set FFmpeg_FOUND to TRUE
+# if all listed variables are TRUE
+find_package_handle_standard_args(
+    FFmpeg  DEFAULT_MSG
+    FFmpeg_AVCODEC_LIBRARY 
+    FFmpeg_AVFORMAT_LIBRARY 
+    FFmpeg_AVUTIL_LIBRARY 
+    FFmpeg_SWSCALE_LIBRARY 
+    FFmpeg_INCLUDE_DIR
+    )
+
+mark_as_advanced(
+    FFmpeg_INCLUDE_DIR 
+    FFmpeg_AVCODEC_LIBRARY 
+    FFmpeg_AVFORMAT_LIBRARY 
+    FFmpeg_AVUTIL_LIBRARY 
+    FFmpeg_SWSCALE_LIBRARY 
+    )
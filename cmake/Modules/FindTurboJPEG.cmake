@@ -0,0 +1,46 @@
+# - Try to find libjpeg-turbo's TurboJPEG API
+# 
+# Once done this will define
+#
+#  TurboJPEG_FOUND         - System has TurboJPEG
+#  TurboJPEG_INCLUDE_DIRS  - The TurboJPEG include directories
+#  TurboJPEG_LIBRARIES     - The libraries needed to use TurboJPEG
+#
+# ------------------------------------------------------------------------------
+
+if (WIN32)
+    set(typical_turbojpeg_dir "C:/libjpeg-turbo64")
+else()
+    set(typical_turbojpeg_dir "/usr")
+endif()
+set(typical_turbojpeg_lib_dir "${typical_turbojpeg_dir}/lib")
+set(typical_turbojpeg_inc_dir "${typical_turbojpeg_dir}/include")
+
+message(STATUS "finding include dir")
+find_path(
+    TurboJPEG_INCLUDE_DIR 
+    "turbojpeg.h"
+    HINTS ${typical_turbojpeg_inc_dir}
+    )
+message(STATUS "TurboJPEG_INCLUDE_DIR: " ${TurboJPEG_INCLUDE_DIR})
+
+message(STATUS "finding library")
+find_library(
+    TurboJPEG_LIBRARY 
+    NAMES turbojpeg turbojpeg-static
+    HINTS ${typical_turbojpeg_lib_dir} 
+    )
+
+set(TurboJPEG_LIBRARIES ${TurboJPEG_LIBRARY} )
+set(TurboJPEG_INCLUDE_DIRS ${TurboJPEG_INCLUDE_DIR} )
+
+include(FindPackageHandleStandardArgs)
+# handle the QUIETLY and REQUIRED arguments and set TurboJPEG_FOUND to TRUE
+# if all listed variables are TRUE
+find_package_handle_standard_args(
+    TurboJPEG  DEFAULT_MSG
+    TurboJPEG_LIBRARY 
+    TurboJPEG_INCLUDE_DIR
+    )
+
+mark_as_advanced(TurboJPEG_INCLUDE_DIR TurboJPEG_LIBRARY )
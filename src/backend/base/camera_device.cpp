@@ -24,6 +24,18 @@ namespace bias
     }
 
 
+    void CameraDevice::setImagePool(ImagePoolPtr imagePoolPtr)
+    {
+        imagePoolPtr_ = imagePoolPtr;
+    }
+
+
+    ImagePoolPtr CameraDevice::getImagePool()
+    {
+        return imagePoolPtr_;
+    }
+
+
     CameraLib CameraDevice::getCameraLib()
     {
 
@@ -162,6 +174,12 @@ namespace bias
         return TRIGGER_INTERNAL;
     }
 
+    GrabStats CameraDevice::getGrabStats()
+    {
+        return GrabStats();
+    }
+
+
     TimeStamp CameraDevice::getImageTimeStamp()
     {
         TimeStamp ts;
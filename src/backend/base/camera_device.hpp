@@ -8,6 +8,7 @@
 #include "property.hpp"
 #include "guid.hpp"
 #include "format7.hpp"
+#include "image_pool.hpp"
 
 namespace bias 
 {
@@ -31,6 +32,10 @@ namespace bias
             virtual cv::Mat grabImage();
             virtual void grabImage(cv::Mat &image) {};
 
+            // Timeout for grabImage in msec - negative for the backend's default
+            // (non-blocking) behaviour. 
+            virtual void setGrabTimeout(int timeoutMs) {};
+
             virtual bool isConnected(); 
             virtual bool isCapturing();
             virtual bool isColor(); 
@@ -68,6 +73,9 @@ namespace bias
 
             virtual TimeStamp getImageTimeStamp();
 
+            virtual GrabStats getGrabStats();
+            virtual void resetGrabStats() {};
+
             virtual std::string getVendorName();
             virtual std::string getModelName();
 
@@ -75,11 +83,16 @@ namespace bias
             virtual void printInfo() {};
             virtual void printGuid() {};
 
+            // Optional pool which grabbed images are allocated from
+            void setImagePool(ImagePoolPtr imagePoolPtr);
+            ImagePoolPtr getImagePool();
+
 
         protected:
             Guid guid_;
             bool connected_;
             bool capturing_;
+            ImagePoolPtr imagePoolPtr_;
     };
 
     typedef std::shared_ptr<CameraDevice> CameraDevicePtr;
@@ -0,0 +1,433 @@
+#include "image_pool.hpp"
+#include <algorithm>
+#include <iterator>
+
+namespace bias 
+{
+    const unsigned int ImagePool::DEFAULT_MAX_BUFFERS = 512;
+    const unsigned int ImagePool::DEFAULT_MAX_MEMORY_MB = 0;
+    const unsigned long ImagePool::TRIM_INTERVAL = 1024;
+
+
+    // ImagePoolStats
+    // ----------------------------------------------------------------------------
+
+    ImagePoolStats::ImagePoolStats()
+    {
+        numRequests = 0;
+        numHits = 0;
+        numExhausted = 0;
+        numInUse = 0;
+        numAllocated = 0;
+        highWaterMark = 0;
+        bytesAllocated = 0;
+    }
+
+
+    double ImagePoolStats::hitRate() const
+    {
+        if (numRequests == 0)
+        {
+            return 0.0;
+        }
+        return double(numHits)/double(numRequests);
+    }
+
+
+    // ImagePool::Allocator
+    // ----------------------------------------------------------------------------
+    //
+    // The cv::MatAllocator which owns the buffers. It is kept separate from the
+    // ImagePool so that images still queued elsewhere when the pool is destroyed 
+    // remain valid - in that case the allocator is orphaned and deletes itself 
+    // when the last outstanding buffer is returned.
+
+    class ImagePool::Allocator : public cv::MatAllocator
+    {
+        public:
+
+            Allocator(unsigned int maxBuffers, unsigned int maxMemoryMB) 
+            {
+                maxBuffers_ = maxBuffers;
+                maxMemoryMB_ = maxMemoryMB;
+                orphaned_ = false;
+                minNumFree_ = 0;
+                numSinceTrim_ = 0;
+            }
+
+            virtual ~Allocator()
+            {
+                freeAll();
+            }
+
+            virtual cv::UMatData* allocate(
+                    int dims, 
+                    const int* sizes, 
+                    int type, 
+                    void* data0, 
+                    size_t* step, 
+                    cv::AccessFlag flags, 
+                    cv::UMatUsageFlags usageFlags
+                    ) const
+            {
+                size_t total = CV_ELEM_SIZE(type);
+                for (int i=dims-1; i>=0; i--)
+                {
+                    if (step)
+                    {
+                        if (data0 && (step[i] != CV_AUTOSTEP))
+                        {
+                            CV_Assert(total <= step[i]);
+                            total = step[i];
+                        }
+                        else
+                        {
+                            step[i] = total;
+                        }
+                    }
+                    total *= sizes[i];
+                }
+
+                cv::UMatData *u = new cv::UMatData(this);
+                u -> size = total;
+                u -> userdata = nullptr;
+
+                if (data0)
+                {
+                    u -> data = u -> origdata = static_cast<uchar*>(data0);
+                    u -> flags |= cv::UMatData::USER_ALLOCATED;
+                    return u;
+                }
+
+                uchar *data = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stats_.numRequests++;
+
+                    std::multimap<size_t,uchar*>::iterator it = freeBuffers_.find(total);
+                    if (it != freeBuffers_.end())
+                    {
+                        data = it -> second;
+                        freeBuffers_.erase(it);
+                        stats_.numHits++;
+                    }
+                    else
+                    {
+                        // Free buffers are all of other sizes (e.g. from before
+                        // an image size change) - give them up to make room.
+                        while (!hasRoomFor(total) && !freeBuffers_.empty())
+                        {
+                            freeBuffer(freeBuffers_.begin());
+                        }
+                        if (hasRoomFor(total))
+                        {
+                            data = static_cast<uchar*>(cv::fastMalloc(total));
+                            stats_.numAllocated++;
+                            stats_.bytesAllocated += total;
+                        }
+                        else
+                        {
+                            stats_.numExhausted++;
+                        }
+                    }
+                    trimFreeBuffers();
+
+                    if (data)
+                    {
+                        stats_.numInUse++;
+                        if (stats_.numInUse > stats_.highWaterMark)
+                        {
+                            stats_.highWaterMark = stats_.numInUse;
+                        }
+                        u -> userdata = const_cast<Allocator*>(this);
+                    }
+                }
+
+                if (!data)
+                {
+                    // Pool exhausted - plain heap buffer which is freed on release
+                    data = static_cast<uchar*>(cv::fastMalloc(total));
+                }
+                u -> data = u -> origdata = data;
+                return u;
+            }
+
+            virtual bool allocate(
+                    cv::UMatData* u, 
+                    cv::AccessFlag accessFlags, 
+                    cv::UMatUsageFlags usageFlags
+                    ) const
+            {
+                return (u != nullptr);
+            }
+
+            virtual void deallocate(cv::UMatData* u) const
+            {
+                if (!u)
+                {
+                    return;
+                }
+                CV_Assert(u -> urefcount == 0);
+                CV_Assert(u -> refcount == 0);
+
+                bool isPooled = (u -> userdata == this);
+                bool isUser = ((u -> flags & cv::UMatData::USER_ALLOCATED) != 0);
+                bool deleteSelf = false;
+
+                if (isPooled)
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stats_.numInUse--;
+                    if (orphaned_ || isOverLimit())
+                    {
+                        cv::fastFree(u -> origdata);
+                        stats_.numAllocated--;
+                        stats_.bytesAllocated -= u -> size;
+                    }
+                    else
+                    {
+                        freeBuffers_.insert(std::make_pair(u -> size, u -> origdata));
+                    }
+                    deleteSelf = orphaned_ && (stats_.numInUse == 0);
+                }
+                else if (!isUser)
+                {
+                    cv::fastFree(u -> origdata);
+                }
+                u -> origdata = 0;
+                delete u;
+
+                if (deleteSelf)
+                {
+                    delete this;
+                }
+            }
+
+            void orphan()
+            {
+                bool deleteSelf = false;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    orphaned_ = true;
+                    deleteSelf = (stats_.numInUse == 0);
+                }
+                if (deleteSelf)
+                {
+                    delete this;
+                }
+                else
+                {
+                    releaseFreeBuffers();
+                }
+            }
+
+            void releaseFreeBuffers()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                freeAll();
+            }
+
+            void setMaxBuffers(unsigned int maxBuffers)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                maxBuffers_ = maxBuffers;
+            }
+
+            unsigned int getMaxBuffers() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return maxBuffers_;
+            }
+
+            void setMaxMemoryMB(unsigned int maxMemoryMB)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                maxMemoryMB_ = maxMemoryMB;
+            }
+
+            unsigned int getMaxMemoryMB() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return maxMemoryMB_;
+            }
+
+            ImagePoolStats getStats() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return stats_;
+            }
+
+            void resetStats()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.numRequests = 0;
+                stats_.numHits = 0;
+                stats_.numExhausted = 0;
+                stats_.highWaterMark = stats_.numInUse;
+            }
+
+        private:
+
+            mutable std::mutex mutex_;
+            mutable std::multimap<size_t,uchar*> freeBuffers_;
+            mutable ImagePoolStats stats_;
+            unsigned int maxBuffers_;
+            unsigned int maxMemoryMB_;
+            bool orphaned_;
+            mutable size_t minNumFree_;         // free list low water mark since last trim
+            mutable unsigned long numSinceTrim_;
+
+            // The helpers below are called with the mutex held (or from the destructor)
+
+            size_t maxBytes() const
+            {
+                return size_t(maxMemoryMB_)*size_t(1 << 20);
+            }
+
+            bool hasRoomFor(size_t size) const
+            {
+                bool room = (stats_.numAllocated < maxBuffers_);
+                if (maxMemoryMB_ > 0)
+                {
+                    room = room && (stats_.bytesAllocated + size <= maxBytes());
+                }
+                return room;
+            }
+
+            bool isOverLimit() const
+            {
+                bool over = (stats_.numAllocated > maxBuffers_);
+                if (maxMemoryMB_ > 0)
+                {
+                    over = over || (stats_.bytesAllocated > maxBytes());
+                }
+                return over;
+            }
+
+            void freeBuffer(std::multimap<size_t,uchar*>::iterator it) const
+            {
+                cv::fastFree(it -> second);
+                stats_.numAllocated--;
+                stats_.bytesAllocated -= it -> first;
+                freeBuffers_.erase(it);
+            }
+
+            void trimFreeBuffers() const
+            {
+                // Buffers which stayed on the free list for the whole interval 
+                // weren't needed - release them. A pipeline in steady state keeps
+                // drawing its free list down to about zero, so this only frees
+                // buffers left over from a spike.
+                minNumFree_ = std::min(minNumFree_, freeBuffers_.size());
+                numSinceTrim_++;
+                if (numSinceTrim_ < TRIM_INTERVAL)
+                {
+                    return;
+                }
+                for (size_t i=0; (i<minNumFree_) && !freeBuffers_.empty(); i++)
+                {
+                    freeBuffer(std::prev(freeBuffers_.end()));
+                }
+                minNumFree_ = freeBuffers_.size();
+                numSinceTrim_ = 0;
+            }
+
+            void freeAll() const
+            {
+                while (!freeBuffers_.empty())
+                {
+                    freeBuffer(freeBuffers_.begin());
+                }
+            }
+    };
+
+
+    // ImagePool
+    // ----------------------------------------------------------------------------
+
+    ImagePool::ImagePool(unsigned int maxBuffers, unsigned int maxMemoryMB)
+    {
+        allocatorPtr_ = new Allocator(maxBuffers, maxMemoryMB);
+    }
+
+
+    ImagePool::~ImagePool()
+    {
+        allocatorPtr_ -> orphan();
+        allocatorPtr_ = nullptr;
+    }
+
+
+    void ImagePool::getImage(cv::Mat &image, int rows, int cols, int type)
+    {
+        // Reuse the image as-is if we are its only holder and it already came
+        // from this pool with the right size and type.
+        bool canReuse = (image.u != nullptr);
+        canReuse = canReuse && (image.u -> currAllocator == allocatorPtr_);
+        canReuse = canReuse && (image.u -> refcount == 1);
+        canReuse = canReuse && (image.rows == rows) && (image.cols == cols);
+        canReuse = canReuse && (image.type() == type);
+        if (canReuse)
+        {
+            return;
+        }
+        image.release();
+        image.allocator = allocatorPtr_;
+        image.create(rows, cols, type);
+
+        // Buffer ownership is tracked by image.u, don't let the allocator pointer
+        // leak into later (re)allocations of this header.
+        image.allocator = nullptr;
+    }
+
+
+    cv::Mat ImagePool::getImage(int rows, int cols, int type)
+    {
+        cv::Mat image;
+        getImage(image, rows, cols, type);
+        return image;
+    }
+
+
+    void ImagePool::setMaxBuffers(unsigned int maxBuffers)
+    {
+        allocatorPtr_ -> setMaxBuffers(maxBuffers);
+    }
+
+
+    unsigned int ImagePool::getMaxBuffers() const
+    {
+        return allocatorPtr_ -> getMaxBuffers();
+    }
+
+
+    void ImagePool::setMaxMemoryMB(unsigned int maxMemoryMB)
+    {
+        allocatorPtr_ -> setMaxMemoryMB(maxMemoryMB);
+    }
+
+
+    unsigned int ImagePool::getMaxMemoryMB() const
+    {
+        return allocatorPtr_ -> getMaxMemoryMB();
+    }
+
+
+    ImagePoolStats ImagePool::getStats() const
+    {
+        return allocatorPtr_ -> getStats();
+    }
+
+
+    void ImagePool::resetStats()
+    {
+        allocatorPtr_ -> resetStats();
+    }
+
+
+    void ImagePool::releaseFreeBuffers()
+    {
+        allocatorPtr_ -> releaseFreeBuffers();
+    }
+
+}
@@ -0,0 +1,79 @@
+#ifndef BIAS_IMAGE_POOL_HPP
+#define BIAS_IMAGE_POOL_HPP
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <opencv2/core/core.hpp>
+
+namespace bias 
+{
+
+    struct ImagePoolStats
+    {
+        unsigned long numRequests;    // images requested from the pool
+        unsigned long numHits;        // requests served by a recycled buffer
+        unsigned long numExhausted;   // requests which fell back to the heap (pool full)
+        unsigned long numInUse;       // pooled buffers currently held by images
+        unsigned long numAllocated;   // pooled buffers owned (in use + free)
+        unsigned long highWaterMark;  // maximum of numInUse since last reset
+        size_t bytesAllocated;        // bytes held by pooled buffers
+
+        ImagePoolStats();
+        double hitRate() const;
+    };
+
+
+    class ImagePool
+    {
+        // ------------------------------------------------------------------------
+        // Per-camera pool of image buffers keyed by buffer size. Images obtained 
+        // from the pool are ordinary reference counted cv::Mats; when the last 
+        // holder releases one the buffer goes back on the free list instead of
+        // the heap. Once maxBuffers buffers - or maxMemoryMB of them, if set - 
+        // are live, further requests fall back to plain heap allocations and are
+        // counted as exhaustion events. Size the pool to the queues it feeds. 
+        //
+        // Free buffers which go unused for TRIM_INTERVAL requests are released,
+        // so the pool shrinks back after a spike (a slow consumer filling the 
+        // queues) instead of holding its peak until the pool is destroyed.
+        // ------------------------------------------------------------------------
+
+        public:
+
+            static const unsigned int DEFAULT_MAX_BUFFERS;
+            static const unsigned int DEFAULT_MAX_MEMORY_MB;  // 0 = no limit
+            static const unsigned long TRIM_INTERVAL;
+
+            explicit ImagePool(
+                    unsigned int maxBuffers=DEFAULT_MAX_BUFFERS, 
+                    unsigned int maxMemoryMB=DEFAULT_MAX_MEMORY_MB
+                    );
+            ~ImagePool();
+
+            void getImage(cv::Mat &image, int rows, int cols, int type);
+            cv::Mat getImage(int rows, int cols, int type);
+
+            void setMaxBuffers(unsigned int maxBuffers);
+            unsigned int getMaxBuffers() const;
+            void setMaxMemoryMB(unsigned int maxMemoryMB);
+            unsigned int getMaxMemoryMB() const;
+
+            ImagePoolStats getStats() const;
+            void resetStats();
+            void releaseFreeBuffers();
+
+        private:
+
+            class Allocator;
+            Allocator *allocatorPtr_;
+
+            ImagePool(const ImagePool&);
+            ImagePool& operator=(const ImagePool&);
+    };
+
+    typedef std::shared_ptr<ImagePool> ImagePoolPtr;
+
+}
+
+#endif // #ifndef BIAS_IMAGE_POOL_HPP
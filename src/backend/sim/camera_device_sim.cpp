@@ -0,0 +1,751 @@
+#ifdef WITH_SIM
+#include "camera_device_sim.hpp"
+#include "exception.hpp"
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+
+namespace bias {
+
+    constexpr unsigned int CameraDevice_sim::NumBufferedFrames;
+    constexpr unsigned int CameraDevice_sim::SourceMargin;
+    constexpr unsigned int CameraDevice_sim::ImageHStepSize;
+    constexpr unsigned int CameraDevice_sim::ImageVStepSize;
+    constexpr unsigned int CameraDevice_sim::OffsetHStepSize;
+    constexpr unsigned int CameraDevice_sim::OffsetVStepSize;
+
+    // Synthetic content parameters - levels are fractions of full scale
+    const double PI = 3.14159265358979323846;
+    const double BLOB_BACKGROUND_LEVEL = 0.1;
+    const double BLOB_LEVEL = 0.9;
+    const double BLOB_FREQ_HZ = 0.2;
+    const double BLOB_PATH_RADIUS = 0.35;
+    const double CONSTANT_LEVEL = 0.5;
+
+
+    CameraDevice_sim::CameraDevice_sim() : CameraDevice() 
+    {
+        initialize();
+    }
+
+
+    CameraDevice_sim::CameraDevice_sim(Guid guid) : CameraDevice(guid)
+    {
+        config_ = SimCameraConfig::fromEnvironment();
+        initialize();
+        rng_.seed(guid_.getValue_sim().index);
+    }
+
+
+    CameraDevice_sim::~CameraDevice_sim() 
+    {
+        if (capturing_) 
+        { 
+            stopCapture(); 
+        }
+
+        if (connected_) 
+        { 
+            disconnect(); 
+        }
+    }
+
+
+    CameraLib CameraDevice_sim::getCameraLib() 
+    { 
+        return CAMERA_LIB_SIM; 
+    }
+
+
+    void CameraDevice_sim::connect() 
+    {
+        connected_ = true;
+    }
+
+
+    void CameraDevice_sim::disconnect()
+    {
+        if (capturing_) 
+        { 
+            stopCapture(); 
+        }
+        connected_ = false;
+    }
+
+
+    void CameraDevice_sim::startCapture()
+    {
+        if (!connected_) 
+        { 
+            std::stringstream ssError;
+            ssError << __FUNCTION__;
+            ssError << ": unable to start simulated capture - not connected";
+            throw RuntimeError(ERROR_SIM_START_CAPTURE, ssError.str());
+        }
+
+        if (!capturing_) 
+        {
+            createSourceImage();
+
+            startTime_ = SimClock::now();
+            anchorTime_ = startTime_;
+            anchorFrame_ = 0;
+            frameNumber_ = 0;
+            lastTimeStampUs_ = -1;
+
+            capturing_ = true;
+            resetGrabStats();
+        }
+    }
+
+
+    void CameraDevice_sim::stopCapture()
+    {
+        if (capturing_) 
+        {
+            capturing_ = false;
+        }
+    }
+
+
+    cv::Mat CameraDevice_sim::grabImage()
+    {
+        cv::Mat image;  
+        grabImage(image);
+        return image;
+    }
+
+
+    void CameraDevice_sim::grabImage(cv::Mat &image)
+    {
+        if (!capturing_) 
+        {
+            image.release();
+            return;
+        }
+
+        SimClock::time_point now = SimClock::now();
+        SimClock::time_point frameTime = getFrameTime(frameNumber_);
+
+        // Reader is behind by more than the camera buffers - skip ahead, the
+        // frames in between have been overwritten.
+        double lagFrames = std::chrono::duration<double>(now - frameTime).count()*getFrameRateValue();
+        if (lagFrames > double(NumBufferedFrames))
+        {
+            uint64_t numLost = uint64_t(lagFrames) - NumBufferedFrames;
+            frameNumber_ += numLost;
+            grabStats_.numOverrun += (unsigned long)(numLost);
+            frameTime = getFrameTime(frameNumber_);
+        }
+
+        // Wait for the frame to be due. In blocking mode give up after the 
+        // timeout and return an empty image, as a real camera would.
+        if (frameTime > now)
+        {
+            if (grabTimeoutMs_ >= 0)
+            {
+                SimClock::time_point timeoutTime = now + std::chrono::milliseconds(grabTimeoutMs_);
+                if (frameTime > timeoutTime)
+                {
+                    std::this_thread::sleep_until(timeoutTime);
+                    image.release();
+                    return;
+                }
+            }
+            std::this_thread::sleep_until(frameTime);
+        }
+        uint64_t frameNumber = frameNumber_;
+        frameNumber_++;
+
+        // Injected faults
+        std::uniform_real_distribution<double> uniformDist(0.0, 1.0);
+        if ((config_.dropRate > 0.0) && (uniformDist(rng_) < config_.dropRate))
+        {
+            grabStats_.numDropped++;
+            image.release();
+            return;
+        }
+        if ((config_.errorRate > 0.0) && (uniformDist(rng_) < config_.errorRate))
+        {
+            grabStats_.numErrors++;
+            std::stringstream ssError;
+            ssError << __FUNCTION__;
+            ssError << ": simulated grab error, frame = " << frameNumber;
+            throw RuntimeError(ERROR_SIM_GRAB_IMAGE, ssError.str());
+        }
+
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+        updateTimeStamp(frameTime);
+        double frameTimeSec = std::chrono::duration<double>(frameTime - startTime_).count();
+        renderImage(frameNumber, frameTimeSec, image);
+
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        double dtUs = std::chrono::duration<double,std::micro>(t1 - t0).count();
+        updateGrabStats(dtUs);
+    }
+
+
+    void CameraDevice_sim::setGrabTimeout(int timeoutMs)
+    {
+        grabTimeoutMs_ = timeoutMs;
+    }
+
+
+    GrabStats CameraDevice_sim::getGrabStats()
+    {
+        return grabStats_;
+    }
+
+
+    void CameraDevice_sim::resetGrabStats()
+    {
+        grabStats_ = GrabStats();
+    }
+
+
+    bool CameraDevice_sim::isColor()
+    {
+        return false;
+    } 
+
+
+    bool CameraDevice_sim::isSupported(VideoMode vidMode, FrameRate frmRate)
+    {
+        VideoModeList allowedVideoModes = getAllowedVideoModes();
+        FrameRateList allowedFrameRates = getAllowedFrameRates(vidMode);
+        bool videoModeFound = (std::find(allowedVideoModes.begin(), allowedVideoModes.end(), vidMode) != allowedVideoModes.end());
+        bool frameRateFound = (std::find(allowedFrameRates.begin(), allowedFrameRates.end(), frmRate) != allowedFrameRates.end());
+        return (videoModeFound && frameRateFound);
+    }
+
+
+    bool CameraDevice_sim::isSupported(ImageMode imgMode)
+    {
+        ImageModeList allowedModes = getAllowedImageModes();
+        bool found = (std::find(allowedModes.begin(), allowedModes.end(), imgMode) != allowedModes.end());
+        return found;
+    }
+
+
+    unsigned int CameraDevice_sim::getNumberOfImageMode()
+    {
+        return getAllowedImageModes().size();
+    }
+
+
+    VideoMode CameraDevice_sim::getVideoMode() 
+    {
+        return VIDEOMODE_FORMAT7;
+    } 
+
+
+    FrameRate CameraDevice_sim::getFrameRate() 
+    {
+        return FRAMERATE_FORMAT7;
+    }
+
+
+    ImageMode CameraDevice_sim::getImageMode()
+    { 
+        return format7Settings_.mode;
+    }
+
+
+    VideoModeList CameraDevice_sim::getAllowedVideoModes()
+    {
+        VideoModeList allowedVideoModes = {VIDEOMODE_FORMAT7}; 
+        return allowedVideoModes;
+    }
+
+
+    FrameRateList CameraDevice_sim::getAllowedFrameRates(VideoMode vidMode)
+    { 
+        FrameRateList allowedFrameRates = {};
+        if (vidMode == VIDEOMODE_FORMAT7)
+        {
+            allowedFrameRates.push_back(FRAMERATE_FORMAT7);
+        }
+        return allowedFrameRates;
+    }
+
+
+    ImageModeList CameraDevice_sim::getAllowedImageModes()
+    {
+        ImageModeList allImageModes = {IMAGEMODE_0};
+        return allImageModes;
+    }
+
+
+    PropertyInfo CameraDevice_sim::getPropertyInfo(PropertyType propType)
+    {
+        PropertyInfo propInfo;
+        propInfo.type = propType;
+        if (propertyInfoMap_.count(propType) > 0)
+        {
+            propInfo = propertyInfoMap_[propType];
+        }
+        return propInfo;
+    }
+
+
+    Property CameraDevice_sim::getProperty(PropertyType propType)
+    {
+        Property prop;
+        prop.type = propType;
+        if (propertyMap_.count(propType) > 0)
+        {
+            prop = propertyMap_[propType];
+        }
+        return prop;
+    }
+
+
+    void CameraDevice_sim::setProperty(Property prop)
+    {
+        if ((propertyInfoMap_.count(prop.type) == 0) || !propertyInfoMap_[prop.type].manualCapable)
+        {
+            std::stringstream ssError;
+            ssError << __FUNCTION__;
+            ssError << ": property " << getPropertyTypeString(prop.type);
+            ssError << " is not settable on simulated camera";
+            throw RuntimeError(ERROR_SIM_PROPERTY_NOT_SETTABLE, ssError.str());
+        }
+
+        PropertyInfo propInfo = propertyInfoMap_[prop.type];
+        float value = prop.absoluteControl ? prop.absoluteValue : float(prop.value);
+        value = std::min(std::max(value, propInfo.minAbsoluteValue), propInfo.maxAbsoluteValue);
+
+        if ((prop.type == PROPERTY_TYPE_FRAME_RATE) && capturing_)
+        {
+            // Start the new rate from the next frame of the old schedule
+            anchorTime_ = getFrameTime(frameNumber_);
+            anchorFrame_ = frameNumber_;
+        }
+
+        Property &currProp = propertyMap_[prop.type];
+        currProp.absoluteValue = value;
+        currProp.value = (unsigned int)(std::lround(value));
+    }
+
+
+    Format7Settings CameraDevice_sim::getFormat7Settings()
+    {
+        return format7Settings_;
+    }
+
+
+    Format7Info CameraDevice_sim::getFormat7Info(ImageMode imgMode)
+    {
+        Format7Info format7Info(imgMode);
+        format7Info.supported = isSupported(imgMode);
+        if (format7Info.supported)
+        {
+            format7Info.maxWidth = SimCameraConfig::MAX_WIDTH;
+            format7Info.maxHeight = SimCameraConfig::MAX_HEIGHT;
+            format7Info.imageHStepSize = ImageHStepSize;
+            format7Info.imageVStepSize = ImageVStepSize;
+            format7Info.offsetHStepSize = OffsetHStepSize;
+            format7Info.offsetVStepSize = OffsetVStepSize;
+            format7Info.percentage = 100.0;
+        }
+        return format7Info;
+    }
+
+
+    bool CameraDevice_sim::validateFormat7Settings(Format7Settings settings)
+    {
+        bool ok = true;
+
+        if (!isSupported(settings.mode))
+        {
+            ok = false;
+        }
+
+        Format7Info info = getFormat7Info(settings.mode);
+
+        if ((settings.width == 0) || (settings.height == 0))
+        {
+            ok = false;
+        }
+        if ((settings.width + settings.offsetX) > info.maxWidth)
+        {
+            ok = false;
+        }
+        if ((settings.height + settings.offsetY) > info.maxHeight)
+        {
+            ok = false;
+        }
+        if (settings.width%ImageHStepSize != 0)
+        {
+            ok = false;
+        }
+        if (settings.height%ImageVStepSize != 0)
+        {
+            ok = false;
+        }
+        if (settings.offsetX%OffsetHStepSize != 0)
+        {
+            ok = false;
+        }
+        if (settings.offsetY%OffsetVStepSize != 0)
+        {
+            ok = false;
+        }
+
+        PixelFormatList formatList = getListOfSupportedPixelFormats(settings.mode);
+        if (std::find(formatList.begin(), formatList.end(), settings.pixelFormat) == formatList.end())
+        {
+            ok = false;
+        }
+        return ok;
+    }
+
+
+    void CameraDevice_sim::setFormat7Configuration(Format7Settings settings, float percentSpeed)
+    {
+        if (!validateFormat7Settings(settings))
+        {
+            std::stringstream ssError;
+            ssError << __FUNCTION__;
+            ssError << ": invalid format7 settings for simulated camera";
+            throw RuntimeError(ERROR_SIM_FORMAT7_SETTINGS, ssError.str());
+        }
+
+        format7Settings_ = settings;
+        if (capturing_)
+        {
+            createSourceImage();
+        }
+    }
+
+
+    PixelFormatList CameraDevice_sim::getListOfSupportedPixelFormats(ImageMode imgMode)
+    {
+        PixelFormatList pixelFormatList;
+        if (isSupported(imgMode))
+        {
+            pixelFormatList = {PIXEL_FORMAT_MONO8, PIXEL_FORMAT_MONO12, PIXEL_FORMAT_MONO16};
+        }
+        return pixelFormatList;
+    }
+
+
+    void CameraDevice_sim::setTriggerInternal()
+    {
+        triggerType_ = TRIGGER_INTERNAL;
+    }
+
+
+    void CameraDevice_sim::setTriggerExternal()
+    {
+        // No trigger input to wait on - the simulated trigger source pulses 
+        // at the frame rate.
+        triggerType_ = TRIGGER_EXTERNAL;
+    }
+
+
+    TriggerType CameraDevice_sim::getTriggerType()
+    {
+        return triggerType_;
+    }
+
+
+    TimeStamp CameraDevice_sim::getImageTimeStamp()
+    {
+        return timeStamp_;
+    }
+
+
+    std::string CameraDevice_sim::getVendorName()
+    {
+        return std::string("BIAS");
+    }
+
+    
+    std::string CameraDevice_sim::getModelName()
+    {
+        return std::string("Simulated Camera");
+    }
+
+
+    std::string CameraDevice_sim::toString()
+    {
+        std::stringstream ss;
+        ss << std::endl;
+        ss << "vendor:      " << getVendorName() << std::endl;
+        ss << "model:       " << getModelName() << std::endl;
+        ss << "guid:        " << guid_.toString() << std::endl;
+        ss << config_.toString();
+        return ss.str();
+    }
+
+
+    void CameraDevice_sim::printGuid() 
+    { 
+        guid_.printValue(); 
+    }
+
+
+    void CameraDevice_sim::printInfo()
+    {
+        std::cout << toString();
+    }
+
+
+    // Private methods
+    // ------------------------------------------------------------------------
+
+    void CameraDevice_sim::initialize()
+    {
+        format7Settings_.mode = IMAGEMODE_0;
+        format7Settings_.offsetX = 0;
+        format7Settings_.offsetY = 0;
+        format7Settings_.width = std::max((config_.width/ImageHStepSize)*ImageHStepSize, ImageHStepSize);
+        format7Settings_.height = std::max((config_.height/ImageVStepSize)*ImageVStepSize, ImageVStepSize);
+        format7Settings_.pixelFormat = config_.pixelFormat;
+        initializeProperties();
+    }
+
+
+    void CameraDevice_sim::initializeProperties()
+    {
+        propertyInfoMap_.clear();
+        propertyMap_.clear();
+
+        float frameRateMin = float(SimCameraConfig::MIN_FRAME_RATE);
+        float frameRateMax = float(SimCameraConfig::MAX_FRAME_RATE);
+        addProperty(PROPERTY_TYPE_FRAME_RATE, frameRateMin, frameRateMax, float(config_.frameRate), "fps");
+        addProperty(PROPERTY_TYPE_SHUTTER, 10.0, 200000.0, 1000.0, "us");
+        addProperty(PROPERTY_TYPE_GAIN, 0.0, 24.0, 0.0, "dB");
+        addProperty(PROPERTY_TYPE_BRIGHTNESS, 0.0, 10.0, 0.0, "%");
+        addProperty(PROPERTY_TYPE_TEMPERATURE, 40.0, 40.0, 40.0, "C");
+
+        // Read only
+        propertyInfoMap_[PROPERTY_TYPE_TEMPERATURE].manualCapable = false;
+        propertyInfoMap_[PROPERTY_TYPE_TEMPERATURE].readOutCapable = true;
+    }
+
+
+    void CameraDevice_sim::addProperty(
+            PropertyType propType, 
+            float minValue, 
+            float maxValue, 
+            float value, 
+            std::string units
+            )
+    {
+        PropertyInfo propInfo;
+        propInfo.type = propType;
+        propInfo.present = true;
+        propInfo.autoCapable = false;
+        propInfo.manualCapable = true;
+        propInfo.absoluteCapable = true;
+        propInfo.onePushCapable = false;
+        propInfo.onOffCapable = false;
+        propInfo.readOutCapable = false;
+        propInfo.minValue = (unsigned int)(std::lround(minValue));
+        propInfo.maxValue = (unsigned int)(std::lround(maxValue));
+        propInfo.minAbsoluteValue = minValue;
+        propInfo.maxAbsoluteValue = maxValue;
+        propInfo.haveUnits = true;
+        propInfo.units = units;
+        propInfo.unitsAbbr = units;
+        propertyInfoMap_[propType] = propInfo;
+
+        Property prop;
+        prop.type = propType;
+        prop.present = true;
+        prop.absoluteControl = true;
+        prop.onePush = false;
+        prop.on = true;
+        prop.autoActive = false;
+        prop.value = (unsigned int)(std::lround(value));
+        prop.absoluteValue = value;
+        propertyMap_[propType] = prop;
+    }
+
+
+    double CameraDevice_sim::getFrameRateValue()
+    {
+        return double(propertyMap_[PROPERTY_TYPE_FRAME_RATE].absoluteValue);
+    }
+
+
+    CameraDevice_sim::SimClock::time_point CameraDevice_sim::getFrameTime(uint64_t frameNumber)
+    {
+        // Computed from the anchor rather than accumulated so rounding errors 
+        // don't make the rate drift.
+        std::chrono::duration<double> dt(double(frameNumber - anchorFrame_)/getFrameRateValue());
+        return anchorTime_ + std::chrono::duration_cast<SimClock::duration>(dt);
+    }
+
+
+    int CameraDevice_sim::getOpencvType()
+    {
+        return (format7Settings_.pixelFormat == PIXEL_FORMAT_MONO8) ? CV_8UC1 : CV_16UC1;
+    }
+
+
+    unsigned int CameraDevice_sim::getPixelValue(double frac)
+    {
+        // 12-bit data is in the upper bits of a 16-bit pixel, as delivered by
+        // the camera backends.
+        frac = std::min(std::max(frac, 0.0), 1.0);
+        switch (format7Settings_.pixelFormat)
+        {
+            case PIXEL_FORMAT_MONO12:
+                return (unsigned int)(std::lround(frac*4095.0)) << 4;
+
+            case PIXEL_FORMAT_MONO16:
+                return (unsigned int)(std::lround(frac*65535.0));
+
+            default:
+                return (unsigned int)(std::lround(frac*255.0));
+        }
+    }
+
+
+    void CameraDevice_sim::createSourceImage()
+    {
+        // Rendered once per capture (or format change). Each frame is then a
+        // window into this image, moved according to the content type.
+        int rows = int(format7Settings_.height + SourceMargin);
+        int cols = int(format7Settings_.width + SourceMargin);
+        sourceImage_ = cv::Mat(rows, cols, getOpencvType());
+        bool is16Bit = (sourceImage_.depth() == CV_16U);
+
+        std::uniform_real_distribution<double> uniformDist(0.0, 1.0);
+
+        for (int i=0; i<rows; i++)
+        {
+            uint8_t *rowPtr8 = sourceImage_.ptr<uint8_t>(i);
+            uint16_t *rowPtr16 = sourceImage_.ptr<uint16_t>(i);
+
+            for (int j=0; j<cols; j++)
+            {
+                double frac = CONSTANT_LEVEL;
+                switch (config_.content)
+                {
+                    case SIM_CONTENT_GRADIENT:
+                        frac = double((i + j)%SourceMargin)/double(SourceMargin - 1);
+                        break;
+
+                    case SIM_CONTENT_NOISE:
+                        frac = uniformDist(rng_);
+                        break;
+
+                    case SIM_CONTENT_BLOBS:
+                        frac = BLOB_BACKGROUND_LEVEL;
+                        break;
+
+                    default:
+                        break;
+                }
+
+                unsigned int value = getPixelValue(frac);
+                if (is16Bit)
+                {
+                    rowPtr16[j] = uint16_t(value);
+                }
+                else
+                {
+                    rowPtr8[j] = uint8_t(value);
+                }
+            }
+        }
+    }
+
+
+    void CameraDevice_sim::renderImage(uint64_t frameNumber, double frameTimeSec, cv::Mat &image)
+    {
+        int rows = int(format7Settings_.height);
+        int cols = int(format7Settings_.width);
+        int type = getOpencvType();
+
+        if (imagePoolPtr_)
+        {
+            imagePoolPtr_ -> getImage(image, rows, cols, type);
+        }
+        else
+        {
+            image.create(rows, cols, type);
+        }
+
+        int dx = 0;
+        int dy = 0;
+        switch (config_.content)
+        {
+            case SIM_CONTENT_GRADIENT:
+                dx = int((frameNumber + format7Settings_.offsetX)%SourceMargin);
+                dy = int(format7Settings_.offsetY%SourceMargin);
+                break;
+
+            case SIM_CONTENT_NOISE:
+                dx = int(rng_()%SourceMargin);
+                dy = int(rng_()%SourceMargin);
+                break;
+
+            default:
+                break;
+        }
+        sourceImage_(cv::Rect(dx, dy, cols, rows)).copyTo(image);
+
+        if (config_.content == SIM_CONTENT_BLOBS)
+        {
+            drawBlobs(frameTimeSec, image);
+        }
+    }
+
+
+    void CameraDevice_sim::drawBlobs(double frameTimeSec, cv::Mat &image)
+    {
+        // Blobs move on closed paths at a speed set in seconds, not frames, so
+        // the motion looks the same whatever the frame rate.
+        int size = std::min(int(config_.blobSize), std::min(image.rows, image.cols));
+        cv::Scalar value = cv::Scalar(double(getPixelValue(BLOB_LEVEL)));
+
+        for (unsigned int i=0; i<config_.numBlobs; i++)
+        {
+            double phase = 2.0*PI*double(i)/double(config_.numBlobs);
+            double freq = BLOB_FREQ_HZ*(1.0 + 0.25*double(i));
+            double cx = 0.5*image.cols*(1.0 + 2.0*BLOB_PATH_RADIUS*std::cos(2.0*PI*freq*frameTimeSec + phase));
+            double cy = 0.5*image.rows*(1.0 + 2.0*BLOB_PATH_RADIUS*std::sin(2.6*PI*freq*frameTimeSec + phase));
+            int x = std::min(std::max(int(cx) - size/2, 0), image.cols - size);
+            int y = std::min(std::max(int(cy) - size/2, 0), image.rows - size);
+            image(cv::Rect(x, y, size, size)).setTo(value);
+        }
+    }
+
+
+    void CameraDevice_sim::updateTimeStamp(SimClock::time_point frameTime)
+    {
+        double timeUs = std::chrono::duration<double,std::micro>(frameTime - startTime_).count();
+        if (config_.jitterUs > 0.0)
+        {
+            std::normal_distribution<double> jitterDist(0.0, config_.jitterUs);
+            timeUs += jitterDist(rng_);
+        }
+
+        // Jitter mustn't reorder frames
+        int64_t timeStampUs = std::max(int64_t(std::llround(timeUs)), lastTimeStampUs_ + 1);
+        lastTimeStampUs_ = timeStampUs;
+
+        timeStamp_.seconds = (unsigned long long)(timeStampUs/INT64_C(1000000));
+        timeStamp_.microSeconds = (unsigned int)(timeStampUs%INT64_C(1000000));
+    }
+
+
+    void CameraDevice_sim::updateGrabStats(double dtUs)
+    {
+        grabStats_.numFrames++;
+        grabStats_.lastUs = dtUs;
+        grabStats_.meanUs += (dtUs - grabStats_.meanUs)/double(grabStats_.numFrames);
+        grabStats_.maxUs = std::max(grabStats_.maxUs, dtUs);
+    }
+
+}
+
+#endif // #ifdef WITH_SIM
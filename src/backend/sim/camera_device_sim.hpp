@@ -0,0 +1,157 @@
+#ifdef WITH_SIM
+#ifndef BIAS_CAMERA_DEVICE_SIM_HPP
+#define BIAS_CAMERA_DEVICE_SIM_HPP
+
+#include <map>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+
+#include "utils.hpp"
+#include "camera_device.hpp"
+#include "property.hpp"
+#include "sim_camera_config.hpp"
+
+namespace bias {
+
+    class CameraDevice_sim : public CameraDevice
+    {
+        // --------------------------------------------------------------------
+        // Simulated camera - produces synthetic frames on an exact schedule
+        // (frame n is due at start + n/frameRate) without any hardware. The
+        // grab sleeps until the next frame is due rather than spinning. 
+        // Timestamps come from the schedule plus optional gaussian jitter, and
+        // a configurable fraction of frames can be dropped or made to fail so 
+        // the capture pipeline's error handling can be exercised. If the 
+        // reader falls more than NumBufferedFrames behind, the frames in 
+        // between are lost as they would be with a real camera.
+        // --------------------------------------------------------------------
+
+        public:
+
+            CameraDevice_sim(); 
+            explicit CameraDevice_sim(Guid guid);
+            virtual ~CameraDevice_sim();
+
+            virtual CameraLib getCameraLib();
+
+            virtual void connect();
+            virtual void disconnect();
+            
+            virtual void startCapture();
+            virtual void stopCapture();
+
+            virtual cv::Mat grabImage();
+            virtual void grabImage(cv::Mat &image);
+            virtual void setGrabTimeout(int timeoutMs);
+
+            virtual bool isColor();
+            
+            virtual bool isSupported(VideoMode vidMode, FrameRate frmRate);
+            virtual bool isSupported(ImageMode imgMode);
+            virtual unsigned int getNumberOfImageMode();
+
+            virtual VideoMode getVideoMode();
+            virtual FrameRate getFrameRate();
+            virtual ImageMode getImageMode();
+
+            virtual VideoModeList getAllowedVideoModes();
+            virtual FrameRateList getAllowedFrameRates(VideoMode vidMode);
+            virtual ImageModeList getAllowedImageModes();
+
+            virtual PropertyInfo getPropertyInfo(PropertyType propType);
+            virtual Property getProperty(PropertyType propType);
+            virtual void setProperty(Property prop);
+
+            virtual Format7Settings getFormat7Settings();
+            virtual Format7Info getFormat7Info(ImageMode imgMode);
+            
+            virtual bool validateFormat7Settings(Format7Settings settings);
+            virtual void setFormat7Configuration(Format7Settings settings, float percentSpeed);
+            
+            virtual PixelFormatList getListOfSupportedPixelFormats(ImageMode imgMode);
+
+            virtual void setTriggerInternal();
+            virtual void setTriggerExternal();
+            virtual TriggerType getTriggerType();
+
+            virtual std::string getVendorName();
+            virtual std::string getModelName();
+
+            virtual TimeStamp getImageTimeStamp();
+
+            virtual GrabStats getGrabStats();
+            virtual void resetGrabStats();
+            
+            virtual std::string toString();
+
+            virtual void printGuid();
+            
+            virtual void printInfo();
+
+            // Constants
+            // --------------------------------------------------------
+            // Frames the simulated camera buffers before old ones are lost 
+            static constexpr unsigned int NumBufferedFrames = 10;
+
+            // Extra rows/cols in the pre-rendered source image. Frames are
+            // windows into it so moving/changing content is a single copy.
+            static constexpr unsigned int SourceMargin = 256;
+
+            static constexpr unsigned int ImageHStepSize = 8;
+            static constexpr unsigned int ImageVStepSize = 2;
+            static constexpr unsigned int OffsetHStepSize = 2;
+            static constexpr unsigned int OffsetVStepSize = 2;
+
+        private:
+
+            typedef std::chrono::steady_clock SimClock;
+
+            SimCameraConfig config_;
+            Format7Settings format7Settings_;
+            std::map<PropertyType, PropertyInfo> propertyInfoMap_;
+            std::map<PropertyType, Property> propertyMap_;
+
+            int grabTimeoutMs_ = -1;
+            GrabStats grabStats_ = GrabStats();
+            TriggerType triggerType_ = TRIGGER_INTERNAL;
+
+            // Frame schedule - frame n is due at anchorTime_ + (n - anchorFrame_)/rate.
+            // Re-anchored when the frame rate changes so the schedule is continuous.
+            SimClock::time_point startTime_;
+            SimClock::time_point anchorTime_;
+            uint64_t anchorFrame_ = 0;
+            uint64_t frameNumber_ = 0;
+
+            TimeStamp timeStamp_ = {0,0};
+            int64_t lastTimeStampUs_ = -1;
+
+            cv::Mat sourceImage_;
+            std::mt19937 rng_;
+
+            void initialize();
+            void initializeProperties();
+            void addProperty(PropertyType propType, float minValue, float maxValue, float value, std::string units);
+
+            double getFrameRateValue();
+            SimClock::time_point getFrameTime(uint64_t frameNumber);
+
+            int getOpencvType();
+            unsigned int getPixelValue(double frac);
+            void createSourceImage();
+            void renderImage(uint64_t frameNumber, double frameTimeSec, cv::Mat &image);
+            void drawBlobs(double frameTimeSec, cv::Mat &image);
+
+            void updateTimeStamp(SimClock::time_point frameTime);
+            void updateGrabStats(double dtUs);
+    };
+
+
+    typedef std::shared_ptr<CameraDevice_sim> CameraDevicePtr_sim;
+
+}
+
+#endif // #ifndef BIAS_CAMERA_DEVICE_SIM_HPP
+#endif // #ifdef WITH_SIM
@@ -0,0 +1,66 @@
+#ifdef WITH_SIM
+
+#include "guid_device_sim.hpp"
+#include <sstream>
+#include <iostream>
+
+namespace bias {
+
+    GuidDevice_sim::GuidDevice_sim() 
+    {
+        value_.index = 0;
+    }
+
+    GuidDevice_sim::GuidDevice_sim(SimGuid guid_sim) 
+    { 
+        value_ = guid_sim; 
+    }
+
+    CameraLib GuidDevice_sim::getCameraLib() 
+    { 
+        return CAMERA_LIB_SIM; 
+    }
+
+    std::string GuidDevice_sim::toString() 
+    {
+        std::stringstream ss;
+        ss << "sim" << value_.index;
+        return ss.str();
+    }
+
+    void GuidDevice_sim::printValue() 
+    {
+        std::cout << "guid: " << toString() << std::endl;
+    }
+    
+    SimGuid GuidDevice_sim::getValue() 
+    { 
+        return value_; 
+    }
+
+    bool GuidDevice_sim::isEqual(GuidDevice &guid)
+    {
+        return toString().compare(guid.toString()) == 0;
+    }
+
+    bool GuidDevice_sim::lessThan(GuidDevice &guid) 
+    {
+        // Compare as strings so simulated and real camera guids (which are
+        // compared the same way by the Spinnaker backend) order consistently.
+        return toString().compare(guid.toString()) < 0;
+    }
+
+    bool GuidDevice_sim::lessThanEqual(GuidDevice &guid)
+    {
+        if (isEqual(guid)) 
+        {
+            return true;
+        }
+        else
+        {
+            return lessThan(guid);
+        }
+    }
+}
+    
+#endif // #ifdef WITH_SIM
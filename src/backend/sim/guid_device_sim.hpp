@@ -0,0 +1,43 @@
+#ifdef WITH_SIM
+#ifndef BIAS_GUID_DEVICE_SIM_HPP
+#define BIAS_GUID_DEVICE_SIM_HPP
+
+#include <string>
+#include <memory>
+#include "basic_types.hpp"
+#include "guid_device.hpp"
+
+namespace bias {
+
+    // Simulated cameras are identified by their index
+    struct SimGuid
+    {
+        unsigned int index;
+    };
+
+    class GuidDevice_sim : public GuidDevice 
+    {
+        // ---------------------------------------------------------------------
+        // Provides representation of simulated camera guids
+        // ---------------------------------------------------------------------
+        public:
+            GuidDevice_sim();
+            explicit GuidDevice_sim(SimGuid guid_sim);
+            virtual ~GuidDevice_sim() {};
+            virtual CameraLib getCameraLib();
+            virtual void printValue();
+            virtual std::string toString();
+            SimGuid getValue();
+
+        private:
+            SimGuid value_;
+            virtual bool isEqual(GuidDevice &guid);
+            virtual bool lessThan(GuidDevice &guid);
+            virtual bool lessThanEqual(GuidDevice &guid);
+    };
+
+    typedef std::shared_ptr<GuidDevice_sim> GuidDevicePtr_sim;
+}
+
+#endif // #ifndef BIAS_GUID_DEVICE_SIM_HPP
+#endif // #ifdef  WITH_SIM
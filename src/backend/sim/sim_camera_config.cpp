@@ -0,0 +1,202 @@
+#ifdef WITH_SIM
+
+#include "sim_camera_config.hpp"
+#include "utils.hpp"
+#include <cstdlib>
+#include <cerrno>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+namespace bias {
+
+    const unsigned int SimCameraConfig::DEFAULT_NUM_CAMERAS = 1;
+    const unsigned int SimCameraConfig::MAX_NUM_CAMERAS = 16;
+    const double SimCameraConfig::DEFAULT_FRAME_RATE = 100.0;
+    const double SimCameraConfig::MIN_FRAME_RATE = 1.0;
+    const double SimCameraConfig::MAX_FRAME_RATE = 20000.0;
+    const unsigned int SimCameraConfig::DEFAULT_WIDTH = 640;
+    const unsigned int SimCameraConfig::DEFAULT_HEIGHT = 480;
+    const unsigned int SimCameraConfig::MAX_WIDTH = 2048;
+    const unsigned int SimCameraConfig::MAX_HEIGHT = 2048;
+    const unsigned int SimCameraConfig::DEFAULT_NUM_BLOBS = 4;
+    const unsigned int SimCameraConfig::DEFAULT_BLOB_SIZE = 24;
+
+    // Environment helpers - unset variables leave the value unchanged, bad
+    // values are reported and ignored.
+    // ------------------------------------------------------------------------
+
+    static bool getEnvString(const char *name, std::string &value)
+    {
+        const char *str = std::getenv(name);
+        if ((str == nullptr) || (*str == '\0'))
+        {
+            return false;
+        }
+        value = std::string(str);
+        return true;
+    }
+
+
+    static void warnBadValue(const char *name, std::string valueStr)
+    {
+        std::cout << "WARNING: ignoring invalid value " << name << "=" << valueStr << std::endl;
+    }
+
+
+    static void getEnvDouble(const char *name, double minValue, double maxValue, double &value)
+    {
+        std::string valueStr;
+        if (!getEnvString(name, valueStr))
+        {
+            return;
+        }
+        char *end = nullptr;
+        errno = 0;
+        double tmpValue = std::strtod(valueStr.c_str(), &end);
+        if ((errno != 0) || (*end != '\0') || !(tmpValue >= minValue) || !(tmpValue <= maxValue))
+        {
+            warnBadValue(name, valueStr);
+            return;
+        }
+        value = tmpValue;
+    }
+
+
+    static void getEnvUInt(const char *name, unsigned int minValue, unsigned int maxValue, unsigned int &value)
+    {
+        double tmpValue = double(value);
+        getEnvDouble(name, double(minValue), double(maxValue), tmpValue);
+        value = (unsigned int)(tmpValue);
+    }
+
+
+    // SimCameraConfig
+    // ------------------------------------------------------------------------
+
+    SimCameraConfig::SimCameraConfig()
+    {
+        frameRate = DEFAULT_FRAME_RATE;
+        width = DEFAULT_WIDTH;
+        height = DEFAULT_HEIGHT;
+        pixelFormat = PIXEL_FORMAT_MONO8;
+        content = SIM_CONTENT_BLOBS;
+        numBlobs = DEFAULT_NUM_BLOBS;
+        blobSize = DEFAULT_BLOB_SIZE;
+        jitterUs = 0.0;
+        dropRate = 0.0;
+        errorRate = 0.0;
+    }
+
+
+    std::string SimCameraConfig::toString()
+    {
+        std::stringstream ss;
+        ss << "frameRate:   " << frameRate << std::endl;
+        ss << "width:       " << width << std::endl;
+        ss << "height:      " << height << std::endl;
+        ss << "pixelFormat: " << getPixelFormatString(pixelFormat) << std::endl;
+        ss << "content:     " << getSimContentString(content) << std::endl;
+        ss << "numBlobs:    " << numBlobs << std::endl;
+        ss << "blobSize:    " << blobSize << std::endl;
+        ss << "jitterUs:    " << jitterUs << std::endl;
+        ss << "dropRate:    " << dropRate << std::endl;
+        ss << "errorRate:   " << errorRate << std::endl;
+        return ss.str();
+    }
+
+
+    void SimCameraConfig::print()
+    {
+        std::cout << toString();
+    }
+
+
+    SimCameraConfig SimCameraConfig::fromEnvironment()
+    {
+        SimCameraConfig config;
+
+        getEnvDouble("BIAS_SIM_FRAME_RATE", MIN_FRAME_RATE, MAX_FRAME_RATE, config.frameRate);
+        getEnvUInt("BIAS_SIM_WIDTH", 1, MAX_WIDTH, config.width);
+        getEnvUInt("BIAS_SIM_HEIGHT", 1, MAX_HEIGHT, config.height);
+        getEnvUInt("BIAS_SIM_NUM_BLOBS", 0, 100, config.numBlobs);
+        getEnvUInt("BIAS_SIM_BLOB_SIZE", 1, 512, config.blobSize);
+        getEnvDouble("BIAS_SIM_JITTER_US", 0.0, 1.0e6, config.jitterUs);
+        getEnvDouble("BIAS_SIM_DROP_RATE", 0.0, 1.0, config.dropRate);
+        getEnvDouble("BIAS_SIM_ERROR_RATE", 0.0, 1.0, config.errorRate);
+
+        std::string valueStr;
+        if (getEnvString("BIAS_SIM_PIXEL_FORMAT", valueStr))
+        {
+            std::transform(valueStr.begin(), valueStr.end(), valueStr.begin(), ::tolower);
+            if (valueStr == "mono8")
+            {
+                config.pixelFormat = PIXEL_FORMAT_MONO8;
+            }
+            else if (valueStr == "mono12")
+            {
+                config.pixelFormat = PIXEL_FORMAT_MONO12;
+            }
+            else if (valueStr == "mono16")
+            {
+                config.pixelFormat = PIXEL_FORMAT_MONO16;
+            }
+            else
+            {
+                warnBadValue("BIAS_SIM_PIXEL_FORMAT", valueStr);
+            }
+        }
+
+        if (getEnvString("BIAS_SIM_CONTENT", valueStr))
+        {
+            std::transform(valueStr.begin(), valueStr.end(), valueStr.begin(), ::tolower);
+            bool found = false;
+            for (int i=0; i<NUMBER_OF_SIM_CONTENT; i++)
+            {
+                if (valueStr == getSimContentString(SimContent(i)))
+                {
+                    config.content = SimContent(i);
+                    found = true;
+                }
+            }
+            if (!found)
+            {
+                warnBadValue("BIAS_SIM_CONTENT", valueStr);
+            }
+        }
+        return config;
+    }
+
+
+    unsigned int SimCameraConfig::getNumberOfCameras()
+    {
+        unsigned int numCameras = DEFAULT_NUM_CAMERAS;
+        getEnvUInt("BIAS_SIM_NUM_CAMERAS", 0, MAX_NUM_CAMERAS, numCameras);
+        return numCameras;
+    }
+
+
+    std::string getSimContentString(SimContent content)
+    {
+        switch (content)
+        {
+            case SIM_CONTENT_GRADIENT:
+                return std::string("gradient");
+
+            case SIM_CONTENT_NOISE:
+                return std::string("noise");
+
+            case SIM_CONTENT_BLOBS:
+                return std::string("blobs");
+
+            case SIM_CONTENT_CONSTANT:
+                return std::string("constant");
+
+            default:
+                return std::string("unknown");
+        }
+    }
+
+}
+
+#endif // #ifdef WITH_SIM
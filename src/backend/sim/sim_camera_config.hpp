@@ -0,0 +1,80 @@
+#ifdef WITH_SIM
+#ifndef BIAS_SIM_CAMERA_CONFIG_HPP
+#define BIAS_SIM_CAMERA_CONFIG_HPP
+
+#include <string>
+#include "basic_types.hpp"
+
+namespace bias {
+
+    enum SimContent
+    {
+        SIM_CONTENT_GRADIENT,   // diagonal stripes moving one pixel per frame
+        SIM_CONTENT_NOISE,      // uniform noise, different every frame
+        SIM_CONTENT_BLOBS,      // bright squares moving over a dark background
+        SIM_CONTENT_CONSTANT,   // flat gray 
+        NUMBER_OF_SIM_CONTENT,
+    };
+
+
+    struct SimCameraConfig
+    {
+        // --------------------------------------------------------------------
+        // Initial settings for a simulated camera. Frame rate, image size and 
+        // pixel format can be changed later through the usual property and 
+        // format7 calls; content, jitter and the injected drop/error rates
+        // are fixed for the life of the camera. 
+        //
+        // Values are read from the environment (e.g. BIAS_SIM_FRAME_RATE=2000) 
+        // so the GUI and the tests can use the backend unchanged:
+        //
+        //   BIAS_SIM_NUM_CAMERAS   number of simulated cameras 
+        //   BIAS_SIM_FRAME_RATE    frames per second
+        //   BIAS_SIM_WIDTH         image width
+        //   BIAS_SIM_HEIGHT        image height
+        //   BIAS_SIM_PIXEL_FORMAT  mono8, mono12 or mono16
+        //   BIAS_SIM_CONTENT       gradient, noise, blobs or constant
+        //   BIAS_SIM_NUM_BLOBS     number of blobs (blobs content)
+        //   BIAS_SIM_BLOB_SIZE     blob width/height in pixels 
+        //   BIAS_SIM_JITTER_US     std. dev. of timestamp jitter in usec
+        //   BIAS_SIM_DROP_RATE     fraction of frames silently dropped
+        //   BIAS_SIM_ERROR_RATE    fraction of grabs which fail with an error
+        // --------------------------------------------------------------------
+
+        static const unsigned int DEFAULT_NUM_CAMERAS;
+        static const unsigned int MAX_NUM_CAMERAS;
+        static const double DEFAULT_FRAME_RATE;
+        static const double MIN_FRAME_RATE;
+        static const double MAX_FRAME_RATE;
+        static const unsigned int DEFAULT_WIDTH;
+        static const unsigned int DEFAULT_HEIGHT;
+        static const unsigned int MAX_WIDTH;
+        static const unsigned int MAX_HEIGHT;
+        static const unsigned int DEFAULT_NUM_BLOBS;
+        static const unsigned int DEFAULT_BLOB_SIZE;
+
+        double frameRate;
+        unsigned int width;
+        unsigned int height;
+        PixelFormat pixelFormat;
+        SimContent content;
+        unsigned int numBlobs;
+        unsigned int blobSize;
+        double jitterUs;
+        double dropRate;
+        double errorRate;
+
+        SimCameraConfig();
+        std::string toString();
+        void print();
+
+        static SimCameraConfig fromEnvironment();
+        static unsigned int getNumberOfCameras();
+    };
+
+    std::string getSimContentString(SimContent content);
+
+}
+
+#endif // #ifndef BIAS_SIM_CAMERA_CONFIG_HPP
+#endif // #ifdef WITH_SIM
@@ -7,7 +7,9 @@
 #include <algorithm>
 #include <bitset>
 #include <fstream>
+#include <chrono>
 
+#include "image_allocator_spin.hpp"
 #include "base_node_spin.hpp"
 #include "string_node_spin.hpp"
 #include "enum_node_spin.hpp"
@@ -22,11 +24,16 @@
 namespace bias {
 
 
-    CameraDevice_spin::CameraDevice_spin() : CameraDevice() {}
+    CameraDevice_spin::CameraDevice_spin() : CameraDevice() 
+    {
+        imageAllocatorPtr_ = new ImageAllocator_spin();
+    }
 
 
     CameraDevice_spin::CameraDevice_spin(Guid guid) : CameraDevice(guid)
     {
+        imageAllocatorPtr_ = new ImageAllocator_spin();
+
         spinError err = spinSystemGetInstance(&hSystem_);
         if (err != SPINNAKER_ERR_SUCCESS) 
         {
@@ -39,7 +46,6 @@ namespace bias {
 
     CameraDevice_spin::~CameraDevice_spin() 
     {
-
         if (capturing_) 
         { 
             stopCapture(); 
@@ -50,6 +56,12 @@ namespace bias {
             disconnect(); 
         }
 
+        // Allocator deletes itself once any wrapped images still in use are 
+        // released - detached as the system is released below.
+        imageAllocatorPtr_ -> detach();
+        imageAllocatorPtr_ -> orphan();
+        imageAllocatorPtr_ = nullptr;
+
         spinError err = spinSystemReleaseInstance(hSystem_);
         if ( err != SPINNAKER_ERR_SUCCESS ) 
         {
@@ -306,6 +318,7 @@ namespace bias {
             }
 
             capturing_ = true;
+            resetGrabStats();
             //isFirst_ = true;
             //
         }
@@ -327,6 +340,20 @@ namespace bias {
                 throw RuntimeError(ERROR_SPIN_RELEASE_SPIN_IMAGE, ssError.str());
             }
 
+            // Zero-copy images may still be held downstream, e.g. in the log
+            // queue or a writer's compressor queue. They must be released before
+            // acquisition ends - any which aren't in time are detached and the
+            // camera gets a new allocator.
+            if (!(imageAllocatorPtr_ -> waitForRelease()))
+            {
+                std::cout << "warning: " << __FUNCTION__ << ": ";
+                std::cout << imageAllocatorPtr_ -> numOutstanding();
+                std::cout << " zero-copy images still in use, detaching" << std::endl;
+                imageAllocatorPtr_ -> detach();
+                imageAllocatorPtr_ -> orphan();
+                imageAllocatorPtr_ = new ImageAllocator_spin();
+            }
+
             spinError err = spinCameraEndAcquisition(hCamera_);
             if (err != SPINNAKER_ERR_SUCCESS)
             {
@@ -362,54 +389,94 @@ namespace bias {
             return;
         }
 
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
 
-        spinError err = SPINNAKER_ERR_SUCCESS;
-        spinImage hSpinImageConv = nullptr; 
-
-        err = spinImageCreateEmpty(&hSpinImageConv);
-        if (err != SPINNAKER_ERR_SUCCESS)
-        {
-            std::stringstream ssError;
-            ssError << __FUNCTION__;
-            ssError << ": unable to create empty spinImage, error = " << err; 
-            throw RuntimeError(ERROR_SPIN_IMAGE_CREATE_EMPTY, ssError.str());
-        }
-        
         spinPixelFormatEnums origPixelFormat = getImagePixelFormat_spin(hSpinImage_);
         spinPixelFormatEnums convPixelFormat = getSuitablePixelFormat(origPixelFormat);
-        
-        err = spinImageConvert(hSpinImage_, convPixelFormat, hSpinImageConv);
-        if (err != SPINNAKER_ERR_SUCCESS) 
+        int opencvPixelFormat = getCompatibleOpencvFormat(convPixelFormat);
+        bool isZeroCopy = false;
+
+        if (convPixelFormat == origPixelFormat)
+        {
+            // Fast path - camera already delivers a format opencv can use.  Wrap 
+            // the camera's buffer directly; the image takes ownership of the 
+            // spinImage and returns it to the stream when released.
+            ImageInfo_spin imageInfo = getImageInfo_spin(hSpinImage_);
+            isZeroCopy = imageAllocatorPtr_ -> wrapImage(
+                    hSpinImage_, 
+                    imageInfo, 
+                    opencvPixelFormat, 
+                    image
+                    );
+
+            if (isZeroCopy)
+            {
+                hSpinImage_ = nullptr;
+            }
+            else
+            {
+                // Too many images outstanding - copy, but no conversion required
+                copySpinImage(imageInfo, opencvPixelFormat, image);
+            }
+        }
+        else
         {
-            std::stringstream ssError;
-            ssError << __FUNCTION__;
-            ssError << ": unable to convert spinImage, error = " << err; 
-            throw RuntimeError(ERROR_SPIN_IMAGE_CONVERT, ssError.str());
+            spinError err = SPINNAKER_ERR_SUCCESS;
+            spinImage hSpinImageConv = nullptr; 
+
+            err = spinImageCreateEmpty(&hSpinImageConv);
+            if (err != SPINNAKER_ERR_SUCCESS)
+            {
+                std::stringstream ssError;
+                ssError << __FUNCTION__;
+                ssError << ": unable to create empty spinImage, error = " << err; 
+                throw RuntimeError(ERROR_SPIN_IMAGE_CREATE_EMPTY, ssError.str());
+            }
+
+            err = spinImageConvert(hSpinImage_, convPixelFormat, hSpinImageConv);
+            if (err != SPINNAKER_ERR_SUCCESS) 
+            {
+                std::stringstream ssError;
+                ssError << __FUNCTION__;
+                ssError << ": unable to convert spinImage, error = " << err; 
+                throw RuntimeError(ERROR_SPIN_IMAGE_CONVERT, ssError.str());
+            }
+
+            ImageInfo_spin imageInfo = getImageInfo_spin(hSpinImageConv);
+            copySpinImage(imageInfo, opencvPixelFormat, image);
+
+            // ----------------------------------------------------------------------------
+
+            if (!destroySpinImage(hSpinImageConv))
+            {
+                std::stringstream ssError;
+                ssError << __FUNCTION__;
+                ssError << ": unable to release spinImage";
+                throw RuntimeError(ERROR_SPIN_RELEASE_SPIN_IMAGE, ssError.str());
+            }
         }
 
-        ImageInfo_spin imageInfo = getImageInfo_spin(hSpinImageConv);
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        double dtUs = std::chrono::duration<double,std::micro>(t1 - t0).count();
+        updateGrabStats(dtUs, isZeroCopy);
+    }
 
-        int opencvPixelFormat = getCompatibleOpencvFormat(convPixelFormat);
 
-        cv::Mat imageTmp = cv::Mat( 
-                imageInfo.rows+imageInfo.ypad, 
-                imageInfo.cols+imageInfo.xpad, 
-                opencvPixelFormat, 
-                imageInfo.dataPtr, 
-                imageInfo.stride
-                );
+    void CameraDevice_spin::setGrabTimeout(int timeoutMs)
+    {
+        grabTimeoutMs_ = timeoutMs;
+    }
 
-        imageTmp.copyTo(image);
 
-        // ----------------------------------------------------------------------------
+    GrabStats CameraDevice_spin::getGrabStats()
+    {
+        return grabStats_;
+    }
 
-        if (!destroySpinImage(hSpinImageConv))
-        {
-            std::stringstream ssError;
-            ssError << __FUNCTION__;
-            ssError << ": unable to release spinImage";
-            throw RuntimeError(ERROR_SPIN_RELEASE_SPIN_IMAGE, ssError.str());
-        }
+
+    void CameraDevice_spin::resetGrabStats()
+    {
+        grabStats_ = GrabStats();
     }
 
 
@@ -990,7 +1057,12 @@ namespace bias {
         imageOK_ = false;
     
         // Get next image from camera
-        if (triggerType_ == TRIGGER_INTERNAL) 
+        if (grabTimeoutMs_ >= 0)
+        {
+            // Blocking mode - sleep in the driver until a frame arrives or timeout
+            err = spinCameraGetNextImageEx(hCamera_, uint64_t(grabTimeoutMs_), &hSpinImage_);
+        }
+        else if (triggerType_ == TRIGGER_INTERNAL) 
         {
             err = spinCameraGetNextImage(hCamera_, &hSpinImage_); // This fixes memory leak ??? why??
         }
@@ -1042,6 +1114,41 @@ namespace bias {
     }
 
 
+    void CameraDevice_spin::copySpinImage(
+            const ImageInfo_spin &imageInfo, 
+            int opencvPixelFormat, 
+            cv::Mat &image
+            )
+    {
+        cv::Mat imageTmp = cv::Mat( 
+                imageInfo.rows+imageInfo.ypad, 
+                imageInfo.cols+imageInfo.xpad, 
+                opencvPixelFormat, 
+                imageInfo.dataPtr, 
+                imageInfo.stride
+                );
+
+        if (imagePoolPtr_)
+        {
+            imagePoolPtr_ -> getImage(image, imageTmp.rows, imageTmp.cols, opencvPixelFormat);
+        }
+        imageTmp.copyTo(image);
+    }
+
+
+    void CameraDevice_spin::updateGrabStats(double dtUs, bool isZeroCopy)
+    {
+        grabStats_.numFrames++;
+        if (isZeroCopy)
+        {
+            grabStats_.numZeroCopy++;
+        }
+        grabStats_.lastUs = dtUs;
+        grabStats_.meanUs += (dtUs - grabStats_.meanUs)/double(grabStats_.numFrames);
+        grabStats_.maxUs = std::max(grabStats_.maxUs, dtUs);
+    }
+
+
     bool CameraDevice_spin::releaseSpinImage(spinImage &hImage)
     {
         bool rval = true;
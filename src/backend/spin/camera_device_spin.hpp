@@ -16,6 +16,8 @@
 
 namespace bias {
 
+    class ImageAllocator_spin;
+    struct ImageInfo_spin;
 
 
     class CameraDevice_spin : public CameraDevice
@@ -36,6 +38,7 @@ namespace bias {
 
             virtual cv::Mat grabImage();
             virtual void grabImage(cv::Mat &image);
+            virtual void setGrabTimeout(int timeoutMs);
 
             virtual bool isColor();
             
@@ -73,6 +76,9 @@ namespace bias {
             virtual std::string getModelName();
 
             virtual TimeStamp getImageTimeStamp();
+
+            virtual GrabStats getGrabStats();
+            virtual void resetGrabStats();
             
             virtual std::string toString();
 
@@ -114,9 +120,15 @@ namespace bias {
             bool imageOK_ = false;
             spinImage hSpinImage_ = nullptr;
 
+            int grabTimeoutMs_ = -1;
+            ImageAllocator_spin *imageAllocatorPtr_ = nullptr;
+            GrabStats grabStats_ = GrabStats();
+
             TriggerType triggerType_ =  TRIGGER_TYPE_UNSPECIFIED;
 
             bool grabImageCommon(std::string &errMsg);
+            void copySpinImage(const ImageInfo_spin &imageInfo, int opencvPixelFormat, cv::Mat &image);
+            void updateGrabStats(double dtUs, bool isZeroCopy);
             bool releaseSpinImage(spinImage &hImage);
             bool destroySpinImage(spinImage &hImage);
 
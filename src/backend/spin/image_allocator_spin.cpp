@@ -0,0 +1,162 @@
+#ifdef WITH_SPIN
+#include "image_allocator_spin.hpp"
+#include <chrono>
+
+namespace bias {
+
+    // Spinnaker's default stream buffer count is small (~10), keep most of them
+    // available to the camera.
+    const unsigned int ImageAllocator_spin::DEFAULT_MAX_OUTSTANDING = 4;
+
+    // Long enough for the logger and plugins to drain their queues on stop
+    const unsigned int ImageAllocator_spin::RELEASE_WAIT_TIMEOUT_MS = 2000;
+
+
+    ImageAllocator_spin::ImageAllocator_spin(unsigned int maxOutstanding) 
+    {
+        numOutstanding_ = 0;
+        maxOutstanding_ = maxOutstanding;
+        orphaned_ = false;
+        detached_ = false;
+    }
+
+
+    bool ImageAllocator_spin::wrapImage(
+            spinImage hImage, 
+            const ImageInfo_spin &imageInfo, 
+            int opencvPixelFormat, 
+            cv::Mat &image
+            )
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (orphaned_ || detached_ || (numOutstanding_ >= maxOutstanding_))
+            {
+                return false;
+            }
+            numOutstanding_++;
+        }
+
+        int rows = int(imageInfo.rows + imageInfo.ypad);
+        int cols = int(imageInfo.cols + imageInfo.xpad);
+
+        cv::UMatData *u = new cv::UMatData(this);
+        u -> data = u -> origdata = static_cast<uchar*>(imageInfo.dataPtr);
+        u -> size = imageInfo.stride*size_t(rows);
+        u -> flags |= cv::UMatData::USER_ALLOCATED;
+        u -> userdata = hImage;
+
+        // Header over the Spinnaker buffer which takes ownership of the spinImage
+        // through u - released in deallocate when the refcount drops to zero.
+        image.release();
+        image = cv::Mat(rows, cols, opencvPixelFormat, imageInfo.dataPtr, imageInfo.stride);
+        image.u = u;
+        u -> refcount = 1;
+        return true;
+    }
+
+
+    unsigned int ImageAllocator_spin::numOutstanding() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return numOutstanding_;
+    }
+
+
+    bool ImageAllocator_spin::waitForRelease(unsigned int timeoutMs) const
+    {
+        // Returns false if images are still outstanding after timeoutMs
+        std::unique_lock<std::mutex> lock(mutex_);
+        return releasedCond_.wait_for(
+                lock, 
+                std::chrono::milliseconds(timeoutMs), 
+                [this]() { return numOutstanding_ == 0; }
+                );
+    }
+
+
+    void ImageAllocator_spin::detach()
+    {
+        // Images released from now on are not handed back to Spinnaker. Takes
+        // the lock so no release is in progress once this returns.
+        std::lock_guard<std::mutex> lock(mutex_);
+        detached_ = true;
+    }
+
+
+    void ImageAllocator_spin::orphan()
+    {
+        bool deleteSelf = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            orphaned_ = true;
+            deleteSelf = (numOutstanding_ == 0);
+        }
+        if (deleteSelf)
+        {
+            delete this;
+        }
+    }
+
+
+    cv::UMatData* ImageAllocator_spin::allocate(
+            int dims, 
+            const int* sizes, 
+            int type, 
+            void* data, 
+            size_t* step, 
+            cv::AccessFlag flags, 
+            cv::UMatUsageFlags usageFlags
+            ) const
+    {
+        // Only wrapImage creates images with this allocator - anything else
+        // (e.g. a reallocation of a wrapped header) goes to the default allocator.
+        return cv::Mat::getDefaultAllocator() -> allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+
+    bool ImageAllocator_spin::allocate(
+            cv::UMatData* u, 
+            cv::AccessFlag accessFlags, 
+            cv::UMatUsageFlags usageFlags
+            ) const
+    {
+        return (u != nullptr);
+    }
+
+
+    void ImageAllocator_spin::deallocate(cv::UMatData* u) const
+    {
+        if (!u)
+        {
+            return;
+        }
+        CV_Assert(u -> urefcount == 0);
+        CV_Assert(u -> refcount == 0);
+
+        bool deleteSelf = false;
+        {
+            // Return buffer to the stream unless detached. Released under the
+            // lock so detach can't return while a release is in progress.
+            std::lock_guard<std::mutex> lock(mutex_);
+            spinImage hImage = static_cast<spinImage>(u -> userdata);
+            if ((hImage != nullptr) && (!detached_))
+            {
+                spinImageRelease(hImage);
+            }
+            numOutstanding_--;
+            deleteSelf = orphaned_ && (numOutstanding_ == 0);
+            releasedCond_.notify_all();
+        }
+        u -> origdata = 0;
+        delete u;
+
+        if (deleteSelf)
+        {
+            delete this;
+        }
+    }
+
+}
+
+#endif // #ifdef WITH_SPIN
@@ -0,0 +1,85 @@
+#ifdef WITH_SPIN
+#ifndef BIAS_IMAGE_ALLOCATOR_SPIN_HPP
+#define BIAS_IMAGE_ALLOCATOR_SPIN_HPP
+
+#include <mutex>
+#include <condition_variable>
+#include <opencv2/core/core.hpp>
+#include "SpinnakerC.h"
+#include "utils_spin.hpp"
+
+namespace bias {
+
+
+    class ImageAllocator_spin : public cv::MatAllocator
+    {
+        // ------------------------------------------------------------------------
+        // Wraps Spinnaker image buffers in reference counted cv::Mats without 
+        // copying. The spinImage is held until the last cv::Mat referring to it is
+        // released and is then handed back to the acquisition stream. Only a 
+        // limited number of images may be outstanding at once, as each one ties 
+        // up a stream buffer - wrapImage returns false when that limit is reached
+        // and the caller should fall back to copying.
+        //
+        // Outstanding images must be released before the camera's acquisition
+        // ends - waitForRelease waits for them. Any which cannot be waited for
+        // are detached, so their spinImages are never released once the 
+        // acquisition has ended or the system has been released.
+        //
+        // Create with new and dispose of with orphan(); the allocator deletes 
+        // itself once all outstanding images have been released.
+        // ------------------------------------------------------------------------
+
+        public:
+
+            static const unsigned int DEFAULT_MAX_OUTSTANDING;
+            static const unsigned int RELEASE_WAIT_TIMEOUT_MS;
+
+            explicit ImageAllocator_spin(unsigned int maxOutstanding=DEFAULT_MAX_OUTSTANDING);
+
+            bool wrapImage(
+                    spinImage hImage, 
+                    const ImageInfo_spin &imageInfo, 
+                    int opencvPixelFormat, 
+                    cv::Mat &image
+                    );
+
+            unsigned int numOutstanding() const;
+            bool waitForRelease(unsigned int timeoutMs=RELEASE_WAIT_TIMEOUT_MS) const;
+            void detach();
+            void orphan();
+
+            virtual cv::UMatData* allocate(
+                    int dims, 
+                    const int* sizes, 
+                    int type, 
+                    void* data, 
+                    size_t* step, 
+                    cv::AccessFlag flags, 
+                    cv::UMatUsageFlags usageFlags
+                    ) const;
+
+            virtual bool allocate(
+                    cv::UMatData* u, 
+                    cv::AccessFlag accessFlags, 
+                    cv::UMatUsageFlags usageFlags
+                    ) const;
+
+            virtual void deallocate(cv::UMatData* u) const;
+
+        private:
+
+            mutable std::mutex mutex_;
+            mutable std::condition_variable releasedCond_;
+            mutable unsigned int numOutstanding_;
+            unsigned int maxOutstanding_;
+            bool orphaned_;
+            bool detached_;
+
+            virtual ~ImageAllocator_spin() {};
+    };
+
+}
+
+#endif // #ifndef BIAS_IMAGE_ALLOCATOR_SPIN_HPP
+#endif // #ifdef WITH_SPIN
@@ -0,0 +1,762 @@
+#include "video_reader.hpp"
+#include "pack12.hpp"
+#include <QFileInfo>
+#include <QDir>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <map>
+#include <cstring>
+#include <opencv2/highgui/highgui.hpp>
+
+namespace bias
+{
+
+    namespace
+    {
+        // Bounds checked little-endian reads from the mapped file
+        class MappedCursor
+        {
+            public:
+
+                MappedCursor(const uchar *data, uint64_t size, uint64_t pos=0)
+                {
+                    data_ = data;
+                    size_ = size;
+                    pos_ = pos;
+                    ok_ = (pos <= size);
+                }
+
+                template <class T> T read()
+                {
+                    T value = T(0);
+                    if (ok_ && (size_ - pos_ >= sizeof(T)))
+                    {
+                        std::memcpy(&value, data_ + pos_, sizeof(T));
+                        pos_ += sizeof(T);
+                    }
+                    else
+                    {
+                        ok_ = false;
+                    }
+                    return value;
+                }
+
+                const uchar *skip(uint64_t numBytes)
+                {
+                    const uchar *ptr = nullptr;
+                    if (ok_ && (size_ - pos_ >= numBytes))
+                    {
+                        ptr = data_ + pos_;
+                        pos_ += numBytes;
+                    }
+                    else
+                    {
+                        ok_ = false;
+                    }
+                    return ptr;
+                }
+
+                std::string readString(uint64_t length)
+                {
+                    const uchar *ptr = skip(length);
+                    return (ptr != nullptr) ? std::string((const char *) ptr, length) : std::string();
+                }
+
+                bool ok() const { return ok_; }
+                uint64_t pos() const { return pos_; }
+
+            private:
+
+                const uchar *data_;
+                uint64_t size_;
+                uint64_t pos_;
+                bool ok_;
+        };
+
+
+        struct UfmfIndexArray
+        {
+            char dtype;
+            const uchar *data;
+            uint32_t numBytes;
+        };
+
+        typedef std::map<std::string, UfmfIndexArray> UfmfIndexMap;
+
+        template <class T> std::vector<T> getIndexArray(const UfmfIndexMap &indexMap, std::string key, char dtype)
+        {
+            std::vector<T> values;
+            UfmfIndexMap::const_iterator it = indexMap.find(key);
+            if ((it != indexMap.end()) && (it -> second.dtype == dtype))
+            {
+                values.resize(it -> second.numBytes/sizeof(T));
+                if (!values.empty())
+                {
+                    std::memcpy(&values[0], it -> second.data, values.size()*sizeof(T));
+                }
+            }
+            return values;
+        }
+
+    } // namespace
+
+
+    // VideoReader
+    // --------------------------------------------------------------------------------
+    VideoReader::VideoReader()
+    {
+        data_ = nullptr;
+        size_ = 0;
+        numFrames_ = 0;
+        width_ = 0;
+        height_ = 0;
+        imageType_ = CV_8UC1;
+    }
+
+
+    VideoReader::~VideoReader()
+    {
+        close();
+    }
+
+
+    void VideoReader::close()
+    {
+        if (data_ != nullptr)
+        {
+            file_.unmap(const_cast<uchar*>(data_));
+            data_ = nullptr;
+        }
+        if (file_.isOpen())
+        {
+            file_.close();
+        }
+        size_ = 0;
+        numFrames_ = 0;
+    }
+
+
+    bool VideoReader::isOpen() const
+    {
+        return (data_ != nullptr);
+    }
+
+
+    QString VideoReader::getErrorMsg() const
+    {
+        return errorMsg_;
+    }
+
+
+    int VideoReader::getNumFrames() const
+    {
+        return numFrames_;
+    }
+
+
+    int VideoReader::getImageWidth() const
+    {
+        return width_;
+    }
+
+
+    int VideoReader::getImageHeight() const
+    {
+        return height_;
+    }
+
+
+    int VideoReader::getImageType() const
+    {
+        return imageType_;
+    }
+
+
+    float VideoReader::getFPS() const
+    {
+        // Estimated from the first and last time stamps
+        if (numFrames_ > 1)
+        {
+            double dt = getTimeStamp(numFrames_-1) - getTimeStamp(0);
+            if (dt > 0.0)
+            {
+                return float(double(numFrames_-1)/dt);
+            }
+        }
+        return 0.0f;
+    }
+
+
+    double VideoReader::getTimeStamp(int frame) const
+    {
+        if ((frame < 0) || (frame >= int(timeStamps_.size())))
+        {
+            return 0.0;
+        }
+        return timeStamps_[frame];
+    }
+
+
+    bool VideoReader::getFrameView(int frame, cv::Mat &image)
+    {
+        return false;
+    }
+
+
+    std::shared_ptr<VideoReader> VideoReader::create(QString fileName)
+    {
+        std::shared_ptr<VideoReader> readerPtr;
+        QString suffix = QFileInfo(fileName).suffix().toLower();
+        if (suffix == QString("fmf"))
+        {
+            readerPtr = std::make_shared<VideoReader_fmf>();
+        }
+        else if (suffix == QString("ufmf"))
+        {
+            readerPtr = std::make_shared<VideoReader_ufmf>();
+        }
+        else if (suffix == QString("mjpg"))
+        {
+            readerPtr = std::make_shared<VideoReader_mjpg>();
+        }
+        if (readerPtr)
+        {
+            readerPtr -> open(fileName);
+        }
+        return readerPtr;
+    }
+
+
+    bool VideoReader::mapFile(QString fileName)
+    {
+        close();
+        errorMsg_ = QString();
+        file_.setFileName(fileName);
+        if (!file_.open(QIODevice::ReadOnly))
+        {
+            return setError(QString("unable to open %1").arg(fileName));
+        }
+        size_ = uint64_t(file_.size());
+        if (size_ == 0)
+        {
+            file_.close();
+            return setError(QString("%1 is empty").arg(fileName));
+        }
+
+        // Private mapping so stray writes through frame views never reach the file
+        data_ = file_.map(0, file_.size(), QFileDevice::MapPrivateOption);
+        if (data_ == nullptr)
+        {
+            file_.close();
+            return setError(QString("unable to map %1").arg(fileName));
+        }
+        return true;
+    }
+
+
+    bool VideoReader::setError(QString errorMsg)
+    {
+        errorMsg_ = errorMsg;
+        close();
+        return false;
+    }
+
+
+    // VideoReader_fmf
+    // --------------------------------------------------------------------------------
+    VideoReader_fmf::VideoReader_fmf()
+    {
+        headerSize_ = 0;
+        bytesPerChunk_ = 0;
+        packed12_ = false;
+    }
+
+
+    bool VideoReader_fmf::open(QString fileName)
+    {
+        if (!mapFile(fileName))
+        {
+            return false;
+        }
+
+        MappedCursor cursor(data_, size_);
+        uint32_t version = cursor.read<uint32_t>();
+        uint32_t bitsPerPixel = 8;
+        imageType_ = CV_8UC1;
+        packed12_ = false;
+        if (version == 3)
+        {
+            uint32_t formatLength = cursor.read<uint32_t>();
+            std::string format = cursor.readString(formatLength);
+            bitsPerPixel = cursor.read<uint32_t>();
+            if ((format == std::string("MONO16")) && (bitsPerPixel == 16))
+            {
+                imageType_ = CV_16UC1;
+            }
+            else if ((format == std::string("MONO12p")) && (bitsPerPixel == 12))
+            {
+                imageType_ = CV_16UC1;
+                packed12_ = true;
+            }
+            else if ((format != std::string("MONO8")) || (bitsPerPixel != 8))
+            {
+                return setError(QString("fmf format %1 not supported").arg(QString::fromStdString(format)));
+            }
+        }
+        else if (version != 1)
+        {
+            return setError(QString("fmf version %1 not supported").arg(version));
+        }
+        uint32_t height = cursor.read<uint32_t>();
+        uint32_t width = cursor.read<uint32_t>();
+        bytesPerChunk_ = cursor.read<uint64_t>();
+        uint64_t numFrames = cursor.read<uint64_t>();
+        headerSize_ = cursor.pos();
+
+        uint64_t bytesPerFrame = (uint64_t(width)*uint64_t(height)*bitsPerPixel + 7)/8;
+        if (!cursor.ok() || (bytesPerChunk_ != bytesPerFrame + sizeof(double)))
+        {
+            return setError(QString("fmf header is invalid"));
+        }
+        width_ = int(width);
+        height_ = int(height);
+
+        // The frame count is only written when recording finishes so fall
+        // back to the number of complete frames in the file.
+        uint64_t numAvailable = (size_ - headerSize_)/bytesPerChunk_;
+        if ((numFrames == 0) || (numFrames > numAvailable))
+        {
+            numFrames = numAvailable;
+        }
+        numFrames_ = int(numFrames);
+        return true;
+    }
+
+
+    double VideoReader_fmf::getTimeStamp(int frame) const
+    {
+        if ((frame < 0) || (frame >= numFrames_))
+        {
+            return 0.0;
+        }
+        double timeStamp;
+        std::memcpy(&timeStamp, data_ + headerSize_ + uint64_t(frame)*bytesPerChunk_, sizeof(double));
+        return timeStamp;
+    }
+
+
+    bool VideoReader_fmf::readFrame(int frame, cv::Mat &image)
+    {
+        if (packed12_)
+        {
+            if ((frame < 0) || (frame >= numFrames_))
+            {
+                return false;
+            }
+            const uchar *frameData = data_ + headerSize_ + uint64_t(frame)*bytesPerChunk_ + sizeof(double);
+            image.create(height_, width_, CV_16UC1);
+            unpackMono12p(frameData, image.ptr<uint16_t>(0), size_t(width_)*size_t(height_));
+            return true;
+        }
+
+        cv::Mat view;
+        if (!getFrameView(frame, view))
+        {
+            return false;
+        }
+        image.create(height_, width_, imageType_);
+        view.copyTo(image);
+        return true;
+    }
+
+
+    bool VideoReader_fmf::getFrameView(int frame, cv::Mat &image)
+    {
+        // Packed frames have to be unpacked with readFrame
+        if ((frame < 0) || (frame >= numFrames_) || packed12_)
+        {
+            return false;
+        }
+        uchar *frameData = const_cast<uchar*>(data_ + headerSize_ + uint64_t(frame)*bytesPerChunk_ + sizeof(double));
+        image = cv::Mat(height_, width_, imageType_, frameData);
+        return true;
+    }
+
+
+    // VideoReader_ufmf
+    // --------------------------------------------------------------------------------
+    VideoReader_ufmf::VideoReader_ufmf()
+    {
+        isFixedSize_ = false;
+        boxWidth_ = 0;
+        boxHeight_ = 0;
+        cachedKeyFrame_ = -1;
+    }
+
+
+    bool VideoReader_ufmf::open(QString fileName)
+    {
+        frameLocs_.clear();
+        keyFrameLocs_.clear();
+        timeStamps_.clear();
+        cachedKeyFrame_ = -1;
+        keyFrameImage_.release();
+
+        if (!mapFile(fileName))
+        {
+            return false;
+        }
+
+        MappedCursor cursor(data_, size_);
+        std::string headerString = cursor.readString(4);
+        uint32_t version = cursor.read<uint32_t>();
+        uint64_t indexLocation = cursor.read<uint64_t>();
+        if (headerString != std::string("ufmf"))
+        {
+            return setError(QString("%1 is not a ufmf file").arg(fileName));
+        }
+        if (version != 4)
+        {
+            return setError(QString("ufmf version %1 not supported").arg(version));
+        }
+        uint16_t maxWidth = cursor.read<uint16_t>();
+        uint16_t maxHeight = cursor.read<uint16_t>();
+        isFixedSize_ = (cursor.read<uint8_t>() != 0);
+        uint8_t colorCodingLength = cursor.read<uint8_t>();
+        std::string colorCoding = cursor.readString(colorCodingLength);
+        if (!cursor.ok())
+        {
+            return setError(QString("ufmf header is invalid"));
+        }
+        if (colorCoding == std::string("MONO8"))
+        {
+            imageType_ = CV_8UC1;
+        }
+        else if (colorCoding == std::string("MONO16"))
+        {
+            imageType_ = CV_16UC1;
+        }
+        else
+        {
+            return setError(QString("ufmf color coding not supported"));
+        }
+        if (indexLocation == 0)
+        {
+            return setError(QString("ufmf file has no index - recording not finished"));
+        }
+        if (isFixedSize_)
+        {
+            boxWidth_ = maxWidth;
+            boxHeight_ = maxHeight;
+        }
+        else
+        {
+            width_ = maxWidth;
+            height_ = maxHeight;
+        }
+
+        if (!readIndex(indexLocation))
+        {
+            return setError(QString("ufmf index is invalid"));
+        }
+
+        // Frame size comes from the key frames for fixed size boxes
+        if (!keyFrameLocs_.empty())
+        {
+            if (!readKeyFrame(0))
+            {
+                return setError(QString("ufmf key frame is invalid"));
+            }
+            width_ = keyFrameImage_.cols;
+            height_ = keyFrameImage_.rows;
+        }
+        numFrames_ = int(frameLocs_.size());
+        return true;
+    }
+
+
+    bool VideoReader_ufmf::readIndex(uint64_t indexLocation)
+    {
+        // The index location points just past the index chunk id
+        MappedCursor cursor(data_, size_, indexLocation);
+        UfmfIndexMap indexMap;
+
+        // Walk the (nested) index dictionary flattening its arrays into 
+        // indexMap with keys such as "frame/loc" or "keyframe/mean/timestamp"
+        std::vector<std::pair<std::string, unsigned int>> keysLeft;
+        if (cursor.read<char>() != 'd')
+        {
+            return false;
+        }
+        keysLeft.push_back(std::make_pair(std::string(), (unsigned int)(cursor.read<uint8_t>())));
+        while (!keysLeft.empty() && cursor.ok())
+        {
+            if (keysLeft.back().second == 0)
+            {
+                keysLeft.pop_back();
+                continue;
+            }
+            keysLeft.back().second--;
+            std::string prefix = keysLeft.back().first;
+
+            uint16_t keyLength = cursor.read<uint16_t>();
+            std::string key = prefix + cursor.readString(keyLength);
+            char chunkType = cursor.read<char>();
+            if (chunkType == 'd')
+            {
+                if (keysLeft.size() > 8)
+                {
+                    return false;
+                }
+                keysLeft.push_back(std::make_pair(key + "/", (unsigned int)(cursor.read<uint8_t>())));
+            }
+            else if (chunkType == 'a')
+            {
+                UfmfIndexArray array;
+                array.dtype = cursor.read<char>();
+                array.numBytes = cursor.read<uint32_t>();
+                array.data = cursor.skip(array.numBytes);
+                indexMap[key] = array;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        if (!cursor.ok())
+        {
+            return false;
+        }
+
+        frameLocs_ = getIndexArray<uint64_t>(indexMap, "frame/loc", 'q');
+        timeStamps_ = getIndexArray<double>(indexMap, "frame/timestamp", 'd');
+        keyFrameLocs_ = getIndexArray<uint64_t>(indexMap, "keyframe/mean/loc", 'q');
+        if (timeStamps_.size() != frameLocs_.size())
+        {
+            return false;
+        }
+        for (size_t i=0; i<frameLocs_.size(); i++)
+        {
+            if (frameLocs_[i] >= size_)
+            {
+                return false;
+            }
+        }
+        std::sort(keyFrameLocs_.begin(), keyFrameLocs_.end());
+        return true;
+    }
+
+
+    bool VideoReader_ufmf::readKeyFrame(int keyFrame)
+    {
+        if (keyFrame == cachedKeyFrame_)
+        {
+            return true;
+        }
+        MappedCursor cursor(data_, size_, keyFrameLocs_[keyFrame]);
+        uint8_t chunkId = cursor.read<uint8_t>();
+        uint8_t typeLength = cursor.read<uint8_t>();
+        cursor.skip(typeLength);
+        char dtype = cursor.read<char>();
+        uint16_t width = cursor.read<uint16_t>();
+        uint16_t height = cursor.read<uint16_t>();
+        cursor.read<double>();
+        if (!cursor.ok() || (chunkId != 0))
+        {
+            return false;
+        }
+
+        if ((dtype == 'B') || (dtype == 'H'))
+        {
+            int type = (dtype == 'H') ? CV_16UC1 : CV_8UC1;
+            uint64_t elemSize = (dtype == 'H') ? sizeof(uint16_t) : sizeof(uint8_t);
+            const uchar *pixels = cursor.skip(uint64_t(width)*uint64_t(height)*elemSize);
+            if ((pixels == nullptr) || (type != imageType_))
+            {
+                return false;
+            }
+            cv::Mat(height, width, type, const_cast<uchar*>(pixels)).copyTo(keyFrameImage_);
+        }
+        else if (dtype == 'f')
+        {
+            const uchar *pixels = cursor.skip(uint64_t(width)*uint64_t(height)*sizeof(float));
+            if (pixels == nullptr)
+            {
+                return false;
+            }
+            cv::Mat floatImage(height, width, CV_32FC1);
+            std::memcpy(floatImage.data, pixels, floatImage.total()*sizeof(float));
+            floatImage.convertTo(keyFrameImage_, imageType_);
+        }
+        else
+        {
+            return false;
+        }
+        cachedKeyFrame_ = keyFrame;
+        return true;
+    }
+
+
+    bool VideoReader_ufmf::readFrame(int frame, cv::Mat &image)
+    {
+        if ((frame < 0) || (frame >= numFrames_))
+        {
+            return false;
+        }
+        uint64_t frameLoc = frameLocs_[frame];
+
+        // Background is the last key frame written before this frame
+        image.create(height_, width_, imageType_);
+        if (keyFrameLocs_.empty())
+        {
+            image.setTo(cv::Scalar(0));
+        }
+        else
+        {
+            std::vector<uint64_t>::iterator it;
+            it = std::upper_bound(keyFrameLocs_.begin(), keyFrameLocs_.end(), frameLoc);
+            int keyFrame = (it == keyFrameLocs_.begin()) ? 0 : int(it - keyFrameLocs_.begin()) - 1;
+            if (!readKeyFrame(keyFrame))
+            {
+                return false;
+            }
+            keyFrameImage_.copyTo(image);
+        }
+
+        // Paste the foreground boxes over the background
+        size_t elemSize = image.elemSize();
+        MappedCursor cursor(data_, size_, frameLoc);
+        uint8_t chunkId = cursor.read<uint8_t>();
+        cursor.read<double>();
+        uint32_t numBoxes = cursor.read<uint32_t>();
+        if (!cursor.ok() || (chunkId != 1))
+        {
+            return false;
+        }
+        for (uint32_t i=0; i<numBoxes; i++)
+        {
+            int col = cursor.read<uint16_t>();
+            int row = cursor.read<uint16_t>();
+            int boxWidth = boxWidth_;
+            int boxHeight = boxHeight_;
+            if (!isFixedSize_)
+            {
+                boxWidth = cursor.read<uint16_t>();
+                boxHeight = cursor.read<uint16_t>();
+            }
+            const uchar *pixels = cursor.skip(uint64_t(boxWidth)*uint64_t(boxHeight)*elemSize);
+            if (pixels == nullptr)
+            {
+                return false;
+            }
+            if ((col >= width_) || (row >= height_))
+            {
+                continue;
+            }
+            int numCol = std::min(boxWidth, width_ - col);
+            int numRow = std::min(boxHeight, height_ - row);
+            for (int j=0; j<numRow; j++)
+            {
+                std::memcpy(
+                        image.ptr<uchar>(row+j) + col*elemSize, 
+                        pixels + j*boxWidth*elemSize, 
+                        std::max(numCol,0)*elemSize
+                        );
+            }
+        }
+        return true;
+    }
+
+
+    // VideoReader_mjpg
+    // --------------------------------------------------------------------------------
+    QString VideoReader_mjpg::getIndexFileName(QString movieFileName)
+    {
+        // movie.mjpg -> index.txt, movie_3.mjpg -> index_3.txt (see VideoWriter_jpg)
+        QFileInfo movieInfo(movieFileName);
+        QString baseName = movieInfo.completeBaseName();
+        if (baseName.startsWith(QString("movie")))
+        {
+            baseName = QString("index") + baseName.mid(QString("movie").size());
+        }
+        return movieInfo.dir().absoluteFilePath(baseName + QString(".txt"));
+    }
+
+
+    bool VideoReader_mjpg::open(QString fileName)
+    {
+        frameBegin_.clear();
+        frameEnd_.clear();
+        timeStamps_.clear();
+
+        if (!mapFile(fileName))
+        {
+            return false;
+        }
+
+        // Index lines are: frame count, time stamp, begin and end file positions
+        QFile indexFile(getIndexFileName(fileName));
+        if (!indexFile.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            return setError(QString("unable to open mjpg index %1").arg(indexFile.fileName()));
+        }
+        std::istringstream indexStream(indexFile.readAll().toStdString());
+        indexFile.close();
+
+        std::string line;
+        while (std::getline(indexStream, line))
+        {
+            std::istringstream lineStream(line);
+            unsigned long frameCount;
+            double timeStamp;
+            uint64_t beginPos;
+            uint64_t endPos;
+            if (!(lineStream >> frameCount >> timeStamp >> beginPos >> endPos))
+            {
+                continue;
+            }
+            if ((beginPos >= endPos) || (endPos > size_))
+            {
+                // Frames past the end belong to a recording which didn't finish
+                break;
+            }
+            frameBegin_.push_back(beginPos);
+            frameEnd_.push_back(endPos);
+            timeStamps_.push_back(timeStamp);
+        }
+        numFrames_ = int(frameBegin_.size());
+
+        // The first frame decides whether the movie plays back as mono8 or bgr
+        cv::Mat image;
+        if (numFrames_ > 0)
+        {
+            uchar *jpgData = const_cast<uchar*>(data_ + frameBegin_[0]);
+            cv::Mat jpgBuffer(1, int(frameEnd_[0] - frameBegin_[0]), CV_8UC1, jpgData);
+            cv::imdecode(jpgBuffer, cv::IMREAD_UNCHANGED, &image);
+        }
+        if (image.empty() || ((image.type() != CV_8UC1) && (image.type() != CV_8UC3)))
+        {
+            return setError(QString("mjpg file has no readable frames"));
+        }
+        width_ = image.cols;
+        height_ = image.rows;
+        imageType_ = image.type();
+        return true;
+    }
+
+
+    bool VideoReader_mjpg::readFrame(int frame, cv::Mat &image)
+    {
+        if ((frame < 0) || (frame >= numFrames_))
+        {
+            return false;
+        }
+        uchar *jpgData = const_cast<uchar*>(data_ + frameBegin_[frame]);
+        cv::Mat jpgBuffer(1, int(frameEnd_[frame] - frameBegin_[frame]), CV_8UC1, jpgData);
+        int flags = (imageType_ == CV_8UC1) ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+        cv::imdecode(jpgBuffer, flags, &image);
+        return !image.empty();
+    }
+
+} // namespace bias
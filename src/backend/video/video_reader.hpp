@@ -0,0 +1,130 @@
+#ifndef BIAS_VIDEO_READER_HPP
+#define BIAS_VIDEO_READER_HPP
+
+#include <QString>
+#include <QFile>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+
+namespace bias
+{
+
+    // ----------------------------------------------------------------------------
+    // Random access readers for the movie formats written by BIAS (fmf, ufmf and
+    // mjpg + index). The movie file is memory mapped and frame offsets come from
+    // the file's index (or the fixed frame stride for fmf) so seeking is O(1) and
+    // no data is read that isn't needed. Images are single channel CV_8U, or
+    // CV_16U for 16-bit and 12-bit packed fmf files and 16-bit ufmf files.
+    // ----------------------------------------------------------------------------
+
+    class VideoReader
+    {
+        public:
+
+            VideoReader();
+            virtual ~VideoReader();
+
+            virtual bool open(QString fileName) = 0;
+            void close();
+            bool isOpen() const;
+            QString getErrorMsg() const;
+
+            int getNumFrames() const;
+            int getImageWidth() const;
+            int getImageHeight() const;
+            int getImageType() const;
+            float getFPS() const;
+            virtual double getTimeStamp(int frame) const;
+
+            // Decodes the frame into image. Image is reallocated with create()
+            // so an existing (e.g. pooled) buffer of the right size is reused.
+            virtual bool readFrame(int frame, cv::Mat &image) = 0;
+
+            // Sets image to refer directly to the frame data in the mapped file
+            // if the format allows it. The image should be treated as read only
+            // (the mapping is private so the file is never modified) and is only
+            // valid until the reader is closed. Returns false if not supported.
+            virtual bool getFrameView(int frame, cv::Mat &image);
+
+            // Returns a reader for the file, opened, based on its extension or
+            // nullptr if the format isn't one we read natively. Check isOpen().
+            static std::shared_ptr<VideoReader> create(QString fileName);
+
+        protected:
+
+            QFile file_;
+            const uchar *data_;
+            uint64_t size_;
+            int numFrames_;
+            int width_;
+            int height_;
+            int imageType_;
+            std::vector<double> timeStamps_;
+            QString errorMsg_;
+
+            bool mapFile(QString fileName);
+            bool setError(QString errorMsg);
+    };
+
+
+    class VideoReader_fmf : public VideoReader
+    {
+        public:
+
+            VideoReader_fmf();
+            virtual bool open(QString fileName);
+            virtual double getTimeStamp(int frame) const;
+            virtual bool readFrame(int frame, cv::Mat &image);
+            virtual bool getFrameView(int frame, cv::Mat &image);
+
+        private:
+
+            uint64_t headerSize_;
+            uint64_t bytesPerChunk_;
+            bool packed12_;
+    };
+
+
+    class VideoReader_ufmf : public VideoReader
+    {
+        public:
+
+            VideoReader_ufmf();
+            virtual bool open(QString fileName);
+            virtual bool readFrame(int frame, cv::Mat &image);
+
+        private:
+
+            bool isFixedSize_;
+            int boxWidth_;
+            int boxHeight_;
+            std::vector<uint64_t> frameLocs_;
+            std::vector<uint64_t> keyFrameLocs_;
+            int cachedKeyFrame_;
+            cv::Mat keyFrameImage_;
+
+            bool readIndex(uint64_t indexLocation);
+            bool readKeyFrame(int keyFrame);
+    };
+
+
+    class VideoReader_mjpg : public VideoReader
+    {
+        public:
+
+            virtual bool open(QString fileName);
+            virtual bool readFrame(int frame, cv::Mat &image);
+
+            static QString getIndexFileName(QString movieFileName);
+
+        private:
+
+            std::vector<uint64_t> frameBegin_;
+            std::vector<uint64_t> frameEnd_;
+    };
+
+} // namespace bias
+
+#endif // #ifndef BIAS_VIDEO_READER_HPP
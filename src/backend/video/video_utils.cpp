@@ -1,6 +1,7 @@
 #include "video_utils.hpp"
 #include <opencv2/videoio.hpp>
 #include <iostream>
+#include <thread>
 //#include "stampedImage.hpp"
 
 
@@ -9,15 +10,40 @@ namespace bias {
 
     videoBackend::videoBackend() {
         isOpen_ = false;
+        readerFrame_ = 0;
+        readerTimeStamp_ = 0.0;
         dt_ = 1.0 / 30.0;
+        realTimePacing_ = false;
+        paceStarted_ = false;
+        paceStartFrame_ = 0;
     }
 
     videoBackend::videoBackend(QString file) {
 
         filename = file;
-        cap_.open(filename.toStdString().c_str());
-        isOpen_ = true;
-        dt_ = 1.0 / (double)getFPS();
+        readerFrame_ = 0;
+        readerTimeStamp_ = 0.0;
+
+        // movies written by BIAS (fmf, ufmf, mjpg) are read natively with O(1)
+        // seeks, anything else goes through OpenCV
+        readerPtr_ = VideoReader::create(filename);
+        if (readerPtr_) {
+            isOpen_ = readerPtr_->isOpen();
+            if (!isOpen_) {
+                printf("unable to read video file: %s\n", 
+                    readerPtr_->getErrorMsg().toStdString().c_str());
+            }
+        }
+        else {
+            cap_.open(filename.toStdString().c_str());
+            isOpen_ = true;
+        }
+
+        double fps = isOpen_ ? (double)getFPS() : 0.0;
+        dt_ = (fps > 0.0) ? 1.0 / fps : 1.0 / 30.0;
+        realTimePacing_ = false;
+        paceStarted_ = false;
+        paceStartFrame_ = 0;
 
     }
 
@@ -25,6 +51,7 @@ namespace bias {
     void videoBackend::releaseCapObject() {
 
         cap_.release();
+        readerPtr_.reset();
         isOpen_ = false;
 
     }
@@ -38,24 +65,86 @@ namespace bias {
 
 	}
     
+    void videoBackend::waitForNextFrame() {
+
+        if (!realTimePacing_)
+            return;
+
+        // sleep until the next frame is due, based on the video frame rate
+        int fr = getCurrentFrameNumber();
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!paceStarted_) {
+            paceStarted_ = true;
+            paceStartFrame_ = fr;
+            paceStartTime_ = now;
+        }
+        std::chrono::duration<double> due((fr - paceStartFrame_) * dt_);
+        std::chrono::steady_clock::time_point dueTime = paceStartTime_ 
+            + std::chrono::duration_cast<std::chrono::steady_clock::duration>(due);
+        if (dueTime > now) {
+            std::this_thread::sleep_until(dueTime);
+        }
+
+    }
+
     cv::Mat videoBackend::grabImage() {
 
-        cv::Mat frame;
         cv::Mat grey;
 
         checkCapOpen();
-        
-        cap_.read(frame);
 
-        if (frame.empty())
-            return frame;
+        if (readerPtr_) {
+            if (readerFrame_ >= readerPtr_->getNumFrames())
+                return grey;
+
+            // decode into a pooled buffer if available, otherwise use a view 
+            // of the mapped file where the format allows it
+            bool ok = false;
+            if (imagePoolPtr_) {
+                imagePoolPtr_->getImage(grey, readerPtr_->getImageHeight(), 
+                    readerPtr_->getImageWidth(), readerPtr_->getImageType());
+                ok = readerPtr_->readFrame(readerFrame_, grey);
+            }
+            else {
+                ok = readerPtr_->getFrameView(readerFrame_, grey);
+                if (!ok)
+                    ok = readerPtr_->readFrame(readerFrame_, grey);
+            }
+            if (!ok)
+                return cv::Mat();
+
+            readerTimeStamp_ = readerPtr_->getTimeStamp(readerFrame_);
+            readerFrame_++;
+            return grey;
+        }
+
+        cap_.read(frame_);
 
-        // convert the frame to grayscale
-        cv::cvtColor(frame, grey, cv::COLOR_BGR2GRAY);
+        if (frame_.empty())
+            return grey;
+
+        // convert the frame to grayscale, into a pooled buffer if available
+        if (imagePoolPtr_) {
+            imagePoolPtr_->getImage(grey, frame_.rows, frame_.cols, CV_8UC1);
+        }
+        cv::cvtColor(frame_, grey, cv::COLOR_BGR2GRAY);
         return grey; 
 
     }
 
+    void videoBackend::setImagePool(ImagePoolPtr imagePoolPtr) {
+
+        imagePoolPtr_ = imagePoolPtr;
+
+    }
+
+    void videoBackend::setRealTimePacing(bool pacing) {
+
+        realTimePacing_ = pacing;
+        paceStarted_ = false;
+
+    }
+
     void videoBackend::convertImagetoFloat(cv::Mat& img) {
 
         // convert the frame into float32
@@ -67,34 +156,50 @@ namespace bias {
 
     int videoBackend::getImageHeight() {
         checkCapOpen();
+        if (readerPtr_)
+            return readerPtr_->getImageHeight();
         return cap_.get(cv::CAP_PROP_FRAME_HEIGHT);
     }
 
     int videoBackend::getImageWidth() {
         checkCapOpen();
+        if (readerPtr_)
+            return readerPtr_->getImageWidth();
         return cap_.get(cv::CAP_PROP_FRAME_WIDTH);
     }
 
 
     float videoBackend::getFPS() {
         checkCapOpen();
+        if (readerPtr_)
+            return readerPtr_->getFPS();
         return cap_.get(cv::CAP_PROP_FPS);
     }
 
 
     int videoBackend::getNumFrames() {
 
+        if (readerPtr_)
+            return readerPtr_->getNumFrames();
         return cap_.get(cv::CAP_PROP_FRAME_COUNT);
 
     }
 
     int videoBackend::getCurrentFrameNumber() {
 
+        if (readerPtr_)
+            return readerFrame_;
         return cap_.get(cv::CAP_PROP_POS_FRAMES);
     }
 
     bool videoBackend::setFrame(int f) {
 
+        if (readerPtr_) {
+            if ((f < 0) || (f >= readerPtr_->getNumFrames()))
+                return false;
+            readerFrame_ = f;
+            return true;
+        }
 		return cap_.set(cv::CAP_PROP_POS_FRAMES, f);
 
 	}
@@ -102,8 +207,15 @@ namespace bias {
     TimeStamp videoBackend::getImageTimeStamp() {
 
         TimeStamp timestamp = TimeStamp();
-        int fr = getCurrentFrameNumber();
-        double t = fr * dt_;
+        double t;
+        if (readerPtr_) {
+            // recorded time stamp of the last frame read
+            t = readerTimeStamp_;
+        }
+        else {
+            int fr = getCurrentFrameNumber();
+            t = fr * dt_;
+        }
         timestamp.seconds = (int)t;
         timestamp.microSeconds = (int) ((t - timestamp.seconds) * 1e6);
         return timestamp;
@@ -112,6 +224,8 @@ namespace bias {
 
     void videoBackend::setBufferSize() {
 
+        if (readerPtr_)
+            return;
         cap_.set(cv::CAP_PROP_BUFFERSIZE, 3);
 
     }
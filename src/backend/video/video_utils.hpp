@@ -2,10 +2,14 @@
 #define VIDEO_UTILS_HPP
 
 #include <QString>
+#include <chrono>
 #include <opencv2/core/core.hpp>
 #include <opencv2/videoio.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include "basic_types.hpp"
+#include "image_pool.hpp"
+#include "video_reader.hpp"
+#include <memory>
 
 
 namespace bias {
@@ -18,6 +22,7 @@ namespace bias {
           
         videoBackend();    
         videoBackend(QString file);
+        void waitForNextFrame();
         cv::Mat grabImage();
         void convertImagetoFloat(cv::Mat& img);
         int getImageHeight();
@@ -33,12 +38,25 @@ namespace bias {
         void releaseCapObject();
         void checkCapOpen();
         bool setFrame(int f);
+        void setImagePool(ImagePoolPtr imagePoolPtr);
+        void setRealTimePacing(bool pacing);
 
     private:
 
         cv::VideoCapture cap_;
+        std::shared_ptr<VideoReader> readerPtr_;  // native reader for fmf, ufmf and mjpg
+        int readerFrame_;                          // next frame for the native reader
+        double readerTimeStamp_;                   // time stamp of the last native frame
         bool isOpen_;
         double dt_;
+        cv::Mat frame_;              // decode buffer, reused between reads
+        ImagePoolPtr imagePoolPtr_;  // optional pool for returned grey images
+
+        // when pacing, waitForNextFrame blocks until each frame's time relative to the first
+        bool realTimePacing_;
+        bool paceStarted_;
+        int paceStartFrame_;
+        std::chrono::steady_clock::time_point paceStartTime_;
    
     };
 
@@ -11,6 +11,7 @@ namespace bias {
         CAMERA_LIB_FC2=0,
         CAMERA_LIB_DC1394,
         CAMERA_LIB_SPIN,
+        CAMERA_LIB_SIM,
         CAMERA_LIB_UNDEFINED,
         NUMBER_OF_CAMERA_LIB,
     };
@@ -195,6 +196,13 @@ namespace bias {
         ERROR_SPIN_SET_TRIGGER_INTERNAL,
         ERROR_SPIN_GET_TRIGGER_TYPE,
 
+        // Simulated camera errors
+        ERROR_NO_SIM,
+        ERROR_SIM_START_CAPTURE,
+        ERROR_SIM_GRAB_IMAGE,
+        ERROR_SIM_FORMAT7_SETTINGS,
+        ERROR_SIM_PROPERTY_NOT_SETTABLE,
+
         // Video Writer Errors
         ERROR_VIDEO_WRITER_ADD_FRAME,
         ERROR_VIDEO_WRITER_INITIALIZE,
@@ -395,10 +403,19 @@ namespace bias {
         VIDEOFILE_FORMAT_AVI,
         VIDEOFILE_FORMAT_FMF,
         VIDEOFILE_FORMAT_UFMF,
+        VIDEOFILE_FORMAT_FFMPEG,
         NUMBER_OF_VIDEOFILE_FORMAT,
         VIDEOFILE_FORMAT_UNSPECIFIED,
     };
 
+    enum GrabMode
+    {
+        GRAB_MODE_POLL,       // non-blocking grab, grabber yields and retries
+        GRAB_MODE_BLOCKING,   // grab blocks (with timeout) until a frame arrives
+        NUMBER_OF_GRAB_MODE,
+        GRAB_MODE_UNSPECIFIED,
+    };
+
     enum ImageRotationType
     { 
         IMAGE_ROTATION_0=0,
@@ -424,6 +441,18 @@ namespace bias {
         unsigned int microSeconds;
     };
 
+    struct GrabStats
+    {
+        unsigned long numFrames;    // frames returned by grabImage
+        unsigned long numZeroCopy;  // frames handed out without copy or conversion
+        double lastUs;              // post-acquisition handling time, last frame
+        double meanUs;              // running mean of the above 
+        double maxUs;               // worst case of the above
+        unsigned long numOverrun;   // frames overwritten before they were read
+        unsigned long numDropped;   // frames lost by the camera or driver
+        unsigned long numErrors;    // grabs which failed with an error
+    };
+
 } // namespace bias
 
 #endif // #ifndef BIAS_BASIC_TYPES_HPP
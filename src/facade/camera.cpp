@@ -15,6 +15,9 @@
 #ifdef WITH_SPIN
 #include "camera_device_spin.hpp"
 #endif
+#ifdef WITH_SIM
+#include "camera_device_sim.hpp"
+#endif
 
 namespace bias {
 
@@ -41,6 +44,10 @@ namespace bias {
                 createCameraDevice_spin(guid);
                 break;
 
+            case CAMERA_LIB_SIM:
+                createCameraDevice_sim(guid);
+                break;
+
             case CAMERA_LIB_UNDEFINED:
                 ssError << __FUNCTION__;
                 ssError << ": camera library is not defined";
@@ -107,12 +114,36 @@ namespace bias {
     }
 
 
+    void Camera::setGrabTimeout(int timeoutMs)
+    {
+        cameraDevicePtr_ -> setGrabTimeout(timeoutMs);
+    }
+
+
     TimeStamp Camera::getImageTimeStamp()
     {
         return cameraDevicePtr_ -> getImageTimeStamp();
     }
 
 
+    GrabStats Camera::getGrabStats()
+    {
+        return cameraDevicePtr_ -> getGrabStats();
+    }
+
+
+    void Camera::setImagePool(ImagePoolPtr imagePoolPtr)
+    {
+        cameraDevicePtr_ -> setImagePool(imagePoolPtr);
+    }
+
+
+    ImagePoolPtr Camera::getImagePool()
+    {
+        return cameraDevicePtr_ -> getImagePool();
+    }
+
+
     bool Camera::isConnected()
     {
         return cameraDevicePtr_ -> isConnected();
@@ -787,6 +818,26 @@ namespace bias {
         throw_ERROR_NO_SPIN(std::string(__PRETTY_FUNCTION__));
     }
 
+#endif
+
+    // Simulated camera specific methods
+    // -----------------------------------------------------------------------
+#ifdef WITH_SIM
+
+    void Camera::createCameraDevice_sim(Guid guid)
+    {
+        cameraDevicePtr_ = std::make_shared<CameraDevice_sim>(guid);
+    }
+
+#else
+    // Dummy methods for when the backend isn't included - allows the ifdefs 
+    // to  be limited to two locations.
+
+    void Camera::createCameraDevice_sim(Guid guid)
+    {
+        throw_ERROR_NO_SIM(std::string(__PRETTY_FUNCTION__));
+    }
+
 #endif
 
     // Shared pointer comparison operator - for use in sets, maps, etc.
@@ -40,7 +40,12 @@ namespace bias {
             void stopCapture();
             void grabImage(cv::Mat &image);
             cv::Mat grabImage();
+            void setGrabTimeout(int timeoutMs);
             TimeStamp getImageTimeStamp();
+            GrabStats getGrabStats();
+
+            void setImagePool(ImagePoolPtr imagePoolPtr);
+            ImagePoolPtr getImagePool();
 
             bool isConnected();
             bool isCapturing();
@@ -145,6 +150,7 @@ namespace bias {
             void createCameraDevice_fc2(Guid guid);
             void createCameraDevice_dc1394(Guid guid);
             void createCameraDevice_spin(Guid guid);
+            void createCameraDevice_sim(Guid guid);
 
     };
 
@@ -28,6 +28,7 @@ namespace bias {
         update_fc2();
         update_dc1394();
         update_spin();
+        update_sim();
     }
 
     void CameraFinder::printGuid() 
@@ -405,4 +406,30 @@ namespace bias {
 
 #endif
 
+#ifdef WITH_SIM
+
+    // Simulated camera specific features
+    // ------------------------------------------------------------------------
+
+    void CameraFinder::update_sim()
+    {
+        // Simulated cameras are always "attached" - the number of them is 
+        // taken from the environment (BIAS_SIM_NUM_CAMERAS, default 1).
+        unsigned int numCameras = SimCameraConfig::getNumberOfCameras();
+        for (unsigned int i=0; i<numCameras; i++)
+        {
+            SimGuid guid_sim = {i};
+            guidSet_.insert(Guid(guid_sim));
+        }
+    }
+
+#else
+
+    // Dummy methods for when the simulated backend is not included
+    // ------------------------------------------------------------------------
+
+    void CameraFinder::update_sim() {}
+
+#endif
+
 } // namespace bias
@@ -17,6 +17,9 @@
 #include "node_map_spin.hpp"
 #include "string_node_spin.hpp"
 #endif
+#ifdef WITH_SIM
+#include "sim_camera_config.hpp"
+#endif
 
 namespace bias {
 
@@ -54,6 +57,7 @@ namespace bias {
             void update_fc2();
             void update_dc1394();
             void update_spin();
+            void update_sim();
 
 #ifdef WITH_FC2
         private:
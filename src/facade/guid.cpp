@@ -137,6 +137,29 @@ namespace bias {
         return rval;
     };
 
+#endif
+
+#ifdef WITH_SIM
+
+    // Simulated camera specific methods
+    // ------------------------------------------------------------------------
+    Guid::Guid(SimGuid guid)
+    {
+        guidDevicePtr_ = std::make_shared<GuidDevice_sim>(guid);
+    }
+
+    SimGuid Guid::getValue_sim()
+    {
+        SimGuid rval = {0};
+        if ( getCameraLib() == CAMERA_LIB_SIM )
+        {
+            GuidDevicePtr_sim tempPtr;
+            tempPtr = std::dynamic_pointer_cast<GuidDevice_sim>(guidDevicePtr_);
+            rval = tempPtr -> getValue();
+        }
+        return rval;
+    }
+
 #endif
     
     // Guid comparison operator
@@ -22,6 +22,10 @@
 #include "guid_device_spin.hpp"
 #endif
 
+#ifdef WITH_SIM
+#include "guid_device_sim.hpp"
+#endif
+
 
 namespace bias {
     
@@ -69,6 +73,12 @@ namespace bias {
             explicit Guid(std::string guidStr);
             std::string getValue_spin();
 #endif
+#ifdef WITH_SIM
+        // Simulated camera specific features
+        public:
+            explicit Guid(SimGuid guid);
+            SimGuid getValue_sim();
+#endif
            
     };
 
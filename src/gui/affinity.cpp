@@ -1,21 +1,126 @@
 #include "affinity.hpp"
 #include <iostream>
-#include <map>
+#include <sstream>
+#include <set>
+#include <algorithm>
+#include <QDir>
+#include <QFile>
+#include <QThread>
+#include <QStringList>
+#include <QMutexLocker>
 
 #ifdef WIN32
 #include <windows.h>
 #endif
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
 namespace bias
 {
+    QMap<RealtimePolicy, QString> createRealtimePolicyToStringMap()
+    {
+        QMap<RealtimePolicy, QString> map;
+        map.insert(REALTIME_POLICY_NONE, QString("none"));
+        map.insert(REALTIME_POLICY_FIFO, QString("fifo"));
+        map.insert(REALTIME_POLICY_RR, QString("rr"));
+        return map;
+    }
+    const QMap<RealtimePolicy, QString> REALTIME_POLICY_TO_STRING_MAP = createRealtimePolicyToStringMap();
+
+    const bool ThreadAffinityParams::DEFAULT_ENABLED = false;
+    const int ThreadAffinityParams::DEFAULT_REALTIME_PRIORITY = 50;
+
+    ThreadAffinityParams::ThreadAffinityParams()
+    {
+        enabled = DEFAULT_ENABLED;
+        numaNode = -1;
+        device = QString("");
+        grabberCpu = -1;
+        workerCpus = QString("");
+        realtimePolicy = REALTIME_POLICY_NONE;
+        realtimePriority = DEFAULT_REALTIME_PRIORITY;
+    }
+
+
+    ThreadLayout::ThreadLayout()
+    {
+        numaNode = 0;
+        grabberCpu = -1;
+    }
+
 
     unsigned int ThreadAffinityService::numberOfCameras_ = 0;
     QMutex ThreadAffinityService::coutDebugMutex_; 
+    QMutex ThreadAffinityService::layoutMutex_;
+    bool ThreadAffinityService::layoutDirty_ = true;
+    std::vector<int> ThreadAffinityService::availableCpus_;
+    std::map<unsigned int, ThreadAffinityParams> ThreadAffinityService::paramsMap_;
+    std::map<unsigned int, bool> ThreadAffinityService::realtimeFailed_;
+    std::vector<ThreadLayout> ThreadAffinityService::layout_;
 
     void ThreadAffinityService::setNumberOfCameras(unsigned int numberOfCameras)
     {
+        QMutexLocker locker(&layoutMutex_);
         numberOfCameras_ = numberOfCameras;
+        if (availableCpus_.empty())
+        {
+            // Read before any thread has been pinned - new threads inherit 
+            // the mask of the thread which created them.
+            availableCpus_ = getProcessCpus();
+        }
+        layoutDirty_ = true;
+    }
+
+
+    void ThreadAffinityService::setParams(unsigned int cameraNumber, ThreadAffinityParams params)
+    {
+        QMutexLocker locker(&layoutMutex_);
+        paramsMap_[cameraNumber] = params;
+        layoutDirty_ = true;
+    }
+
+
+    ThreadAffinityParams ThreadAffinityService::getParams(unsigned int cameraNumber)
+    {
+        QMutexLocker locker(&layoutMutex_);
+        if (paramsMap_.count(cameraNumber) == 0)
+        {
+            return ThreadAffinityParams();
+        }
+        return paramsMap_[cameraNumber];
+    }
+
+
+    ThreadLayout ThreadAffinityService::getLayout(unsigned int cameraNumber)
+    {
+        QMutexLocker locker(&layoutMutex_);
+        if (layoutDirty_)
+        {
+            updateLayout();
+        }
+        if (cameraNumber >= layout_.size())
+        {
+            return ThreadLayout();
+        }
+        return layout_[cameraNumber];
     }
+
+
+    QString ThreadAffinityService::getLayoutString()
+    {
+        QMutexLocker locker(&layoutMutex_);
+        if (layoutDirty_)
+        {
+            updateLayout();
+        }
+        return getLayoutStringNoLock();
+    }
+
     
     bool ThreadAffinityService::assignThreadAffinity(bool isImageGrabber, unsigned int cameraNumber)
     {
@@ -100,6 +205,88 @@ namespace bias
         //std::cout << "normalProcMask:     " << std::hex << int(normalProcMask) << std::dec << std::endl;
         //std::cout << std::endl;
         //coutDebugMutex_.unlock();
+#elif defined(__linux__)
+
+        layoutMutex_.lock();
+        if (layoutDirty_)
+        {
+            updateLayout();
+        }
+        if (cameraNumber >= layout_.size())
+        {
+            // No layout, e.g. the number of cameras was never set - leave 
+            // the thread unpinned.
+            layoutMutex_.unlock();
+            return false;
+        }
+        ThreadLayout layout = layout_[cameraNumber];
+        ThreadAffinityParams params;
+        if (paramsMap_.count(cameraNumber) > 0)
+        {
+            params = paramsMap_[cameraNumber];
+        }
+        layoutMutex_.unlock();
+
+        rval = true;
+        if (params.enabled)
+        {
+            std::vector<int> cpuList = layout.workerCpus;
+            if (isImageGrabber && (layout.grabberCpu >= 0))
+            {
+                cpuList = std::vector<int>(1, layout.grabberCpu);
+            }
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            for (int cpu : cpuList)
+            {
+                CPU_SET(cpu, &cpuSet);
+            }
+            if (!cpuList.empty())
+            {
+                rval = (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) == 0);
+            }
+        }
+
+        // Pool threads are reused, e.g., a thread which ran a grabber may 
+        // later run a compressor, so the policy is always set. Lowering to 
+        // SCHED_OTHER is always permitted.
+        int policy = SCHED_OTHER;
+        sched_param schedParam;
+        schedParam.sched_priority = 0;
+        if (isImageGrabber && (params.realtimePolicy != REALTIME_POLICY_NONE))
+        {
+            policy = (params.realtimePolicy == REALTIME_POLICY_RR) ? SCHED_RR : SCHED_FIFO;
+            int priorityMin = sched_get_priority_min(policy);
+            int priorityMax = sched_get_priority_max(policy);
+            schedParam.sched_priority = std::max(priorityMin, std::min(params.realtimePriority, priorityMax));
+        }
+
+        int currentPolicy;
+        sched_param currentParam;
+        pthread_getschedparam(pthread_self(), &currentPolicy, &currentParam);
+        if ((policy != currentPolicy) || (schedParam.sched_priority != currentParam.sched_priority))
+        {
+            int error = pthread_setschedparam(pthread_self(), policy, &schedParam);
+            if ((error != 0) && (policy != SCHED_OTHER))
+            {
+                // Not permitted (needs CAP_SYS_NICE or an rtprio limit) - carry 
+                // on with normal scheduling and say so once per camera.
+                layoutMutex_.lock();
+                bool reported = realtimeFailed_[cameraNumber];
+                realtimeFailed_[cameraNumber] = true;
+                layoutMutex_.unlock();
+                if (!reported)
+                {
+                    coutDebugMutex_.lock();
+                    std::cout << "thread affinity: camera " << cameraNumber << ", unable to set ";
+                    std::cout << REALTIME_POLICY_TO_STRING_MAP[params.realtimePolicy].toStdString();
+                    std::cout << " scheduling for grabber (" << strerror(error) << ") - ";
+                    std::cout << "using normal scheduling" << std::endl;
+                    coutDebugMutex_.unlock();
+                }
+            }
+        }
+        return rval;
 #endif
 
         return true;
@@ -108,4 +295,389 @@ namespace bias
     }  // assignThreadAffinity
 
 
+    bool ThreadAffinityService::assignSharedThreadAffinity()
+    {
+#ifdef WIN32
+        // Non-grabber threads get the same cpus whatever the camera
+        return assignThreadAffinity(false, 0);
+#elif defined(__linux__)
+        // Union of the worker cpus of the cameras whose threads are pinned -
+        // or all the process's cpus if none are.
+        std::set<int> cpuSet;
+        layoutMutex_.lock();
+        if (layoutDirty_)
+        {
+            updateLayout();
+        }
+        for (unsigned int i=0; i<layout_.size(); i++)
+        {
+            bool enabled = ThreadAffinityParams::DEFAULT_ENABLED;
+            if (paramsMap_.count(i) > 0)
+            {
+                enabled = paramsMap_[i].enabled;
+            }
+            if (enabled)
+            {
+                cpuSet.insert(layout_[i].workerCpus.begin(), layout_[i].workerCpus.end());
+            }
+        }
+        if (cpuSet.empty())
+        {
+            cpuSet.insert(availableCpus_.begin(), availableCpus_.end());
+        }
+        layoutMutex_.unlock();
+
+        if (cpuSet.empty())
+        {
+            return false;
+        }
+        cpu_set_t cpuMask;
+        CPU_ZERO(&cpuMask);
+        for (int cpu : cpuSet)
+        {
+            CPU_SET(cpu, &cpuMask);
+        }
+        return (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuMask) == 0);
+#endif
+        return true;
+    }
+
+
+    std::vector<int> ThreadAffinityService::parseCpuList(QString cpuListString, bool *ok)
+    {
+        // Linux cpu list format, e.g., "0-3,8,10-11"
+        std::vector<int> cpuList;
+        bool success = true;
+        QStringList parts = cpuListString.trimmed().split(",", QString::SkipEmptyParts);
+        for (QString part : parts)
+        {
+            QStringList range = part.trimmed().split("-");
+            bool ok0 = false;
+            bool ok1 = false;
+            int cpu0 = range[0].trimmed().toInt(&ok0);
+            int cpu1 = (range.size() == 2) ? range[1].trimmed().toInt(&ok1) : cpu0;
+            ok1 = (range.size() == 2) ? ok1 : true;
+            if ((range.size() > 2) || !ok0 || !ok1 || (cpu0 < 0) || (cpu1 < cpu0))
+            {
+                success = false;
+                continue;
+            }
+            for (int cpu=cpu0; cpu<=cpu1; cpu++)
+            {
+                cpuList.push_back(cpu);
+            }
+        }
+        std::sort(cpuList.begin(), cpuList.end());
+        cpuList.erase(std::unique(cpuList.begin(), cpuList.end()), cpuList.end());
+        if (ok != 0)
+        {
+            *ok = success;
+        }
+        return cpuList;
+    }
+
+
+    QString ThreadAffinityService::cpuListToString(const std::vector<int> &cpuList)
+    {
+        QStringList parts;
+        size_t i = 0;
+        while (i < cpuList.size())
+        {
+            size_t j = i;
+            while (((j+1) < cpuList.size()) && (cpuList[j+1] == cpuList[j] + 1))
+            {
+                j++;
+            }
+            if (j == i)
+            {
+                parts << QString::number(cpuList[i]);
+            }
+            else
+            {
+                parts << QString("%1-%2").arg(cpuList[i]).arg(cpuList[j]);
+            }
+            i = j + 1;
+        }
+        return parts.join(",");
+    }
+
+
+    // Private methods
+    // ------------------------------------------------------------------------
+    void ThreadAffinityService::updateLayout()
+    {
+        // Called with layoutMutex_ held
+        if (availableCpus_.empty())
+        {
+            availableCpus_ = getProcessCpus();
+        }
+        std::set<int> availableSet(availableCpus_.begin(), availableCpus_.end());
+
+        std::map<int, std::vector<int>> nodeToCpus = getNumaNodes();
+        if (nodeToCpus.empty())
+        {
+            nodeToCpus[0] = availableCpus_;
+        }
+        std::vector<int> nodeList;
+        for (auto &item : nodeToCpus)
+        {
+            nodeList.push_back(item.first);
+        }
+
+        std::vector<ThreadAffinityParams> paramsList(numberOfCameras_);
+        for (unsigned int i=0; i<numberOfCameras_; i++)
+        {
+            if (paramsMap_.count(i) > 0)
+            {
+                paramsList[i] = paramsMap_[i];
+            }
+        }
+        layout_.assign(numberOfCameras_, ThreadLayout());
+
+        // Numa node - given, from the camera's device or round robin
+        for (unsigned int i=0; i<numberOfCameras_; i++)
+        {
+            int node = -1;
+            if (nodeToCpus.count(paramsList[i].numaNode) > 0)
+            {
+                node = paramsList[i].numaNode;
+            }
+            else if (!paramsList[i].device.isEmpty())
+            {
+                int deviceNode = getDeviceNumaNode(paramsList[i].device);
+                if (nodeToCpus.count(deviceNode) > 0)
+                {
+                    node = deviceNode;
+                }
+            }
+            if (node < 0)
+            {
+                node = nodeList[i%nodeList.size()];
+            }
+            layout_[i].numaNode = node;
+        }
+
+        // Grabber cpus - those given first so the automatic ones avoid them. 
+        // Automatic cpus are taken from the top of the node's list, as low 
+        // numbered cpus tend to get more interrupts and housekeeping, and at 
+        // least one cpu is left on the node for the other threads.
+        std::set<int> grabberCpus;
+        for (unsigned int i=0; i<numberOfCameras_; i++)
+        {
+            int cpu = paramsList[i].grabberCpu;
+            if (paramsList[i].enabled && (availableSet.count(cpu) > 0))
+            {
+                layout_[i].grabberCpu = cpu;
+                grabberCpus.insert(cpu);
+            }
+        }
+        for (unsigned int i=0; i<numberOfCameras_; i++)
+        {
+            if (!paramsList[i].enabled || (paramsList[i].grabberCpu >= 0))
+            {
+                continue;
+            }
+            const std::vector<int> &nodeCpus = nodeToCpus[layout_[i].numaNode];
+            unsigned int numFree = 0;
+            for (int cpu : nodeCpus)
+            {
+                numFree += (grabberCpus.count(cpu) == 0) ? 1 : 0;
+            }
+            if (numFree < 2)
+            {
+                continue;
+            }
+            for (auto it=nodeCpus.rbegin(); it!=nodeCpus.rend(); it++)
+            {
+                if (grabberCpus.count(*it) == 0)
+                {
+                    layout_[i].grabberCpu = *it;
+                    grabberCpus.insert(*it);
+                    break;
+                }
+            }
+        }
+
+        // Worker cpus - given or the rest of the node
+        for (unsigned int i=0; i<numberOfCameras_; i++)
+        {
+            std::vector<int> workerCpus;
+            if (!paramsList[i].workerCpus.isEmpty())
+            {
+                for (int cpu : parseCpuList(paramsList[i].workerCpus))
+                {
+                    if (availableSet.count(cpu) > 0)
+                    {
+                        workerCpus.push_back(cpu);
+                    }
+                }
+            }
+            if (workerCpus.empty())
+            {
+                for (int cpu : nodeToCpus[layout_[i].numaNode])
+                {
+                    if (grabberCpus.count(cpu) == 0)
+                    {
+                        workerCpus.push_back(cpu);
+                    }
+                }
+            }
+            if (workerCpus.empty())
+            {
+                workerCpus = nodeToCpus[layout_[i].numaNode];
+            }
+            layout_[i].workerCpus = workerCpus;
+        }
+
+        layoutDirty_ = false;
+        realtimeFailed_.clear();
+
+#ifdef __linux__
+        coutDebugMutex_.lock();
+        std::cout << getLayoutStringNoLock().toStdString();
+        coutDebugMutex_.unlock();
+#endif
+    }
+
+
+    QString ThreadAffinityService::getLayoutStringNoLock()
+    {
+        std::set<int> nodeSet;
+        for (const ThreadLayout &layout : layout_)
+        {
+            nodeSet.insert(layout.numaNode);
+        }
+
+        std::stringstream ss;
+        ss << "thread affinity: " << numberOfCameras_ << " camera(s), cpus ";
+        ss << cpuListToString(availableCpus_).toStdString() << std::endl;
+        for (unsigned int i=0; i<layout_.size(); i++)
+        {
+            ThreadAffinityParams params;
+            if (paramsMap_.count(i) > 0)
+            {
+                params = paramsMap_[i];
+            }
+            ss << "  camera " << i << ": ";
+            if (!params.enabled)
+            {
+                ss << "not pinned";
+            }
+            else
+            {
+                ss << "node " << layout_[i].numaNode << ", grabber cpu ";
+                if (layout_[i].grabberCpu >= 0)
+                {
+                    ss << layout_[i].grabberCpu;
+                }
+                else
+                {
+                    ss << "shared";
+                }
+                ss << ", workers " << cpuListToString(layout_[i].workerCpus).toStdString();
+            }
+            if (params.realtimePolicy != REALTIME_POLICY_NONE)
+            {
+                ss << ", " << REALTIME_POLICY_TO_STRING_MAP[params.realtimePolicy].toStdString();
+                ss << " priority " << params.realtimePriority;
+            }
+            ss << std::endl;
+        }
+        return QString::fromStdString(ss.str());
+    }
+
+
+    std::vector<int> ThreadAffinityService::getProcessCpus()
+    {
+        std::vector<int> cpuList;
+#ifdef __linux__
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        if (sched_getaffinity(0, sizeof(cpu_set_t), &cpuSet) == 0)
+        {
+            for (int cpu=0; cpu<CPU_SETSIZE; cpu++)
+            {
+                if (CPU_ISSET(cpu, &cpuSet))
+                {
+                    cpuList.push_back(cpu);
+                }
+            }
+        }
+#endif
+        if (cpuList.empty())
+        {
+            for (int cpu=0; cpu<QThread::idealThreadCount(); cpu++)
+            {
+                cpuList.push_back(cpu);
+            }
+        }
+        return cpuList;
+    }
+
+
+    std::map<int, std::vector<int>> ThreadAffinityService::getNumaNodes()
+    {
+        // Available cpus of each numa node from sysfs - empty if there is no 
+        // numa information.
+        std::map<int, std::vector<int>> nodeToCpus;
+        std::set<int> availableSet(availableCpus_.begin(), availableCpus_.end());
+
+        QDir nodeDir("/sys/devices/system/node");
+        QStringList nodeNames = nodeDir.entryList(QStringList("node*"), QDir::Dirs);
+        for (QString nodeName : nodeNames)
+        {
+            bool ok = false;
+            int node = nodeName.mid(4).toInt(&ok);
+            QFile cpuListFile(nodeDir.absoluteFilePath(nodeName + "/cpulist"));
+            if (!ok || !cpuListFile.open(QIODevice::ReadOnly))
+            {
+                continue;
+            }
+            QString cpuListString = QString(cpuListFile.readAll());
+            std::vector<int> cpuList;
+            for (int cpu : parseCpuList(cpuListString))
+            {
+                if (availableSet.count(cpu) > 0)
+                {
+                    cpuList.push_back(cpu);
+                }
+            }
+            if (!cpuList.empty())
+            {
+                nodeToCpus[node] = cpuList;
+            }
+        }
+        return nodeToCpus;
+    }
+
+
+    int ThreadAffinityService::getDeviceNumaNode(QString device)
+    {
+        // device is a sysfs device path, a PCI address (e.g. "0000:3b:00.0")
+        // or a network interface name (e.g. "eth2"). Returns -1 if unknown.
+        QString fileName;
+        if (device.startsWith("/"))
+        {
+            fileName = device + "/numa_node";
+        }
+        else if (device.contains(":"))
+        {
+            fileName = QString("/sys/bus/pci/devices/%1/numa_node").arg(device);
+        }
+        else
+        {
+            fileName = QString("/sys/class/net/%1/device/numa_node").arg(device);
+        }
+
+        QFile nodeFile(fileName);
+        if (!nodeFile.open(QIODevice::ReadOnly))
+        {
+            return -1;
+        }
+        bool ok = false;
+        int node = QString(nodeFile.readAll()).trimmed().toInt(&ok);
+        return ok ? node : -1;
+    }
+
+
 } // namespace bias
@@ -1,20 +1,97 @@
 #ifndef BIAS_AFFINITY_HPP
 #define BIAS_AFFINITY_HPP
 #include <QMutex>
+#include <QMap>
+#include <QString>
+#include <map>
+#include <vector>
 
-namespace bias 
+namespace bias
 {
 
+    enum RealtimePolicy
+    {
+        REALTIME_POLICY_NONE = 0,
+        REALTIME_POLICY_FIFO,
+        REALTIME_POLICY_RR
+    };
+
+    extern const QMap<RealtimePolicy, QString> REALTIME_POLICY_TO_STRING_MAP;
+
+
+    struct ThreadAffinityParams
+    {
+        // Per camera overrides of the automatic thread layout (Linux only).
+        bool enabled;                   // pin the camera's threads at all - opt in
+        int numaNode;                   // -1 = from device or round robin
+        QString device;                 // network interface, PCI address or sysfs
+                                        // device path - used to find the numa node
+        int grabberCpu;                 // -1 = automatic
+        QString workerCpus;             // cpu list, e.g. "4-7,12", empty = automatic
+        RealtimePolicy realtimePolicy;  // scheduling policy for the grabber thread
+        int realtimePriority;
+
+        static const bool DEFAULT_ENABLED;
+        static const int DEFAULT_REALTIME_PRIORITY;
+
+        ThreadAffinityParams();
+    };
+
+
+    struct ThreadLayout
+    {
+        int numaNode;
+        int grabberCpu;                 // -1 = no dedicated cpu
+        std::vector<int> workerCpus;
+        ThreadLayout();
+    };
+
 
     class ThreadAffinityService
     {
+        // --------------------------------------------------------------------
+        // Assigns the capture threads to cpus. On Linux each camera is given
+        // a numa node (from its device, the config or round robin) and its
+        // grabber a dedicated cpu on that node. The camera's other threads
+        // (dispatcher, logger, compressors, etc.) share the node's remaining
+        // cpus. Frame buffers are allocated by the grabber thread so, with
+        // first touch placement, the image pool ends up on the same node.
+        // Threads shared by all cameras, i.e. the gui thread, may use any of
+        // the cameras' worker cpus.
+        // --------------------------------------------------------------------
+
         public:
             static void setNumberOfCameras(unsigned int numberOfCameras);
             static bool assignThreadAffinity(bool isImageGrabber, unsigned int cameraNumber);
+            static bool assignSharedThreadAffinity();
+
+            static void setParams(unsigned int cameraNumber, ThreadAffinityParams params);
+            static ThreadAffinityParams getParams(unsigned int cameraNumber);
+            static ThreadLayout getLayout(unsigned int cameraNumber);
+            static QString getLayoutString();
+
+            static std::vector<int> parseCpuList(QString cpuListString, bool *ok=0);
+            static QString cpuListToString(const std::vector<int> &cpuList);
 
         private:
             static unsigned int numberOfCameras_;
             static QMutex coutDebugMutex_;
+
+            // Use layoutMutex_ when accessing these values
+            // --------------------------------------------
+            static QMutex layoutMutex_;
+            static bool layoutDirty_;
+            static std::vector<int> availableCpus_;
+            static std::map<unsigned int, ThreadAffinityParams> paramsMap_;
+            static std::map<unsigned int, bool> realtimeFailed_;
+            static std::vector<ThreadLayout> layout_;
+            // --------------------------------------------
+
+            static void updateLayout();
+            static QString getLayoutStringNoLock();
+            static std::vector<int> getProcessCpus();
+            static std::map<int, std::vector<int>> getNumaNodes();
+            static int getDeviceNumaNode(QString device);
     };
 
 } // namespace bias
@@ -0,0 +1,524 @@
+#include "async_file_writer.hpp"
+#include "basic_types.hpp"
+#include "exception.hpp"
+#include "affinity.hpp"
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <QThreadPool>
+#include <QElapsedTimer>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef WIN32
+#include <malloc.h>
+#endif
+
+namespace bias
+{
+    const size_t AsyncFileWriter::DEFAULT_CHUNK_SIZE = 4*1024*1024;
+    const unsigned int AsyncFileWriter::DEFAULT_MAX_BACKLOG = 16;
+    const size_t AsyncFileWriter::DIRECT_IO_ALIGNMENT = 4096;
+
+
+    AsyncFileWriterStats::AsyncFileWriterStats()
+    {
+        bytesWritten = 0;
+        numChunks = 0;
+        backlog = 0;
+        maxBacklog = 0;
+        stallTimeMs = 0.0;
+        maxStallMs = 0.0;
+        maxWriteMs = 0.0;
+        elapsedTimeMs = 0.0;
+    }
+
+
+    // Chunk buffer - aligned so that it can be used with O_DIRECT
+    // ----------------------------------------------------------------------------------
+    class AsyncFileWriterChunk
+    {
+        public:
+
+            char *data;
+            size_t size;
+            size_t capacity;
+
+            AsyncFileWriterChunk(size_t chunkCapacity)
+            {
+                size = 0;
+                capacity = chunkCapacity;
+#ifdef WIN32
+                data = (char *) _aligned_malloc(capacity, AsyncFileWriter::DIRECT_IO_ALIGNMENT);
+#else
+                void *ptr = nullptr;
+                if (posix_memalign(&ptr, AsyncFileWriter::DIRECT_IO_ALIGNMENT, capacity) != 0)
+                {
+                    ptr = nullptr;
+                }
+                data = (char *) ptr;
+#endif
+                if (data == nullptr)
+                {
+                    unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
+                    std::string errorMsg("async file writer unable to allocate write buffer");
+                    throw RuntimeError(errorId, errorMsg);
+                }
+            }
+
+            ~AsyncFileWriterChunk()
+            {
+#ifdef WIN32
+                _aligned_free(data);
+#else
+                free(data);
+#endif
+            }
+
+        private:
+            AsyncFileWriterChunk(const AsyncFileWriterChunk &);
+            AsyncFileWriterChunk &operator=(const AsyncFileWriterChunk &);
+    };
+
+
+    // AsyncFileWriter
+    // ----------------------------------------------------------------------------------
+    AsyncFileWriter::AsyncFileWriter(size_t chunkSize, unsigned int maxBacklog)
+    {
+        setAutoDelete(false);
+
+        // Keep chunks a multiple of the direct I/O alignment
+        chunkSize_ = DIRECT_IO_ALIGNMENT*((chunkSize + DIRECT_IO_ALIGNMENT - 1)/DIRECT_IO_ALIGNMENT);
+        maxBacklog_ = (maxBacklog > 0) ? maxBacklog : 1;
+        directIo_ = false;
+        preallocateSize_ = 0;
+        cameraNumber_ = 0;
+
+        isOpen_ = false;
+        running_ = false;
+        finishing_ = false;
+        error_ = false;
+
+        fd_ = -1;
+        numChunksAllocated_ = 0;
+        position_ = 0;
+    }
+
+
+    AsyncFileWriter::~AsyncFileWriter()
+    {
+        finish();
+        if (isOpen_)
+        {
+            close();
+        }
+    }
+
+
+    void AsyncFileWriter::setDirectIo(bool value)
+    {
+        directIo_ = value;
+    }
+
+
+    void AsyncFileWriter::setPreallocateSize(uint64_t numBytes)
+    {
+        preallocateSize_ = numBytes;
+    }
+
+
+    void AsyncFileWriter::setCameraNumber(unsigned int cameraNumber)
+    {
+        cameraNumber_ = cameraNumber;
+    }
+
+
+    void AsyncFileWriter::open(std::string fileName)
+    {
+        position_ = 0;
+        error_ = false;
+        errorMsg_.clear();
+        stats_ = AsyncFileWriterStats();
+
+#ifdef __linux__
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+        if (directIo_)
+        {
+            fd_ = ::open(fileName.c_str(), flags | O_DIRECT, 0644);
+            if ((fd_ < 0) && (errno == EINVAL))
+            {
+                // File system doesn't support direct I/O - fall back to buffered
+                directIo_ = false;
+            }
+        }
+        if (!directIo_)
+        {
+            fd_ = ::open(fileName.c_str(), flags, 0644);
+        }
+        if (fd_ < 0)
+        {
+            unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
+            std::string errorMsg("video writer unable to open file:\n\n");
+            errorMsg += std::strerror(errno);
+            throw RuntimeError(errorId, errorMsg);
+        }
+        if (preallocateSize_ > 0)
+        {
+            // Preallocation is only a hint - ignore failures
+            if (fallocate(fd_, 0, 0, off_t(preallocateSize_)) != 0)
+            {
+                preallocateSize_ = 0;
+            }
+        }
+#else
+        file_.clear();
+        file_.open(fileName, std::ios::binary | std::ios::out);
+        if (!file_.is_open())
+        {
+            unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
+            std::string errorMsg("video writer unable to open file:\n\n");
+            errorMsg += fileName;
+            throw RuntimeError(errorId, errorMsg);
+        }
+#endif
+        isOpen_ = true;
+        acquireLock();
+        openTimer_.start();
+        releaseLock();
+    }
+
+
+    void AsyncFileWriter::start(QThreadPool *threadPoolPtr)
+    {
+        acquireLock();
+        finishing_ = false;
+        running_ = true;
+        releaseLock();
+        threadPoolPtr -> start(this);
+    }
+
+
+    void AsyncFileWriter::write(const void *data, size_t size)
+    {
+        if (error_)
+        {
+            unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
+            std::string errorMsg("video writer unable to write file:\n\n");
+            errorMsg += getErrorMsg();
+            throw RuntimeError(errorId, errorMsg);
+        }
+
+        const char *dataPtr = (const char *) data;
+        while (size > 0)
+        {
+            if (currentChunkPtr_ == nullptr)
+            {
+                currentChunkPtr_ = getFreeChunk();
+            }
+            AsyncFileWriterChunk &chunk = *currentChunkPtr_;
+            size_t num = chunk.capacity - chunk.size;
+            num = (size < num) ? size : num;
+            std::memcpy(chunk.data + chunk.size, dataPtr, num);
+            chunk.size += num;
+            dataPtr += num;
+            size -= num;
+            position_ += num;
+            if (chunk.size == chunk.capacity)
+            {
+                handOffCurrentChunk();
+            }
+        }
+    }
+
+
+    uint64_t AsyncFileWriter::tellp() const
+    {
+        return position_;
+    }
+
+
+    void AsyncFileWriter::finish()
+    {
+        // Writes out everything buffered and waits for the writer thread to exit.
+        if ((currentChunkPtr_ != nullptr) && (currentChunkPtr_ -> size > 0))
+        {
+            handOffCurrentChunk();
+        }
+        acquireLock();
+        finishing_ = true;
+        notEmptyWaitCond_.wakeAll();
+        while (running_)
+        {
+            doneWaitCond_.wait(&mutex_);
+        }
+        releaseLock();
+    }
+
+
+    void AsyncFileWriter::writeAt(uint64_t pos, const void *data, size_t size)
+    {
+        // Overwrite already written bytes e.g. to patch a header. Only valid
+        // after finish().
+        if (error_ || !isOpen_)
+        {
+            return;
+        }
+#ifdef __linux__
+        if (directIo_)
+        {
+            int flags = fcntl(fd_, F_GETFL);
+            fcntl(fd_, F_SETFL, flags & ~O_DIRECT);
+            directIo_ = false;
+        }
+        if (pwrite(fd_, data, size, off_t(pos)) != ssize_t(size))
+        {
+            setError(std::strerror(errno));
+        }
+#else
+        file_.seekp(std::streampos(pos), std::ios_base::beg);
+        file_.write((const char *) data, size);
+        file_.seekp(0, std::ios_base::end);
+        if (!file_)
+        {
+            setError("write failed");
+        }
+#endif
+    }
+
+
+    void AsyncFileWriter::close()
+    {
+        if (!isOpen_)
+        {
+            return;
+        }
+#ifdef __linux__
+        if (preallocateSize_ > 0)
+        {
+            // Remove unused preallocated space
+            if (ftruncate(fd_, off_t(position_)) != 0)
+            {
+                setError(std::strerror(errno));
+            }
+        }
+        ::close(fd_);
+        fd_ = -1;
+#else
+        file_.close();
+#endif
+        isOpen_ = false;
+    }
+
+
+    bool AsyncFileWriter::isOpen() const
+    {
+        return isOpen_;
+    }
+
+
+    bool AsyncFileWriter::haveError() const
+    {
+        return error_;
+    }
+
+
+    std::string AsyncFileWriter::getErrorMsg()
+    {
+        acquireLock();
+        std::string errorMsg = errorMsg_;
+        releaseLock();
+        return errorMsg;
+    }
+
+
+    AsyncFileWriterStats AsyncFileWriter::getStats()
+    {
+        acquireLock();
+        AsyncFileWriterStats stats = stats_;
+        stats.backlog = (unsigned int)(fullChunks_.size());
+        if (openTimer_.isValid())
+        {
+            stats.elapsedTimeMs = 1.0e-6*double(openTimer_.nsecsElapsed());
+        }
+        releaseLock();
+        return stats;
+    }
+
+
+    void AsyncFileWriter::handOffCurrentChunk()
+    {
+        acquireLock();
+        if (!running_)
+        {
+            // No writer thread - write synchronously
+            releaseLock();
+            writeChunk(*currentChunkPtr_);
+            acquireLock();
+            stats_.bytesWritten += currentChunkPtr_ -> size;
+            stats_.numChunks++;
+            currentChunkPtr_ -> size = 0;
+            releaseLock();
+            return;
+        }
+        fullChunks_.push_back(currentChunkPtr_);
+        unsigned int backlog = (unsigned int)(fullChunks_.size());
+        if (backlog > stats_.maxBacklog)
+        {
+            stats_.maxBacklog = backlog;
+        }
+        notEmptyWaitCond_.wakeOne();
+        releaseLock();
+        currentChunkPtr_.reset();
+    }
+
+
+    AsyncFileWriter::ChunkPtr AsyncFileWriter::getFreeChunk()
+    {
+        // Reuse a written chunk, allocate a new one if the backlog limit allows,
+        // otherwise wait for the writer thread to finish a chunk.
+        ChunkPtr chunkPtr;
+        bool allocate = false;
+        QElapsedTimer stallTimer;
+        bool stalled = false;
+
+        acquireLock();
+        while (chunkPtr == nullptr)
+        {
+            if (!freeChunks_.empty())
+            {
+                chunkPtr = freeChunks_.back();
+                freeChunks_.pop_back();
+            }
+            else if (numChunksAllocated_ < maxBacklog_ + 2)
+            {
+                numChunksAllocated_++;
+                allocate = true;
+                break;
+            }
+            else
+            {
+                if (!stalled)
+                {
+                    stallTimer.start();
+                    stalled = true;
+                }
+                notFullWaitCond_.wait(&mutex_);
+            }
+        }
+        if (stalled)
+        {
+            double stallMs = 1.0e-6*double(stallTimer.nsecsElapsed());
+            stats_.stallTimeMs += stallMs;
+            if (stallMs > stats_.maxStallMs)
+            {
+                stats_.maxStallMs = stallMs;
+            }
+        }
+        releaseLock();
+
+        if (allocate)
+        {
+            chunkPtr = std::make_shared<AsyncFileWriterChunk>(chunkSize_);
+        }
+        chunkPtr -> size = 0;
+        return chunkPtr;
+    }
+
+
+    void AsyncFileWriter::writeChunk(AsyncFileWriterChunk &chunk)
+    {
+        if (error_ || (chunk.size == 0))
+        {
+            return;
+        }
+#ifdef __linux__
+        if (directIo_ && (chunk.size%DIRECT_IO_ALIGNMENT != 0))
+        {
+            // Final partial chunk - direct I/O needs aligned sizes
+            int flags = fcntl(fd_, F_GETFL);
+            fcntl(fd_, F_SETFL, flags & ~O_DIRECT);
+            directIo_ = false;
+        }
+        size_t numDone = 0;
+        while (numDone < chunk.size)
+        {
+            ssize_t num = ::write(fd_, chunk.data + numDone, chunk.size - numDone);
+            if (num < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                setError(std::strerror(errno));
+                return;
+            }
+            numDone += size_t(num);
+        }
+#else
+        file_.write(chunk.data, chunk.size);
+        if (!file_)
+        {
+            setError("write failed");
+        }
+#endif
+    }
+
+
+    void AsyncFileWriter::setError(std::string errorMsg)
+    {
+        acquireLock();
+        if (!error_)
+        {
+            errorMsg_ = errorMsg;
+            error_ = true;
+        }
+        releaseLock();
+    }
+
+
+    void AsyncFileWriter::run()
+    {
+        ThreadAffinityService::assignThreadAffinity(false,cameraNumber_);
+
+        while (true)
+        {
+            acquireLock();
+            while (fullChunks_.empty() && !finishing_)
+            {
+                notEmptyWaitCond_.wait(&mutex_);
+            }
+            if (fullChunks_.empty())
+            {
+                running_ = false;
+                doneWaitCond_.wakeAll();
+                releaseLock();
+                return;
+            }
+            ChunkPtr chunkPtr = fullChunks_.front();
+            fullChunks_.pop_front();
+            releaseLock();
+
+            QElapsedTimer writeTimer;
+            writeTimer.start();
+            writeChunk(*chunkPtr);
+            double writeMs = 1.0e-6*double(writeTimer.nsecsElapsed());
+
+            acquireLock();
+            stats_.bytesWritten += chunkPtr -> size;
+            stats_.numChunks++;
+            if (writeMs > stats_.maxWriteMs)
+            {
+                stats_.maxWriteMs = writeMs;
+            }
+            chunkPtr -> size = 0;
+            freeChunks_.push_back(chunkPtr);
+            notFullWaitCond_.wakeAll();
+            releaseLock();
+        }
+    }
+
+} // namespace bias
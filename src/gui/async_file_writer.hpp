@@ -0,0 +1,125 @@
+#ifndef BIAS_ASYNC_FILE_WRITER_HPP
+#define BIAS_ASYNC_FILE_WRITER_HPP
+
+#include <QRunnable>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <atomic>
+#include <cstdint>
+#include "lockable.hpp"
+
+class QThreadPool;
+
+namespace bias
+{
+
+    struct AsyncFileWriterStats
+    {
+        uint64_t bytesWritten;      // bytes on disk so far
+        unsigned long numChunks;    // chunks written
+        unsigned int backlog;       // chunks waiting to be written
+        unsigned int maxBacklog;    // high water mark of backlog
+        double stallTimeMs;         // total time producer was blocked on a full backlog
+        double maxStallMs;          // longest single producer stall
+        double maxWriteMs;          // longest single chunk write
+        double elapsedTimeMs;       // time since the file was opened
+        AsyncFileWriterStats();
+    };
+
+
+    class AsyncFileWriterChunk;
+
+
+    // Sequential file writer with the disk I/O done on a separate thread.
+    //
+    // The producer appends bytes with write() which copies them into large
+    // pre-allocated chunks. Full chunks are handed to the writer thread which
+    // issues one big sequential write per chunk. At most maxBacklog chunks may be
+    // waiting - write() blocks (and the stall is recorded) rather than drop data.
+    // tellp() gives the logical position of the next byte for building indices.
+    //
+    // On Linux the file can optionally be opened with O_DIRECT and preallocated
+    // with fallocate; the preallocated tail is truncated on close.
+    class AsyncFileWriter : public QRunnable, public Lockable<Empty>
+    {
+        public:
+
+            AsyncFileWriter(
+                    size_t chunkSize=DEFAULT_CHUNK_SIZE,
+                    unsigned int maxBacklog=DEFAULT_MAX_BACKLOG
+                    );
+            virtual ~AsyncFileWriter();
+
+            void setDirectIo(bool value);
+            void setPreallocateSize(uint64_t numBytes);
+            void setCameraNumber(unsigned int cameraNumber);
+
+            // Producer side - the thread which creates the file content
+            void open(std::string fileName);
+            void start(QThreadPool *threadPoolPtr);
+            void write(const void *data, size_t size);
+            template <class T> void writeValue(const T &value)
+            {
+                write(&value, sizeof(T));
+            }
+            uint64_t tellp() const;
+            void finish();
+            void writeAt(uint64_t pos, const void *data, size_t size);
+            void close();
+
+            bool isOpen() const;
+            bool haveError() const;
+            std::string getErrorMsg();
+            AsyncFileWriterStats getStats();
+
+            static const size_t DEFAULT_CHUNK_SIZE;
+            static const unsigned int DEFAULT_MAX_BACKLOG;
+            static const size_t DIRECT_IO_ALIGNMENT;
+
+        protected:
+
+            typedef std::shared_ptr<AsyncFileWriterChunk> ChunkPtr;
+
+            size_t chunkSize_;
+            unsigned int maxBacklog_;
+            bool directIo_;
+            uint64_t preallocateSize_;
+            unsigned int cameraNumber_;
+
+            bool isOpen_;
+            bool running_;
+            bool finishing_;
+            std::atomic<bool> error_;
+            std::string errorMsg_;
+
+            int fd_;
+            std::fstream file_;
+
+            ChunkPtr currentChunkPtr_;
+            std::deque<ChunkPtr> fullChunks_;
+            std::vector<ChunkPtr> freeChunks_;
+            unsigned int numChunksAllocated_;
+            uint64_t position_;
+
+            QWaitCondition notEmptyWaitCond_;
+            QWaitCondition notFullWaitCond_;
+            QWaitCondition doneWaitCond_;
+
+            AsyncFileWriterStats stats_;
+            QElapsedTimer openTimer_;
+
+            void handOffCurrentChunk();
+            ChunkPtr getFreeChunk();
+            void writeChunk(AsyncFileWriterChunk &chunk);
+            void setError(std::string errorMsg);
+            void run();
+    };
+
+} // namespace bias
+
+#endif // #ifndef BIAS_ASYNC_FILE_WRITER_HPP
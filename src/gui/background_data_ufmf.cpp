@@ -1,31 +1,46 @@
 #include "background_data_ufmf.hpp"
 #include "stamped_image.hpp"
+#include "simd_utils.hpp"
 #include <cstring>
 #include <algorithm>
 #include <opencv2/core/core.hpp>
-
-// TEST
-// ------------------------------------------------------------------
 #include <QThread>
-// ------------------------------------------------------------------
 
 namespace bias
-{ 
-    BackgroundData_ufmf::BackgroundData_ufmf()  
+{
+    const unsigned int BackgroundData_ufmf::MAX_COUNT = 0xffff;
+
+#ifdef BIAS_HAVE_SSE2
+    // Sum of 8 unsigned 16-bit counters
+    static inline unsigned long sumBlock8(const uint16_t *ptr)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i v = _mm_loadu_si128((const __m128i *) ptr);
+        __m128i s = _mm_add_epi32(_mm_unpacklo_epi16(v,zero), _mm_unpackhi_epi16(v,zero));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1,0,3,2)));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2,3,0,1)));
+        return (unsigned long)(_mm_cvtsi128_si32(s));
+    }
+#endif
+
+
+    BackgroundData_ufmf::BackgroundData_ufmf()
     {
         binSize_ = 1;
+        binShift_ = 0;
         numBins_ = 0;
         numRows_ = 0;
         numCols_ = 0;
         binPtr_ = NULL;
-        cntPtr_ = NULL;
+        imageType_ = CV_8UC1;
         nFrames_ = 0;
+        maxBinCount_ = 0;
     }
 
 
     BackgroundData_ufmf::BackgroundData_ufmf(
-            StampedImage stampedImg, 
-            unsigned int numBins, 
+            StampedImage stampedImg,
+            unsigned int numBins,
             unsigned int binSize
             )
     {
@@ -33,15 +48,21 @@ namespace bias
         binSize_ = binSize;
         numRows_ = stampedImg.image.rows;
         numCols_ = stampedImg.image.cols;
+        imageType_ = stampedImg.image.type();
 
-        binPtr_ = std::shared_ptr<unsigned int>(
-                new unsigned int[numRows_*numCols_*numBins_], 
-                std::default_delete<unsigned int[]>()
-                );
-
-        cntPtr_ = std::shared_ptr<unsigned long>(
-                new unsigned long[numRows_*numCols_],
-                std::default_delete<unsigned long[]>()
+        binShift_ = -1;
+        for (int i=0; i<16; i++)
+        {
+            if (binSize_ == (1u << i))
+            {
+                binShift_ = i;
+                break;
+            }
+        }
+
+        binPtr_ = std::shared_ptr<uint16_t>(
+                new uint16_t[size_t(numRows_)*numCols_*numBins_],
+                std::default_delete<uint16_t[]>()
                 );
         clear();
     }
@@ -49,112 +70,298 @@ namespace bias
 
     void BackgroundData_ufmf::addImage(StampedImage stampedImg)
     {
-        unsigned int bin;
-        unsigned int pix;
-        unsigned int binInd;
-        unsigned int cntInd;
-        unsigned int  *binPtr = binPtr_.get();
-        unsigned long *cntPtr = cntPtr_.get();
+        if ((binPtr_ == NULL) || (stampedImg.image.type() != imageType_))
+        {
+            return;
+        }
+        if ((imageType_ != CV_8UC1) && (imageType_ != CV_16UC1))
+        {
+            return;
+        }
+        if ((stampedImg.image.rows != int(numRows_)) || (stampedImg.image.cols != int(numCols_)))
+        {
+            return;
+        }
+
+        if (maxBinCount_ >= MAX_COUNT)
+        {
+            rescale();
+        }
 
         QThread *thisThread = QThread::currentThread();
+        size_t rowStride = size_t(numCols_)*numBins_;
 
         for (unsigned int row=0; row < numRows_; row++)
         {
-            for (unsigned int col=0; col< numCols_; col++)
+            if (imageType_ == CV_16UC1)
+            {
+                addRow16(stampedImg.image.ptr<uint16_t>(row), binPtr_.get() + row*rowStride);
+            }
+            else
             {
-                pix = (unsigned int) (stampedImg.image.at<uchar>(row,col));
-                bin = pix/binSize_; 
+                addRow(stampedImg.image.ptr<uint8_t>(row), binPtr_.get() + row*rowStride);
+            }
 
-                binInd = col + numCols_*row + (numRows_*numCols_)*bin;
-                cntInd = col + numCols_*row;
+            // Yield to another thread once per row - helps keep frame rate steady
+            thisThread -> yieldCurrentThread();
+        }
+        maxBinCount_++;
+        nFrames_++;
+    }
 
-                *(binPtr + binInd) += 1;
-                *(cntPtr + cntInd) += 1;
 
-                // Yield to another thread - this helps keep frame rate steady
-                thisThread -> yieldCurrentThread();
-            } 
+    void BackgroundData_ufmf::addRow(const uint8_t *pixPtr, uint16_t *binPtr) const
+    {
+        const unsigned int lastBin = numBins_ - 1;
+        unsigned int col = 0;
 
-        } 
-        nFrames_++;
+        if (binShift_ >= 0)
+        {
+#ifdef BIAS_HAVE_SSE2
+            // Compute bin indices for 16 pixels at a time and scatter the increments
+            alignas(16) uint16_t bins[16];
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i shift = _mm_cvtsi32_si128(binShift_);
+            const __m128i maxBin = _mm_set1_epi16(short(lastBin));
+            for (; col + 16 <= numCols_; col += 16)
+            {
+                __m128i pix = _mm_loadu_si128((const __m128i *) (pixPtr + col));
+                __m128i lo = _mm_srl_epi16(_mm_unpacklo_epi8(pix, zero), shift);
+                __m128i hi = _mm_srl_epi16(_mm_unpackhi_epi8(pix, zero), shift);
+                // Clamp to last bin - values are < 256 so signed min is safe
+                _mm_store_si128((__m128i *) bins, _mm_min_epi16(lo, maxBin));
+                _mm_store_si128((__m128i *) (bins+8), _mm_min_epi16(hi, maxBin));
+                uint16_t *colPtr = binPtr + size_t(col)*numBins_;
+                for (unsigned int i=0; i<16; i++)
+                {
+                    colPtr[i*numBins_ + bins[i]]++;
+                }
+            }
+#endif
+            for (; col < numCols_; col++)
+            {
+                unsigned int bin = std::min(((unsigned int) pixPtr[col]) >> binShift_, lastBin);
+                binPtr[size_t(col)*numBins_ + bin]++;
+            }
+        }
+        else
+        {
+            for (; col < numCols_; col++)
+            {
+                unsigned int bin = std::min(((unsigned int) pixPtr[col])/binSize_, lastBin);
+                binPtr[size_t(col)*numBins_ + bin]++;
+            }
+        }
+    }
+
+
+    void BackgroundData_ufmf::addRow16(const uint16_t *pixPtr, uint16_t *binPtr) const
+    {
+        const unsigned int lastBin = numBins_ - 1;
+        unsigned int col = 0;
+
+        if (binShift_ >= 0)
+        {
+#ifdef BIAS_HAVE_SSE2
+            // As addRow but 8 pixels at a time. Values may use all 16 bits so
+            // the clamp is an unsigned min, bin - max(bin - lastBin, 0).
+            alignas(16) uint16_t bins[8];
+            const __m128i shift = _mm_cvtsi32_si128(binShift_);
+            const __m128i maxBin = _mm_set1_epi16(short(lastBin));
+            for (; col + 8 <= numCols_; col += 8)
+            {
+                __m128i pix = _mm_srl_epi16(_mm_loadu_si128((const __m128i *) (pixPtr + col)), shift);
+                _mm_store_si128((__m128i *) bins, _mm_sub_epi16(pix, _mm_subs_epu16(pix, maxBin)));
+                uint16_t *colPtr = binPtr + size_t(col)*numBins_;
+                for (unsigned int i=0; i<8; i++)
+                {
+                    colPtr[i*numBins_ + bins[i]]++;
+                }
+            }
+#endif
+            for (; col < numCols_; col++)
+            {
+                unsigned int bin = std::min(((unsigned int) pixPtr[col]) >> binShift_, lastBin);
+                binPtr[size_t(col)*numBins_ + bin]++;
+            }
+        }
+        else
+        {
+            for (; col < numCols_; col++)
+            {
+                unsigned int bin = std::min(((unsigned int) pixPtr[col])/binSize_, lastBin);
+                binPtr[size_t(col)*numBins_ + bin]++;
+            }
+        }
+    }
+
+
+    void BackgroundData_ufmf::rescale()
+    {
+        // Halve all counters, rounding up so that non-empty bins stay non-empty.
+        uint16_t *binPtr = binPtr_.get();
+        size_t numCounters = size_t(numRows_)*numCols_*numBins_;
+        size_t i = 0;
+#ifdef BIAS_HAVE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 8 <= numCounters; i += 8)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *) (binPtr + i));
+            _mm_storeu_si128((__m128i *) (binPtr + i), _mm_avg_epu16(v, zero));
+        }
+#endif
+        for (; i < numCounters; i++)
+        {
+            binPtr[i] = uint16_t((binPtr[i] + 1) >> 1);
+        }
+        maxBinCount_ = (maxBinCount_ + 1) >> 1;
     }
 
+
     int BackgroundData_ufmf::getNFrames()
     {
 		return nFrames_;
 	}
 
-    cv::Mat BackgroundData_ufmf::getMedianImage() const
+
+    unsigned int BackgroundData_ufmf::getNumRows() const
     {
-        unsigned int bin;
-        unsigned int binValue;
-        unsigned int *binPtr = binPtr_.get();
+        return numRows_;
+    }
 
-        unsigned long cntTotal;
-        unsigned long cntHalf;
-        unsigned long cntCurrent;
-        unsigned long *cntPtr = cntPtr_.get();
 
-        float medianScale = float(binSize_);
-        float medianShift = (medianScale - 1.0)/2.0;
-        float median;
+    unsigned int BackgroundData_ufmf::getNumCols() const
+    {
+        return numCols_;
+    }
 
-        cv::Mat medianMat(numRows_, numCols_, CV_8UC1);
 
-        QThread *thisThread = QThread::currentThread();
+    int BackgroundData_ufmf::getImageType() const
+    {
+        return imageType_;
+    }
 
-        for (unsigned int row=0; row<numRows_; row++)
+
+    float BackgroundData_ufmf::medianBin(const uint16_t *binPtr) const
+    {
+        // Get total and half total # of counts for current pixel
+        unsigned long cntTotal = 0;
+        unsigned int bin = 0;
+#ifdef BIAS_HAVE_SSE2
+        for (; bin + 8 <= numBins_; bin += 8)
+        {
+            cntTotal += sumBlock8(binPtr + bin);
+        }
+#endif
+        for (; bin < numBins_; bin++)
         {
-            for (unsigned int col=0; col<numCols_; col++)
+            cntTotal += binPtr[bin];
+        }
+        if (cntTotal == 0)
+        {
+            return 0.0;
+        }
+        unsigned long cntHalf = cntTotal/2;
+
+        // Find first bin such that more than half of all counts are in a bin
+        // with a value smaller than or equal to itself. Skip whole blocks first.
+        unsigned long cntBelow = 0;
+        bin = 0;
+#ifdef BIAS_HAVE_SSE2
+        for (; bin + 8 <= numBins_; bin += 8)
+        {
+            unsigned long cntBlock = sumBlock8(binPtr + bin);
+            if (cntBelow + cntBlock > cntHalf)
             {
-                // Get total and half total # of counts for current pixel
-                cntTotal = *(cntPtr + col + numCols_*row);
-                cntHalf = cntTotal/2;
+                break;
+            }
+            cntBelow += cntBlock;
+        }
+#endif
+        for (; bin < numBins_ - 1; bin++)
+        {
+            if (cntBelow + binPtr[bin] > cntHalf)
+            {
+                break;
+            }
+            cntBelow += binPtr[bin];
+        }
 
-                // Find first bin such that at least half of all counts are in a 
-                // bin with a value smaller than of equal to itself. 
-                for (bin=0,cntCurrent=0; bin<numBins_, cntCurrent<=cntHalf; bin++)
-                {
-                    binValue = *(binPtr + col + numCols_*row + (numRows_*numCols_)*bin);  
-                    cntCurrent += binValue;
-                }
+        // Compute the median bin value
+        if ((cntTotal%2!=0) || ((cntHalf - cntBelow) > 1))
+        {
+            return float(bin);
+        }
+        else
+        {
+            return float(bin) - 0.5f;
+        }
+    }
 
-                // Compute the median bin value
-                if ((cntTotal%2!=0) || ((cntHalf-(cntCurrent-binValue)) > 1))
-                {
-                    median = float(bin-1);
-                }
-                else
-                {
-                    median = (float(bin-1)-0.5);
-                }
 
-                // Median clamp - in case of values outside of range (shouldn't happen)
-                // --------------------------------------------------------------------
-                //median = (median < 0)   ?   0 : median;
-                //median = (median > 255) ? 255 : median;
-                //---------------------------------------------------------------------
+    cv::Mat BackgroundData_ufmf::getMedianImage() const
+    {
+        cv::Mat medianMat(numRows_, numCols_, imageType_);
+        getMedianRows(medianMat, 0, numRows_);
+        return medianMat;
+    }
 
-                // Adjust to get the median pixal value
-                median = medianScale*median + medianShift;
-                medianMat.at<uchar>(row,col) = uchar(median);
 
-                // Yield to another thread - this helps keep frame rate steady
-                thisThread -> yieldCurrentThread();
+    void BackgroundData_ufmf::getMedianRows(
+            cv::Mat &medianMat, 
+            unsigned int rowBegin, 
+            unsigned int rowEnd
+            ) const
+    {
+        // Computes median for rows [rowBegin, rowEnd) of medianMat which must be 
+        // a numRows x numCols image of the same type as the data's images. Rows 
+        // outside the range are untouched so disjoint row ranges may be computed 
+        // concurrently. 
+        float medianScale = float(binSize_);
+        float medianShift = (medianScale - 1.0f)/2.0f;
 
-            } // for j
+        const uint16_t *binPtr = binPtr_.get();
+        rowEnd = std::min(rowEnd, numRows_);
 
+        QThread *thisThread = QThread::currentThread();
 
-        } // for i
+        for (unsigned int row=rowBegin; row<rowEnd; row++)
+        {
+            const uint16_t *rowPtr = binPtr + size_t(row)*numCols_*numBins_;
+            if (imageType_ == CV_16UC1)
+            {
+                uint16_t *medianPtr = medianMat.ptr<uint16_t>(row);
+                for (unsigned int col=0; col<numCols_; col++)
+                {
+                    float median = medianScale*medianBin(rowPtr + size_t(col)*numBins_) + medianShift;
+                    medianPtr[col] = uint16_t(median);
+                }
+            }
+            else
+            {
+                uchar *medianPtr = medianMat.ptr<uchar>(row);
+                for (unsigned int col=0; col<numCols_; col++)
+                {
+                    // Adjust to get the median pixel value
+                    float median = medianScale*medianBin(rowPtr + size_t(col)*numBins_) + medianShift;
+                    medianPtr[col] = uchar(median);
+                }
+            }
 
-        return medianMat;
+            // Yield to another thread once per row - helps keep frame rate steady
+            thisThread -> yieldCurrentThread();
+        }
     }
 
+
     void BackgroundData_ufmf::clear()
     {
-        std::fill_n(binPtr_.get(), numRows_*numCols_*numBins_, 0);
-        std::fill_n(cntPtr_.get(), numRows_*numCols_, 0);
+        if (binPtr_ != NULL)
+        {
+            std::fill_n(binPtr_.get(), size_t(numRows_)*numCols_*numBins_, 0);
+        }
         nFrames_ = 0;
+        maxBinCount_ = 0;
     }
 
 } // namespace bias
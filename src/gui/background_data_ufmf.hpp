@@ -1,6 +1,7 @@
 #ifndef BIAS_BACKGROUND_DATA_UFMF_HPP
 #define BIAS_BACKGROUND_DATA_UFMF_HPP
 #include <memory>
+#include <cstdint>
 
 namespace cv {class Mat;}
 
@@ -8,29 +9,51 @@ namespace bias
 {
     class StampedImage;
 
+    // Per-pixel intensity histograms used for running median background estimation.
+    //
+    // Histograms are stored pixel-major - the numBins 16-bit counters for a pixel
+    // are contiguous - so the median search for a pixel walks a single small block
+    // of memory. All pixels receive exactly one count per frame, so the counters
+    // can only overflow after MAX_COUNT frames. When that happens every histogram
+    // is halved which leaves the median unchanged up to rounding.
+    //
+    // Images may be CV_8UC1 or CV_16UC1. The median image has the same type as
+    // the images, for 16-bit images its resolution is set by the bin size.
     class BackgroundData_ufmf
     {
         public:
+            static const unsigned int MAX_COUNT;
+
             BackgroundData_ufmf();
-            BackgroundData_ufmf( 
-                    StampedImage stampedImg, 
-                    unsigned int numBins, 
+            BackgroundData_ufmf(
+                    StampedImage stampedImg,
+                    unsigned int numBins,
                     unsigned int binSize
                     );
             void addImage(StampedImage stampedImg);
             cv::Mat getMedianImage() const;
+            void getMedianRows(cv::Mat &medianMat, unsigned int rowBegin, unsigned int rowEnd) const;
             void clear();
             int getNFrames();
+            unsigned int getNumRows() const;
+            unsigned int getNumCols() const;
+            int getImageType() const;
 
         private:
-            // Move these to std vectors ??
-            std::shared_ptr<unsigned int>  binPtr_;
-            std::shared_ptr<unsigned long> cntPtr_;
+            std::shared_ptr<uint16_t> binPtr_;
             unsigned int numRows_;
             unsigned int numCols_;
+            int imageType_;
             unsigned int numBins_;
             unsigned int binSize_;
+            int binShift_;               // log2(binSize_) if power of two else -1
             int nFrames_;
+            unsigned int maxBinCount_;   // upper bound on any counter value
+
+            void rescale();
+            void addRow(const uint8_t *pixPtr, uint16_t *binPtr) const;
+            void addRow16(const uint16_t *pixPtr, uint16_t *binPtr) const;
+            float medianBin(const uint16_t *binPtr) const;
     };
 }
 
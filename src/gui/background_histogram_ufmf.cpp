@@ -11,6 +11,7 @@ namespace bias
     // Static constants
     const unsigned int BackgroundHistogram_ufmf::DEFAULT_NUM_BINS = 256;
     const unsigned int BackgroundHistogram_ufmf::DEFAULT_BIN_SIZE = 1;
+    const unsigned int BackgroundHistogram_ufmf::DEFAULT_BIN_SIZE_16U = 256;
     const unsigned int BackgroundHistogram_ufmf::DEFAULT_MEDIAN_UPDATE_COUNT = 100;
     const unsigned int BackgroundHistogram_ufmf::MIN_MEDIAN_UPDATE_COUNT = 10;
     const unsigned int BackgroundHistogram_ufmf::DEFAULT_MEDIAN_UPDATE_INTERVAL = 50;
@@ -129,12 +130,18 @@ namespace bias
             if (isFirst)
             {
                 // Create two new background data objects - put one in old data queue.
+                // 16-bit images use the same number of bins spread over the full range.
+                unsigned int binSize = DEFAULT_BIN_SIZE;
+                if (newStampedImg.image.depth() == CV_16U)
+                {
+                    binSize = DEFAULT_BIN_SIZE_16U;
+                }
                 for (int i=0; i<2; i++) 
                 {
                     backgroundData = BackgroundData_ufmf(
                             newStampedImg,
                             DEFAULT_NUM_BINS,
-                            DEFAULT_BIN_SIZE
+                            binSize
                             );
                     if (i==0)
                     {
@@ -36,6 +36,7 @@ namespace bias
 
             static const unsigned int DEFAULT_NUM_BINS; 
             static const unsigned int DEFAULT_BIN_SIZE; 
+            static const unsigned int DEFAULT_BIN_SIZE_16U; 
             static const unsigned int DEFAULT_MEDIAN_UPDATE_COUNT;
             static const unsigned int MIN_MEDIAN_UPDATE_COUNT;
             static const unsigned int DEFAULT_MEDIAN_UPDATE_INTERVAL;
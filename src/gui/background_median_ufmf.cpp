@@ -2,11 +2,71 @@
 #include "background_data_ufmf.hpp"
 #include "affinity.hpp"
 #include <iostream>
+#include <algorithm>
 #include <QThread>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QElapsedTimer>
 #include <opencv2/core/core.hpp>
 
 namespace bias
 { 
+    const unsigned int BackgroundMedian_ufmf::DEFAULT_NUMBER_OF_WORKERS = 4;
+    const unsigned int BackgroundMedian_ufmf::MIN_NUMBER_OF_WORKERS = 1;
+    const unsigned int BackgroundMedian_ufmf::MAX_NUMBER_OF_WORKERS = 32;
+    const unsigned int BackgroundMedian_ufmf::TILES_PER_WORKER = 4;
+    const bool BackgroundMedian_ufmf::DEFAULT_INCREMENTAL = false;
+
+
+    // Computes the median for a tile of rows on a thread pool worker
+    class BackgroundMedianTask_ufmf : public QRunnable
+    {
+        public:
+            BackgroundMedianTask_ufmf(
+                    BackgroundData_ufmf backgroundData,
+                    cv::Mat medianImage,
+                    unsigned int rowBegin,
+                    unsigned int rowEnd,
+                    std::shared_ptr<LockableQueue<BackgroundMedianTile_ufmf>> tileQueuePtr,
+                    QSemaphore *doneSemaphorePtr
+                    )
+                : backgroundData_(backgroundData),
+                  medianImage_(medianImage),
+                  rowBegin_(rowBegin),
+                  rowEnd_(rowEnd),
+                  tileQueuePtr_(tileQueuePtr),
+                  doneSemaphorePtr_(doneSemaphorePtr)
+            {
+                setAutoDelete(true);
+            }
+
+            void run()
+            {
+                backgroundData_.getMedianRows(medianImage_, rowBegin_, rowEnd_);
+
+                // Publish tile now if incremental updates are enabled
+                if (tileQueuePtr_ != NULL)
+                {
+                    BackgroundMedianTile_ufmf tile;
+                    tile.image = medianImage_.rowRange(rowBegin_, rowEnd_);
+                    tile.rowBegin = rowBegin_;
+                    tileQueuePtr_ -> acquireLock();
+                    tileQueuePtr_ -> push(tile);
+                    tileQueuePtr_ -> releaseLock();
+                }
+                doneSemaphorePtr_ -> release();
+            }
+
+        private:
+            BackgroundData_ufmf backgroundData_;
+            cv::Mat medianImage_;
+            unsigned int rowBegin_;
+            unsigned int rowEnd_;
+            std::shared_ptr<LockableQueue<BackgroundMedianTile_ufmf>> tileQueuePtr_;
+            QSemaphore *doneSemaphorePtr_;
+    };
+
+
     BackgroundMedian_ufmf::BackgroundMedian_ufmf(QObject *parent)
         : QObject(parent)
     { 
@@ -17,7 +77,7 @@ namespace bias
     BackgroundMedian_ufmf::BackgroundMedian_ufmf( 
             std::shared_ptr<LockableQueue<BackgroundData_ufmf>> bgNewDataQueuePtr,
             std::shared_ptr<LockableQueue<BackgroundData_ufmf>> bgOldDataQueuePtr,
-            std::shared_ptr<LockableQueue<cv::Mat>> medianMatQueuePtr,
+            std::shared_ptr<LockableQueue<BackgroundMedianTile_ufmf>> medianMatQueuePtr,
             unsigned int cameraNumber,
             QObject *parent
             ) 
@@ -30,7 +90,7 @@ namespace bias
     void BackgroundMedian_ufmf::initialize(
             std::shared_ptr<LockableQueue<BackgroundData_ufmf>> bgNewDataQueuePtr,
             std::shared_ptr<LockableQueue<BackgroundData_ufmf>> bgOldDataQueuePtr,
-            std::shared_ptr<LockableQueue<cv::Mat>> medianMatQueuePtr,
+            std::shared_ptr<LockableQueue<BackgroundMedianTile_ufmf>> medianMatQueuePtr,
             unsigned int cameraNumber
             )
     {
@@ -39,6 +99,8 @@ namespace bias
         bgNewDataQueuePtr_ = bgNewDataQueuePtr;
         bgOldDataQueuePtr_ = bgOldDataQueuePtr;
         medianMatQueuePtr_ = medianMatQueuePtr;
+        numberOfWorkers_ = 1;
+        incremental_ = DEFAULT_INCREMENTAL;
 
         bool notNull = true;
         notNull &= (bgNewDataQueuePtr_ != NULL);
@@ -58,12 +120,25 @@ namespace bias
     }
 
 
+    void BackgroundMedian_ufmf::setThreadPool(QThreadPool *threadPoolPtr, unsigned int numberOfWorkers)
+    {
+        threadPoolPtr_ = threadPoolPtr;
+        numberOfWorkers_ = std::max(numberOfWorkers, MIN_NUMBER_OF_WORKERS);
+        numberOfWorkers_ = std::min(numberOfWorkers_, MAX_NUMBER_OF_WORKERS);
+    }
+
+
+    void BackgroundMedian_ufmf::setIncremental(bool incremental)
+    {
+        incremental_ = incremental;
+    }
+
+
     void BackgroundMedian_ufmf::run()
     {
         bool done = false;
-        bool isFirst = true;
         BackgroundData_ufmf backgroundData;
-        cv::Mat medianImage;
+        QElapsedTimer updateTimer;
 
         if (!ready_) 
         { 
@@ -95,11 +170,51 @@ namespace bias
 
             //std::cout << "*** new median data" << std::endl;
 
-            // Compute median
-            medianImage = backgroundData.getMedianImage();
+            // Compute median - split into row tiles when a thread pool is available
+            updateTimer.start();
+            unsigned int numRows = backgroundData.getNumRows();
+            cv::Mat medianImage(numRows, backgroundData.getNumCols(), backgroundData.getImageType());
+
+            if ((threadPoolPtr_.isNull()) || (numberOfWorkers_ <= 1) || (numRows == 0))
+            {
+                backgroundData.getMedianRows(medianImage, 0, numRows);
+            }
+            else
+            {
+                unsigned int numTiles = std::min(numRows, numberOfWorkers_*TILES_PER_WORKER);
+                unsigned int tileRows = (numRows + numTiles - 1)/numTiles;
+                numTiles = (numRows + tileRows - 1)/tileRows;
+
+                std::shared_ptr<LockableQueue<BackgroundMedianTile_ufmf>> tileQueuePtr;
+                if (incremental_)
+                {
+                    tileQueuePtr = medianMatQueuePtr_;
+                }
+
+                QSemaphore doneSemaphore(0);
+                for (unsigned int i=0; i<numTiles; i++)
+                {
+                    unsigned int rowBegin = i*tileRows;
+                    unsigned int rowEnd = std::min(rowBegin + tileRows, numRows);
+                    threadPoolPtr_ -> start(new BackgroundMedianTask_ufmf(
+                                backgroundData,
+                                medianImage,
+                                rowBegin,
+                                rowEnd,
+                                tileQueuePtr,
+                                &doneSemaphore
+                                ));
+                }
+                doneSemaphore.acquire(numTiles);
+            }
+
+            BackgroundMedianTile_ufmf medianTile;
+            medianTile.image = medianImage;
+            medianTile.isComplete = true;
+            medianTile.updateTimeMs = double(updateTimer.nsecsElapsed())*1.0e-6;
 
             medianMatQueuePtr_ -> acquireLock();
-            medianMatQueuePtr_ -> push(medianImage);
+            medianMatQueuePtr_ -> push(medianTile);
             medianMatQueuePtr_ -> releaseLock();
 
             // Put data back into outgoing queue 
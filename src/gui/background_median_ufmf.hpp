@@ -3,15 +3,30 @@
 #include <memory>
 #include <QObject>
 #include <QRunnable>
+#include <QPointer>
+#include <opencv2/core/core.hpp>
 #include "lockable.hpp"
 
-namespace cv {class Mat;}
+class QThreadPool;
 
 namespace bias
 {
     class BackgroundData_ufmf;
 
 
+    // Median image data sent from the median calculation to the writer. When
+    // incremental publishing is enabled row tiles are sent as they are finished,
+    // otherwise (and always at the end of an update) the whole median image. 
+    struct BackgroundMedianTile_ufmf
+    {
+        cv::Mat image;            // median values for rows [rowBegin, rowBegin+image.rows)
+        unsigned int rowBegin;
+        bool isComplete;          // true for the full median image of an update
+        double updateTimeMs;      // wall time of the median update (complete only)
+        BackgroundMedianTile_ufmf() : rowBegin(0), isComplete(false), updateTimeMs(0.0) {};
+    };
+
+
     class BackgroundMedian_ufmf
         : public QObject, public QRunnable, public Lockable<Empty>
     {
@@ -22,27 +37,42 @@ namespace bias
             BackgroundMedian_ufmf( 
                     std::shared_ptr<LockableQueue<BackgroundData_ufmf>> bgNewDataQueuePtr,
                     std::shared_ptr<LockableQueue<BackgroundData_ufmf>> bgOldDataQueuePtr,
-                    std::shared_ptr<LockableQueue<cv::Mat>> medianMatQueuePtr,
+                    std::shared_ptr<LockableQueue<BackgroundMedianTile_ufmf>> medianMatQueuePtr,
                     unsigned int cameraNumber,
                     QObject *parent=0
                     );
             void initialize(
                     std::shared_ptr<LockableQueue<BackgroundData_ufmf>> bgNewDataQueuePtr,
                     std::shared_ptr<LockableQueue<BackgroundData_ufmf>> bgOldDataQueuePtr,
-                    std::shared_ptr<LockableQueue<cv::Mat>> medianMatQueuePtr,
+                    std::shared_ptr<LockableQueue<BackgroundMedianTile_ufmf>> medianMatQueuePtr,
                     unsigned int cameraNumber
                     );
             void stop();
 
+            // Row tiles are computed on threadPool using numberOfWorkers tasks per
+            // tile batch. With no pool (or one worker) the median is computed on 
+            // this thread. 
+            void setThreadPool(QThreadPool *threadPoolPtr, unsigned int numberOfWorkers);
+            void setIncremental(bool incremental);
+
+            static const unsigned int DEFAULT_NUMBER_OF_WORKERS;
+            static const unsigned int MIN_NUMBER_OF_WORKERS;
+            static const unsigned int MAX_NUMBER_OF_WORKERS;
+            static const unsigned int TILES_PER_WORKER;
+            static const bool DEFAULT_INCREMENTAL;
+
         private:
             bool ready_;
             bool stopped_;
             unsigned int cameraNumber_;
+            unsigned int numberOfWorkers_;
+            bool incremental_;
+            QPointer<QThreadPool> threadPoolPtr_;
 
             // Queues of incoming and outgoing background data for median calculation
             std::shared_ptr<LockableQueue<BackgroundData_ufmf>> bgNewDataQueuePtr_;
             std::shared_ptr<LockableQueue<BackgroundData_ufmf>> bgOldDataQueuePtr_;
-            std::shared_ptr<LockableQueue<cv::Mat>> medianMatQueuePtr_;
+            std::shared_ptr<LockableQueue<BackgroundMedianTile_ufmf>> medianMatQueuePtr_;
             void run();
 
     };
@@ -0,0 +1,124 @@
+#include "camera_status.hpp"
+#include <atomic>
+
+namespace bias
+{
+
+    // CameraStatus
+    // ------------------------------------------------------------------------
+
+    CameraStatus::CameraStatus()
+    {
+        connected = false;
+        capturing = false;
+        logging = false;
+        frameCount = 0;
+        timeStamp = 0.0;
+        framesPerSec = 0.0;
+    }
+
+
+    QVariantMap CameraStatus::toMap() const
+    {
+        QVariantMap statusMap;
+        statusMap.insert("connected", connected);
+        statusMap.insert("capturing", capturing);
+        statusMap.insert("logging", logging);
+        statusMap.insert("frameCount", qulonglong(frameCount));
+        statusMap.insert("framesPerSec", framesPerSec);
+        statusMap.insert("timeStamp", timeStamp);
+        return statusMap;
+    }
+
+
+    // CameraStatusPublisher
+    // ------------------------------------------------------------------------
+
+    CameraStatusPublisher::CameraStatusPublisher()
+    {
+        std::shared_ptr<State> statePtr = std::make_shared<State>();
+        statePtr -> connected = false;
+        statePtr -> capturing = false;
+        statePtr -> logging = false;
+        std::atomic_store(&statePtr_, std::shared_ptr<const State>(statePtr));
+
+        frameSeq_.store(0);
+        frameCount_.store(0);
+        timeStamp_.store(0.0);
+        framesPerSec_.store(0.0);
+    }
+
+
+    void CameraStatusPublisher::publishState(
+            bool connected,
+            bool capturing,
+            bool logging,
+            QString guid,
+            QString videoFile,
+            PipelineStatsPtr pipelineStatsPtr
+            )
+    {
+        std::shared_ptr<State> statePtr = std::make_shared<State>();
+        statePtr -> connected = connected;
+        statePtr -> capturing = capturing;
+        statePtr -> logging = logging;
+        statePtr -> guid = guid;
+        statePtr -> videoFile = videoFile;
+        statePtr -> pipelineStatsPtr = pipelineStatsPtr;
+        std::atomic_store(&statePtr_, std::shared_ptr<const State>(statePtr));
+    }
+
+
+    void CameraStatusPublisher::publishFrame(
+            unsigned long frameCount,
+            double timeStamp,
+            double framesPerSec
+            )
+    {
+        // Single writer - the sequence is odd while the values are updated
+        unsigned int seq = frameSeq_.load(std::memory_order_relaxed);
+        frameSeq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        frameCount_.store(frameCount, std::memory_order_relaxed);
+        timeStamp_.store(timeStamp, std::memory_order_relaxed);
+        framesPerSec_.store(framesPerSec, std::memory_order_relaxed);
+        frameSeq_.store(seq + 2, std::memory_order_release);
+    }
+
+
+    void CameraStatusPublisher::resetFramesPerSec()
+    {
+        CameraStatus status = getStatus();
+        publishFrame(status.frameCount, status.timeStamp, 0.0);
+    }
+
+
+    CameraStatus CameraStatusPublisher::getStatus() const
+    {
+        CameraStatus status;
+
+        std::shared_ptr<const State> statePtr = std::atomic_load(&statePtr_);
+        status.connected = statePtr -> connected;
+        status.capturing = statePtr -> capturing;
+        status.logging = statePtr -> logging;
+        status.guid = statePtr -> guid;
+        status.videoFile = statePtr -> videoFile;
+        status.pipelineStatsPtr = statePtr -> pipelineStatsPtr;
+
+        unsigned int seq0 = 0;
+        unsigned int seq1 = 0;
+        do
+        {
+            seq0 = frameSeq_.load(std::memory_order_acquire);
+            status.frameCount = frameCount_.load(std::memory_order_relaxed);
+            status.timeStamp = timeStamp_.load(std::memory_order_relaxed);
+            status.framesPerSec = framesPerSec_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seq1 = frameSeq_.load(std::memory_order_relaxed);
+        }
+        while ((seq0 != seq1) || (seq0 & 1));
+
+        return status;
+    }
+
+} // namespace bias
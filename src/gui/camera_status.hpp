@@ -0,0 +1,89 @@
+#ifndef BIAS_CAMERA_STATUS_HPP
+#define BIAS_CAMERA_STATUS_HPP
+
+#include <memory>
+#include <atomic>
+#include <QString>
+#include <QVariantMap>
+#include "pipeline_stats.hpp"
+
+namespace bias
+{
+
+    struct CameraStatus
+    {
+        bool connected;
+        bool capturing;
+        bool logging;
+        QString guid;                   // empty if not connected
+        QString videoFile;
+        unsigned long frameCount;
+        double timeStamp;
+        double framesPerSec;
+        PipelineStatsPtr pipelineStatsPtr;
+
+        CameraStatus();
+        QVariantMap toMap() const;      // as returned by the get-status command
+    };
+
+
+    class CameraStatusPublisher
+    {
+        // --------------------------------------------------------------------
+        // Latest status of a camera for readers on other threads, e.g. the
+        // external control server, so status queries need not wait on the
+        // GUI thread. The connection, capture and logging state is published
+        // by the GUI thread as an immutable snapshot which is swapped in
+        // atomically. The frame count, time stamp and frame rate are
+        // published by the dispatcher for every frame under a sequence
+        // counter, so they are always from the same frame and publishing
+        // them neither locks nor allocates.
+        // --------------------------------------------------------------------
+
+        public:
+
+            CameraStatusPublisher();
+
+            // GUI thread
+            void publishState(
+                    bool connected,
+                    bool capturing,
+                    bool logging,
+                    QString guid,
+                    QString videoFile,
+                    PipelineStatsPtr pipelineStatsPtr
+                    );
+
+            // Dispatcher thread - or the GUI thread when the dispatcher is
+            // not running.
+            void publishFrame(unsigned long frameCount, double timeStamp, double framesPerSec);
+            void resetFramesPerSec();
+
+            // Any thread
+            CameraStatus getStatus() const;
+
+        private:
+
+            struct State
+            {
+                bool connected;
+                bool capturing;
+                bool logging;
+                QString guid;
+                QString videoFile;
+                PipelineStatsPtr pipelineStatsPtr;
+            };
+
+            std::shared_ptr<const State> statePtr_; // std::atomic_load/store only
+
+            std::atomic<unsigned int> frameSeq_;    // odd while being written
+            std::atomic<unsigned long> frameCount_;
+            std::atomic<double> timeStamp_;
+            std::atomic<double> framesPerSec_;
+    };
+
+    typedef std::shared_ptr<CameraStatusPublisher> CameraStatusPublisherPtr;
+
+} // namespace bias
+
+#endif // #ifndef BIAS_CAMERA_STATUS_HPP
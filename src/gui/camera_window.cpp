@@ -7,13 +7,16 @@
 #include "image_grabber.hpp"
 #include "image_dispatcher.hpp"
 #include "image_logger.hpp"
+#include "pre_trigger_buffer.hpp"
 #include "video_writer.hpp"
 #include "video_writer_bmp.hpp"
 #include "video_writer_jpg.hpp"
 #include "video_writer_avi.hpp"
 #include "video_writer_fmf.hpp"
 #include "video_writer_ufmf.hpp"
+#include "video_writer_ffmpeg.hpp"
 #include "affinity.hpp"
+#include "frame_sync.hpp"
 #include "property_dialog.hpp"
 #include "timer_settings_dialog.hpp"
 #include "logging_settings_dialog.hpp"
@@ -21,6 +24,7 @@
 #include "format7_settings_dialog.hpp"
 #include "alignment_settings_dialog.hpp"
 #include "background_histogram_ufmf.hpp"
+#include "background_median_ufmf.hpp"
 #include "json.hpp"
 #include "json_utils.hpp"
 #include "ext_ctl_http_server.hpp"
@@ -69,6 +73,20 @@ namespace bias
     const unsigned int MAX_THREAD_COUNT=10;
     const int THREADPOOL_WAIT_TIMEOUT = 50;
 
+    // Image queue capacities (rounded up to a power of two by the ring buffer)
+    const size_t NEW_IMAGE_QUEUE_CAPACITY = 256;
+    const size_t LOG_IMAGE_QUEUE_CAPACITY = 2048;
+    const size_t PLUGIN_IMAGE_QUEUE_CAPACITY = 512;
+
+    // Image pool - enough buffers to fill the queues plus those held by the
+    // grabber, dispatcher, display and writers, up to a memory limit which 
+    // caps the number of buffers for large frames.
+    const unsigned int IMAGE_POOL_MARGIN = 64;
+    const unsigned int IMAGE_POOL_MAX_BUFFERS = (unsigned int)(
+            NEW_IMAGE_QUEUE_CAPACITY + LOG_IMAGE_QUEUE_CAPACITY + PLUGIN_IMAGE_QUEUE_CAPACITY 
+            ) + IMAGE_POOL_MARGIN;
+    const unsigned int IMAGE_POOL_MAX_MEMORY_MB = 4096;
+
     // Default settings
     const unsigned long DEFAULT_CAPTURE_DURATION = 300; // sec
     const double DEFAULT_IMAGE_DISPLAY_FREQ = 15.0;     // Hz
@@ -98,6 +116,7 @@ namespace bias
         map.insert(VIDEOFILE_FORMAT_AVI,  QString("avi"));
         map.insert(VIDEOFILE_FORMAT_FMF,  QString("fmf"));
         map.insert(VIDEOFILE_FORMAT_UFMF, QString("ufmf"));
+        map.insert(VIDEOFILE_FORMAT_FFMPEG, QString("mkv"));
         return map;
     };
     const QMap<VideoFileFormat, QString> VIDEOFILE_EXTENSION_MAP = createExtensionMap();
@@ -124,6 +143,16 @@ namespace bias
     const QMap<int, QString> COLORMAP_INT_TO_STRING_MAP = createColorMapIntToStringMap();
     const int DEFAULT_COLORMAP_NUMBER = COLORMAP_NONE;
 
+    QMap<GrabMode, QString> createGrabModeToStringMap()
+    {
+        QMap<GrabMode, QString> map;
+        map.insert(GRAB_MODE_POLL, QString("poll"));
+        map.insert(GRAB_MODE_BLOCKING, QString("blocking"));
+        return map;
+    }
+    const QMap<GrabMode, QString> GRAB_MODE_TO_STRING_MAP = createGrabModeToStringMap();
+    const GrabMode DEFAULT_GRAB_MODE = GRAB_MODE_POLL;
+
     // Debug files
     const QString DEBUG_DUMP_CAMERA_PROPS_FILE_NAME("bias_camera_props_dump.txt");
 
@@ -144,6 +173,16 @@ namespace bias
     }
 
 
+    CameraWindow::~CameraWindow()
+    {
+        // The server runs on its own thread and is deleted when it stops
+        if (!httpServerPtr_.isNull())
+        {
+            httpServerPtr_ -> stopThread();
+        }
+    }
+
+
     RtnStatus CameraWindow::connectCamera(bool showErrorDlg) 
     {
         bool error = false;
@@ -327,100 +366,162 @@ namespace bias
         framesPerSec_ = 0.0;
         skippedFramesWarning_ = false;
 
-        newImageQueuePtr_ -> clear();
-        logImageQueuePtr_ -> clear();
-        pluginImageQueuePtr_ -> clear();
+        // Fresh bounded queues for each capture. The grabber never blocks and the
+        // logger reports overflow, so both drop the newest frame when full. Plugins
+        // only care about recent frames so they drop the oldest.
+        newImageQueuePtr_ = std::make_shared<SpscRingBuffer<StampedImage>>(
+                NEW_IMAGE_QUEUE_CAPACITY, 
+                RING_BUFFER_DROP_NEWEST
+                );
+        logImageQueuePtr_ = std::make_shared<SpscRingBuffer<StampedImage>>(
+                LOG_IMAGE_QUEUE_CAPACITY, 
+                RING_BUFFER_DROP_NEWEST
+                );
+        pluginImageQueuePtr_ = std::make_shared<SpscRingBuffer<StampedImage>>(
+                PLUGIN_IMAGE_QUEUE_CAPACITY,
+                RING_BUFFER_DROP_OLDEST
+                );
+
+        // Fresh statistics for each capture - the last capture's remain 
+        // available until the next one is started.
+        pipelineStatsPtr_ = std::make_shared<PipelineStats>(cameraNumber_);
 
 
         QString autoNamingString = getAutoNamingString();
         unsigned int versionNumber = 0;
 
+        // Multi-camera frame synchronization - no-op unless enabled
+        FrameSyncService::startCamera(cameraNumber_);
+
         if (logging_)
         {
-            // Create video writer based on video file format type
             QString videoFileFullPath = getVideoFileFullPath(autoNamingString);
-            std::shared_ptr<VideoWriter> videoWriterPtr; 
-
-            switch (videoFileFormat_)
-            {
-                case VIDEOFILE_FORMAT_BMP:
-                    videoWriterPtr = std::make_shared<VideoWriter_bmp>(
-                            videoWriterParams_.bmp,
-                            videoFileFullPath,
-                            cameraNumber_
-                            );
-                    break;
-
-                case VIDEOFILE_FORMAT_JPG:
-                    videoWriterPtr = std::make_shared<VideoWriter_jpg>(
-                            videoWriterParams_.jpg,
-                            videoFileFullPath,
-                            cameraNumber_
-                            );
-                    break;
 
-                case VIDEOFILE_FORMAT_AVI:  
-                    videoWriterPtr = std::make_shared<VideoWriter_avi>(
-                            videoWriterParams_.avi,
-                            videoFileFullPath,
-                            cameraNumber_
-                            );
-                    break;
+            // All cameras share one synchronized frame index, named after 
+            // the video file of the first camera to start logging.
+            QFileInfo videoFileInfo(videoFileFullPath);
+            QFileInfo syncIndexFileInfo(
+                    QDir(videoFileInfo.absolutePath()),
+                    videoFileInfo.baseName() + QString("_sync_index.txt")
+                    );
+            FrameSyncService::startRecording(cameraNumber_, syncIndexFileInfo.absoluteFilePath());
+            VideoWriterParams videoWriterParams = videoWriterParams_;
+            PreTriggerParams preTriggerParams = videoWriterParams_.preTrigger;
 
-                case VIDEOFILE_FORMAT_FMF:
-                    videoWriterPtr = std::make_shared<VideoWriter_fmf>(
-                            videoWriterParams_.fmf,
-                            videoFileFullPath,
-                            cameraNumber_
-                            );
-                    break;
+            if (preTriggerParams.enabled)
+            {
+                // Pre-trigger recording - the logger buffers frames in memory 
+                // and makes a writer for each triggered clip. Clips are named 
+                // after the video file with a clip number appended.
+                if (videoWriterParams.fmf.expectedDuration == 0)
+                {
+                    double clipDuration = preTriggerParams.preTriggerSec + preTriggerParams.postTriggerSec;
+                    videoWriterParams.fmf.expectedDuration = (unsigned int)(std::ceil(clipDuration));
+                }
+                VideoFileFormat videoFileFormat = videoFileFormat_;
+                bool versioning = autoNamingOptions_.includeVersionNumber;
 
-                case VIDEOFILE_FORMAT_UFMF:
-                    videoWriterPtr = std::make_shared<VideoWriter_ufmf>(
-                            videoWriterParams_.ufmf,
-                            videoFileFullPath,
-                            cameraNumber_
+                VideoWriterFactory videoWriterFactory = [=](unsigned int clipNumber) 
+                {
+                    QFileInfo fileInfo(videoFileFullPath);
+                    QString clipStr = QString("_clip%1").arg(clipNumber,3,10,QChar('0'));
+                    QFileInfo clipFileInfo(
+                            QDir(fileInfo.absolutePath()), 
+                            fileInfo.baseName() + clipStr + "." + fileInfo.suffix()
                             );
-                    break;
+                    QString clipFileName = clipFileInfo.absoluteFilePath();
 
-                default:
-                    videoWriterPtr = std::make_shared<VideoWriter>(
-                            videoFileFullPath,
-                            cameraNumber_
+                    std::shared_ptr<VideoWriter> clipWriterPtr = createVideoWriter(
+                            videoFileFormat,
+                            videoWriterParams,
+                            clipFileName
                             );
-                    break;
+                    clipWriterPtr -> setFileName(clipFileName);
+                    clipWriterPtr -> setVersioning(versioning);
+
+                    connect(
+                            clipWriterPtr.get(),
+                            SIGNAL(imageLoggingError(unsigned int, QString)),
+                            this,
+                            SLOT(imageLoggingError(unsigned int, QString))
+                           );
+                    return clipWriterPtr;
+                };
+
+                imageLoggerPtr_ = new ImageLogger(
+                        cameraNumber_,
+                        NULL,
+                        logImageQueuePtr_,
+                        this
+                        );
+                imageLoggerPtr_ -> setPreTrigger(preTriggerParams, videoWriterFactory);
+                imageLoggerPtr_ -> setPipelineStats(pipelineStatsPtr_);
+                imageLoggerPtr_ -> setAutoDelete(false);
+
+                connect(
+                        imageLoggerPtr_,
+                        SIGNAL(imageLoggingError(unsigned int, QString)),
+                        this,
+                        SLOT(imageLoggingError(unsigned int, QString))
+                       );
+
+                if (preTriggerParams.timerIntervalSec > 0.0)
+                {
+                    preTriggerTimerPtr_ -> setInterval(int(1000.0*preTriggerParams.timerIntervalSec));
+                    preTriggerTimerPtr_ -> start();
+                }
 
-            } // switch (videoFileFormat) 
+                threadPoolPtr_ -> start(imageLoggerPtr_);
+            }
+            else
+            {
+                // Create video writer based on video file format type
+                if ((videoFileFormat_ == VIDEOFILE_FORMAT_FMF) && (videoWriterParams.fmf.expectedDuration == 0))
+                {
+                    // Use the capture timer duration to size the file 
+                    // preallocation unless a duration has been given.
+                    if (actionTimerEnabledPtr_ -> isChecked())
+                    {
+                        videoWriterParams.fmf.expectedDuration = (unsigned int)(captureDurationSec_);
+                    }
+                }
+                std::shared_ptr<VideoWriter> videoWriterPtr = createVideoWriter(
+                        videoFileFormat_,
+                        videoWriterParams,
+                        videoFileFullPath
+                        );
 
-            // Set output file
-            videoWriterPtr -> setFileName(videoFileFullPath);
-            videoWriterPtr -> setVersioning(autoNamingOptions_.includeVersionNumber);
-            versionNumber = videoWriterPtr -> getNextVersionNumber();
+                // Set output file
+                videoWriterPtr -> setFileName(videoFileFullPath);
+                videoWriterPtr -> setVersioning(autoNamingOptions_.includeVersionNumber);
+                versionNumber = videoWriterPtr -> getNextVersionNumber();
 
-            imageLoggerPtr_ = new ImageLogger(
-                    cameraNumber_,
-                    videoWriterPtr, 
-                    logImageQueuePtr_, 
-                    this
-                    );
-            imageLoggerPtr_ -> setAutoDelete(false);
+                imageLoggerPtr_ = new ImageLogger(
+                        cameraNumber_,
+                        videoWriterPtr, 
+                        logImageQueuePtr_, 
+                        this
+                        );
+                imageLoggerPtr_ -> setPipelineStats(pipelineStatsPtr_);
+                imageLoggerPtr_ -> setAutoDelete(false);
 
-            // Connect image logger error signals
-            connect(
-                    imageLoggerPtr_,
-                    SIGNAL(imageLoggingError(unsigned int, QString)),
-                    this,
-                    SLOT(imageLoggingError(unsigned int, QString))
-                   );
+                // Connect image logger error signals
+                connect(
+                        imageLoggerPtr_,
+                        SIGNAL(imageLoggingError(unsigned int, QString)),
+                        this,
+                        SLOT(imageLoggingError(unsigned int, QString))
+                       );
 
-            connect(
-                    videoWriterPtr.get(),
-                    SIGNAL(imageLoggingError(unsigned int, QString)),
-                    this,
-                    SLOT(imageLoggingError(unsigned int, QString))
-                   );
+                connect(
+                        videoWriterPtr.get(),
+                        SIGNAL(imageLoggingError(unsigned int, QString)),
+                        this,
+                        SLOT(imageLoggingError(unsigned int, QString))
+                       );
 
-            threadPoolPtr_ -> start(imageLoggerPtr_);
+                threadPoolPtr_ -> start(imageLoggerPtr_);
+            }
 
         } // if (logging_)
 
@@ -436,6 +537,7 @@ namespace bias
             pluginHandlerPtr_ -> setCameraNumber(cameraNumber_);
             pluginHandlerPtr_ -> setImageQueue(pluginImageQueuePtr_);
             pluginHandlerPtr_ -> setPlugin(currentPluginPtr);
+            pluginHandlerPtr_ -> setPipelineStats(pipelineStatsPtr_);
             pluginHandlerPtr_ -> setAutoDelete(false);
             threadPoolPtr_ -> start(pluginHandlerPtr_);
         } 
@@ -456,6 +558,10 @@ namespace bias
         }
         imageGrabberPtr_->setIsVideo(doCaptureFromVideo_);
         imageGrabberPtr_->setVideoFileName(captureVideoFileName_);
+        imageGrabberPtr_->setImagePool(imagePoolPtr_);
+        imageGrabberPtr_->setGrabMode(grabMode_);
+        imageGrabberPtr_->setPipelineStats(pipelineStatsPtr_);
+        imagePoolPtr_ -> resetStats();
 
         imageDispatcherPtr_ = new ImageDispatcher(
                 logging_, 
@@ -467,6 +573,16 @@ namespace bias
                 this
                 );
         imageDispatcherPtr_ -> setAutoDelete(false);
+        imageDispatcherPtr_ -> setImagePool(imagePoolPtr_);
+        imageDispatcherPtr_ -> setPipelineStats(pipelineStatsPtr_);
+        imageDispatcherPtr_ -> setStatusPublisher(statusPublisherPtr_);
+        statusPublisherPtr_ -> publishFrame(0, 0.0, 0.0);
+        if (pipelineTrace_)
+        {
+            QString traceName = QString("pipeline_trace_cam%1.bin").arg(cameraNumber_);
+            QFileInfo traceFileInfo = QFileInfo(currentVideoFileDir_, traceName);
+            imageDispatcherPtr_ -> setTraceFileName(traceFileInfo.absoluteFilePath());
+        }
 
         connect(
                 imageGrabberPtr_, 
@@ -551,6 +667,7 @@ namespace bias
         {
             captureDurationTimerPtr_ -> stop();
         }
+        preTriggerTimerPtr_ -> stop();
 
         // Note, image grabber and dispatcher are destroyed by the 
         // threadPool when their run methods exit.
@@ -602,32 +719,42 @@ namespace bias
         while (!threadsDone)
         {
             threadsDone = threadPoolPtr_ -> waitForDone(THREADPOOL_WAIT_TIMEOUT);
-
-            newImageQueuePtr_ -> acquireLock();
             newImageQueuePtr_ -> signalNotEmpty();
-            newImageQueuePtr_ -> releaseLock();
-
-            logImageQueuePtr_ -> acquireLock();
             logImageQueuePtr_ -> signalNotEmpty();
-            logImageQueuePtr_ -> releaseLock();
-
-            pluginImageQueuePtr_ -> acquireLock();
             pluginImageQueuePtr_ -> signalNotEmpty();
-            pluginImageQueuePtr_ -> releaseLock();
+
+            // Show progress while the logger writes out frames which are still 
+            // being compressed so it is clear when the next trial can start.
+            if ((!threadsDone) && (!imageLoggerPtr_.isNull()))
+            {
+                QString writerStatus = imageLoggerPtr_ -> getWriterStatusString();
+                if (!writerStatus.isEmpty())
+                {
+                    updateStatusLabel(writerStatus);
+                    statusLabelPtr_ -> repaint();
+                }
+            }
         }
 
-        // Clear any stale data out of existing queues
-        newImageQueuePtr_ -> acquireLock();
-        newImageQueuePtr_ -> clear();
-        newImageQueuePtr_ -> releaseLock();
+        // Report frames dropped by the bounded image queues - on the console
+        // and in the status bar, where it stays until the next status update.
+        QString dropMsg;
+        unsigned long numNewDropped = newImageQueuePtr_ -> numDropped();
+        unsigned long numLogDropped = logImageQueuePtr_ -> numDropped();
+        if ((numNewDropped > 0) || (numLogDropped > 0))
+        {
+            std::cout << "warning: camera " << cameraNumber_ << " dropped frames, new image queue = "; 
+            std::cout << numNewDropped << ", log image queue = " << numLogDropped << std::endl;
+            dropMsg = QString("dropped = %1 (new image queue), %2 (log queue)").arg(numNewDropped).arg(numLogDropped);
+        }
 
-        logImageQueuePtr_ -> acquireLock();
+        // Clear any stale data out of existing queues - threads are stopped.
+        newImageQueuePtr_ -> clear();
         logImageQueuePtr_ -> clear();
-        logImageQueuePtr_ -> releaseLock();
-
-        pluginImageQueuePtr_ -> acquireLock();
         pluginImageQueuePtr_ -> clear();
-        pluginImageQueuePtr_ -> releaseLock();
+
+        FrameSyncService::stopRecording(cameraNumber_);
+        FrameSyncService::stopCamera(cameraNumber_);
 
         
         if (isPluginEnabled())
@@ -645,8 +772,9 @@ namespace bias
         actionPluginsEnabledPtr_ -> setEnabled(true);
         pluginActionGroupPtr_ -> setEnabled(true);
 
-        updateStatusLabel();
+        updateStatusLabel(dropMsg);
         framesPerSec_ = 0.0;
+        statusPublisherPtr_ -> resetFramesPerSec();
         updateAllImageLabels();
 
         updateAllMenus();
@@ -904,6 +1032,7 @@ namespace bias
         cameraMap.insert("frameRate", frameRateString);
         QString trigTypeString = QString::fromStdString(getTriggerTypeString(trigType));
         cameraMap.insert("triggerType", trigTypeString);
+        cameraMap.insert("grabMode", GRAB_MODE_TO_STRING_MAP[grabMode_]);
 
         // Create format7 settings map
         QVariantMap format7SettingsMap;
@@ -935,6 +1064,10 @@ namespace bias
         
         QVariantMap bmpSettingsMap;
         bmpSettingsMap.insert("frameSkip", videoWriterParams_.bmp.frameSkip);
+        bmpSettingsMap.insert("imageFormat", videoWriterParams_.bmp.imageFormat);
+        bmpSettingsMap.insert("pngCompressionLevel", videoWriterParams_.bmp.pngCompressionLevel);
+        bmpSettingsMap.insert("compressionThreads", videoWriterParams_.bmp.numberOfCompressors);
+        bmpSettingsMap.insert("filesPerDirectory", (unsigned long long)(videoWriterParams_.bmp.filesPerDirectory));
         loggingSettingsMap.insert("bmp", bmpSettingsMap);
 
         QVariantMap jpgSettingsMap;
@@ -944,6 +1077,8 @@ namespace bias
         jpgSettingsMap.insert("mjpg", videoWriterParams_.jpg.mjpgFlag);
         jpgSettingsMap.insert("mjpgMaxFramePerFileFlag", videoWriterParams_.jpg.mjpgMaxFramePerFileFlag);
         jpgSettingsMap.insert("mjpgMaxFramePerFile", (unsigned long long)(videoWriterParams_.jpg.mjpgMaxFramePerFile));
+        jpgSettingsMap.insert("chromaSubsampling", videoWriterParams_.jpg.chromaSubsampling);
+        jpgSettingsMap.insert("fastDct", videoWriterParams_.jpg.fastDct);
         loggingSettingsMap.insert("jpg", jpgSettingsMap);
 
         QVariantMap aviSettingsMap;
@@ -953,6 +1088,11 @@ namespace bias
 
         QVariantMap fmfSettingsMap;
         fmfSettingsMap.insert("frameSkip", videoWriterParams_.fmf.frameSkip);
+        fmfSettingsMap.insert("asyncWrite", videoWriterParams_.fmf.asyncWrite);
+        fmfSettingsMap.insert("directIo", videoWriterParams_.fmf.directIo);
+        fmfSettingsMap.insert("expectedDuration", videoWriterParams_.fmf.expectedDuration);
+        fmfSettingsMap.insert("expectedFrameRate", videoWriterParams_.fmf.expectedFrameRate);
+        fmfSettingsMap.insert("packed12", videoWriterParams_.fmf.packed12);
         loggingSettingsMap.insert("fmf", fmfSettingsMap);
 
         QVariantMap ufmfSettingsMap;
@@ -962,6 +1102,10 @@ namespace bias
         ufmfSettingsMap.insert("medianUpdateCount", videoWriterParams_.ufmf.medianUpdateCount);
         ufmfSettingsMap.insert("medianUpdateInterval", videoWriterParams_.ufmf.medianUpdateInterval);
         ufmfSettingsMap.insert("compressionThreads", videoWriterParams_.ufmf.numberOfCompressors);
+        ufmfSettingsMap.insert("medianThreads", videoWriterParams_.ufmf.numberOfMedianWorkers);
+        ufmfSettingsMap.insert("medianIncremental", videoWriterParams_.ufmf.medianIncremental);
+        ufmfSettingsMap.insert("directIo", videoWriterParams_.ufmf.directIo);
+        ufmfSettingsMap.insert("preallocateMB", videoWriterParams_.ufmf.preallocateMB);
 
         QVariantMap ufmfDilateMap;
         ufmfDilateMap.insert("on", videoWriterParams_.ufmf.dilateState);
@@ -969,6 +1113,23 @@ namespace bias
         ufmfSettingsMap.insert("dilate", ufmfDilateMap);
         
         loggingSettingsMap.insert("ufmf", ufmfSettingsMap);
+
+        QVariantMap ffmpegSettingsMap;
+        ffmpegSettingsMap.insert("frameSkip", videoWriterParams_.ffmpeg.frameSkip);
+        ffmpegSettingsMap.insert("codec", videoWriterParams_.ffmpeg.codec);
+        ffmpegSettingsMap.insert("crf", videoWriterParams_.ffmpeg.crf);
+        ffmpegSettingsMap.insert("preset", videoWriterParams_.ffmpeg.preset);
+        ffmpegSettingsMap.insert("encoderThreads", videoWriterParams_.ffmpeg.numberOfThreads);
+        ffmpegSettingsMap.insert("maxQueueSize", videoWriterParams_.ffmpeg.maxQueueSize);
+        loggingSettingsMap.insert("ffmpeg", ffmpegSettingsMap);
+
+        QVariantMap preTriggerSettingsMap;
+        preTriggerSettingsMap.insert("enabled", videoWriterParams_.preTrigger.enabled);
+        preTriggerSettingsMap.insert("preTriggerSec", videoWriterParams_.preTrigger.preTriggerSec);
+        preTriggerSettingsMap.insert("postTriggerSec", videoWriterParams_.preTrigger.postTriggerSec);
+        preTriggerSettingsMap.insert("maxMemoryMB", videoWriterParams_.preTrigger.maxMemoryMB);
+        preTriggerSettingsMap.insert("timerIntervalSec", videoWriterParams_.preTrigger.timerIntervalSec);
+        loggingSettingsMap.insert("preTrigger", preTriggerSettingsMap);
         loggingMap.insert("settings", loggingSettingsMap);
 
         // Add logging auto-naming options
@@ -979,6 +1140,7 @@ namespace bias
         autoNamingOptionsMap.insert("cameraIdentifier", autoNamingOptions_.getCameraIdentifierString());
         autoNamingOptionsMap.insert("timeAndDateFormat", autoNamingOptions_.timeAndDateFormat);
         loggingMap.insert("autoNamingOptions", autoNamingOptionsMap);
+        loggingMap.insert("pipelineTrace", pipelineTrace_);
         configurationMap.insert("logging", loggingMap);
 
         // Add Timer configuration
@@ -1012,6 +1174,18 @@ namespace bias
         configFileMap.insert("fileName", currentConfigFileName_);
         configurationMap.insert("configuration", configFileMap);
 
+        // Add thread affinity configuration
+        ThreadAffinityParams affinityParams = ThreadAffinityService::getParams(cameraNumber_);
+        QVariantMap threadAffinityMap;
+        threadAffinityMap.insert("enabled", affinityParams.enabled);
+        threadAffinityMap.insert("numaNode", affinityParams.numaNode);
+        threadAffinityMap.insert("device", affinityParams.device);
+        threadAffinityMap.insert("grabberCpu", affinityParams.grabberCpu);
+        threadAffinityMap.insert("workerCpus", affinityParams.workerCpus);
+        threadAffinityMap.insert("realtime", REALTIME_POLICY_TO_STRING_MAP[affinityParams.realtimePolicy]);
+        threadAffinityMap.insert("realtimePriority", affinityParams.realtimePriority);
+        configurationMap.insert("threadAffinity", threadAffinityMap);
+
         // Add plugin configuration
         if (isPluginEnabled())
         {
@@ -1187,6 +1361,19 @@ namespace bias
             return rtnStatus;
         }
 
+        // Set thread affinity configuration - optional
+        // --------------------------------------------
+        QVariantMap threadAffinityMap = configMap["threadAffinity"].toMap();
+        if (threadAffinityMap.isEmpty())
+        {
+            threadAffinityMap = oldConfigMap["threadAffinity"].toMap();
+        }
+        rtnStatus = setThreadAffinityFromMap(threadAffinityMap,showErrorDlg);
+        if (!rtnStatus.success)
+        {
+            return rtnStatus;
+        }
+
         // Set plugin 
         QVariantMap pluginMap = configMap["plugin"].toMap();
         if (pluginMap.isEmpty())
@@ -1282,6 +1469,39 @@ namespace bias
         return rtnStatus;
     }
 
+
+    RtnStatus CameraWindow::triggerClip(bool showErrorDlg)
+    {
+        RtnStatus rtnStatus;
+        QString msgTitle("Trigger Clip Error");
+        QString msgText;
+
+        if (!videoWriterParams_.preTrigger.enabled)
+        {
+            msgText = QString("Unable to trigger clip: pre-trigger recording is not enabled");
+        }
+        else if (!capturing_ || !logging_ || imageLoggerPtr_.isNull())
+        {
+            msgText = QString("Unable to trigger clip: not capturing with logging enabled");
+        }
+
+        if (!msgText.isEmpty())
+        {
+            if (showErrorDlg)
+            {
+                QMessageBox::critical(this, msgTitle, msgText);
+            }
+            rtnStatus.success = false;
+            rtnStatus.message = msgText;
+            return rtnStatus;
+        }
+
+        imageLoggerPtr_ -> trigger();
+        rtnStatus.success = true;
+        rtnStatus.message = QString("");
+        return rtnStatus;
+    }
+
     
     QString CameraWindow::getCameraGuidString(RtnStatus &rtnStatus)
     {
@@ -1680,6 +1900,24 @@ namespace bias
     }
 
 
+    QVariantMap CameraWindow::getPipelineStats()
+    {
+        return pipelineStatsPtr_ -> toMap();
+    }
+
+
+    QString CameraWindow::getPipelineStatsPrometheus()
+    {
+        return pipelineStatsPtr_ -> toPrometheus();
+    }
+
+
+    QVariantMap CameraWindow::getFrameSyncStats()
+    {
+        return FrameSyncService::getStats().toMap();
+    }
+
+
     unsigned long CameraWindow::getFrameCount()
     {
         return frameCount_;
@@ -1692,6 +1930,28 @@ namespace bias
     }
 
 
+    void CameraWindow::publishStatus()
+    {
+        // Status for readers on other threads, e.g. the external control 
+        // server. The frame count, time stamp and rate are published by the
+        // image dispatcher.
+        QString guidString;
+        if (connected_)
+        {
+            RtnStatus rtnStatus;
+            guidString = getCameraGuidString(rtnStatus);
+        }
+        statusPublisherPtr_ -> publishState(
+                connected_,
+                capturing_,
+                logging_,
+                guidString,
+                getVideoFileFullPath(),
+                pipelineStatsPtr_
+                );
+    }
+
+
     bool CameraWindow::isConnected()
     {
         return connected_;
@@ -1793,49 +2053,79 @@ namespace bias
         if (capturing_) 
         {
             bool haveNewImage = false;
-            cv::Mat cameraImageMat;
+            PreviewImage previewImage;
 
-            // Get information from image dispatcher
+            // Get information from image dispatcher - the preview image is
+            // downsampled, colour mapped and histogrammed by the dispatcher.
             // -------------------------------------------------------------------
 
+            QSize previewLabelSize = previewImageLabelPtr_ -> size();
             if (imageDispatcherPtr_ -> tryLock(IMAGE_DISPLAY_CAMERA_LOCK_TRY_DT))
             {
-                cameraImageMat = imageDispatcherPtr_ -> getImage();
+                imageDispatcherPtr_ -> setPreviewParams(
+                        cv::Size(previewLabelSize.width(), previewLabelSize.height()),
+                        colorMapNumber_
+                        );
+                previewImage = imageDispatcherPtr_ -> getPreviewImage();
                 framesPerSec_ = imageDispatcherPtr_ -> getFPS();
                 timeStamp_ = imageDispatcherPtr_ -> getTimeStamp();
                 frameCount_ = imageDispatcherPtr_ -> getFrameCount();
                 imageDispatcherPtr_ -> releaseLock();
-                haveNewImage = true;
+                haveNewImage = !previewImage.isEmpty();
             }
             // -------------------------------------------------------------------
 
             if (haveNewImage)
             {
-                cv::Mat histMat = calcHistogram(cameraImageMat);
-                cv::Size imgSize = cameraImageMat.size();
-                if (colorMapNumber_ != COLORMAP_NONE)
-                {
-                    cv::applyColorMap(cameraImageMat,cameraImageMat, colorMapNumber_);
-                }
-                QImage img = matToQImage(cameraImageMat);
-
+                cv::Size imgSize = previewImage.sourceSize;
 
                 // Set pixmaps and update image labels - note need to add pluginPixmap
-                if (!img.isNull()) 
-                {
-                    previewPixmapOriginal_ = QPixmap::fromImage(img);
-                    haveImagePixmap_ = true;
-                }
+                previewPixmapOriginal_ = QPixmap::fromImage(previewImage.image);
+                previewPixmapScale_ = float(previewImage.image.width())/float(imgSize.width);
+                haveImagePixmap_ = true;
 
                 // Update status message
                 QString statusMsg = QString().sprintf("%dx%d", imgSize.width, imgSize.height);
                 statusMsg += QString().sprintf(",  %1.1f fps", framesPerSec_);
+                ImagePoolStats poolStats = imageDispatcherPtr_ -> getImagePoolStats();
+                statusMsg += QString().sprintf(",  pool %1.0f%% hit", 100.0*poolStats.hitRate());
+                if (poolStats.numExhausted > 0)
+                {
+                    statusMsg += QString(" (exhausted %1)").arg(poolStats.numExhausted);
+                }
+                GrabberStats grabStats = imageGrabberPtr_ -> getStats();
+                statusMsg += QString().sprintf(",  grab cpu %1.0f%%", 100.0*grabStats.cpuLoad);
+                statusMsg += QString().sprintf(" lat %1.0f/%1.0f us", grabStats.meanLatencyUs, grabStats.maxLatencyUs);
                 if ((logging_) && (!imageLoggerPtr_.isNull()))
                 {
                     imageLoggerPtr_ -> acquireLock();
                     unsigned int logQueueSize = imageLoggerPtr_ -> getLogQueueSize();
                     imageLoggerPtr_ -> releaseLock();
                     statusMsg += QString(",  log queue size = %1").arg(logQueueSize);
+                    QString writerStatus = imageLoggerPtr_ -> getWriterStatusString();
+                    if (!writerStatus.isEmpty())
+                    {
+                        statusMsg += QString(",  ") + writerStatus;
+                    }
+                    QString preTriggerStatus = imageLoggerPtr_ -> getPreTriggerStatusString();
+                    if (!preTriggerStatus.isEmpty())
+                    {
+                        statusMsg += QString(",  ") + preTriggerStatus;
+                    }
+                    unsigned long numDropped = newImageQueuePtr_ -> numDropped();
+                    numDropped += logImageQueuePtr_ -> numDropped();
+                    if (numDropped > 0)
+                    {
+                        statusMsg += QString(",  dropped = %1").arg(numDropped);
+                    }
+                }
+                if (FrameSyncService::isEnabled())
+                {
+                    QString syncStatus = FrameSyncService::getStatusString(cameraNumber_);
+                    if (!syncStatus.isEmpty())
+                    {
+                        statusMsg += QString(",  ") + syncStatus;
+                    }
                 }
                 updateStatusLabel(statusMsg);
 
@@ -1851,7 +2141,7 @@ namespace bias
                 {
                     setCaptureTimeLabel(double(1.0e-3*captureDt));
                 }
-                updateHistogramPixmap(histMat);
+                updateHistogramPixmap(previewImage.histogram);
             }
 
         } // if (capturing_)
@@ -1887,6 +2177,10 @@ namespace bias
         }
        
         updateAllImageLabels();
+
+        // Picks up changes made through the GUI - changes made through the 
+        // external control server are published as they are made.
+        publishStatus();
     }
 
 
@@ -1941,6 +2235,17 @@ namespace bias
     }
 
 
+    void CameraWindow::preTriggerRequested()
+    {
+        // Trigger from a plugin or the pre-trigger timer - ignored unless 
+        // capturing in pre-trigger mode.
+        if (videoWriterParams_.preTrigger.enabled && capturing_ && logging_)
+        {
+            triggerClip(false);
+        }
+    }
+
+
     void CameraWindow::imageLoggingError(unsigned int errorId, QString errorMsg)
     {
         if ((errorId == ERROR_FRAMES_TODO_MAX_QUEUE_SIZE) || (errorId == ERROR_FRAMES_FINISHED_MAX_SET_SIZE))
@@ -2465,12 +2770,12 @@ namespace bias
     {
         if (actionServerEnabledPtr_ -> isChecked())
         {
-            httpServerPtr_ -> listen(QHostAddress::Any, httpServerPort_);
+            httpServerPtr_ -> startListening(httpServerPort_);
 
         }
         else
         {
-            httpServerPtr_ -> close();
+            httpServerPtr_ -> stopListening();
         }
     }
 
@@ -2531,7 +2836,7 @@ namespace bias
 		}
         QString s = QFileDialog::getOpenFileName(this, 
             "Choose Video File to Capture from", captureVideoDir, 
-            "Video Files (*.avi *.mp4 *.mov *.wmv *.flv)");
+            "Video Files (*.avi *.mp4 *.mov *.wmv *.flv *.mkv *.fmf *.ufmf *.mjpg)");
         if(!s.isEmpty()) {
             captureVideoFileName_ = s;
 			actionCaptureFromVideoPtr_->setChecked(true);
@@ -2574,6 +2879,7 @@ namespace bias
         connected_ = false;
         capturing_ = false;
         haveImagePixmap_ = false;
+        previewPixmapScale_ = 1.0;
         logging_ = false; 
         //logging_ = true; 
 
@@ -2594,18 +2900,24 @@ namespace bias
         //videoFileFormat_ = VIDEOFILE_FORMAT_UFMF;
         //videoFileFormat_ = VIDEOFILE_FORMAT_AVI;
         videoFileFormat_ = VIDEOFILE_FORMAT_JPG;
+        grabMode_ = DEFAULT_GRAB_MODE;
+        pipelineTrace_ = false;
         imageDisplayFreq_ = DEFAULT_IMAGE_DISPLAY_FREQ;
         captureDurationSec_ = DEFAULT_CAPTURE_DURATION;
 
         cameraNumber_ = cameraNumber;
         numberOfCameras_ = numberOfCameras;
         cameraPtr_ = std::make_shared<Lockable<Camera>>(guid);
+        imagePoolPtr_ = std::make_shared<ImagePool>(IMAGE_POOL_MAX_BUFFERS, IMAGE_POOL_MAX_MEMORY_MB);
+        cameraPtr_ -> setImagePool(imagePoolPtr_);
 
         threadPoolPtr_ = new QThreadPool(this);
         threadPoolPtr_ -> setMaxThreadCount(MAX_THREAD_COUNT);
-        newImageQueuePtr_ = std::make_shared<LockableQueue<StampedImage>>();
-        logImageQueuePtr_ = std::make_shared<LockableQueue<StampedImage>>();
-        pluginImageQueuePtr_ = std::make_shared<LockableQueue<StampedImage>>();
+        newImageQueuePtr_ = std::make_shared<SpscRingBuffer<StampedImage>>(NEW_IMAGE_QUEUE_CAPACITY);
+        logImageQueuePtr_ = std::make_shared<SpscRingBuffer<StampedImage>>(LOG_IMAGE_QUEUE_CAPACITY);
+        pluginImageQueuePtr_ = std::make_shared<SpscRingBuffer<StampedImage>>(PLUGIN_IMAGE_QUEUE_CAPACITY);
+        pipelineStatsPtr_ = std::make_shared<PipelineStats>(cameraNumber_);
+        statusPublisherPtr_ = std::make_shared<CameraStatusPublisher>();
 
         setDefaultFileDirs();
         currentVideoFileDir_ = defaultVideoFileDir_;
@@ -2633,12 +2945,23 @@ namespace bias
         pluginMap_[FlyTrackPlugin::PLUGIN_NAME] = new FlyTrackPlugin(this);
         // -------------------------------------------------------------------------------
 
+        for (auto pluginPtr : pluginMap_.values())
+        {
+            connect(
+                    pluginPtr,
+                    SIGNAL(recordTriggerRequest()),
+                    this,
+                    SLOT(preTriggerRequested())
+                   );
+        }
+
         setupStatusLabel();
         setupCameraMenu();
         setupLoggingMenu();
         setupDisplayMenu();
         setupImageDisplayTimer();
         setupCaptureDurationTimer();
+        setupPreTriggerTimer();
         setupImageLabels();
         setupPluginMenu();
         updateAllMenus(); 
@@ -2663,16 +2986,18 @@ namespace bias
 
         updateStatusLabel();
 
-        ThreadAffinityService::assignThreadAffinity(false,cameraNumber_);
+        // The gui thread is shared by all cameras' windows
+        ThreadAffinityService::assignSharedThreadAffinity();
 
         httpServerPort_  = HTTP_SERVER_PORT_BEGIN; 
         httpServerPort_ += HTTP_SERVER_PORT_STEP*(cameraNumber_ + 1);
-        httpServerPtr_ = new ExtCtlHttpServer(this,this);
+        httpServerPtr_ = new ExtCtlHttpServer(this,statusPublisherPtr_);
+        httpServerPtr_ -> startThread();
         setServerPortText();
         if (DEFAULT_HTTP_SERVER_ENABLED)
         {
             actionServerEnabledPtr_ -> setChecked(true);
-            httpServerPtr_ -> listen(QHostAddress::Any, httpServerPort_);
+            httpServerPtr_ -> startListening(httpServerPort_);
 
         }
         else
@@ -2702,6 +3027,7 @@ namespace bias
         if (cameraPreview)
         {
             previewPixmapOriginal_ = QPixmap::fromImage(dummyImage);
+            previewPixmapScale_ = 1.0;
         }
         if (pluginPreview)
         {
@@ -2848,6 +3174,13 @@ namespace bias
                 SLOT(actionLoggingFormatTriggered())
                );
 
+        connect(
+                actionLoggingFormatFFMPEGPtr_,
+                SIGNAL(triggered()),
+                this,
+                SLOT(actionLoggingFormatTriggered())
+               );
+
         connect(
                 actionLoggingFormatIFMFPtr_,
                 SIGNAL(triggered()),
@@ -3109,6 +3442,91 @@ namespace bias
     }
 
 
+    void CameraWindow::setupPreTriggerTimer()
+    {
+        preTriggerTimerPtr_ = new QTimer(this);
+        connect(
+                preTriggerTimerPtr_,
+                SIGNAL(timeout()),
+                this,
+                SLOT(preTriggerRequested())
+               );
+    }
+
+
+    std::shared_ptr<VideoWriter> CameraWindow::createVideoWriter(
+            VideoFileFormat videoFileFormat,
+            VideoWriterParams videoWriterParams,
+            QString videoFileFullPath
+            ) const
+    {
+        // Also called from the logger thread to make pre-trigger clip writers
+        // so only the arguments and the camera number are used.
+        std::shared_ptr<VideoWriter> videoWriterPtr; 
+
+        switch (videoFileFormat)
+        {
+            case VIDEOFILE_FORMAT_BMP:
+                videoWriterPtr = std::make_shared<VideoWriter_bmp>(
+                        videoWriterParams.bmp,
+                        videoFileFullPath,
+                        cameraNumber_
+                        );
+                break;
+
+            case VIDEOFILE_FORMAT_JPG:
+                videoWriterPtr = std::make_shared<VideoWriter_jpg>(
+                        videoWriterParams.jpg,
+                        videoFileFullPath,
+                        cameraNumber_
+                        );
+                break;
+
+            case VIDEOFILE_FORMAT_AVI:  
+                videoWriterPtr = std::make_shared<VideoWriter_avi>(
+                        videoWriterParams.avi,
+                        videoFileFullPath,
+                        cameraNumber_
+                        );
+                break;
+
+            case VIDEOFILE_FORMAT_FMF:
+                videoWriterPtr = std::make_shared<VideoWriter_fmf>(
+                        videoWriterParams.fmf,
+                        videoFileFullPath,
+                        cameraNumber_
+                        );
+                break;
+
+            case VIDEOFILE_FORMAT_UFMF:
+                videoWriterPtr = std::make_shared<VideoWriter_ufmf>(
+                        videoWriterParams.ufmf,
+                        videoFileFullPath,
+                        cameraNumber_
+                        );
+                break;
+
+            case VIDEOFILE_FORMAT_FFMPEG:
+                videoWriterPtr = std::make_shared<VideoWriter_ffmpeg>(
+                        videoWriterParams.ffmpeg,
+                        videoFileFullPath,
+                        cameraNumber_
+                        );
+                break;
+
+            default:
+                videoWriterPtr = std::make_shared<VideoWriter>(
+                        videoFileFullPath,
+                        cameraNumber_
+                        );
+                break;
+
+        } // switch (videoFileFormat) 
+
+        return videoWriterPtr;
+    }
+
+
     void CameraWindow::updateWindowTitle()
     {
         QString windowTitle;
@@ -3198,12 +3616,17 @@ namespace bias
         loggingFormatActionGroupPtr_ -> addAction(actionLoggingFormatAVIPtr_);
         loggingFormatActionGroupPtr_ -> addAction(actionLoggingFormatFMFPtr_);
         loggingFormatActionGroupPtr_ -> addAction(actionLoggingFormatUFMFPtr_);
+        loggingFormatActionGroupPtr_ -> addAction(actionLoggingFormatFFMPEGPtr_);
         loggingFormatActionGroupPtr_ -> addAction(actionLoggingFormatIFMFPtr_);
         actionToVideoFileFormatMap_[actionLoggingFormatBMPPtr_] = VIDEOFILE_FORMAT_BMP;
         actionToVideoFileFormatMap_[actionLoggingFormatJPGPtr_] = VIDEOFILE_FORMAT_JPG;
         actionToVideoFileFormatMap_[actionLoggingFormatAVIPtr_] = VIDEOFILE_FORMAT_AVI;
         actionToVideoFileFormatMap_[actionLoggingFormatFMFPtr_] = VIDEOFILE_FORMAT_FMF;
         actionToVideoFileFormatMap_[actionLoggingFormatUFMFPtr_] = VIDEOFILE_FORMAT_UFMF;
+        actionToVideoFileFormatMap_[actionLoggingFormatFFMPEGPtr_] = VIDEOFILE_FORMAT_FFMPEG;
+#ifndef WITH_FFMPEG
+        actionLoggingFormatFFMPEGPtr_ -> setVisible(false);
+#endif
 
         if (logging_)
         {
@@ -3301,9 +3724,14 @@ namespace bias
             bool flipAndRotate,
             bool addFrameCount,
             bool addRoiBoundary,
-            bool addAlignmentObjs
+            bool addAlignmentObjs,
+            float pixmapScale
             )
     {
+        // pixmapScale is the size of pixmapOriginal relative to the camera 
+        // image. ROI, alignment objects and the label's scale factor are all 
+        // in camera image coordinates.
+
         // Draw ROI
         QPixmap pixmapCopy = QPixmap(pixmapOriginal);
 
@@ -3311,10 +3739,10 @@ namespace bias
         {
             if (format7SettingsDialogPtr_ -> isRoiShowChecked())
             {
-                int x = format7SettingsDialogPtr_ -> getRoiXOffset();
-                int y = format7SettingsDialogPtr_ -> getRoiYOffset();
-                int w = format7SettingsDialogPtr_ -> getRoiXWidth();
-                int h = format7SettingsDialogPtr_ -> getRoiYHeight();
+                int x = int(pixmapScale*format7SettingsDialogPtr_ -> getRoiXOffset());
+                int y = int(pixmapScale*format7SettingsDialogPtr_ -> getRoiYOffset());
+                int w = int(pixmapScale*format7SettingsDialogPtr_ -> getRoiXWidth());
+                int h = int(pixmapScale*format7SettingsDialogPtr_ -> getRoiYHeight());
                 QPainter roiPainter(&pixmapCopy);
                 QPen roiPen = QPen(ROI_BOUNDARY_COLOR);
                 roiPen.setWidth(ROI_BOUNDARY_LINE_WIDTH);
@@ -3331,7 +3759,7 @@ namespace bias
                 Qt::SmoothTransformation
                 );
 
-        float scaleFactor = float(pixmapScaled.width())/float(pixmapCopy.width());
+        float scaleFactor = pixmapScale*float(pixmapScaled.width())/float(pixmapCopy.width());
         imageLabelPtr -> setScaleFactor(scaleFactor);
 
         // Add alignment objects
@@ -3373,8 +3801,8 @@ namespace bias
             // Draw alignement circle
             if (alignmentSettings_.ellipseVisible)
             {
-                float scaleX = float(scaledPixmapWidth)/float(origPixmapWidth);
-                float scaleY = float(scaledPixmapHeight)/float(origPixmapHeight);
+                float scaleX = pixmapScale*float(scaledPixmapWidth)/float(origPixmapWidth);
+                float scaleY = pixmapScale*float(scaledPixmapHeight)/float(origPixmapHeight);
                 QPainter ellipsePainter(&pixmapScaled);
                 QPen ellipsePen = QPen(alignmentSettings_.ellipseQColor);
                 ellipsePen.setWidth(alignmentSettings_.ellipsePenWidth);
@@ -3438,7 +3866,8 @@ namespace bias
                 true,  
                 true,  
                 true,
-                true
+                true,
+                previewPixmapScale_
                 );
 
         updateImageLabel(
@@ -3467,7 +3896,8 @@ namespace bias
             bool flipAndRotate,
             bool addFrameCount,
             bool addRoiBoundary,
-            bool addAlignmentObjs
+            bool addAlignmentObjs,
+            float pixmapScale
             )
     {
         // Determines if resize of pixmap of image on Qlabel is required and 
@@ -3490,7 +3920,8 @@ namespace bias
                     flipAndRotate,
                     addFrameCount,
                     addRoiBoundary,
-                    addAlignmentObjs
+                    addAlignmentObjs,
+                    pixmapScale
                     );
         }
     }
@@ -3504,7 +3935,8 @@ namespace bias
                 true, 
                 true, 
                 true, 
-                true
+                true,
+                previewPixmapScale_
                 );
 
         resizeImageLabel(
@@ -3535,14 +3967,23 @@ namespace bias
 
         QPainter painter(&histogramPixmapOriginal_);
         painter.setPen(QColor(50,50,50));
-        cv::Size histSize = hist.size();
 
         float histImageMaxY = float(DEFAULT_HISTOGRAM_IMAGE_SIZE.height() - 1.0);
+        double maxVal = 0.0;
+        if (!hist.empty())
+        {
+            cv::minMaxLoc(hist,NULL,&maxVal,NULL,NULL);
+        }
+        if (maxVal <= 0.0)
+        {
+            return;
+        }
+        float histScale = float(histImageMaxY/maxVal);
 
-        for (int i=0; i<histSize.height; i++) 
+        for (int i=0; i<int(hist.total()); i++) 
         {
             int y0 = int(histImageMaxY);
-            int y1 = int(histImageMaxY - hist.at<float>(0,i));
+            int y1 = int(histImageMaxY - histScale*hist.at<float>(i));
             painter.drawLine(i,y0,i,y1);
         }
 
@@ -4601,6 +5042,24 @@ namespace bias
 
         } // swtich(triggerType)
 
+        // Grab mode - optional, older configuration files don't include it
+        if (cameraMap.contains("grabMode"))
+        {
+            QString grabModeString = cameraMap["grabMode"].toString();
+            if (!GRAB_MODE_TO_STRING_MAP.values().contains(grabModeString))
+            {
+                QString errMsgText = QString("Camera: unknown grabMode = %1").arg(grabModeString);
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            grabMode_ = GRAB_MODE_TO_STRING_MAP.key(grabModeString);
+        }
+
         rtnStatus.success = true;
         rtnStatus.message = QString("");
         return rtnStatus;
@@ -4791,6 +5250,24 @@ namespace bias
             return rtnStatus;
         }
 
+        // Get "pipelineTrace" value - optional
+        // ------------------------------------
+        if (loggingMap.contains("pipelineTrace"))
+        {
+            if (!loggingMap["pipelineTrace"].canConvert<bool>())
+            {
+                QString errMsgText("Logging configuration: unable to convert pipelineTrace to bool");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            pipelineTrace_ = loggingMap["pipelineTrace"].toBool();
+        }
+
         // After we have all logging information - try and enable logging
         if (loggingEnabledValue)
         {
@@ -5174,14 +5651,13 @@ namespace bias
         if (serverEnabled)
         {
             actionServerEnabledPtr_ -> setChecked(true);
-            httpServerPtr_ -> close();
-            httpServerPtr_ -> listen(QHostAddress::Any, httpServerPort_);
+            httpServerPtr_ -> startListening(httpServerPort_);
 
         }
         else
         {
             actionServerEnabledPtr_ -> setChecked(false);
-            httpServerPtr_ -> close();
+            httpServerPtr_ -> stopListening();
         }
 
         rtnStatus.success = true;
@@ -5375,31 +5851,177 @@ namespace bias
     }
 
 
-    RtnStatus CameraWindow::setCameraPropertyFromMap(
-            QVariantMap propValueMap, 
-            PropertyInfo propInfo, 
-            bool showErrorDlg
-            )
+    RtnStatus CameraWindow::setThreadAffinityFromMap(QVariantMap threadAffinityMap, bool showErrorDlg)
     {
+        // All values are optional - missing values keep their defaults. The
+        // new layout is used by the capture threads started after this call.
         RtnStatus rtnStatus;
-        Property newProp;
-        newProp.type = propInfo.type;
-        QString errMsgTitle("Load Configuration Error (Camera Property)");
-        QString name = QString::fromStdString(getPropertyTypeString(propInfo.type));
+        QString errMsgTitle("Load Configuration Error (Thread Affinity)");
+        ThreadAffinityParams params;
 
-        // Get value for "Present"
-        if (!propValueMap.contains("present"))
+        // Get "enabled" value
+        // -------------------
+        if (threadAffinityMap.contains("enabled"))
         {
-            QString errMsgText = QString(
-                    "Camera: property %1 has no value for present"
-                    ).arg(name);
-            if (showErrorDlg)
+            if (!threadAffinityMap["enabled"].canConvert<bool>())
             {
-                QMessageBox::critical(this,errMsgTitle,errMsgText);
-            }
-            rtnStatus.success = false;
-            rtnStatus.message = errMsgText;
-            return rtnStatus;
+                QString errMsgText("Thread affinity configuration: unable to convert enabled to bool");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            params.enabled = threadAffinityMap["enabled"].toBool();
+        }
+
+        // Get "numaNode" value
+        // --------------------
+        if (threadAffinityMap.contains("numaNode"))
+        {
+            if (!threadAffinityMap["numaNode"].canConvert<int>())
+            {
+                QString errMsgText("Thread affinity configuration: unable to convert numaNode to int");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            params.numaNode = threadAffinityMap["numaNode"].toInt();
+        }
+
+        // Get "device" value
+        // ------------------
+        if (threadAffinityMap.contains("device"))
+        {
+            if (!threadAffinityMap["device"].canConvert<QString>())
+            {
+                QString errMsgText("Thread affinity configuration: unable to convert device to string");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            params.device = threadAffinityMap["device"].toString();
+        }
+
+        // Get "grabberCpu" value
+        // ----------------------
+        if (threadAffinityMap.contains("grabberCpu"))
+        {
+            if (!threadAffinityMap["grabberCpu"].canConvert<int>())
+            {
+                QString errMsgText("Thread affinity configuration: unable to convert grabberCpu to int");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            params.grabberCpu = threadAffinityMap["grabberCpu"].toInt();
+        }
+
+        // Get "workerCpus" value
+        // ----------------------
+        if (threadAffinityMap.contains("workerCpus"))
+        {
+            QString workerCpus = threadAffinityMap["workerCpus"].toString();
+            bool ok = false;
+            ThreadAffinityService::parseCpuList(workerCpus, &ok);
+            if (!ok)
+            {
+                QString errMsgText = QString("Thread affinity configuration: invalid workerCpus = %1").arg(workerCpus);
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            params.workerCpus = workerCpus;
+        }
+
+        // Get "realtime" value
+        // --------------------
+        if (threadAffinityMap.contains("realtime"))
+        {
+            QString realtimeString = threadAffinityMap["realtime"].toString();
+            if (!REALTIME_POLICY_TO_STRING_MAP.values().contains(realtimeString))
+            {
+                QString errMsgText = QString("Thread affinity configuration: unknown realtime = %1").arg(realtimeString);
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            params.realtimePolicy = REALTIME_POLICY_TO_STRING_MAP.key(realtimeString);
+        }
+
+        // Get "realtimePriority" value
+        // ----------------------------
+        if (threadAffinityMap.contains("realtimePriority"))
+        {
+            if (!threadAffinityMap["realtimePriority"].canConvert<int>())
+            {
+                QString errMsgText("Thread affinity configuration: unable to convert realtimePriority to int");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            params.realtimePriority = threadAffinityMap["realtimePriority"].toInt();
+        }
+
+        ThreadAffinityService::setParams(cameraNumber_, params);
+
+        rtnStatus.success = true;
+        rtnStatus.message = QString("");
+        return rtnStatus;
+    }
+
+
+    RtnStatus CameraWindow::setCameraPropertyFromMap(
+            QVariantMap propValueMap, 
+            PropertyInfo propInfo, 
+            bool showErrorDlg
+            )
+    {
+        RtnStatus rtnStatus;
+        Property newProp;
+        newProp.type = propInfo.type;
+        QString errMsgTitle("Load Configuration Error (Camera Property)");
+        QString name = QString::fromStdString(getPropertyTypeString(propInfo.type));
+
+        // Get value for "Present"
+        if (!propValueMap.contains("present"))
+        {
+            QString errMsgText = QString(
+                    "Camera: property %1 has no value for present"
+                    ).arg(name);
+            if (showErrorDlg)
+            {
+                QMessageBox::critical(this,errMsgTitle,errMsgText);
+            }
+            rtnStatus.success = false;
+            rtnStatus.message = errMsgText;
+            return rtnStatus;
         }
         if (!propValueMap["present"].canConvert<bool>())
         {
@@ -6289,6 +6911,111 @@ namespace bias
         }
         videoWriterParams_.bmp.frameSkip = bmpFrameSkip;
 
+        // new optional parameter
+        if (bmpMap.contains("imageFormat"))
+        {
+            if (!bmpMap["imageFormat"].canConvert<QString>())
+            {
+                QString errMsgText("Logging Settings: bmp unable to convert imageFormat to string");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            QString imageFormat = bmpMap["imageFormat"].toString();
+            ImageFileFormat_bmp imageFileFormat;
+            if (!CompressedFrame_bmp::getFormatFromString(imageFormat, imageFileFormat))
+            {
+                QString errMsgText("Logging Settings: bmp imageFormat must be bmp, png or tiff");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            videoWriterParams_.bmp.imageFormat = CompressedFrame_bmp::getFormatString(imageFileFormat);
+        }
+
+        // new optional parameter
+        if (bmpMap.contains("pngCompressionLevel"))
+        {
+            if (!bmpMap["pngCompressionLevel"].canConvert<unsigned int>())
+            {
+                QString errMsgText("Logging Settings: bmp unable to convert pngCompressionLevel to unsigned int");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            unsigned int pngCompressionLevel = bmpMap["pngCompressionLevel"].toUInt();
+            if (pngCompressionLevel > CompressedFrame_bmp::MAX_PNG_COMPRESSION_LEVEL)
+            {
+                QString errMsgText("Logging Settings: bmp pngCompressionLevel must be between 0 and 9");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            videoWriterParams_.bmp.pngCompressionLevel = pngCompressionLevel;
+        }
+
+        // new optional parameter
+        if (bmpMap.contains("compressionThreads"))
+        {
+            if (!bmpMap["compressionThreads"].canConvert<unsigned int>())
+            {
+                QString errMsgText("Logging Settings: bmp unable to convert compressionThreads to unsigned int");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            unsigned int bmpCompressionThreads = bmpMap["compressionThreads"].toUInt();
+            if (bmpCompressionThreads == 0)
+            {
+                QString errMsgText("Logging Settings: bmp compressionThreads must be greater than zero");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            videoWriterParams_.bmp.numberOfCompressors = bmpCompressionThreads;
+        }
+
+        // new optional parameter
+        if (bmpMap.contains("filesPerDirectory"))
+        {
+            if (!bmpMap["filesPerDirectory"].canConvert<unsigned long long>())
+            {
+                QString errMsgText("Logging Settings: bmp unable to convert filesPerDirectory to unsigned long");
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            videoWriterParams_.bmp.filesPerDirectory = (unsigned long)(bmpMap["filesPerDirectory"].toULongLong());
+        }
+
         // Get jpg values - ignore if not there
         // --------------
         QVariantMap jpgMap = formatMap["jpg"].toMap();
@@ -6484,6 +7211,52 @@ namespace bias
                 videoWriterParams_.jpg.mjpgMaxFramePerFile = maxFramePerFile;
                 }
             }
+
+            // new optional parameter
+            if (jpgMap.contains("chromaSubsampling"))
+            {
+                if (!jpgMap["chromaSubsampling"].canConvert<unsigned int>())
+                {
+                    QString errMsgText("Logging Settings: jpg unable to convert chromaSubsampling to unsigned int");
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                unsigned int chromaSubsampling = jpgMap["chromaSubsampling"].toUInt();
+                if (!Encoder_jpg::isValidChromaSubsampling(chromaSubsampling))
+                {
+                    QString errMsgText("Logging Settings: jpg chromaSubsampling must be 444, 422 or 420");
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                videoWriterParams_.jpg.chromaSubsampling = chromaSubsampling;
+            }
+
+            // new optional parameter
+            if (jpgMap.contains("fastDct"))
+            {
+                if (!jpgMap["fastDct"].canConvert<bool>())
+                {
+                    QString errMsgText("Logging Settings: jpg unable to convert fastDct to bool");
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                videoWriterParams_.jpg.fastDct = jpgMap["fastDct"].toBool();
+            }
         }
 
         // Get fmf values
@@ -6537,31 +7310,121 @@ namespace bias
             return rtnStatus;
         }
         videoWriterParams_.fmf.frameSkip = fmfFrameSkip;
-        
-        // Get ufmf values
-        // ---------------
-        QVariantMap ufmfMap = formatMap["ufmf"].toMap();
-        if (ufmfMap.isEmpty())
+
+        // fmf background disk writer thread - optional
+        if (fmfMap.contains("asyncWrite"))
         {
-            QString errMsgText("Logging Settings: ufmf settings not present");
-            if (showErrorDlg)
+            if (!fmfMap["asyncWrite"].canConvert<bool>())
             {
-                QMessageBox::critical(this,errMsgTitle,errMsgText);
+                QString errMsgText("Logging Settings: fmf unable to convert");
+                errMsgText += " asyncWrite to bool";
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
             }
-            rtnStatus.success = false;
-            rtnStatus.message = errMsgText;
-            return rtnStatus;
+            videoWriterParams_.fmf.asyncWrite = fmfMap["asyncWrite"].toBool();
         }
-        // ufmf Frame Skip
-        if (!ufmfMap.contains("frameSkip"))
+
+        // fmf direct (unbuffered) disk I/O - optional
+        if (fmfMap.contains("directIo"))
         {
-            QString errMsgText("Logging Settings: ufmf frameSkip not present");
-            if (showErrorDlg)
+            if (!fmfMap["directIo"].canConvert<bool>())
             {
-                QMessageBox::critical(this,errMsgTitle,errMsgText);
-            }
-            rtnStatus.success = false;
-            rtnStatus.message = errMsgText;
+                QString errMsgText("Logging Settings: fmf unable to convert");
+                errMsgText += " directIo to bool";
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            videoWriterParams_.fmf.directIo = fmfMap["directIo"].toBool();
+        }
+
+        // fmf expected recording duration (sec) for preallocation - optional
+        if (fmfMap.contains("expectedDuration"))
+        {
+            if (!fmfMap["expectedDuration"].canConvert<unsigned int>())
+            {
+                QString errMsgText("Logging Settings: fmf unable to convert");
+                errMsgText += " expectedDuration to unsigned int";
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            videoWriterParams_.fmf.expectedDuration = fmfMap["expectedDuration"].toUInt();
+        }
+
+        // fmf expected frame rate for preallocation - optional
+        if (fmfMap.contains("expectedFrameRate"))
+        {
+            if (!fmfMap["expectedFrameRate"].canConvert<double>())
+            {
+                QString errMsgText("Logging Settings: fmf unable to convert");
+                errMsgText += " expectedFrameRate to double";
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            videoWriterParams_.fmf.expectedFrameRate = fmfMap["expectedFrameRate"].toDouble();
+        }
+
+        // fmf 12-bit packing of 16-bit images - optional
+        if (fmfMap.contains("packed12"))
+        {
+            if (!fmfMap["packed12"].canConvert<bool>())
+            {
+                QString errMsgText("Logging Settings: fmf unable to convert");
+                errMsgText += " packed12 to bool";
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            videoWriterParams_.fmf.packed12 = fmfMap["packed12"].toBool();
+        }
+        
+        // Get ufmf values
+        // ---------------
+        QVariantMap ufmfMap = formatMap["ufmf"].toMap();
+        if (ufmfMap.isEmpty())
+        {
+            QString errMsgText("Logging Settings: ufmf settings not present");
+            if (showErrorDlg)
+            {
+                QMessageBox::critical(this,errMsgTitle,errMsgText);
+            }
+            rtnStatus.success = false;
+            rtnStatus.message = errMsgText;
+            return rtnStatus;
+        }
+        // ufmf Frame Skip
+        if (!ufmfMap.contains("frameSkip"))
+        {
+            QString errMsgText("Logging Settings: ufmf frameSkip not present");
+            if (showErrorDlg)
+            {
+                QMessageBox::critical(this,errMsgTitle,errMsgText);
+            }
+            rtnStatus.success = false;
+            rtnStatus.message = errMsgText;
             return rtnStatus;
         }
         if (!ufmfMap["frameSkip"].canConvert<unsigned int>())
@@ -6829,6 +7692,97 @@ namespace bias
         }
         videoWriterParams_.ufmf.medianUpdateInterval = ufmfMedianUpdateInterval;
 
+        // ufmf median threads - optional
+        if (ufmfMap.contains("medianThreads"))
+        {
+            if (!ufmfMap["medianThreads"].canConvert<unsigned int>())
+            {
+                QString errMsgText("Logging Settings: ufmf unable");
+                errMsgText += " to convert medianThreads to unsigned int";
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            unsigned int ufmfMedianThreads = ufmfMap["medianThreads"].toUInt();
+            if ( 
+                    (ufmfMedianThreads < BackgroundMedian_ufmf::MIN_NUMBER_OF_WORKERS) ||
+                    (ufmfMedianThreads > BackgroundMedian_ufmf::MAX_NUMBER_OF_WORKERS)
+               )
+            {
+                QString errMsgText("Logging Settings: ufmf medianThreads");
+                errMsgText += QString(" must be in range [%1,%2]").arg(
+                        BackgroundMedian_ufmf::MIN_NUMBER_OF_WORKERS).arg(
+                        BackgroundMedian_ufmf::MAX_NUMBER_OF_WORKERS
+                        );
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            videoWriterParams_.ufmf.numberOfMedianWorkers = ufmfMedianThreads;
+        }
+
+        // ufmf incremental median publishing - optional
+        if (ufmfMap.contains("medianIncremental"))
+        {
+            if (!ufmfMap["medianIncremental"].canConvert<bool>())
+            {
+                QString errMsgText("Logging Settings: ufmf unable");
+                errMsgText += " to convert medianIncremental to bool";
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            videoWriterParams_.ufmf.medianIncremental = ufmfMap["medianIncremental"].toBool();
+        }
+
+        // ufmf direct (unbuffered) disk I/O - optional
+        if (ufmfMap.contains("directIo"))
+        {
+            if (!ufmfMap["directIo"].canConvert<bool>())
+            {
+                QString errMsgText("Logging Settings: ufmf unable");
+                errMsgText += " to convert directIo to bool";
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            videoWriterParams_.ufmf.directIo = ufmfMap["directIo"].toBool();
+        }
+
+        // ufmf file preallocation size - optional
+        if (ufmfMap.contains("preallocateMB"))
+        {
+            if (!ufmfMap["preallocateMB"].canConvert<unsigned int>())
+            {
+                QString errMsgText("Logging Settings: ufmf unable");
+                errMsgText += " to convert preallocateMB to unsigned int";
+                if (showErrorDlg)
+                {
+                    QMessageBox::critical(this,errMsgTitle,errMsgText);
+                }
+                rtnStatus.success = false;
+                rtnStatus.message = errMsgText;
+                return rtnStatus;
+            }
+            videoWriterParams_.ufmf.preallocateMB = ufmfMap["preallocateMB"].toUInt();
+        }
+
         // ufmf Dilate
         QVariantMap ufmfDilateMap = ufmfMap["dilate"].toMap();
         if (ufmfDilateMap.isEmpty())
@@ -6904,6 +7858,336 @@ namespace bias
         // ----------------------------------------------------------------------
         videoWriterParams_.ufmf.dilateWindowSize = ufmfDilateWindowSize;
 
+        // Get ffmpeg values - optional, older configurations don't have them
+        // ---------------------------------------------------------------------
+        if (formatMap.contains("ffmpeg"))
+        {
+            QVariantMap ffmpegMap = formatMap["ffmpeg"].toMap();
+
+            // ffmpeg frameSkip - optional
+            if (ffmpegMap.contains("frameSkip"))
+            {
+                if (!ffmpegMap["frameSkip"].canConvert<unsigned int>())
+                {
+                    QString errMsgText("Logging Settings: ffmpeg unable to convert");
+                    errMsgText += " frameSkip to unsigned int";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                unsigned int ffmpegValue = ffmpegMap["frameSkip"].toUInt();
+                if (ffmpegValue == 0)
+                {
+                    QString errMsgText("Logging Settings: ffmpeg frameSkip must");
+                    errMsgText += " be greater than zero";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                videoWriterParams_.ffmpeg.frameSkip = ffmpegValue;
+            }
+
+            // ffmpeg codec - optional
+            if (ffmpegMap.contains("codec"))
+            {
+                if (!ffmpegMap["codec"].canConvert<QString>())
+                {
+                    QString errMsgText("Logging Settings: ffmpeg unable to convert");
+                    errMsgText += " codec to string";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                QString ffmpegString = ffmpegMap["codec"].toString();
+                if (!VideoWriter_ffmpeg::isAllowedCodec(ffmpegString))
+                {
+                    QString errMsgText("Logging Settings: ffmpeg codec");
+                    errMsgText += " must be ffv1, h264 or h265";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                videoWriterParams_.ffmpeg.codec = ffmpegString;
+            }
+
+            // ffmpeg crf - optional
+            if (ffmpegMap.contains("crf"))
+            {
+                if (!ffmpegMap["crf"].canConvert<unsigned int>())
+                {
+                    QString errMsgText("Logging Settings: ffmpeg unable to convert");
+                    errMsgText += " crf to unsigned int";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                unsigned int ffmpegValue = ffmpegMap["crf"].toUInt();
+                if (ffmpegValue > VideoWriter_ffmpeg::MAX_CRF)
+                {
+                    QString errMsgText("Logging Settings: ffmpeg crf");
+                    errMsgText += " must be less than or equal to 51";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                videoWriterParams_.ffmpeg.crf = ffmpegValue;
+            }
+
+            // ffmpeg preset - optional
+            if (ffmpegMap.contains("preset"))
+            {
+                if (!ffmpegMap["preset"].canConvert<QString>())
+                {
+                    QString errMsgText("Logging Settings: ffmpeg unable to convert");
+                    errMsgText += " preset to string";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                QString ffmpegString = ffmpegMap["preset"].toString();
+                if (!VideoWriter_ffmpeg::isAllowedPreset(ffmpegString))
+                {
+                    QString errMsgText("Logging Settings: ffmpeg preset");
+                    errMsgText += " is not an x264/x265 preset";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                videoWriterParams_.ffmpeg.preset = ffmpegString;
+            }
+
+            // ffmpeg encoderThreads - optional
+            if (ffmpegMap.contains("encoderThreads"))
+            {
+                if (!ffmpegMap["encoderThreads"].canConvert<unsigned int>())
+                {
+                    QString errMsgText("Logging Settings: ffmpeg unable to convert");
+                    errMsgText += " encoderThreads to unsigned int";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                unsigned int ffmpegValue = ffmpegMap["encoderThreads"].toUInt();
+                videoWriterParams_.ffmpeg.numberOfThreads = ffmpegValue;
+            }
+
+            // ffmpeg maxQueueSize - optional
+            if (ffmpegMap.contains("maxQueueSize"))
+            {
+                if (!ffmpegMap["maxQueueSize"].canConvert<unsigned int>())
+                {
+                    QString errMsgText("Logging Settings: ffmpeg unable to convert");
+                    errMsgText += " maxQueueSize to unsigned int";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                unsigned int ffmpegValue = ffmpegMap["maxQueueSize"].toUInt();
+                if (ffmpegValue < VideoWriter_ffmpeg::MIN_MAX_QUEUE_SIZE)
+                {
+                    QString errMsgText("Logging Settings: ffmpeg maxQueueSize must");
+                    errMsgText += " be greater than zero";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                videoWriterParams_.ffmpeg.maxQueueSize = ffmpegValue;
+            }
+        }
+
+        // Get pre-trigger recording values - optional
+        // -------------------------------------------
+        QVariantMap preTriggerMap = formatMap["preTrigger"].toMap();
+        if (!preTriggerMap.isEmpty())
+        {
+            // preTrigger enabled - optional
+            if (preTriggerMap.contains("enabled"))
+            {
+                if (!preTriggerMap["enabled"].canConvert<bool>())
+                {
+                    QString errMsgText("Logging Settings: preTrigger unable to convert");
+                    errMsgText += " enabled to bool";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                bool preTriggerValue = preTriggerMap["enabled"].toBool();
+                videoWriterParams_.preTrigger.enabled = preTriggerValue;
+            }
+
+            // preTrigger preTriggerSec - optional
+            if (preTriggerMap.contains("preTriggerSec"))
+            {
+                if (!preTriggerMap["preTriggerSec"].canConvert<double>())
+                {
+                    QString errMsgText("Logging Settings: preTrigger unable to convert");
+                    errMsgText += " preTriggerSec to double";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                double preTriggerValue = preTriggerMap["preTriggerSec"].toDouble();
+                if (preTriggerValue < 0.0)
+                {
+                    QString errMsgText("Logging Settings: preTrigger preTriggerSec");
+                    errMsgText += " must be greater than or equal to zero";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                videoWriterParams_.preTrigger.preTriggerSec = preTriggerValue;
+            }
+
+            // preTrigger postTriggerSec - optional
+            if (preTriggerMap.contains("postTriggerSec"))
+            {
+                if (!preTriggerMap["postTriggerSec"].canConvert<double>())
+                {
+                    QString errMsgText("Logging Settings: preTrigger unable to convert");
+                    errMsgText += " postTriggerSec to double";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                double preTriggerValue = preTriggerMap["postTriggerSec"].toDouble();
+                if (preTriggerValue < 0.0)
+                {
+                    QString errMsgText("Logging Settings: preTrigger postTriggerSec");
+                    errMsgText += " must be greater than or equal to zero";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                videoWriterParams_.preTrigger.postTriggerSec = preTriggerValue;
+            }
+
+            // preTrigger maxMemoryMB - optional
+            if (preTriggerMap.contains("maxMemoryMB"))
+            {
+                if (!preTriggerMap["maxMemoryMB"].canConvert<unsigned int>())
+                {
+                    QString errMsgText("Logging Settings: preTrigger unable to convert");
+                    errMsgText += " maxMemoryMB to unsigned int";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                unsigned int preTriggerValue = preTriggerMap["maxMemoryMB"].toUInt();
+                if ((preTriggerValue == 0) || (preTriggerValue > PreTriggerBuffer::MAX_ALLOWED_MEMORY_MB))
+                {
+                    QString errMsgText("Logging Settings: preTrigger maxMemoryMB");
+                    errMsgText += " must be greater than zero and at most 65536";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                videoWriterParams_.preTrigger.maxMemoryMB = preTriggerValue;
+            }
+
+            // preTrigger timerIntervalSec - optional
+            if (preTriggerMap.contains("timerIntervalSec"))
+            {
+                if (!preTriggerMap["timerIntervalSec"].canConvert<double>())
+                {
+                    QString errMsgText("Logging Settings: preTrigger unable to convert");
+                    errMsgText += " timerIntervalSec to double";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                double preTriggerValue = preTriggerMap["timerIntervalSec"].toDouble();
+                if (preTriggerValue < 0.0)
+                {
+                    QString errMsgText("Logging Settings: preTrigger timerIntervalSec");
+                    errMsgText += " must be greater than or equal to zero";
+                    if (showErrorDlg)
+                    {
+                        QMessageBox::critical(this,errMsgTitle,errMsgText);
+                    }
+                    rtnStatus.success = false;
+                    rtnStatus.message = errMsgText;
+                    return rtnStatus;
+                }
+                videoWriterParams_.preTrigger.timerIntervalSec = preTriggerValue;
+            }
+        }
+
         rtnStatus.success = true;
         rtnStatus.message = QString("");
         return rtnStatus;
@@ -7085,26 +8369,6 @@ namespace bias
     }
 
 
-    cv::Mat CameraWindow::calcHistogram(cv::Mat mat)
-    {
-        // -----------------------------------------------------------------------------
-        // TO DO  - only for 8bit black and white cameras needs modification for color.
-        // -----------------------------------------------------------------------------
-        int channels[] = {0};
-        int histSize[] = {256};
-        float dimRange[] = {0,256}; // need to be set based on image type.
-        const float *ranges[] = {dimRange};
-        double minVal = 0;
-        double maxVal = 0;
-        double histImageMaxY = DEFAULT_HISTOGRAM_IMAGE_SIZE.height() - 1.0;
-
-        cv::Mat hist;
-        cv::calcHist(&mat, 1, channels, cv::Mat(), hist, 1, histSize, ranges, true, false);
-        minMaxLoc(hist,&minVal,&maxVal,NULL,NULL);
-        hist = hist*(float(histImageMaxY)/float(maxVal));
-        return hist;
-    }
-
     RtnStatus CameraWindow::onError(QString message, QString title, bool showErrorDlg)
     { 
         RtnStatus rtnStatus;
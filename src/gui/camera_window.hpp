@@ -17,6 +17,8 @@
 #include "auto_naming_options.hpp"
 #include "rtn_status.hpp"
 #include "bias_plugin.hpp"
+#include "pipeline_stats.hpp"
+#include "camera_status.hpp"
 
 
 // External lib forward declarations
@@ -35,6 +37,7 @@ namespace bias
     class ImageGrabber;
     class ImageDispatcher;
     class ImageLogger; 
+    class VideoWriter;
     class PluginHandler;
     class TimerSettingsDialog;
     class LoggingSettingsDialog;
@@ -42,8 +45,9 @@ namespace bias
     class Format7SettingsDialog;
     class AlignmentSettingsDialog;
     class ExtCtlHttpServer;
+    class ImagePool;
     template <class T> class Lockable;
-    template <class T> class LockableQueue;
+    template <class T> class SpscRingBuffer;
 
     struct CmdLineParams
     {
@@ -64,6 +68,7 @@ namespace bias
                     CmdLineParams params,
                     QWidget *parent=0
                     );
+            ~CameraWindow();
             RtnStatus connectCamera(bool showErrorDlg=true);
             RtnStatus disconnectCamera(bool showErrorDlg=true);
             RtnStatus startImageCapture(bool showErrorDlg=true);
@@ -88,6 +93,7 @@ namespace bias
 
             RtnStatus enableLogging(bool showErrorDlg=true);
             RtnStatus disableLogging(bool showErrorDlg=true);
+            RtnStatus triggerClip(bool showErrorDlg=true);
 
             RtnStatus saveConfiguration(
                     QString filename, 
@@ -135,8 +141,12 @@ namespace bias
             bool isPluginEnabled();
             double getTimeStamp();
             double getFramesPerSec();
+            QVariantMap getPipelineStats();
+            QString getPipelineStatsPrometheus();
+            QVariantMap getFrameSyncStats();
             unsigned long getFrameCount();
             float getFormat7PercentSpeed();
+            void publishStatus();
 
         signals:
 
@@ -168,6 +178,9 @@ namespace bias
             void imageCaptureError(unsigned int errorId, QString errorMsg);
             void imageLoggingError(unsigned int errorId, QString errorMsg);
 
+            // Pre-trigger recording requests from plugins and timer
+            void preTriggerRequested();
+
             // Display update and duration check timers
             void updateDisplayOnTimer();
             void checkDurationOnTimer();
@@ -253,6 +266,8 @@ namespace bias
             double imageDisplayFreq_;
             ImageRotationType imageRotation_;
             VideoFileFormat videoFileFormat_;
+            GrabMode grabMode_;
+            bool pipelineTrace_;
             unsigned long frameCount_;
             unsigned long captureDurationSec_;
             AutoNamingOptions autoNamingOptions_;
@@ -260,6 +275,7 @@ namespace bias
             QPointer<QLabel> statusLabelPtr_;
 
             QPixmap previewPixmapOriginal_;
+            float previewPixmapScale_;  // preview size relative to the camera image
             QPixmap pluginPixmapOriginal_;
             QPixmap histogramPixmapOriginal_;
 
@@ -282,9 +298,12 @@ namespace bias
             QMap<QString, QPointer<QAction>> pluginActionMap_;
 
             std::shared_ptr<Lockable<Camera>> cameraPtr_;
-            std::shared_ptr<LockableQueue<StampedImage>> newImageQueuePtr_;
-            std::shared_ptr<LockableQueue<StampedImage>> logImageQueuePtr_;
-            std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr_;
+            std::shared_ptr<ImagePool> imagePoolPtr_;
+            std::shared_ptr<SpscRingBuffer<StampedImage>> newImageQueuePtr_;
+            std::shared_ptr<SpscRingBuffer<StampedImage>> logImageQueuePtr_;
+            std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr_;
+            PipelineStatsPtr pipelineStatsPtr_;
+            CameraStatusPublisherPtr statusPublisherPtr_;
 
             QPointer<QThreadPool> threadPoolPtr_;
 
@@ -295,6 +314,7 @@ namespace bias
 
             QPointer<QTimer> imageDisplayTimerPtr_;
             QPointer<QTimer> captureDurationTimerPtr_;
+            QPointer<QTimer> preTriggerTimerPtr_;
             QDateTime captureStartDateTime_;
             QDateTime captureStopDateTime_;
 
@@ -324,6 +344,7 @@ namespace bias
             void setDefaultFileDirs();
             void setupImageDisplayTimer();
             void setupCaptureDurationTimer();
+            void setupPreTriggerTimer();
             void updateWindowTitle();
             
             QPointer<BiasPlugin> getCurrentPlugin();
@@ -370,7 +391,8 @@ namespace bias
                     bool flipAndRotate=true,
                     bool addFrameCount=true,
                     bool addRoiBoundary=true,
-                    bool addAlignmentObjs=true
+                    bool addAlignmentObjs=true,
+                    float pixmapScale=1.0
                     );
             void updateAllImageLabels();
 
@@ -380,7 +402,8 @@ namespace bias
                     bool flipAndRotate=true,
                     bool addFrameCount=true,
                     bool addRoiBoundary=true,
-                    bool addAlignmentObjs=true
+                    bool addAlignmentObjs=true,
+                    float pixmapScale=1.0
                     );
 
             void resizeAllImageLabels();
@@ -394,6 +417,12 @@ namespace bias
             void setCaptureTimeLabel(double timeStamp);
             void setServerPortText();
 
+            std::shared_ptr<VideoWriter> createVideoWriter(
+                    VideoFileFormat videoFileFormat,
+                    VideoWriterParams videoWriterParams,
+                    QString videoFileFullPath
+                    ) const;
+
             QString getConfigFileFullPath();
             QString getAutoNamingString();
 
@@ -422,8 +451,8 @@ namespace bias
             RtnStatus setServerFromMap(QVariantMap serverMap, bool showErrorDlg);
             RtnStatus setConfigFileFromMap(QVariantMap configFileMap, bool showErrorDlg);
             RtnStatus setPluginFromMap(QVariantMap pluginMap, bool showErrorDlg);
+            RtnStatus setThreadAffinityFromMap(QVariantMap threadAffinityMap, bool showErrorDlg);
 
-            cv::Mat calcHistogram(cv::Mat mat);
             RtnStatus onError(QString message, QString title, bool showErrorDlg);
 
     }; // class CameraWindow
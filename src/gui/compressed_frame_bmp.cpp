@@ -0,0 +1,229 @@
+#include "compressed_frame_bmp.hpp"
+#include "basic_types.hpp"
+#include "exception.hpp"
+#include <opencv2/highgui/highgui.hpp>
+#include <algorithm>
+
+namespace bias
+{
+    // Constants
+    // -------------------------------------------------------------------------------------------------------
+    const QString CompressedFrame_bmp::DEFAULT_FILENAME = "default_filename.bmp";
+    const ImageFileFormat_bmp CompressedFrame_bmp::DEFAULT_IMAGE_FORMAT = IMAGE_FILE_FORMAT_BMP;
+    const unsigned int CompressedFrame_bmp::DEFAULT_PNG_COMPRESSION_LEVEL = 1;
+    const unsigned int CompressedFrame_bmp::MAX_PNG_COMPRESSION_LEVEL = 9;
+
+    // libtiff's COMPRESSION_NONE
+    const int TIFF_COMPRESSION_NONE = 1;
+
+    // Public methods
+    // -------------------------------------------------------------------------------------------------------
+
+    CompressedFrame_bmp::CompressedFrame_bmp()
+    {
+        fileName_ = DEFAULT_FILENAME;
+        imageFormat_ = DEFAULT_IMAGE_FORMAT;
+        pngCompressionLevel_ = DEFAULT_PNG_COMPRESSION_LEVEL;
+        haveFileName_= false;
+        haveStampedImg_ = false;
+        sequenceNumber_ = 0;
+    }
+
+
+    CompressedFrame_bmp::CompressedFrame_bmp(QString fileName, StampedImage stampedImg)
+        : CompressedFrame_bmp()
+    {
+        setFileName(fileName);
+        setStampedImage(stampedImg);
+    }
+
+
+    bool CompressedFrame_bmp::haveFileName() const
+    {
+        return haveFileName_;
+    }
+
+
+    bool CompressedFrame_bmp::haveStampedImage() const
+    {
+        return haveStampedImg_;
+    }
+
+
+    void CompressedFrame_bmp::setStampedImage(StampedImage stampedImg)
+    {
+        stampedImg_= stampedImg;
+        haveStampedImg_ = true;
+    }
+
+
+    StampedImage CompressedFrame_bmp::getStampedImage() const
+    {
+        return stampedImg_;
+    }
+
+
+    unsigned long CompressedFrame_bmp::getFrameCount() const
+    {
+        if (haveStampedImg_)
+        {
+            return stampedImg_.frameCount;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+
+    PipelineStamps &CompressedFrame_bmp::getPipelineStamps()
+    {
+        return stampedImg_.stamps;
+    }
+
+
+    void CompressedFrame_bmp::setSequenceNumber(size_t sequence)
+    {
+        sequenceNumber_ = sequence;
+    }
+
+
+    size_t CompressedFrame_bmp::getSequenceNumber() const
+    {
+        return sequenceNumber_;
+    }
+
+
+    void CompressedFrame_bmp::setFileName(QString fileName)
+    {
+        fileName_ = fileName;
+        haveFileName_ = true;
+    }
+
+
+    QString CompressedFrame_bmp::getFileName() const
+    {
+        return fileName_;
+    }
+
+
+    void CompressedFrame_bmp::setImageFormat(ImageFileFormat_bmp format)
+    {
+        imageFormat_ = format;
+    }
+
+
+    ImageFileFormat_bmp CompressedFrame_bmp::getImageFormat() const
+    {
+        return imageFormat_;
+    }
+
+
+    void CompressedFrame_bmp::setPngCompressionLevel(unsigned int level)
+    {
+        pngCompressionLevel_ = std::min(level, MAX_PNG_COMPRESSION_LEVEL);
+    }
+
+
+    unsigned int CompressedFrame_bmp::getPngCompressionLevel() const
+    {
+        return pngCompressionLevel_;
+    }
+
+
+    void CompressedFrame_bmp::write()
+    {
+        std::vector<int> params;
+        switch (imageFormat_)
+        {
+            case IMAGE_FILE_FORMAT_PNG:
+                params.push_back(cv::IMWRITE_PNG_COMPRESSION);
+                params.push_back(int(pngCompressionLevel_));
+                break;
+
+            case IMAGE_FILE_FORMAT_TIFF:
+                params.push_back(cv::IMWRITE_TIFF_COMPRESSION);
+                params.push_back(TIFF_COMPRESSION_NONE);
+                break;
+
+            default:
+                break;
+        }
+
+        bool ok = false;
+        try
+        {
+            ok = cv::imwrite(fileName_.toStdString(), stampedImg_.image, params);
+        }
+        catch (cv::Exception &exc)
+        {
+            unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
+            std::string errorMsg("adding frame failed - ");
+            errorMsg += exc.what();
+            throw RuntimeError(errorId, errorMsg);
+        }
+        if (!ok)
+        {
+            unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
+            std::string errorMsg("adding frame failed - unable to write ");
+            errorMsg += fileName_.toStdString();
+            throw RuntimeError(errorId, errorMsg);
+        }
+    }
+
+
+    QString CompressedFrame_bmp::getFileExtension(ImageFileFormat_bmp format)
+    {
+        switch (format)
+        {
+            case IMAGE_FILE_FORMAT_PNG:
+                return QString(".png");
+
+            case IMAGE_FILE_FORMAT_TIFF:
+                return QString(".tif");
+
+            default:
+                return QString(".bmp");
+        }
+    }
+
+
+    QString CompressedFrame_bmp::getFormatString(ImageFileFormat_bmp format)
+    {
+        switch (format)
+        {
+            case IMAGE_FILE_FORMAT_PNG:
+                return QString("png");
+
+            case IMAGE_FILE_FORMAT_TIFF:
+                return QString("tiff");
+
+            default:
+                return QString("bmp");
+        }
+    }
+
+
+    bool CompressedFrame_bmp::getFormatFromString(QString formatString, ImageFileFormat_bmp &format)
+    {
+        QString lower = formatString.trimmed().toLower();
+        if (lower == QString("bmp"))
+        {
+            format = IMAGE_FILE_FORMAT_BMP;
+        }
+        else if (lower == QString("png"))
+        {
+            format = IMAGE_FILE_FORMAT_PNG;
+        }
+        else if ((lower == QString("tiff")) || (lower == QString("tif")))
+        {
+            format = IMAGE_FILE_FORMAT_TIFF;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+} // namespace bias
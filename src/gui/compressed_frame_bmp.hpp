@@ -0,0 +1,84 @@
+#ifndef BIAS_COMPRESSED_FRAME_BMP_HPP
+#define BIAS_COMPRESSED_FRAME_BMP_HPP
+#include <opencv2/core/core.hpp>
+#include <QString>
+#include <memory>
+#include <vector>
+#include "stamped_image.hpp"
+#include "lockable.hpp"
+
+namespace bias
+{
+
+    enum ImageFileFormat_bmp
+    {
+        IMAGE_FILE_FORMAT_BMP=0,
+        IMAGE_FILE_FORMAT_PNG,
+        IMAGE_FILE_FORMAT_TIFF,
+    };
+
+
+    // A frame of an image sequence - written to its own image file (bmp, png or
+    // uncompressed tiff) by one of the image sequence writer's compressors.
+    class CompressedFrame_bmp
+    {
+
+        public:
+
+            CompressedFrame_bmp();
+            CompressedFrame_bmp(QString fileName, StampedImage stampedImg);
+
+            bool haveFileName() const;
+            bool haveStampedImage() const;
+
+            void setStampedImage(StampedImage stampedImg);
+            StampedImage getStampedImage() const;
+            unsigned long getFrameCount() const;
+            PipelineStamps &getPipelineStamps();
+
+            void setSequenceNumber(size_t sequence);
+            size_t getSequenceNumber() const;
+
+            void setFileName(QString fileName);
+            QString getFileName() const;
+
+            void setImageFormat(ImageFileFormat_bmp format);
+            ImageFileFormat_bmp getImageFormat() const;
+
+            void setPngCompressionLevel(unsigned int level);
+            unsigned int getPngCompressionLevel() const;
+
+            void write();
+
+            static QString getFileExtension(ImageFileFormat_bmp format);
+            static QString getFormatString(ImageFileFormat_bmp format);
+            static bool getFormatFromString(QString formatString, ImageFileFormat_bmp &format);
+
+            static const QString DEFAULT_FILENAME;
+            static const ImageFileFormat_bmp DEFAULT_IMAGE_FORMAT;
+            static const unsigned int DEFAULT_PNG_COMPRESSION_LEVEL;
+            static const unsigned int MAX_PNG_COMPRESSION_LEVEL;
+
+        protected:
+
+            bool haveFileName_;
+            bool haveStampedImg_;
+
+            QString fileName_;
+            ImageFileFormat_bmp imageFormat_;
+            unsigned int pngCompressionLevel_;
+            size_t sequenceNumber_;
+
+            StampedImage stampedImg_;
+
+    };
+
+    typedef LockableQueue<CompressedFrame_bmp> CompressedFrameQueue_bmp;
+    typedef std::shared_ptr<CompressedFrameQueue_bmp> CompressedFrameQueuePtr_bmp;
+
+    typedef ReorderRingBuffer<CompressedFrame_bmp> CompressedFrameRing_bmp;
+    typedef std::shared_ptr<CompressedFrameRing_bmp> CompressedFrameRingPtr_bmp;
+
+}
+
+#endif
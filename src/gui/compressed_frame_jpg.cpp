@@ -23,6 +23,7 @@ namespace bias
         haveFileName_= false;
         haveStampedImg_ = false;
         haveEncoding_ = false;
+        sequenceNumber_ = 0;
     }
 
 
@@ -89,6 +90,24 @@ namespace bias
         }
     } 
 
+    void CompressedFrame_jpg::setSequenceNumber(size_t sequence)
+    {
+        sequenceNumber_ = sequence;
+    }
+
+
+    PipelineStamps &CompressedFrame_jpg::getPipelineStamps()
+    {
+        return stampedImg_.stamps;
+    }
+
+
+    size_t CompressedFrame_jpg::getSequenceNumber() const
+    {
+        return sequenceNumber_;
+    }
+
+
     double CompressedFrame_jpg::getTimeStamp() const
     {
         if (haveStampedImg_)
@@ -183,34 +202,17 @@ namespace bias
         haveEncoding_ = true;
     }
 
-    // Compressed frame comparison operator
-    // ----------------------------------------------------------------------------------------
-    bool CompressedFrameCmp_jpg::operator() (
-            const CompressedFrame_jpg &cmpFrame0,
-            const CompressedFrame_jpg &cmpFrame1
-            ) const
+
+    void CompressedFrame_jpg::write(Encoder_jpg &encoder)
     {
-        bool haveImage0 = cmpFrame0.haveStampedImage();
-        bool haveImage1 = cmpFrame1.haveStampedImage();
+        encoder.write(stampedImg_.image, quality_, fileName_.toStdString());
+    }
 
-        if ((haveImage0 == false) && (haveImage1 == false))
-        {
-            return false;
-        }
-        else if ((haveImage0 == false) && (haveImage1 == true))
-        {
-            return false;
-        }
-        else if ((haveImage0 == true) && (haveImage1 == false))
-        {
-            return true;
-        }
-        else
-        {
-            unsigned long frameCount0 = cmpFrame0.getFrameCount();
-            unsigned long frameCount1 = cmpFrame1.getFrameCount();
-            return (frameCount0 < frameCount1);
-        }
+
+    void CompressedFrame_jpg::encode(Encoder_jpg &encoder)
+    {
+        encoder.encode(stampedImg_.image, quality_, encodedJpgBuffer_);
+        haveEncoding_ = true;
     }
 
 } // namespace bias
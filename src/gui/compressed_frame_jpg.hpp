@@ -6,6 +6,7 @@
 #include <vector>
 #include "stamped_image.hpp"
 #include "lockable.hpp"
+#include "encoder_jpg.hpp"
 
 
 
@@ -29,8 +30,12 @@ namespace bias
             void setStampedImage(StampedImage stampedImg);
             StampedImage getStampedImage() const;
             unsigned long getFrameCount() const;
+            PipelineStamps &getPipelineStamps();
             double getTimeStamp() const;
 
+            void setSequenceNumber(size_t sequence);
+            size_t getSequenceNumber() const;
+
             void setFileName(QString fileName);
             QString getFileName() const;
 
@@ -46,6 +51,10 @@ namespace bias
             void write();
             void encode();
 
+            // As above but using a compressor thread's persistent encoder
+            void write(Encoder_jpg &encoder);
+            void encode(Encoder_jpg &encoder);
+
             static const QString DEFAULT_FILENAME;
             static const unsigned int DEFAULT_QUALITY;
             static const bool DEFAULT_MJPG_FLAG;
@@ -59,28 +68,22 @@ namespace bias
             QString fileName_;
             unsigned int quality_;
             bool mjpgFlag_;
+            size_t sequenceNumber_;
 
             StampedImage stampedImg_;;
             std::vector<uchar> encodedJpgBuffer_;
 
     };
 
-    class CompressedFrameCmp_jpg 
-        : public std::binary_function<CompressedFrame_jpg, CompressedFrame_jpg, bool>
-    {
-        // Comparison object for Compressed frames
-        public:
-            bool operator() (
-                    const CompressedFrame_jpg &cmpFrame0,
-                    const CompressedFrame_jpg &cmpFrame1
-                    ) const;
-    };
-
     typedef LockableQueue<CompressedFrame_jpg> CompressedFrameQueue_jpg;
     typedef std::shared_ptr<CompressedFrameQueue_jpg> CompressedFrameQueuePtr_jpg;
 
-    typedef LockableSet<CompressedFrame_jpg, CompressedFrameCmp_jpg> CompressedFrameSet_jpg;
-    typedef std::shared_ptr<CompressedFrameSet_jpg> CompressedFrameSetPtr_jpg;
+    typedef ReorderRingBuffer<CompressedFrame_jpg> CompressedFrameRing_jpg;
+    typedef std::shared_ptr<CompressedFrameRing_jpg> CompressedFrameRingPtr_jpg;
+
+    // Encoded buffers handed back by the writer for reuse by the compressors
+    typedef LockableQueue<std::vector<uchar>> EncodedBufferQueue_jpg;
+    typedef std::shared_ptr<EncodedBufferQueue_jpg> EncodedBufferQueuePtr_jpg;
 
 }
 
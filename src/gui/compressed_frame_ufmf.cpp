@@ -2,7 +2,8 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <algorithm>
 #include <iostream>
-#include <QThread>
+#include <cstring>
+#include "simd_utils.hpp"
 
 namespace bias
 {
@@ -10,6 +11,7 @@ namespace bias
     // ------------------------------------------------------------------------------
     const uchar CompressedFrame_ufmf::BACKGROUND_MEMBER_VALUE = 255; 
     const uchar CompressedFrame_ufmf::FOREGROUND_MEMBER_VALUE = 0;
+    const uchar CompressedFrame_ufmf::WRITTEN_MEMBER_VALUE = 128;
     const unsigned int CompressedFrame_ufmf::DEFAULT_BOX_LENGTH = 30; 
     const double CompressedFrame_ufmf::DEFAULT_FG_MAX_FRAC_COMPRESS = 0.2;
 
@@ -35,9 +37,11 @@ namespace bias
         isCompressed_ = false;
         ready_ = false;
         numPix_ = 0;
+        elemSize_ = 0;
         numForeground_ = 0;
         numPixWritten_ = 0;
         numConnectedComp_ = 0;
+        sequenceNumber_ = 0;
         boxLength_ = boxLength;
         boxArea_ = boxLength*boxLength;
         fgMaxFracCompress_ = fgMaxFracCompress;
@@ -82,12 +86,30 @@ namespace bias
     }
 
 
+    PipelineStamps &CompressedFrame_ufmf::getPipelineStamps()
+    {
+        return stampedImg_.stamps;
+    }
+
+
     unsigned int CompressedFrame_ufmf::getNumConnectedComp() const
     {
         return numConnectedComp_;
     }
 
 
+    void CompressedFrame_ufmf::setSequenceNumber(size_t sequence)
+    {
+        sequenceNumber_ = sequence;
+    }
+
+
+    size_t CompressedFrame_ufmf::getSequenceNumber() const
+    {
+        return sequenceNumber_;
+    }
+
+
     void CompressedFrame_ufmf::dilateEnabled(bool value)
     {
         dilateEnabled_ = true;
@@ -154,7 +176,7 @@ namespace bias
     }
 
 
-    void CompressedFrame_ufmf::compress()
+    void CompressedFrame_ufmf::compress(MembershipKernel_ufmf &membershipKernel)
     {
         // ---------------------------------------------------------------------
         // NOTE, probably should raise an exception here
@@ -165,27 +187,28 @@ namespace bias
         unsigned int numRow = (unsigned int) (stampedImg_.image.rows);
         unsigned int numCol = (unsigned int) (stampedImg_.image.cols);
         unsigned int numPix = numRow*numCol;
+        unsigned int elemSize = (unsigned int) (stampedImg_.image.elemSize());
 
         // Allocate memory for compressed frames if required and set buffer values
-        if (numPix_ != numPix) 
+        if ((numPix_ != numPix) || (elemSize_ != elemSize))
         {
             numPix_ = numPix;
+            elemSize_ = elemSize;
             allocateBuffers();
         }
-        resetBuffers();
 
         unsigned int fgMaxNumCompress = (unsigned int)(double(numPix)*fgMaxFracCompress_);
 
         // Get background/foreground membership, 255=background, 0=foreground
-        cv::inRange(stampedImg_.image, bgLowerBound_, bgUpperBound_, membershipImage_);
-        if (dilateEnabled_)
-        {
-            cv::Size structElemSize = cv::Size(2*dilateWindowSize_+1,2*dilateWindowSize_+1);
-            cv::Mat structElem = cv::getStructuringElement(cv::MORPH_RECT,structElemSize,cv::Point(-1,-1));
-            cv::erode(membershipImage_, membershipImage_, structElem, cv::Point(-1,-1),1);
-        }
-
-        numForeground_ = numPix - cv::countNonZero(membershipImage_);
+        // Threshold, erode and count in a single pass over the image.
+        unsigned int erodeRadius = dilateEnabled_ ? dilateWindowSize_ : 0;
+        numForeground_ = membershipKernel.compute(
+                stampedImg_.image, 
+                bgLowerBound_, 
+                bgUpperBound_, 
+                erodeRadius, 
+                membershipImage_
+                );
         numConnectedComp_ = 0;
         numPixWritten_ = 0;
 
@@ -213,15 +236,11 @@ namespace bias
         (*writeHgtBufPtr_)[0] = numRow;
         (*writeWdtBufPtr_)[0] = numCol;
 
-        unsigned int pixCnt = 0;
+        uint8_t *imageDatPtr = imageDatBufPtr_ -> data();
+        unsigned int rowBytes = numCol*elemSize_;
         for (unsigned int row=0; row<numRow; row++)
         {
-            for (unsigned int col=0; col<numCol; col++)
-            {
-                (*imageDatBufPtr_)[pixCnt] = (uint8_t) stampedImg_.image.at<uchar>(row,col);
-                (*numWriteBufPtr_)[pixCnt] = 1;
-                pixCnt++;
-            }
+            std::memcpy(imageDatPtr + row*rowBytes, stampedImg_.image.ptr<uint8_t>(row), rowBytes);
         }
         numPixWritten_ = numRow*numCol; 
         numConnectedComp_ = 1;
@@ -232,103 +251,87 @@ namespace bias
 
     void CompressedFrame_ufmf::createCompressedFrame()
     { 
-        // Get pointer to current thread for yeilding computation
-        QThread *thisThread = QThread::currentThread();
-
-        // Get number of rows, cols and pixels from image
+        // Boxes are found in raster order. Each foreground pixel not already 
+        // covered by a box starts a new box of up to boxLength x boxLength pixels
+        // with its top left corner at the pixel. The box width is shortened if 
+        // its first row runs into a previously written pixel and the height is 
+        // shortened at the first subsequent row which does. Written pixels are 
+        // marked in the membership image, which is recomputed for every frame,
+        // so no additional buffers need to be cleared. Box pixels are copied 
+        // as raw bytes, elemSize_ per pixel, so 8 and 16-bit images are alike.
         unsigned int numRow = (unsigned int) (stampedImg_.image.rows);
         unsigned int numCol = (unsigned int) (stampedImg_.image.cols);
-        unsigned int numPix = numRow*numCol;
+
+        uint16_t *writeRowPtr = writeRowBufPtr_ -> data();
+        uint16_t *writeColPtr = writeColBufPtr_ -> data();
+        uint16_t *writeHgtPtr = writeHgtBufPtr_ -> data();
+        uint16_t *writeWdtPtr = writeWdtBufPtr_ -> data();
+        uint8_t  *imageDatPtr = imageDatBufPtr_ -> data();
 
         isCompressed_ = true;
         numPixWritten_ = 0;
         numConnectedComp_ = 0;
-        for (unsigned int i=0; i<numPix; i++) { (*numWriteBufPtr_)[i] = 0; }
 
         unsigned int imageDatInd = 0;
         for (unsigned int row=0; row<numRow; row++)
         {
-            for (unsigned int col=0; col<numCol; col++)
+            uint8_t *memberRowPtr = membershipImage_.ptr<uint8_t>(row);
+            unsigned int col = 0;
+
+            while (col < numCol)
             {
-                // Start new box if pixel if foreground or continue to next pixel
-                if (membershipImage_.at<uchar>(row,col) == BACKGROUND_MEMBER_VALUE) 
-                { 
-                    continue;
+                // Find start of next run of foreground pixels in this row
+                col += (unsigned int)(findFirstEqual(memberRowPtr + col, numCol - col, FOREGROUND_MEMBER_VALUE));
+                if (col >= numCol)
+                {
+                    break;
                 }
 
-                // store everything in box with corner at (row,col)
-                (*writeRowBufPtr_)[numConnectedComp_] = row;
-                (*writeColBufPtr_)[numConnectedComp_] = col;
-                (*writeHgtBufPtr_)[numConnectedComp_] = std::min(boxLength_, numRow-row);
-                (*writeWdtBufPtr_)[numConnectedComp_] = std::min(boxLength_, numCol-col);
+                unsigned int hgt = std::min(boxLength_, numRow - row);
+                unsigned int wdt = std::min(boxLength_, numCol - col);
 
-                // Loop through pixels to store
-                unsigned int rowPlusHeight = row + (*writeHgtBufPtr_)[numConnectedComp_];
-
-                for (unsigned int rowEnd=row; rowEnd < rowPlusHeight; rowEnd++)
+                for (unsigned int rowEnd=row; rowEnd < row + hgt; rowEnd++)
                 {
-                    
-                    bool stopEarly = false;
-                    unsigned int colEnd = col;
-                    unsigned int numWriteInd = rowEnd*numCol + col;
-                    unsigned int colPlusWidth = col + (*writeWdtBufPtr_)[numConnectedComp_];
-
-                    // Check if we've already written something in this column
-                    for (colEnd=col; colEnd < colPlusWidth; colEnd++)
-                    {
-                        if ((*numWriteBufPtr_)[numWriteInd] > 0)
-                        {
-                            stopEarly = true;
-                            break;
-                        }
-                        numWriteInd += 1;
-                    }  // for (unsigned int colEnd 
-
-                    if (stopEarly) 
+                    // Check if we've already written something in this row of the box
+                    uint8_t *memberPtr = membershipImage_.ptr<uint8_t>(rowEnd) + col;
+                    unsigned int numFree = (unsigned int)(findFirstEqual(memberPtr, wdt, WRITTEN_MEMBER_VALUE));
+                    if (numFree < wdt)
                     {
                         if (rowEnd == row)
-                        { 
+                        {
                             // If this is the first row - shorten the width and write as usual
-                            (*writeWdtBufPtr_)[numConnectedComp_] = colEnd - col;
+                            wdt = numFree;
                         }
                         else
                         {
                             // Otherwise, shorten the height, and don't write any of this row
-                            (*writeHgtBufPtr_)[numConnectedComp_] = rowEnd - row;
+                            hgt = rowEnd - row;
                             break;
                         }
+                    }
+
+                    std::memcpy(
+                            imageDatPtr + imageDatInd, 
+                            stampedImg_.image.ptr<uint8_t>(rowEnd) + col*elemSize_, 
+                            wdt*elemSize_
+                            );
+                    std::memset(memberPtr, WRITTEN_MEMBER_VALUE, wdt);
+                    imageDatInd += wdt*elemSize_;
+                }
 
-                    } // if (stopEarly) 
-
-                    colPlusWidth = col + (*writeWdtBufPtr_)[numConnectedComp_];
-                    numWriteInd = rowEnd*numCol + col;
-
-                    for (colEnd=col; colEnd < colPlusWidth; colEnd++)
-                    {
-                        (*numWriteBufPtr_)[numWriteInd] += 1;
-                        numWriteInd += 1;
-
-                        (*imageDatBufPtr_)[imageDatInd] = (uint8_t) stampedImg_.image.at<uchar>(rowEnd,colEnd); 
-                        imageDatInd += 1;
-
-                        membershipImage_.at<uchar>(rowEnd,colEnd) = BACKGROUND_MEMBER_VALUE;
-
-                    } // for (unsigned int colEnd 
-
-
-                } // for (unsigned int rowEnd 
-
+                writeRowPtr[numConnectedComp_] = row;
+                writeColPtr[numConnectedComp_] = col;
+                writeHgtPtr[numConnectedComp_] = hgt;
+                writeWdtPtr[numConnectedComp_] = wdt;
                 numConnectedComp_++;
 
-                // Yeild to another thread - helps keep frame rate steady
-                thisThread -> yieldCurrentThread();
-
-            } // for (unsigned int col
-
+                // Pixels covered by the box's first row are now written
+                col += wdt;
+            } 
 
         } // for (unsigned int row
 
-        numPixWritten_ = imageDatInd;
+        numPixWritten_ = imageDatInd/elemSize_;
 
     } // CompressedFrame_ufmf::createCompressedFrame
 
@@ -341,61 +344,21 @@ namespace bias
 
     void CompressedFrame_ufmf::allocateBuffers()
     {
+        // Box buffers are sized for the worst case (one box per pixel). They are 
+        // completely rewritten up to numConnectedComp_/numPixWritten_ for each 
+        // frame so they don't need to be cleared.
         writeRowBufPtr_ = std::make_shared<std::vector<uint16_t>>();
         writeColBufPtr_ = std::make_shared<std::vector<uint16_t>>();
         writeHgtBufPtr_ = std::make_shared<std::vector<uint16_t>>();
         writeWdtBufPtr_ = std::make_shared<std::vector<uint16_t>>();
-        numWriteBufPtr_ = std::make_shared<std::vector<uint16_t>>();
         imageDatBufPtr_ = std::make_shared<std::vector<uint8_t>>();
 
         writeRowBufPtr_ -> resize(numPix_);
         writeColBufPtr_ -> resize(numPix_);
         writeHgtBufPtr_ -> resize(numPix_);
         writeWdtBufPtr_ -> resize(numPix_);
-        numWriteBufPtr_ -> resize(numPix_);
-        imageDatBufPtr_ -> resize(numPix_);
+        imageDatBufPtr_ -> resize(size_t(numPix_)*elemSize_);
     }
 
 
-    void CompressedFrame_ufmf::resetBuffers()
-    {
-        std::fill_n(writeRowBufPtr_ -> begin(), numPix_, 0); 
-        std::fill_n(writeColBufPtr_ -> begin(), numPix_, 0);
-        std::fill_n(writeHgtBufPtr_ -> begin(), numPix_, 0);
-        std::fill_n(writeWdtBufPtr_ -> begin(), numPix_, 0);
-        std::fill_n(numWriteBufPtr_ -> begin(), numPix_, 0);
-        std::fill_n(imageDatBufPtr_ -> begin(), numPix_, 0);
-    }
-
-
-    // Compressed frame comparison operator
-    // ----------------------------------------------------------------------------------------
-    bool CompressedFrameCmp_ufmf::operator() (
-            const CompressedFrame_ufmf &cmpFrame0,
-            const CompressedFrame_ufmf &cmpFrame1
-            ) const
-    {
-        bool haveData0 = cmpFrame0.haveData();
-        bool haveData1 = cmpFrame1.haveData();
-
-        if ((haveData0 == false) && (haveData1 == false))
-        {
-            return false;
-        }
-        else if ((haveData0 == false) && (haveData1 == true))
-        {
-            return false;
-        }
-        else if ((haveData0 == true) && (haveData1 == false))
-        {
-            return true;
-        }
-        else
-        {
-            unsigned long frameCount0 = cmpFrame0.getFrameCount();
-            unsigned long frameCount1 = cmpFrame1.getFrameCount();
-            return (frameCount0 < frameCount1);
-        }
-    }
-
 } // namespace bias
@@ -7,6 +7,7 @@
 #include <opencv2/core/core.hpp>
 #include "stamped_image.hpp"
 #include "lockable.hpp"
+#include "membership_kernel_ufmf.hpp"
 
 namespace bias
 {
@@ -32,14 +33,19 @@ namespace bias
                     unsigned long bgUpdateCount
                     );
 
-            void compress();
+            // The kernel holds scratch buffers - one per compressor thread
+            void compress(MembershipKernel_ufmf &membershipKernel);
 
             bool haveData() const;
             bool isReady() const;
             double getTimeStamp() const;
             unsigned long getFrameCount() const;
+            PipelineStamps &getPipelineStamps();
             unsigned int getNumConnectedComp() const;
 
+            void setSequenceNumber(size_t sequence);
+            size_t getSequenceNumber() const;
+
             void dilateEnabled(bool value);
             void setDilateWindowSize(unsigned int value);
 
@@ -51,6 +57,7 @@ namespace bias
 
             static const uchar BACKGROUND_MEMBER_VALUE;
             static const uchar FOREGROUND_MEMBER_VALUE;
+            static const uchar WRITTEN_MEMBER_VALUE;     // foreground already in a box
             static const unsigned int DEFAULT_BOX_LENGTH; 
             static const double DEFAULT_FG_MAX_FRAC_COMPRESS;
 
@@ -71,16 +78,17 @@ namespace bias
             StampedImage stampedImg_;     // Original image w/ framenumber and timestamp
 
             unsigned int numPix_;
+            unsigned int elemSize_;       // Bytes per pixel, 1 (mono8) or 2 (mono16)
             unsigned int numForeground_;  // Number of forground pixels
             unsigned int numPixWritten_;  // Number of pixels written
             unsigned long bgUpdateCount_; // Update count of background model used 
+            size_t sequenceNumber_;       // Position in writer's reorder ring
 
             std::shared_ptr<std::vector<uint16_t>> writeRowBufPtr_;  // Y mins
             std::shared_ptr<std::vector<uint16_t>> writeColBufPtr_;  // X mins
             std::shared_ptr<std::vector<uint16_t>> writeHgtBufPtr_;  // Heights
             std::shared_ptr<std::vector<uint16_t>> writeWdtBufPtr_;  // Widths
-            std::shared_ptr<std::vector<uint16_t>> numWriteBufPtr_;  // Number of times pixel written 
-            std::shared_ptr<std::vector<uint8_t>>  imageDatBufPtr_;  // Image data 
+            std::shared_ptr<std::vector<uint8_t>>  imageDatBufPtr_;  // Image data (raw bytes)
 
             unsigned int boxArea_;           // BoxLength*boxLength
             unsigned int boxLength_;         // Length of boxes or foreground pixels to store
@@ -92,30 +100,18 @@ namespace bias
 
 
             void allocateBuffers();          
-            void resetBuffers(); 
             void createUncompressedFrame();
             void createCompressedFrame();
                                       
     };
 
 
-    class CompressedFrameCmp_ufmf 
-        : public std::binary_function<CompressedFrame_ufmf, CompressedFrame_ufmf, bool>
-    {
-        // Comparison object for Compressed frames
-        public:
-            bool operator() (
-                    const CompressedFrame_ufmf &cmpFrame0,
-                    const CompressedFrame_ufmf &cmpFrame1
-                    ) const;
-    };
-
-    // Typedef for sets and queues of compressed frame objects
+    // Typedef for queues and reorder rings of compressed frame objects
     typedef LockableQueue<CompressedFrame_ufmf> CompressedFrameQueue_ufmf;
     typedef std::shared_ptr<CompressedFrameQueue_ufmf> CompressedFrameQueuePtr_ufmf;
 
-    typedef LockableSet<CompressedFrame_ufmf, CompressedFrameCmp_ufmf> CompressedFrameSet_ufmf;
-    typedef std::shared_ptr<CompressedFrameSet_ufmf> CompressedFrameSetPtr_ufmf;
+    typedef ReorderRingBuffer<CompressedFrame_ufmf> CompressedFrameRing_ufmf;
+    typedef std::shared_ptr<CompressedFrameRing_ufmf> CompressedFrameRingPtr_ufmf;
 
 } // namespace bias
 
@@ -0,0 +1,123 @@
+#include "compressor_bmp.hpp"
+#include "affinity.hpp"
+#include "exception.hpp"
+#include <iostream>
+#include <QThread>
+
+namespace bias
+{
+    Compressor_bmp::Compressor_bmp(QObject *parent) : QObject(parent)
+    { 
+        initialize(nullptr,nullptr,0);
+        ready_ = false;
+    }
+
+    Compressor_bmp::Compressor_bmp(
+            CompressedFrameQueuePtr_bmp framesToDoQueuePtr, 
+            CompressedFrameRingPtr_bmp framesFinishedRingPtr, 
+            unsigned int cameraNumber, 
+            QObject *parent
+            )  : QObject(parent)
+    {
+        initialize(framesToDoQueuePtr,framesFinishedRingPtr,cameraNumber);
+    }
+
+    
+    void Compressor_bmp::initialize(
+            CompressedFrameQueuePtr_bmp framesToDoQueuePtr, 
+            CompressedFrameRingPtr_bmp framesFinishedRingPtr, 
+            unsigned int cameraNumber
+            )
+    {
+        ready_ = false;
+        stopped_ = true;
+        framesToDoQueuePtr_ = framesToDoQueuePtr;
+        framesFinishedRingPtr_ = framesFinishedRingPtr;
+        if ((framesToDoQueuePtr_ != nullptr) && (framesFinishedRingPtr_ != nullptr))
+        {
+            ready_ = true;
+        }
+        cameraNumber_ = cameraNumber;
+    }
+
+   
+    void Compressor_bmp::stop()
+    {
+        stopped_ = true;
+    }
+
+
+    void Compressor_bmp::setPipelineStats(PipelineStatsPtr pipelineStatsPtr)
+    {
+        pipelineStatsPtr_ = pipelineStatsPtr;
+    }
+
+
+    void Compressor_bmp::run()
+    {
+        bool done = false;
+
+        CompressedFrame_bmp compressedFrame;
+
+        if (!ready_) 
+        { 
+            return; 
+        }
+
+        QThread *thisThread = QThread::currentThread();
+        thisThread -> setPriority(QThread::NormalPriority);
+        ThreadAffinityService::assignThreadAffinity(false,cameraNumber_);
+
+        acquireLock();
+        stopped_ = false;
+        releaseLock();
+
+        while (!done)
+        {
+            bool haveNewFrame = false;
+
+            // Get next frame from in waiting queue
+            framesToDoQueuePtr_ -> acquireLock();
+            framesToDoQueuePtr_ -> waitIfEmpty();
+            if (framesToDoQueuePtr_ -> empty())
+            {
+                haveNewFrame = false;
+            }
+            else
+            {
+                haveNewFrame = true;
+                compressedFrame = framesToDoQueuePtr_ -> front();
+                framesToDoQueuePtr_ -> pop();
+            }
+            framesToDoQueuePtr_ -> releaseLock();
+
+            // Check to see if stop has been called
+            acquireLock();
+            done = stopped_;
+            releaseLock();
+
+            if ((haveNewFrame) && (!done))
+            {
+                // Encode and write the image file
+                try
+                {
+                    compressedFrame.write();
+                    if (pipelineStatsPtr_)
+                    {
+                        pipelineStatsPtr_ -> recordStage(PIPELINE_STAGE_WRITTEN, compressedFrame.getPipelineStamps());
+                    }
+                }
+                catch (RuntimeError &runtimeError)
+                {
+                    emit imageLoggingError(runtimeError.id(), QString::fromStdString(runtimeError.what()));
+                }
+
+                // Nothing left for the writer to do - release the image and 
+                // signal completion through the frame's slot
+                size_t sequence = compressedFrame.getSequenceNumber();
+                compressedFrame.setStampedImage(StampedImage());
+                framesFinishedRingPtr_ -> markSkipped(sequence);
+            }
+        }
+    }
+} // namespace bias
@@ -0,0 +1,51 @@
+#ifndef BIAS_COMPRESSOR_BMP_HPP
+#define BIAS_COMPRESSOR_BMP_HPP
+
+#include <QObject>
+#include <QRunnable>
+#include <memory>
+#include "lockable.hpp"
+#include "compressed_frame_bmp.hpp"
+#include "pipeline_stats.hpp"
+
+namespace bias
+{
+    class Compressor_bmp : public QObject, public QRunnable, public Lockable<Empty>
+    {
+        Q_OBJECT
+
+        public:
+
+            Compressor_bmp(QObject *parent=0);
+            Compressor_bmp(
+                    CompressedFrameQueuePtr_bmp framesToDoQueuePtr, 
+                    CompressedFrameRingPtr_bmp framesFinishedRingPtr,
+                    unsigned int cameraNumber, 
+                    QObject *parent=0
+                    );
+
+            void stop();
+            void setPipelineStats(PipelineStatsPtr pipelineStatsPtr);
+
+        signals:
+            void imageLoggingError(unsigned int errorId, QString errorMsg);
+
+        private:
+
+            bool ready_;
+            bool stopped_;
+            unsigned int cameraNumber_;
+            CompressedFrameQueuePtr_bmp framesToDoQueuePtr_;
+            CompressedFrameRingPtr_bmp framesFinishedRingPtr_;
+            PipelineStatsPtr pipelineStatsPtr_;
+
+            void initialize(
+                    CompressedFrameQueuePtr_bmp framesToDoQueuePtr, 
+                    CompressedFrameRingPtr_bmp framesFinishedRingPtr, 
+                    unsigned int cameraNumber
+                    );
+            void run();
+    };
+
+}
+#endif
@@ -4,41 +4,38 @@
 #include <QThread>
 #include "basic_types.hpp"
 #include "video_writer_jpg.hpp"
+#include "exception.hpp"
 
 namespace bias
 {
     Compressor_jpg::Compressor_jpg(QObject *parent) : QObject(parent)
     { 
-        initialize(nullptr,nullptr,nullptr,0);
+        initialize(nullptr,nullptr,0);
         ready_ = false;
     }
 
     Compressor_jpg::Compressor_jpg(
             CompressedFrameQueuePtr_jpg framesToDoQueuePtr, 
-            CompressedFrameSetPtr_jpg framesFinishedSetPtr, 
-            std::shared_ptr<Lockable<std::list<unsigned long>>> framesSkippedIndexListPtr,
+            CompressedFrameRingPtr_jpg framesFinishedRingPtr, 
             unsigned int cameraNumber, 
             QObject *parent
             )  : QObject(parent)
     {
-        initialize(framesToDoQueuePtr,framesFinishedSetPtr,framesSkippedIndexListPtr,cameraNumber);
+        initialize(framesToDoQueuePtr,framesFinishedRingPtr,cameraNumber);
     }
 
     
     void Compressor_jpg::initialize(
             CompressedFrameQueuePtr_jpg framesToDoQueuePtr, 
-            CompressedFrameSetPtr_jpg framesFinishedSetPtr, 
-            std::shared_ptr<Lockable<std::list<unsigned long>>> framesSkippedIndexListPtr,
+            CompressedFrameRingPtr_jpg framesFinishedRingPtr, 
             unsigned int cameraNumber
             )
     {
         ready_ = false;
         stopped_ = true;
-        skipReported_ = false;
         framesToDoQueuePtr_ = framesToDoQueuePtr;
-        framesFinishedSetPtr_ = framesFinishedSetPtr;
-        framesSkippedIndexListPtr_ = framesSkippedIndexListPtr;
-        if (framesToDoQueuePtr_ != nullptr) 
+        framesFinishedRingPtr_ = framesFinishedRingPtr;
+        if ((framesToDoQueuePtr_ != nullptr) && (framesFinishedRingPtr_ != nullptr))
         {
             ready_ = true;
         }
@@ -52,6 +49,25 @@ namespace bias
     }
 
 
+    void Compressor_jpg::setPipelineStats(PipelineStatsPtr pipelineStatsPtr)
+    {
+        pipelineStatsPtr_ = pipelineStatsPtr;
+    }
+
+
+    void Compressor_jpg::setEncoderOptions(unsigned int chromaSubsampling, bool fastDct)
+    {
+        encoder_.setChromaSubsampling(chromaSubsampling);
+        encoder_.setFastDct(fastDct);
+    }
+
+
+    void Compressor_jpg::setSpareBufferQueue(EncodedBufferQueuePtr_jpg spareBuffersPtr)
+    {
+        spareBuffersPtr_ = spareBuffersPtr;
+    }
+
+
     void Compressor_jpg::run()
     {
         bool done = false;
@@ -72,8 +88,6 @@ namespace bias
         stopped_ = false;
         releaseLock();
 
-        unsigned int framesFinishedSetSize = framesFinishedSetPtr_ -> size();
-
         while (!done)
         {
             bool haveNewFrame = false;
@@ -104,31 +118,54 @@ namespace bias
                 bool mjpgFlag = compressedFrame.getMjpgFlag();
                 if (mjpgFlag)
                 {
-                    if (framesFinishedSetSize < VideoWriter_jpg::FRAMES_FINISHED_MAX_SET_SIZE)
+                    // Encode into a buffer the writer has finished with, if 
+                    // there is one, so its capacity is reused.
+                    if (spareBuffersPtr_ != nullptr)
                     {
-                        compressedFrame.encode();
-                        framesFinishedSetPtr_ -> acquireLock();
-                        framesFinishedSetPtr_ -> insert(compressedFrame);
-                        framesFinishedSetSize = framesFinishedSetPtr_ -> size();
-                        framesFinishedSetPtr_ -> releaseLock();
+                        spareBuffersPtr_ -> acquireLock();
+                        if (!(spareBuffersPtr_ -> empty()))
+                        {
+                            compressedFrame.getEncodedJpgBuffer().swap(spareBuffersPtr_ -> front());
+                            spareBuffersPtr_ -> pop();
+                        }
+                        spareBuffersPtr_ -> releaseLock();
                     }
-                    else
+
+                    // Encoded frame goes back to the writer in its (reserved) slot 
+                    // of the reorder ring
+                    size_t sequence = compressedFrame.getSequenceNumber();
+                    try
                     {
-                        framesSkippedIndexListPtr_ -> acquireLock(); 
-                        framesSkippedIndexListPtr_ -> push_back(compressedFrame.getFrameCount());
-                        framesSkippedIndexListPtr_ -> releaseLock();
-                        if (!skipReported_)
+                        compressedFrame.encode(encoder_);
+                        if (pipelineStatsPtr_)
                         {
-                            unsigned int errorId = ERROR_FRAMES_TODO_MAX_QUEUE_SIZE;
-                            QString errorMsg("jpg compressor frames finished set has exceeded the maximum allowed size");
-                            emit imageLoggingError(errorId, errorMsg);
-                            skipReported_ = true;
+                            pipelineStatsPtr_ -> recordStage(PIPELINE_STAGE_COMPRESSED, compressedFrame.getPipelineStamps());
                         }
+                        framesFinishedRingPtr_ -> publish(sequence, std::move(compressedFrame));
+                    }
+                    catch (RuntimeError &runtimeError)
+                    {
+                        framesFinishedRingPtr_ -> markSkipped(sequence);
+                        emit imageLoggingError(runtimeError.id(), QString::fromStdString(runtimeError.what()));
                     }
                 }
                 else
                 {
-                    compressedFrame.write();
+                    try
+                    {
+                        compressedFrame.write(encoder_);
+                        if (pipelineStatsPtr_)
+                        {
+                            pipelineStatsPtr_ -> recordStage(PIPELINE_STAGE_WRITTEN, compressedFrame.getPipelineStamps());
+                        }
+                    }
+                    catch (RuntimeError &runtimeError)
+                    {
+                        emit imageLoggingError(runtimeError.id(), QString::fromStdString(runtimeError.what()));
+                    }
+
+                    // Nothing left for the writer to do - just signal completion
+                    framesFinishedRingPtr_ -> markSkipped(compressedFrame.getSequenceNumber());
                 }
 
             }
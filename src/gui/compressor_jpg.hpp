@@ -6,6 +6,7 @@
 #include <memory>
 #include "lockable.hpp"
 #include "compressed_frame_jpg.hpp"
+#include "pipeline_stats.hpp"
 
 namespace bias
 {
@@ -18,13 +19,15 @@ namespace bias
             Compressor_jpg(QObject *parent=0);
             Compressor_jpg(
                     CompressedFrameQueuePtr_jpg framesToDoQueuePtr, 
-                    CompressedFrameSetPtr_jpg framesFinishedSetPtr,
-                    std::shared_ptr<Lockable<std::list<unsigned long>>> framesSkippedIndexListPtr,
+                    CompressedFrameRingPtr_jpg framesFinishedRingPtr,
                     unsigned int cameraNumber, 
                     QObject *parent=0
                     );
 
             void stop();
+            void setPipelineStats(PipelineStatsPtr pipelineStatsPtr);
+            void setEncoderOptions(unsigned int chromaSubsampling, bool fastDct);
+            void setSpareBufferQueue(EncodedBufferQueuePtr_jpg spareBuffersPtr);
 
         signals:
             void imageLoggingError(unsigned int errorId, QString errorMsg);
@@ -33,16 +36,16 @@ namespace bias
 
             bool ready_;
             bool stopped_;
-            bool skipReported_;
             unsigned int cameraNumber_;
             CompressedFrameQueuePtr_jpg framesToDoQueuePtr_;
-            CompressedFrameSetPtr_jpg framesFinishedSetPtr_;
-            std::shared_ptr<Lockable<std::list<unsigned long>>> framesSkippedIndexListPtr_;
+            CompressedFrameRingPtr_jpg framesFinishedRingPtr_;
+            PipelineStatsPtr pipelineStatsPtr_;
+            EncodedBufferQueuePtr_jpg spareBuffersPtr_;
+            Encoder_jpg encoder_;
 
             void initialize(
                     CompressedFrameQueuePtr_jpg framesToDoQueuePtr, 
-                    CompressedFrameSetPtr_jpg framesFinishedSetPtr, 
-                    std::shared_ptr<Lockable<std::list<unsigned long>>> framesSkippedIndexListPtr,
+                    CompressedFrameRingPtr_jpg framesFinishedRingPtr, 
                     unsigned int cameraNumber
                     );
             void run();
@@ -10,37 +10,33 @@ namespace bias
     Compressor_ufmf::Compressor_ufmf(QObject *parent)
         : QObject(parent)
     { 
-        initialize(nullptr,nullptr,nullptr,0);
+        initialize(nullptr,nullptr,0);
         ready_ = false;
     }
 
     Compressor_ufmf::Compressor_ufmf( 
             CompressedFrameQueuePtr_ufmf framesToDoQueuePtr, 
-            CompressedFrameSetPtr_ufmf framesFinishedSetPtr, 
-            std::shared_ptr<Lockable<std::list<unsigned long>>> framesSkippedIndexListPtr,
+            CompressedFrameRingPtr_ufmf framesFinishedRingPtr, 
             unsigned int cameraNumber,
             QObject *parent
             )  
         : QObject(parent)
     {
-        initialize(framesToDoQueuePtr,framesFinishedSetPtr,framesSkippedIndexListPtr,cameraNumber);
+        initialize(framesToDoQueuePtr,framesFinishedRingPtr,cameraNumber);
     }
 
     
     void Compressor_ufmf::initialize( 
             CompressedFrameQueuePtr_ufmf framesToDoQueuePtr, 
-            CompressedFrameSetPtr_ufmf framesFinishedSetPtr,
-            std::shared_ptr<Lockable<std::list<unsigned long>>> framesSkippedIndexListPtr,
+            CompressedFrameRingPtr_ufmf framesFinishedRingPtr,
             unsigned int cameraNumber
             )
     {
         ready_ = false;
         stopped_ = true;
-        skipReported_ = false;
         framesToDoQueuePtr_ = framesToDoQueuePtr;
-        framesFinishedSetPtr_ = framesFinishedSetPtr;
-        framesSkippedIndexListPtr_ = framesSkippedIndexListPtr;
-        if ((framesToDoQueuePtr_ != NULL) && (framesFinishedSetPtr_ != NULL))
+        framesFinishedRingPtr_ = framesFinishedRingPtr;
+        if ((framesToDoQueuePtr_ != NULL) && (framesFinishedRingPtr_ != NULL))
         {
             ready_ = true;
         }
@@ -54,6 +50,12 @@ namespace bias
     }
 
 
+    void Compressor_ufmf::setPipelineStats(PipelineStatsPtr pipelineStatsPtr)
+    {
+        pipelineStatsPtr_ = pipelineStatsPtr;
+    }
+
+
     void Compressor_ufmf::run()
     {
         bool done = false;
@@ -74,8 +76,6 @@ namespace bias
         stopped_ = false;
         releaseLock();
 
-        unsigned int framesFinishedSetSize = framesFinishedSetPtr_ -> size();
-
         while (!done)
         {
             bool haveNewFrame = false;
@@ -102,31 +102,16 @@ namespace bias
 
             if ((haveNewFrame) && (!done))
             {
-                // Compress the frame
-                compressedFrame.compress();
-
-                if (framesFinishedSetSize < VideoWriter_ufmf::FRAMES_FINISHED_MAX_SET_SIZE)
-                {
-                    // Put completed compressed frame into finished set
-                    framesFinishedSetPtr_ -> acquireLock();
-                    framesFinishedSetPtr_ -> insert(compressedFrame);
-                    framesFinishedSetSize = framesFinishedSetPtr_ -> size();
-                    framesFinishedSetPtr_ -> releaseLock();
-                }
-                else
+                // Compress the frame and hand it back to the writer in its slot
+                // of the reorder ring. The slot was reserved by the writer so it 
+                // is always free.
+                compressedFrame.compress(membershipKernel_);
+                if (pipelineStatsPtr_)
                 {
-                    // Finished frames set is full - skip
-                    framesSkippedIndexListPtr_ -> acquireLock();
-                    framesSkippedIndexListPtr_ -> push_back(compressedFrame.getFrameCount());
-                    framesSkippedIndexListPtr_ -> releaseLock();
-                    if (!skipReported_)
-                    {
-                        unsigned int errorId = ERROR_FRAMES_TODO_MAX_QUEUE_SIZE;
-                        QString errorMsg("ufmf compressor frames finished set has exceeded the maximum allowed size");
-                        emit imageLoggingError(errorId, errorMsg);
-                        skipReported_ = true;
-                    }
+                    pipelineStatsPtr_ -> recordStage(PIPELINE_STAGE_COMPRESSED, compressedFrame.getPipelineStamps());
                 }
+                size_t sequence = compressedFrame.getSequenceNumber();
+                framesFinishedRingPtr_ -> publish(sequence, std::move(compressedFrame));
 
             } // if (haveNewFrame) 
 
@@ -6,6 +6,7 @@
 #include <memory>
 #include "lockable.hpp"
 #include "compressed_frame_ufmf.hpp"
+#include "pipeline_stats.hpp"
 
 namespace bias
 {
@@ -20,13 +21,13 @@ namespace bias
 
             Compressor_ufmf(
                     CompressedFrameQueuePtr_ufmf framesToDoQueuePtr,
-                    CompressedFrameSetPtr_ufmf framesFinishedSetPtr,
-                    std::shared_ptr<Lockable<std::list<unsigned long>>> framesSkippedIndexListPtr,
+                    CompressedFrameRingPtr_ufmf framesFinishedRingPtr,
                     unsigned int cameraNumber,
                     QObject *parent=0
                     );
 
             void stop();
+            void setPipelineStats(PipelineStatsPtr pipelineStatsPtr);
 
 
         signals:
@@ -37,17 +38,16 @@ namespace bias
 
             bool ready_;
             bool stopped_;
-            bool skipReported_;
             unsigned int cameraNumber_;
 
             CompressedFrameQueuePtr_ufmf framesToDoQueuePtr_;
-            CompressedFrameSetPtr_ufmf framesFinishedSetPtr_;
-            std::shared_ptr<Lockable<std::list<unsigned long>>> framesSkippedIndexListPtr_;
+            CompressedFrameRingPtr_ufmf framesFinishedRingPtr_;
+            PipelineStatsPtr pipelineStatsPtr_;
+            MembershipKernel_ufmf membershipKernel_;
 
             void initialize(
                     CompressedFrameQueuePtr_ufmf framesToDoQueuePtr,
-                    CompressedFrameSetPtr_ufmf framesFinishedSetPtr,
-                    std::shared_ptr<Lockable<std::list<unsigned long>>> framesSkippedIndexListPtr,
+                    CompressedFrameRingPtr_ufmf framesFinishedRingPtr,
                     unsigned int cameraNumber
                     );
 
@@ -0,0 +1,591 @@
+#include "encoder_ffmpeg.hpp"
+#include "affinity.hpp"
+#include "basic_types.hpp"
+#include "exception.hpp"
+#include <QThread>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#ifdef WITH_FFMPEG
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+#endif
+
+namespace bias
+{
+    // Constants
+    // ----------------------------------------------------------------------------------
+    const int Encoder_ffmpeg::TIME_BASE_DEN = 1000000; // microseconds
+
+#ifdef WITH_FFMPEG
+    namespace
+    {
+        std::string avErrorString(int errnum)
+        {
+            char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+            av_strerror(errnum, buffer, sizeof(buffer));
+            return std::string(buffer);
+        }
+
+        std::string getEncoderName(QString codec)
+        {
+            if (codec == QString("h264"))
+            {
+                return std::string("libx264");
+            }
+            if (codec == QString("h265"))
+            {
+                return std::string("libx265");
+            }
+            return codec.toStdString();
+        }
+    }
+#endif
+
+
+    // Public methods
+    // ----------------------------------------------------------------------------------
+    Encoder_ffmpeg::Encoder_ffmpeg(unsigned int cameraNumber, QObject *parent) : QObject(parent)
+    {
+        cameraNumber_ = cameraNumber;
+        maxQueueSize_ = 0;
+        isOpen_ = false;
+        stopped_ = false;
+        done_ = false;
+        error_ = false;
+        numEncoded_ = 0;
+        bytesWritten_ = 0;
+        imageType_ = CV_8UC1;
+        firstTimeStamp_ = 0.0;
+        lastPts_ = -1;
+        formatCtx_ = nullptr;
+        codecCtx_ = nullptr;
+        stream_ = nullptr;
+        frame_ = nullptr;
+        packet_ = nullptr;
+        swsCtx_ = nullptr;
+        setAutoDelete(false);
+    }
+
+
+    Encoder_ffmpeg::~Encoder_ffmpeg()
+    {
+        freeOutput();
+    }
+
+
+    void Encoder_ffmpeg::open(
+            QString fileName,
+            VideoWriterParams_ffmpeg params,
+            StampedImage firstImage,
+            double frameRate
+            )
+    {
+#ifndef WITH_FFMPEG
+        unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
+        std::string errorMsg("video writer unable to open file:\n\n");
+        errorMsg += "bias was built without ffmpeg support (cmake option with_ffmpeg)";
+        throw RuntimeError(errorId, errorMsg);
+#else
+        unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
+        std::string errorMsg("video writer unable to open file:\n\n");
+
+        maxQueueSize_ = params.maxQueueSize;
+        imageType_ = firstImage.image.type();
+        size_ = firstImage.image.size();
+        firstTimeStamp_ = firstImage.timeStamp;
+        lastPts_ = -1;
+
+        bool isLossless = (params.codec == QString("ffv1"));
+
+        // Pick the codec's pixel format for the camera's image type
+        AVPixelFormat srcPixFmt = AV_PIX_FMT_NONE;
+        AVPixelFormat dstPixFmt = AV_PIX_FMT_NONE;
+        switch (imageType_)
+        {
+            case CV_8UC1:
+                srcPixFmt = AV_PIX_FMT_GRAY8;
+                dstPixFmt = isLossless ? AV_PIX_FMT_GRAY8 : AV_PIX_FMT_YUV420P;
+                break;
+
+            case CV_8UC3:
+                srcPixFmt = AV_PIX_FMT_BGR24;
+                dstPixFmt = isLossless ? AV_PIX_FMT_GBRP : AV_PIX_FMT_YUV420P;
+                break;
+
+            case CV_16UC1:
+                if (isLossless)
+                {
+                    srcPixFmt = AV_PIX_FMT_GRAY16;
+                    dstPixFmt = AV_PIX_FMT_GRAY16;
+                }
+                break;
+
+            default:
+                break;
+        }
+        if (dstPixFmt == AV_PIX_FMT_NONE)
+        {
+            errorMsg += "image type not supported by the ";
+            errorMsg += params.codec.toStdString() + " codec";
+            throw RuntimeError(errorId, errorMsg);
+        }
+        if ((dstPixFmt == AV_PIX_FMT_YUV420P) && ((size_.width%2 != 0) || (size_.height%2 != 0)))
+        {
+            errorMsg += "image width and height must be even for the ";
+            errorMsg += params.codec.toStdString() + " codec";
+            throw RuntimeError(errorId, errorMsg);
+        }
+
+        std::string fileNameStd = fileName.toStdString();
+        int rtn = avformat_alloc_output_context2(&formatCtx_, nullptr, "matroska", fileNameStd.c_str());
+        if ((rtn < 0) || (formatCtx_ == nullptr))
+        {
+            errorMsg += "unable to create matroska output - " + avErrorString(rtn);
+            throw RuntimeError(errorId, errorMsg);
+        }
+
+        std::string encoderName = getEncoderName(params.codec);
+        const AVCodec *codec = avcodec_find_encoder_by_name(encoderName.c_str());
+        if (codec == nullptr)
+        {
+            freeOutput();
+            errorMsg += "encoder " + encoderName + " not available in libavcodec";
+            throw RuntimeError(errorId, errorMsg);
+        }
+
+        stream_ = avformat_new_stream(formatCtx_, nullptr);
+        codecCtx_ = avcodec_alloc_context3(codec);
+        if ((stream_ == nullptr) || (codecCtx_ == nullptr))
+        {
+            freeOutput();
+            errorMsg += "unable to allocate encoder";
+            throw RuntimeError(errorId, errorMsg);
+        }
+
+        codecCtx_->width = size_.width;
+        codecCtx_->height = size_.height;
+        codecCtx_->pix_fmt = dstPixFmt;
+        if ((srcPixFmt == AV_PIX_FMT_GRAY8) && (dstPixFmt == AV_PIX_FMT_YUV420P))
+        {
+            // Mono8 values are copied unchanged into the luma plane, so tag the
+            // stream full range or players would clip them to 16-235.
+            codecCtx_->color_range = AVCOL_RANGE_JPEG;
+        }
+        codecCtx_->time_base = AVRational{1, TIME_BASE_DEN};
+        if (frameRate > 0.0)
+        {
+            codecCtx_->framerate = av_d2q(frameRate, 100000);
+        }
+        codecCtx_->thread_count = int(params.numberOfThreads); // 0 = one per core
+        codecCtx_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+        if (formatCtx_->oformat->flags & AVFMT_GLOBALHEADER)
+        {
+            codecCtx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+
+        AVDictionary *options = nullptr;
+        if (isLossless)
+        {
+            // Intra only, version 3 for multi-slice (threaded) coding
+            codecCtx_->gop_size = 1;
+            av_dict_set(&options, "level", "3", 0);
+            av_dict_set(&options, "slicecrc", "1", 0);
+        }
+        else
+        {
+            av_dict_set(&options, "crf", std::to_string(params.crf).c_str(), 0);
+            av_dict_set(&options, "preset", params.preset.toStdString().c_str(), 0);
+        }
+        rtn = avcodec_open2(codecCtx_, codec, &options);
+        av_dict_free(&options);
+        if (rtn < 0)
+        {
+            freeOutput();
+            errorMsg += "unable to open encoder " + encoderName + " - " + avErrorString(rtn);
+            throw RuntimeError(errorId, errorMsg);
+        }
+
+        rtn = avcodec_parameters_from_context(stream_->codecpar, codecCtx_);
+        stream_->time_base = codecCtx_->time_base;
+        if (rtn >= 0)
+        {
+            if (!(formatCtx_->oformat->flags & AVFMT_NOFILE))
+            {
+                rtn = avio_open(&formatCtx_->pb, fileNameStd.c_str(), AVIO_FLAG_WRITE);
+            }
+        }
+        if (rtn >= 0)
+        {
+            rtn = avformat_write_header(formatCtx_, nullptr);
+        }
+        if (rtn < 0)
+        {
+            freeOutput();
+            errorMsg += avErrorString(rtn);
+            throw RuntimeError(errorId, errorMsg);
+        }
+
+        frame_ = av_frame_alloc();
+        packet_ = av_packet_alloc();
+        if ((frame_ == nullptr) || (packet_ == nullptr))
+        {
+            freeOutput();
+            errorMsg += "unable to allocate frame";
+            throw RuntimeError(errorId, errorMsg);
+        }
+        frame_->format = dstPixFmt;
+        frame_->color_range = codecCtx_->color_range;
+        frame_->width = size_.width;
+        frame_->height = size_.height;
+        if (av_frame_get_buffer(frame_, 0) < 0)
+        {
+            freeOutput();
+            errorMsg += "unable to allocate frame buffer";
+            throw RuntimeError(errorId, errorMsg);
+        }
+
+        // Colour conversion - mono frames are copied straight into the luma plane
+        if ((srcPixFmt != dstPixFmt) && (srcPixFmt != AV_PIX_FMT_GRAY8))
+        {
+            swsCtx_ = sws_getContext(
+                    size_.width, size_.height, srcPixFmt,
+                    size_.width, size_.height, dstPixFmt,
+                    SWS_BILINEAR, nullptr, nullptr, nullptr
+                    );
+            if (swsCtx_ == nullptr)
+            {
+                freeOutput();
+                errorMsg += "unable to create colour converter";
+                throw RuntimeError(errorId, errorMsg);
+            }
+        }
+        isOpen_ = true;
+#endif
+    }
+
+
+    bool Encoder_ffmpeg::push(StampedImage stampedImg)
+    {
+        bool pushed = false;
+        acquireLock();
+        if ((!stopped_) && (queue_.size() < maxQueueSize_))
+        {
+            queue_.push_back(stampedImg);
+            notEmptyWaitCond_.wakeOne();
+            pushed = true;
+        }
+        releaseLock();
+        return pushed;
+    }
+
+
+    void Encoder_ffmpeg::stop()
+    {
+        acquireLock();
+        stopped_ = true;
+        notEmptyWaitCond_.wakeAll();
+        releaseLock();
+    }
+
+
+    void Encoder_ffmpeg::setPipelineStats(PipelineStatsPtr pipelineStatsPtr)
+    {
+        pipelineStatsPtr_ = pipelineStatsPtr;
+    }
+
+
+    bool Encoder_ffmpeg::waitForProgress(unsigned long timeoutMs)
+    {
+        acquireLock();
+        unsigned long numEncoded = numEncoded_;
+        if (!done_)
+        {
+            progressWaitCond_.wait(&mutex_, timeoutMs);
+        }
+        bool progress = (numEncoded_ != numEncoded) || done_;
+        releaseLock();
+        return progress;
+    }
+
+
+    bool Encoder_ffmpeg::isDone()
+    {
+        acquireLock();
+        bool done = done_;
+        releaseLock();
+        return done;
+    }
+
+
+    unsigned int Encoder_ffmpeg::numQueued()
+    {
+        acquireLock();
+        unsigned int num = (unsigned int)(queue_.size());
+        releaseLock();
+        return num;
+    }
+
+
+    unsigned long Encoder_ffmpeg::numEncoded()
+    {
+        acquireLock();
+        unsigned long num = numEncoded_;
+        releaseLock();
+        return num;
+    }
+
+
+    uint64_t Encoder_ffmpeg::bytesWritten()
+    {
+        acquireLock();
+        uint64_t num = bytesWritten_;
+        releaseLock();
+        return num;
+    }
+
+
+    // Protected methods
+    // ----------------------------------------------------------------------------------
+    void Encoder_ffmpeg::run()
+    {
+        QThread *thisThread = QThread::currentThread();
+        thisThread -> setPriority(QThread::NormalPriority);
+        ThreadAffinityService::assignThreadAffinity(false,cameraNumber_);
+
+        bool done = false;
+        while (!done)
+        {
+            StampedImage stampedImg;
+            bool haveNewFrame = false;
+
+            acquireLock();
+            while (queue_.empty() && !stopped_)
+            {
+                notEmptyWaitCond_.wait(&mutex_);
+            }
+            if (!queue_.empty())
+            {
+                stampedImg = queue_.front();
+                queue_.pop_front();
+                haveNewFrame = true;
+            }
+            else
+            {
+                done = true;
+            }
+            bool error = error_;
+            releaseLock();
+
+            if (haveNewFrame && isOpen_ && !error)
+            {
+                try
+                {
+                    encodeFrame(stampedImg);
+                    if (pipelineStatsPtr_)
+                    {
+                        pipelineStatsPtr_ -> recordStage(PIPELINE_STAGE_WRITTEN, stampedImg.stamps);
+                    }
+                }
+                catch (RuntimeError &runtimeError)
+                {
+                    // Frames still to come are dropped
+                    acquireLock();
+                    error_ = true;
+                    releaseLock();
+                    emit imageLoggingError(runtimeError.id(), QString::fromStdString(runtimeError.what()));
+                }
+            }
+
+            acquireLock();
+            if (haveNewFrame)
+            {
+                numEncoded_++;
+            }
+            progressWaitCond_.wakeAll();
+            releaseLock();
+        }
+
+        if (isOpen_)
+        {
+            try
+            {
+                finishOutput();
+            }
+            catch (RuntimeError &runtimeError)
+            {
+                emit imageLoggingError(runtimeError.id(), QString::fromStdString(runtimeError.what()));
+            }
+            freeOutput();
+        }
+
+        acquireLock();
+        done_ = true;
+        progressWaitCond_.wakeAll();
+        releaseLock();
+    }
+
+
+    void Encoder_ffmpeg::encodeFrame(const StampedImage &stampedImg)
+    {
+#ifdef WITH_FFMPEG
+        if ((stampedImg.image.type() != imageType_) || (stampedImg.image.size() != size_))
+        {
+            unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
+            std::string errorMsg("adding frame failed - image size or type changed during logging");
+            throw RuntimeError(errorId, errorMsg);
+        }
+
+        // Frames still held by the codec's threads mustn't be overwritten
+        if (av_frame_make_writable(frame_) < 0)
+        {
+            unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
+            std::string errorMsg("adding frame failed - unable to allocate frame buffer");
+            throw RuntimeError(errorId, errorMsg);
+        }
+        fillFrame(stampedImg.image);
+
+        // Presentation time from the camera time stamp - must be increasing
+        double dt = stampedImg.timeStamp - firstTimeStamp_;
+        int64_t pts = int64_t(std::llround(dt*TIME_BASE_DEN));
+        if (pts <= lastPts_)
+        {
+            pts = lastPts_ + 1;
+        }
+        frame_->pts = pts;
+        lastPts_ = pts;
+
+        sendFrame(frame_);
+#endif
+    }
+
+
+    void Encoder_ffmpeg::fillFrame(const cv::Mat &image)
+    {
+#ifdef WITH_FFMPEG
+        if (swsCtx_ != nullptr)
+        {
+            const uint8_t *srcData[1] = {image.data};
+            const int srcStride[1] = {int(image.step)};
+            sws_scale(swsCtx_, srcData, srcStride, 0, image.rows, frame_->data, frame_->linesize);
+            return;
+        }
+
+        // Gray, gray16 or the luma plane of yuv420p
+        size_t rowBytes = image.cols*image.elemSize();
+        for (int row=0; row<image.rows; row++)
+        {
+            std::memcpy(frame_->data[0] + row*frame_->linesize[0], image.ptr(row), rowBytes);
+        }
+        if (frame_->format == AV_PIX_FMT_YUV420P)
+        {
+            // Neutral chroma
+            for (int plane=1; plane<3; plane++)
+            {
+                std::memset(frame_->data[plane], 128, frame_->linesize[plane]*(image.rows/2));
+            }
+        }
+#endif
+    }
+
+
+    void Encoder_ffmpeg::sendFrame(AVFrame *frame)
+    {
+#ifdef WITH_FFMPEG
+        // A null frame flushes the encoder
+        int rtn = avcodec_send_frame(codecCtx_, frame);
+        while (rtn >= 0)
+        {
+            rtn = avcodec_receive_packet(codecCtx_, packet_);
+            if ((rtn == AVERROR(EAGAIN)) || (rtn == AVERROR_EOF))
+            {
+                return;
+            }
+            if (rtn < 0)
+            {
+                break;
+            }
+            av_packet_rescale_ts(packet_, codecCtx_->time_base, stream_->time_base);
+            packet_->stream_index = stream_->index;
+            uint64_t packetSize = uint64_t(packet_->size);
+            rtn = av_interleaved_write_frame(formatCtx_, packet_);
+            if (rtn >= 0)
+            {
+                acquireLock();
+                bytesWritten_ += packetSize;
+                releaseLock();
+            }
+        }
+        unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
+        std::string errorMsg("adding frame failed - ");
+        errorMsg += avErrorString(rtn);
+        throw RuntimeError(errorId, errorMsg);
+#endif
+    }
+
+
+    void Encoder_ffmpeg::finishOutput()
+    {
+#ifdef WITH_FFMPEG
+        bool error = false;
+        std::string errorMsg("unable to finish video file - ");
+        try
+        {
+            sendFrame(nullptr);
+        }
+        catch (RuntimeError &runtimeError)
+        {
+            error = true;
+            errorMsg += runtimeError.what();
+        }
+        int rtn = av_write_trailer(formatCtx_);
+        if ((rtn < 0) && !error)
+        {
+            error = true;
+            errorMsg += avErrorString(rtn);
+        }
+        if (!(formatCtx_->oformat->flags & AVFMT_NOFILE))
+        {
+            avio_closep(&formatCtx_->pb);
+        }
+        if (error)
+        {
+            throw RuntimeError(ERROR_VIDEO_WRITER_FINISH, errorMsg);
+        }
+#endif
+    }
+
+
+    void Encoder_ffmpeg::freeOutput()
+    {
+#ifdef WITH_FFMPEG
+        if (swsCtx_ != nullptr)
+        {
+            sws_freeContext(swsCtx_);
+            swsCtx_ = nullptr;
+        }
+        av_frame_free(&frame_);
+        av_packet_free(&packet_);
+        avcodec_free_context(&codecCtx_);
+        if (formatCtx_ != nullptr)
+        {
+            if (!(formatCtx_->oformat->flags & AVFMT_NOFILE) && (formatCtx_->pb != nullptr))
+            {
+                avio_closep(&formatCtx_->pb);
+            }
+            avformat_free_context(formatCtx_);
+            formatCtx_ = nullptr;
+        }
+        stream_ = nullptr;
+#endif
+        isOpen_ = false;
+    }
+
+} // namespace bias
@@ -0,0 +1,113 @@
+#ifndef BIAS_ENCODER_FFMPEG_HPP
+#define BIAS_ENCODER_FFMPEG_HPP
+
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+#include <QWaitCondition>
+#include <deque>
+#include <string>
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+#include "lockable.hpp"
+#include "stamped_image.hpp"
+#include "video_writer_params.hpp"
+#include "pipeline_stats.hpp"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVStream;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+namespace bias
+{
+
+    // Encodes logged frames with libavcodec and muxes them into a matroska
+    // file on its own thread.
+    //
+    // The writer opens the file on the logging thread (so setup errors are
+    // thrown there), starts the encoder on a thread pool and hands it frames
+    // with push(). At most maxQueueSize frames may be waiting - push returns
+    // false rather than block when the queue is full. The codec is opened with
+    // frame and slice threading so libavcodec spreads the work over
+    // numberOfThreads threads (x264/x265 are frame threaded, ffv1 is slice
+    // threaded). Packet timestamps come from the frame time stamps.
+    //
+    // After stop() the encoder encodes what is left in the queue, flushes the
+    // codec, writes the trailer and closes the file.
+    //
+    // Without the with_ffmpeg cmake option open() always throws.
+    class Encoder_ffmpeg : public QObject, public QRunnable, public Lockable<Empty>
+    {
+        Q_OBJECT
+
+        public:
+
+            Encoder_ffmpeg(unsigned int cameraNumber=0, QObject *parent=0);
+            virtual ~Encoder_ffmpeg();
+
+            void open(
+                    QString fileName,
+                    VideoWriterParams_ffmpeg params,
+                    StampedImage firstImage,
+                    double frameRate
+                    );
+            bool push(StampedImage stampedImg);
+            void stop();
+            void setPipelineStats(PipelineStatsPtr pipelineStatsPtr);
+
+            // Waits up to timeoutMs for a frame to be encoded or for the
+            // encoder to finish. Returns true if either happened.
+            bool waitForProgress(unsigned long timeoutMs);
+            bool isDone();
+
+            unsigned int numQueued();
+            unsigned long numEncoded();
+            uint64_t bytesWritten();
+
+            static const int TIME_BASE_DEN;
+
+        signals:
+            void imageLoggingError(unsigned int errorId, QString errorMsg);
+
+        protected:
+
+            unsigned int cameraNumber_;
+            unsigned int maxQueueSize_;
+            bool isOpen_;
+            bool stopped_;
+            bool done_;
+            bool error_;
+
+            std::deque<StampedImage> queue_;
+            PipelineStatsPtr pipelineStatsPtr_;
+            unsigned long numEncoded_;
+            uint64_t bytesWritten_;
+            QWaitCondition notEmptyWaitCond_;
+            QWaitCondition progressWaitCond_;
+
+            int imageType_;
+            cv::Size size_;
+            double firstTimeStamp_;
+            int64_t lastPts_;
+
+            AVFormatContext *formatCtx_;
+            AVCodecContext *codecCtx_;
+            AVStream *stream_;
+            AVFrame *frame_;
+            AVPacket *packet_;
+            SwsContext *swsCtx_;
+
+            void run();
+            void encodeFrame(const StampedImage &stampedImg);
+            void fillFrame(const cv::Mat &image);
+            void sendFrame(AVFrame *frame);
+            void finishOutput();
+            void freeOutput();
+    };
+
+} // namespace bias
+
+#endif // #ifndef BIAS_ENCODER_FFMPEG_HPP
@@ -0,0 +1,282 @@
+#include "encoder_jpg.hpp"
+#include "basic_types.hpp"
+#include "exception.hpp"
+#include <opencv2/highgui/highgui.hpp>
+#include <fstream>
+#include <algorithm>
+
+#ifdef WITH_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+namespace bias
+{
+    // Constants
+    // ----------------------------------------------------------------------------------
+    const unsigned int Encoder_jpg::DEFAULT_CHROMA_SUBSAMPLING = 420;
+    const bool Encoder_jpg::DEFAULT_FAST_DCT = false;
+
+
+    // Public methods
+    // ----------------------------------------------------------------------------------
+    Encoder_jpg::Encoder_jpg()
+    {
+        chromaSubsampling_ = DEFAULT_CHROMA_SUBSAMPLING;
+        fastDct_ = DEFAULT_FAST_DCT;
+        useOpenCv_ = false;
+        handle_ = nullptr;
+        tjBuffer_ = nullptr;
+        tjBufferSize_ = 0;
+        tjDataSize_ = 0;
+        haveTjData_ = false;
+    }
+
+
+    Encoder_jpg::~Encoder_jpg()
+    {
+#ifdef WITH_TURBOJPEG
+        if (tjBuffer_ != nullptr)
+        {
+            tjFree(tjBuffer_);
+        }
+        if (handle_ != nullptr)
+        {
+            tjDestroy(tjhandle(handle_));
+        }
+#endif
+    }
+
+
+    void Encoder_jpg::setChromaSubsampling(unsigned int subsampling)
+    {
+        if (isValidChromaSubsampling(subsampling))
+        {
+            chromaSubsampling_ = subsampling;
+        }
+    }
+
+
+    unsigned int Encoder_jpg::getChromaSubsampling() const
+    {
+        return chromaSubsampling_;
+    }
+
+
+    void Encoder_jpg::setFastDct(bool value)
+    {
+        fastDct_ = value;
+    }
+
+
+    bool Encoder_jpg::getFastDct() const
+    {
+        return fastDct_;
+    }
+
+
+    void Encoder_jpg::setUseOpenCv(bool value)
+    {
+        useOpenCv_ = value;
+    }
+
+
+    bool Encoder_jpg::isUsingTurboJpeg() const
+    {
+#ifdef WITH_TURBOJPEG
+        return !useOpenCv_;
+#else
+        return false;
+#endif
+    }
+
+
+    void Encoder_jpg::encode(const cv::Mat &image, unsigned int quality)
+    {
+        quality = std::min(quality, 100u);
+        haveTjData_ = false;
+        if (isUsingTurboJpeg() && encodeTurboJpeg(image, quality))
+        {
+            haveTjData_ = true;
+        }
+        else
+        {
+            encodeOpenCv(image, quality);
+        }
+    }
+
+
+    const uchar *Encoder_jpg::data() const
+    {
+        if (haveTjData_)
+        {
+            return tjBuffer_;
+        }
+        return cvBuffer_.data();
+    }
+
+
+    size_t Encoder_jpg::size() const
+    {
+        if (haveTjData_)
+        {
+            return size_t(tjDataSize_);
+        }
+        return cvBuffer_.size();
+    }
+
+
+    void Encoder_jpg::encode(const cv::Mat &image, unsigned int quality, std::vector<uchar> &buffer)
+    {
+        encode(image, quality);
+        buffer.assign(data(), data() + size());
+    }
+
+
+    void Encoder_jpg::write(const cv::Mat &image, unsigned int quality, std::string fileName)
+    {
+        encode(image, quality);
+
+        std::ofstream file(fileName, std::ios::out | std::ios::binary);
+        file.write((const char *) data(), size());
+        file.close();
+        if (file.fail())
+        {
+            unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
+            std::string errorMsg("writing jpg frame failed - unable to write ");
+            errorMsg += fileName;
+            throw RuntimeError(errorId, errorMsg);
+        }
+    }
+
+
+    bool Encoder_jpg::isValidChromaSubsampling(unsigned int subsampling)
+    {
+        return (subsampling == 444) || (subsampling == 422) || (subsampling == 420);
+    }
+
+
+    // Private methods
+    // ----------------------------------------------------------------------------------
+    bool Encoder_jpg::encodeTurboJpeg(const cv::Mat &image, unsigned int quality)
+    {
+#ifdef WITH_TURBOJPEG
+        int pixelFormat = 0;
+        int subsampling = TJSAMP_420;
+        switch (image.type())
+        {
+            case CV_8UC1:
+                pixelFormat = TJPF_GRAY;
+                subsampling = TJSAMP_GRAY;
+                break;
+
+            case CV_8UC3:
+                pixelFormat = TJPF_BGR;
+                break;
+
+            case CV_8UC4:
+                pixelFormat = TJPF_BGRA;
+                break;
+
+            default:
+                // Let OpenCV deal with anything else
+                return false;
+        }
+        if (pixelFormat != TJPF_GRAY)
+        {
+            switch (chromaSubsampling_)
+            {
+                case 444:
+                    subsampling = TJSAMP_444;
+                    break;
+                case 422:
+                    subsampling = TJSAMP_422;
+                    break;
+                default:
+                    subsampling = TJSAMP_420;
+                    break;
+            }
+        }
+
+        if (handle_ == nullptr)
+        {
+            handle_ = tjInitCompress();
+            if (handle_ == nullptr)
+            {
+                unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
+                std::string errorMsg("encoding jpg frame failed - unable to create TurboJPEG compressor");
+                throw RuntimeError(errorId, errorMsg);
+            }
+        }
+
+        // Size the output buffer for the worst case once so the encoder never
+        // has to reallocate it.
+        unsigned long bufferSize = tjBufSize(image.cols, image.rows, subsampling);
+        if (bufferSize > tjBufferSize_)
+        {
+            if (tjBuffer_ != nullptr)
+            {
+                tjFree(tjBuffer_);
+            }
+            tjBuffer_ = tjAlloc(int(bufferSize));
+            tjBufferSize_ = (tjBuffer_ != nullptr) ? bufferSize : 0;
+            if (tjBuffer_ == nullptr)
+            {
+                unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
+                std::string errorMsg("encoding jpg frame failed - unable to allocate output buffer");
+                throw RuntimeError(errorId, errorMsg);
+            }
+        }
+
+        int flags = TJFLAG_NOREALLOC;
+        if (fastDct_)
+        {
+            flags |= TJFLAG_FASTDCT;
+        }
+
+        tjDataSize_ = tjBufferSize_;
+        int rval = tjCompress2(
+                tjhandle(handle_),
+                const_cast<unsigned char *>(image.data),
+                image.cols,
+                int(image.step),
+                image.rows,
+                pixelFormat,
+                &tjBuffer_,
+                &tjDataSize_,
+                subsampling,
+                std::max(int(quality), 1),
+                flags
+                );
+        if (rval != 0)
+        {
+            unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
+            std::string errorMsg("encoding jpg frame failed - ");
+            errorMsg += tjGetErrorStr();
+            throw RuntimeError(errorId, errorMsg);
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+
+    void Encoder_jpg::encodeOpenCv(const cv::Mat &image, unsigned int quality)
+    {
+        cvParams_.clear();
+        cvParams_.push_back(cv::IMWRITE_JPEG_QUALITY);
+        cvParams_.push_back(int(quality));
+        try
+        {
+            cv::imencode(".jpg", image, cvBuffer_, cvParams_);
+        }
+        catch (cv::Exception &exc)
+        {
+            unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
+            std::string errorMsg("encoding jpg frame failed - ");
+            errorMsg += exc.what();
+            throw RuntimeError(errorId, errorMsg);
+        }
+    }
+
+} // namespace bias
@@ -0,0 +1,80 @@
+#ifndef BIAS_ENCODER_JPG_HPP
+#define BIAS_ENCODER_JPG_HPP
+
+#include <vector>
+#include <string>
+#include <opencv2/core/core.hpp>
+
+namespace bias
+{
+    // Jpeg encoder which keeps its state between frames.
+    //
+    // Each compressor thread owns one. When built with libjpeg-turbo (the
+    // with_turbojpeg cmake option) a single TurboJPEG compressor handle and
+    // output buffer are created once and reused for every frame - 8 bit mono
+    // images are encoded directly as grayscale jpgs and colour images use the
+    // selected chroma subsampling. Without libjpeg-turbo, or for image types
+    // TurboJPEG can't take, cv::imencode is used into a reused buffer and the
+    // subsampling and fast DCT settings are ignored.
+    class Encoder_jpg
+    {
+        public:
+
+            Encoder_jpg();
+            ~Encoder_jpg();
+
+            // Chroma subsampling for colour images - 444, 422 or 420
+            void setChromaSubsampling(unsigned int subsampling);
+            unsigned int getChromaSubsampling() const;
+
+            void setFastDct(bool value);
+            bool getFastDct() const;
+
+            // Use cv::imencode even if libjpeg-turbo is available
+            void setUseOpenCv(bool value);
+            bool isUsingTurboJpeg() const;
+
+            // Encodes the image. The result is held in the encoder's buffer
+            // and is valid until the next call.
+            void encode(const cv::Mat &image, unsigned int quality);
+            const uchar *data() const;
+            size_t size() const;
+
+            // Encodes the image and copies the result into buffer - the
+            // buffer's existing capacity is reused.
+            void encode(const cv::Mat &image, unsigned int quality, std::vector<uchar> &buffer);
+
+            // Encodes the image and writes it to fileName
+            void write(const cv::Mat &image, unsigned int quality, std::string fileName);
+
+            static bool isValidChromaSubsampling(unsigned int subsampling);
+
+            static const unsigned int DEFAULT_CHROMA_SUBSAMPLING;
+            static const bool DEFAULT_FAST_DCT;
+
+        private:
+
+            unsigned int chromaSubsampling_;
+            bool fastDct_;
+            bool useOpenCv_;
+
+            void *handle_;               // tjhandle
+            unsigned char *tjBuffer_;    // allocated with tjAlloc
+            unsigned long tjBufferSize_; // allocated size
+            unsigned long tjDataSize_;   // size of last encoding
+            bool haveTjData_;
+
+            std::vector<uchar> cvBuffer_;
+            std::vector<int> cvParams_;
+
+            bool encodeTurboJpeg(const cv::Mat &image, unsigned int quality);
+            void encodeOpenCv(const cv::Mat &image, unsigned int quality);
+
+            // Not copyable - owns the TurboJPEG handle and buffer
+            Encoder_jpg(const Encoder_jpg &);
+            Encoder_jpg &operator=(const Encoder_jpg &);
+    };
+
+}
+
+#endif // #ifndef BIAS_ENCODER_JPG_HPP
@@ -1,31 +1,211 @@
 #include "ext_ctl_http_server.hpp"
 #include "camera_window.hpp"
+#include "frame_sync.hpp"
 #include <QtDebug>
 #include "flytrack_plugin.hpp"
 
 namespace bias
 {
-    ExtCtlHttpServer::ExtCtlHttpServer(CameraWindow *cameraWindow, QObject *parent)
-        : BasicHttpServer(parent)
+    // ExtCtlHttpServer
+    // ------------------------------------------------------------------------------
+
+    ExtCtlHttpServer::ExtCtlHttpServer(
+            CameraWindow *cameraWindow, 
+            CameraStatusPublisherPtr statusPublisherPtr,
+            QObject *parent
+            ) : BasicHttpServer(parent)
+    { 
+        statusPublisherPtr_ = statusPublisherPtr;
+
+        // The handler stays on the GUI thread when the server is moved to its 
+        // own thread, so these connections are queued.
+        ExtCtlCommandHandler *commandHandlerPtr = new ExtCtlCommandHandler(cameraWindow, cameraWindow);
+        connect(
+                this, 
+                SIGNAL(commandListRequested(quint64, HttpCommandList)),
+                commandHandlerPtr,
+                SLOT(runCommandList(quint64, HttpCommandList))
+               );
+        connect(
+                commandHandlerPtr,
+                SIGNAL(commandListDone(quint64, QVariantList, bool)),
+                this,
+                SLOT(onCommandListDone(quint64, QVariantList, bool))
+               );
+        connect(this, SIGNAL(closeRequested()), cameraWindow, SLOT(close()));
+    }
+
+
+    // Protected methods
+    // ------------------------------------------------------------------------------
+    void ExtCtlHttpServer::handleCommandRequest(quint64 connectionId, const HttpCommandList &cmdList)
+    {
+        bool statusOnly = true;
+        for (int i=0; i<cmdList.size(); i++)
+        {
+            statusOnly &= isStatusCommand(cmdList[i].name);
+        }
+
+        if (!statusOnly)
+        {
+            emit commandListRequested(connectionId, cmdList);
+            return;
+        }
+
+        CameraStatus status = statusPublisherPtr_ -> getStatus();
+        QVariantList respList;
+        for (int i=0; i<cmdList.size(); i++)
+        {
+            respList.append(handleStatusCommand(cmdList[i].name, status));
+        }
+        sendCommandResp(connectionId, respList);
+    }
+
+
+    bool ExtCtlHttpServer::handlePathRequest(quint64 connectionId, QString path)
+    {
+        // Pipeline statistics in the Prometheus text format 
+        if (path == QString("/metrics"))
+        {
+            CameraStatus status = statusPublisherPtr_ -> getStatus();
+            QString metrics;
+            if (status.pipelineStatsPtr)
+            {
+                metrics = status.pipelineStatsPtr -> toPrometheus();
+            }
+            sendResponse(
+                    connectionId, 
+                    200, 
+                    "Ok", 
+                    "text/plain; version=0.0.4; charset=\"utf-8\"", 
+                    metrics.toUtf8()
+                    );
+            return true;
+        }
+        return false;
+    }
+
+
+    // Private slots
+    // ------------------------------------------------------------------------------
+    void ExtCtlHttpServer::onCommandListDone(quint64 connectionId, QVariantList respList, bool closeRequested)
+    {
+        sendCommandResp(connectionId, respList);
+        if (closeRequested)
+        {
+            // Close the window once the response is on its way
+            flushConnection(connectionId);
+            emit this -> closeRequested();
+        }
+    }
+
+
+    // Private methods
+    // ------------------------------------------------------------------------------
+    bool ExtCtlHttpServer::isStatusCommand(QString name)
+    {
+        return (
+                (name == QString("get-frame-count")) ||
+                (name == QString("get-time-stamp")) ||
+                (name == QString("get-frames-per-sec")) ||
+                (name == QString("get-status")) ||
+                (name == QString("get-camera-guid")) ||
+                (name == QString("get-video-file")) ||
+                (name == QString("get-pipeline-stats")) ||
+                (name == QString("get-sync-stats"))
+               );
+    }
+
+
+    QVariantMap ExtCtlHttpServer::handleStatusCommand(QString name, const CameraStatus &status)
+    {
+        QVariantMap cmdMap;
+        cmdMap.insert("success", true);
+        cmdMap.insert("message", "");
+
+        if (name == QString("get-frame-count"))
+        {
+            cmdMap.insert("value", qulonglong(status.frameCount));
+        }
+        else if (name == QString("get-time-stamp"))
+        {
+            cmdMap.insert("value", status.timeStamp);
+        }
+        else if (name == QString("get-frames-per-sec"))
+        {
+            cmdMap.insert("value", status.framesPerSec);
+        }
+        else if (name == QString("get-status"))
+        {
+            cmdMap.insert("value", status.toMap());
+        }
+        else if (name == QString("get-camera-guid"))
+        {
+            if (status.connected)
+            {
+                cmdMap.insert("value", status.guid);
+            }
+            else
+            {
+                cmdMap.insert("success", false);
+                cmdMap.insert("message", "Unable to get camera Guid: camera not connected");
+                cmdMap.insert("value", "");
+            }
+        }
+        else if (name == QString("get-video-file"))
+        {
+            cmdMap.insert("value", status.videoFile);
+        }
+        else if (name == QString("get-pipeline-stats"))
+        {
+            QVariantMap statsMap;
+            if (status.pipelineStatsPtr)
+            {
+                statsMap = status.pipelineStatsPtr -> toMap();
+            }
+            cmdMap.insert("value", statsMap);
+        }
+        else if (name == QString("get-sync-stats"))
+        {
+            cmdMap.insert("value", FrameSyncService::getStats().toMap());
+        }
+        cmdMap.insert("command", name);
+        return cmdMap;
+    }
+
+
+    // ExtCtlCommandHandler
+    // ------------------------------------------------------------------------------
+
+    ExtCtlCommandHandler::ExtCtlCommandHandler(CameraWindow *cameraWindow, QObject *parent)
+        : QObject(parent)
     { 
         closeFlag_ = false;
         cameraWindowPtr_ = QPointer<CameraWindow>(cameraWindow);
     }
 
-    // Protected slots
+
+    // Public slots
     // ------------------------------------------------------------------------------
-    void ExtCtlHttpServer::readClient()
+    void ExtCtlCommandHandler::runCommandList(quint64 connectionId, HttpCommandList cmdList)
     {
-        BasicHttpServer::readClient();
-        if (closeFlag_)
+        QVariantList respList;
+        for (int i=0; i<cmdList.size(); i++)
         {
-            cameraWindowPtr_ -> close();
+            respList.append(paramsRequestSwitchYard(cmdList[i].name, cmdList[i].value));
         }
+
+        // Status queries which follow see the effect of these commands
+        cameraWindowPtr_ -> publishStatus();
+
+        emit commandListDone(connectionId, respList, closeFlag_);
+        closeFlag_ = false;
     }
 
-    // Protected methods
-    // ------------------------------------------------------------------------------
-    QVariantMap ExtCtlHttpServer::paramsRequestSwitchYard(QString name, QString value)
+
+    // Private Methods
+    // ------------------------------------------------------------------------
+    QVariantMap ExtCtlCommandHandler::paramsRequestSwitchYard(QString name, QString value)
     {
         QVariantMap cmdMap;
 
@@ -61,6 +241,10 @@ namespace bias
         {
             cmdMap = handleLoggingDisable();
         }
+        else if (name == QString("trigger-clip"))
+        {
+            cmdMap = handleTriggerClip();
+        }
         else if (name == QString("load-configuration"))
         {
             cmdMap = handleLoadConfiguration(value);
@@ -97,6 +281,14 @@ namespace bias
         {
             cmdMap = handleGetFramesPerSec();
         }
+        else if (name == QString("get-pipeline-stats"))
+        {
+            cmdMap = handleGetPipelineStats();
+        }
+        else if (name == QString("get-sync-stats"))
+        {
+            cmdMap = handleGetFrameSyncStats();
+        }
         else if (name == QString("set-camera-name"))
         {
             cmdMap = handleSetCameraName(value);
@@ -128,9 +320,7 @@ namespace bias
     }
 
 
-    // Private Methods
-    // ------------------------------------------------------------------------
-    QVariantMap ExtCtlHttpServer::handleConnectRequest()
+    QVariantMap ExtCtlCommandHandler::handleConnectRequest()
     { 
         QVariantMap cmdMap;
         RtnStatus status = cameraWindowPtr_ -> connectCamera(false);
@@ -141,7 +331,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleDisconnectRequest()
+    QVariantMap ExtCtlCommandHandler::handleDisconnectRequest()
     { 
         QVariantMap cmdMap;
         RtnStatus status = cameraWindowPtr_ -> disconnectCamera(false);
@@ -152,7 +342,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleStartCaptureRequest()
+    QVariantMap ExtCtlCommandHandler::handleStartCaptureRequest()
     {
         QVariantMap cmdMap;
         RtnStatus status = cameraWindowPtr_ -> startImageCapture(false);
@@ -163,7 +353,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleStopCaptureRequest()
+    QVariantMap ExtCtlCommandHandler::handleStopCaptureRequest()
     {
         QVariantMap cmdMap;
         RtnStatus status = cameraWindowPtr_ -> stopImageCapture(false);
@@ -174,7 +364,7 @@ namespace bias
     }
 
     
-    QVariantMap ExtCtlHttpServer::handleGetConfiguration()
+    QVariantMap ExtCtlCommandHandler::handleGetConfiguration()
     {
         QVariantMap cmdMap;
         RtnStatus status;
@@ -186,7 +376,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleSetConfiguration(QString jsonConfig)
+    QVariantMap ExtCtlCommandHandler::handleSetConfiguration(QString jsonConfig)
     {
         QVariantMap cmdMap;
         QByteArray jsonArray = jsonConfig.toLatin1();
@@ -198,7 +388,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleLoggingEnable()
+    QVariantMap ExtCtlCommandHandler::handleLoggingEnable()
     {
         QVariantMap cmdMap;
         RtnStatus status = cameraWindowPtr_ -> enableLogging(false);
@@ -209,7 +399,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleLoggingDisable()
+    QVariantMap ExtCtlCommandHandler::handleLoggingDisable()
     {
         QVariantMap cmdMap;
         RtnStatus status = cameraWindowPtr_ -> disableLogging(false);
@@ -220,7 +410,18 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleSaveConfiguration(QString fileName)
+    QVariantMap ExtCtlCommandHandler::handleTriggerClip()
+    {
+        QVariantMap cmdMap;
+        RtnStatus status = cameraWindowPtr_ -> triggerClip(false);
+        cmdMap.insert("success", status.success);
+        cmdMap.insert("message", status.message);
+        cmdMap.insert("value", "");
+        return cmdMap;
+    }
+
+
+    QVariantMap ExtCtlCommandHandler::handleSaveConfiguration(QString fileName)
     {
         QVariantMap cmdMap;
         RtnStatus status = cameraWindowPtr_ -> saveConfiguration(fileName,false);
@@ -231,7 +432,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleLoadConfiguration(QString fileName)
+    QVariantMap ExtCtlCommandHandler::handleLoadConfiguration(QString fileName)
     {
         QVariantMap cmdMap;
 
@@ -243,7 +444,7 @@ namespace bias
     }
 
     
-    QVariantMap ExtCtlHttpServer::handleGetFrameCount()
+    QVariantMap ExtCtlCommandHandler::handleGetFrameCount()
     {
         QVariantMap cmdMap;
         unsigned long frameCount = cameraWindowPtr_ -> getFrameCount();
@@ -253,7 +454,7 @@ namespace bias
         return cmdMap;
     }
 
-    QVariantMap ExtCtlHttpServer::handleGetCameraGuid()
+    QVariantMap ExtCtlCommandHandler::handleGetCameraGuid()
     {
         QVariantMap cmdMap;
         RtnStatus status; 
@@ -272,7 +473,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleGetStatus()
+    QVariantMap ExtCtlCommandHandler::handleGetStatus()
     {
         QVariantMap cmdMap;
         QVariantMap statusMap;
@@ -295,7 +496,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleSetVideoFile(QString fileName)
+    QVariantMap ExtCtlCommandHandler::handleSetVideoFile(QString fileName)
     {
         QVariantMap cmdMap;
         RtnStatus status = cameraWindowPtr_ -> setVideoFile(fileName);
@@ -306,7 +507,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleGetVideoFile()
+    QVariantMap ExtCtlCommandHandler::handleGetVideoFile()
     {
         QVariantMap cmdMap;
         QString fileName = cameraWindowPtr_ -> getVideoFileFullPath();
@@ -317,7 +518,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleGetTimeStamp()
+    QVariantMap ExtCtlCommandHandler::handleGetTimeStamp()
     {
         QVariantMap cmdMap;
         double timeStamp = cameraWindowPtr_ -> getTimeStamp();
@@ -328,7 +529,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleGetFramesPerSec()
+    QVariantMap ExtCtlCommandHandler::handleGetFramesPerSec()
     {
         QVariantMap cmdMap;
         double framesPerSec = cameraWindowPtr_ -> getFramesPerSec();
@@ -339,7 +540,29 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleSetCameraName(QString cameraName)
+    QVariantMap ExtCtlCommandHandler::handleGetPipelineStats()
+    {
+        QVariantMap cmdMap;
+        QVariantMap statsMap = cameraWindowPtr_ -> getPipelineStats();
+        cmdMap.insert("success", true);
+        cmdMap.insert("message", "");
+        cmdMap.insert("value", statsMap);
+        return cmdMap;
+    }
+
+
+    QVariantMap ExtCtlCommandHandler::handleGetFrameSyncStats()
+    {
+        QVariantMap cmdMap;
+        QVariantMap statsMap = cameraWindowPtr_ -> getFrameSyncStats();
+        cmdMap.insert("success", true);
+        cmdMap.insert("message", "");
+        cmdMap.insert("value", statsMap);
+        return cmdMap;
+    }
+
+
+    QVariantMap ExtCtlCommandHandler::handleSetCameraName(QString cameraName)
     {
         QVariantMap cmdMap;
         cameraWindowPtr_ -> setUserCameraName(cameraName);
@@ -350,7 +573,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleSetWindowGeometry(QString jsonGeom)
+    QVariantMap ExtCtlCommandHandler::handleSetWindowGeometry(QString jsonGeom)
     {
         QVariantMap cmdMap;
         QByteArray jsonGeomArray = jsonGeom.toLatin1();
@@ -362,7 +585,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleGetWindowGeometry()
+    QVariantMap ExtCtlCommandHandler::handleGetWindowGeometry()
     {
         QVariantMap cmdMap;
         QVariantMap windowGeomMap = cameraWindowPtr_ -> getWindowGeometryMap();
@@ -373,7 +596,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handlePluginCmd(QString jsonPluginCmd)
+    QVariantMap ExtCtlCommandHandler::handlePluginCmd(QString jsonPluginCmd)
     {
         //qDebug() << __FUNCTION__ << jsonPluginCmd;
         QVariantMap cmdMap;
@@ -388,7 +611,7 @@ namespace bias
     }
 
 
-    QVariantMap ExtCtlHttpServer::handleClose()
+    QVariantMap ExtCtlCommandHandler::handleClose()
     {
         QVariantMap cmdMap;
         if (cameraWindowPtr_ -> isCapturing())
@@ -1,28 +1,34 @@
 #ifndef EXT_CTL_HTTP_SERVER_HPP
 #define EXT_CTL_HTTP_SERVER_HPP
 #include<QVariantMap>
+#include<QVariantList>
+#include<QPointer>
 #include "basic_http_server.hpp"
+#include "camera_status.hpp"
 
 namespace bias
 {
     class CameraWindow;
 
-    class ExtCtlHttpServer : public BasicHttpServer
+
+    class ExtCtlCommandHandler : public QObject
     {
+        // Runs external control commands on the GUI thread for the server.
         Q_OBJECT
 
         public:
-            ExtCtlHttpServer(CameraWindow *cameraWindow, QObject *parent=0);
+            ExtCtlCommandHandler(CameraWindow *cameraWindow, QObject *parent=0);
 
-        protected:
-            virtual QVariantMap paramsRequestSwitchYard(QString name, QString value);
+        signals:
+            void commandListDone(quint64 connectionId, QVariantList respList, bool closeRequested);
 
-        protected slots:
-            virtual void readClient();
+        public slots:
+            void runCommandList(quint64 connectionId, HttpCommandList cmdList);
 
         private:
             bool closeFlag_;
             QPointer<CameraWindow> cameraWindowPtr_;
+            QVariantMap paramsRequestSwitchYard(QString name, QString value);
             QVariantMap handleConnectRequest();
             QVariantMap handleDisconnectRequest();
             QVariantMap handleStartCaptureRequest();
@@ -31,6 +37,7 @@ namespace bias
             QVariantMap handleSetConfiguration(QString jsonConfig);
             QVariantMap handleLoggingEnable();
             QVariantMap handleLoggingDisable();
+            QVariantMap handleTriggerClip();
             QVariantMap handleSaveConfiguration(QString fileName);
             QVariantMap handleLoadConfiguration(QString fileName);
             QVariantMap handleGetCameraGuid();
@@ -40,6 +47,8 @@ namespace bias
             QVariantMap handleGetVideoFile();
             QVariantMap handleGetTimeStamp();
             QVariantMap handleGetFramesPerSec();
+            QVariantMap handleGetPipelineStats();
+            QVariantMap handleGetFrameSyncStats();
             QVariantMap handleSetCameraName(QString cameaName);
             QVariantMap handleSetWindowGeometry(QString jsonGeom);
             QVariantMap handleGetWindowGeometry();
@@ -47,5 +56,44 @@ namespace bias
             QVariantMap handleClose();
     };
 
+
+    class ExtCtlHttpServer : public BasicHttpServer
+    {
+        // --------------------------------------------------------------------
+        // External control server for a camera window, run on its own thread
+        // so clients are not held up while the GUI thread is busy. Requests
+        // which only read the camera's status are answered on the server
+        // thread from the status published by the camera window and
+        // dispatcher. Any other request is passed, as a whole so commands
+        // run in order, to the command handler on the GUI thread and
+        // answered when it is done.
+        // --------------------------------------------------------------------
+
+        Q_OBJECT
+
+        public:
+            ExtCtlHttpServer(
+                    CameraWindow *cameraWindow,
+                    CameraStatusPublisherPtr statusPublisherPtr,
+                    QObject *parent=0
+                    );
+
+        signals:
+            void commandListRequested(quint64 connectionId, HttpCommandList cmdList);
+            void closeRequested();
+
+        protected:
+            virtual void handleCommandRequest(quint64 connectionId, const HttpCommandList &cmdList);
+            virtual bool handlePathRequest(quint64 connectionId, QString path);
+
+        private slots:
+            void onCommandListDone(quint64 connectionId, QVariantList respList, bool closeRequested);
+
+        private:
+            CameraStatusPublisherPtr statusPublisherPtr_;
+            static bool isStatusCommand(QString name);
+            QVariantMap handleStatusCommand(QString name, const CameraStatus &status);
+    };
+
 }
 #endif
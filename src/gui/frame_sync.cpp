@@ -0,0 +1,944 @@
+#include "frame_sync.hpp"
+#include "affinity.hpp"
+#include <cmath>
+#include <limits>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <QThreadPool>
+#include <QMutexLocker>
+
+namespace bias
+{
+    const unsigned long FRAME_SYNC_WAIT_TIMEOUT = 50;        // msec
+    const double FRAME_SYNC_FALLBACK_TOLERANCE = 1.0e-3;      // sec, before the frame interval is known
+
+    // ClockSync
+    // ------------------------------------------------------------------------
+
+    const double ClockSync::WINDOW_DURATION = 1.0;
+    const unsigned int ClockSync::MIN_NUMBER_OF_FIT_WINDOWS = 3;
+    const unsigned int ClockSync::MAX_NUMBER_OF_WINDOWS = 60;
+    const double ClockSync::MAX_SLEW_RATE = 0.1;
+
+    ClockSync::ClockSync()
+    {
+        reset();
+    }
+
+
+    void ClockSync::reset()
+    {
+        windowList_.clear();
+        current_.cameraTime = 0.0;
+        current_.offset = 0.0;
+        windowStart_ = 0.0;
+        haveCurrent_ = false;
+        lastCameraTime_ = 0.0;
+        haveMapped_ = false;
+        lastMappedCameraTime_ = 0.0;
+        lastMappedHostTime_ = 0.0;
+        fitCameraTime_ = 0.0;
+        fitOffset_ = 0.0;
+        fitDrift_ = 0.0;
+    }
+
+
+    void ClockSync::update(double cameraTime, double hostTime)
+    {
+        // Camera time going backwards means the camera's time stamps have
+        // been reset - start again.
+        if (haveCurrent_ && (cameraTime < lastCameraTime_ - WINDOW_DURATION))
+        {
+            reset();
+        }
+        lastCameraTime_ = cameraTime;
+
+        double offset = hostTime - cameraTime;
+        if (!haveCurrent_ || ((cameraTime - windowStart_) >= WINDOW_DURATION))
+        {
+            if (haveCurrent_)
+            {
+                windowList_.push_back(current_);
+                if (windowList_.size() > MAX_NUMBER_OF_WINDOWS)
+                {
+                    windowList_.pop_front();
+                }
+            }
+            windowStart_ = cameraTime;
+            current_.cameraTime = cameraTime;
+            current_.offset = offset;
+            haveCurrent_ = true;
+            fit();
+        }
+        else if (offset < current_.offset)
+        {
+            current_.cameraTime = cameraTime;
+            current_.offset = offset;
+            fit();
+        }
+    }
+
+
+    double ClockSync::toHostTime(double cameraTime)
+    {
+        double hostTime = cameraTime + fitOffset_ + fitDrift_*(cameraTime - fitCameraTime_);
+        if (haveMapped_ && (cameraTime >= lastMappedCameraTime_))
+        {
+            double dt = cameraTime - lastMappedCameraTime_;
+            double minHostTime = lastMappedHostTime_ + (1.0 - MAX_SLEW_RATE)*dt;
+            hostTime = std::max(hostTime, minHostTime);
+        }
+        haveMapped_ = true;
+        lastMappedCameraTime_ = cameraTime;
+        lastMappedHostTime_ = hostTime;
+        return hostTime;
+    }
+
+
+    double ClockSync::getOffset() const
+    {
+        return fitOffset_ + fitDrift_*(lastCameraTime_ - fitCameraTime_);
+    }
+
+
+    double ClockSync::getDrift() const
+    {
+        return fitDrift_;
+    }
+
+
+    bool ClockSync::isValid() const
+    {
+        return haveCurrent_;
+    }
+
+
+    void ClockSync::fit()
+    {
+        // Until there are enough complete windows use the smallest offset
+        // seen. Then fit a line to the minima of the complete windows - the
+        // current window's minimum is from too few frames to be reliable.
+        if (windowList_.size() < MIN_NUMBER_OF_FIT_WINDOWS)
+        {
+            WindowMin minPoint = current_;
+            for (const WindowMin &point : windowList_)
+            {
+                if (point.offset < minPoint.offset)
+                {
+                    minPoint = point;
+                }
+            }
+            fitCameraTime_ = minPoint.cameraTime;
+            fitOffset_ = minPoint.offset;
+            fitDrift_ = 0.0;
+            return;
+        }
+
+        double n = double(windowList_.size());
+        double meanTime = 0.0;
+        double meanOffset = 0.0;
+        for (const WindowMin &point : windowList_)
+        {
+            meanTime += point.cameraTime;
+            meanOffset += point.offset;
+        }
+        meanTime /= n;
+        meanOffset /= n;
+
+        double sxx = 0.0;
+        double sxy = 0.0;
+        for (const WindowMin &point : windowList_)
+        {
+            double dt = point.cameraTime - meanTime;
+            sxx += dt*dt;
+            sxy += dt*(point.offset - meanOffset);
+        }
+        fitCameraTime_ = meanTime;
+        fitOffset_ = meanOffset;
+        fitDrift_ = (sxx > 0.0) ? (sxy/sxx) : 0.0;
+    }
+
+
+    // CameraSyncStats and FrameSyncStats
+    // ------------------------------------------------------------------------
+
+    CameraSyncStats::CameraSyncStats()
+    {
+        numFrames = 0;
+        numMatched = 0;
+        numMissing = 0;
+        numDuplicate = 0;
+        numLate = 0;
+        meanErrorUs = 0.0;
+        rmsErrorUs = 0.0;
+        maxErrorUs = 0.0;
+        clockOffset = 0.0;
+        clockDriftPpm = 0.0;
+    }
+
+
+    QVariantMap CameraSyncStats::toMap() const
+    {
+        QVariantMap map;
+        map.insert("numFrames", qulonglong(numFrames));
+        map.insert("numMatched", qulonglong(numMatched));
+        map.insert("numMissing", qulonglong(numMissing));
+        map.insert("numDuplicate", qulonglong(numDuplicate));
+        map.insert("numLate", qulonglong(numLate));
+        map.insert("meanErrorUs", meanErrorUs);
+        map.insert("rmsErrorUs", rmsErrorUs);
+        map.insert("maxErrorUs", maxErrorUs);
+        map.insert("clockOffset", clockOffset);
+        map.insert("clockDriftPpm", clockDriftPpm);
+        return map;
+    }
+
+
+    FrameSyncStats::FrameSyncStats()
+    {
+        enabled = false;
+        recording = false;
+        toleranceUs = 0.0;
+        numSets = 0;
+        numCompleteSets = 0;
+        numDropped = 0;
+    }
+
+
+    QVariantMap FrameSyncStats::toMap() const
+    {
+        QVariantMap cameraMap;
+        for (auto &item : cameraStats)
+        {
+            cameraMap.insert(QString::number(item.first), item.second.toMap());
+        }
+        QVariantMap map;
+        map.insert("enabled", enabled);
+        map.insert("recording", recording);
+        map.insert("toleranceUs", toleranceUs);
+        map.insert("numSets", qulonglong(numSets));
+        map.insert("numCompleteSets", qulonglong(numCompleteSets));
+        map.insert("numDropped", qulonglong(numDropped));
+        map.insert("cameras", cameraMap);
+        return map;
+    }
+
+
+    // FrameMatcher
+    // ------------------------------------------------------------------------
+
+    FrameMatcher::CameraState::CameraState()
+    {
+        haveTime = false;
+        lastTime = 0.0;
+        lastHostTime = 0.0;
+        stalled = false;
+    }
+
+
+    FrameMatcher::ErrorSums::ErrorSums()
+    {
+        absSum = 0.0;
+        sqSum = 0.0;
+        absMax = 0.0;
+    }
+
+
+    FrameMatcher::FrameMatcher()
+    {
+        numberOfCameras_ = 0;
+        tolerance_ = FRAME_SYNC_FALLBACK_TOLERANCE;
+        maxWait_ = 1.0;
+        reset();
+    }
+
+
+    void FrameMatcher::reset()
+    {
+        setIndex_ = 0;
+        numCompleteSets_ = 0;
+        haveLastSet_ = false;
+        lastSetEnd_ = 0.0;
+        cameraStateMap_.clear();
+        cameraStatsMap_.clear();
+        errorSumsMap_.clear();
+    }
+
+
+    void FrameMatcher::setNumberOfCameras(unsigned int numberOfCameras)
+    {
+        numberOfCameras_ = numberOfCameras;
+    }
+
+
+    void FrameMatcher::setTolerance(double tolerance)
+    {
+        tolerance_ = tolerance;
+    }
+
+
+    void FrameMatcher::setMaxWait(double maxWait)
+    {
+        maxWait_ = maxWait;
+    }
+
+
+    double FrameMatcher::getTolerance() const
+    {
+        return tolerance_;
+    }
+
+
+    void FrameMatcher::addCamera(unsigned int cameraNumber)
+    {
+        cameraStateMap_[cameraNumber] = CameraState();
+        if (cameraStatsMap_.count(cameraNumber) == 0)
+        {
+            cameraStatsMap_[cameraNumber] = CameraSyncStats();
+            errorSumsMap_[cameraNumber] = ErrorSums();
+        }
+    }
+
+
+    void FrameMatcher::removeCamera(unsigned int cameraNumber)
+    {
+        // Pending frames are dropped - the statistics are kept until reset.
+        cameraStateMap_.erase(cameraNumber);
+    }
+
+
+    void FrameMatcher::addFrame(
+            unsigned int cameraNumber,
+            double time,
+            double hostTime,
+            const StampedImage &stampedImage,
+            std::vector<MatchedFrameSet> &setList
+            )
+    {
+        if (cameraStateMap_.count(cameraNumber) == 0)
+        {
+            return;
+        }
+        CameraState &state = cameraStateMap_[cameraNumber];
+        CameraSyncStats &stats = cameraStatsMap_[cameraNumber];
+        stats.numFrames++;
+
+        state.haveTime = true;
+        state.lastTime = time;
+        state.lastHostTime = hostTime;
+        state.stalled = false;
+
+        if (haveLastSet_ && (time <= lastSetEnd_))
+        {
+            stats.numLate++;
+        }
+        else
+        {
+            PendingFrame pendingFrame;
+            pendingFrame.time = time;
+            pendingFrame.hostTime = hostTime;
+            pendingFrame.stampedImage = stampedImage;
+            state.pendingList.push_back(pendingFrame);
+        }
+        update(hostTime, setList);
+    }
+
+
+    void FrameMatcher::update(double hostTime, std::vector<MatchedFrameSet> &setList)
+    {
+        MatchedFrameSet matchedSet;
+        while (makeSet(hostTime, false, matchedSet))
+        {
+            setList.push_back(matchedSet);
+        }
+    }
+
+
+    void FrameMatcher::flush(std::vector<MatchedFrameSet> &setList)
+    {
+        MatchedFrameSet matchedSet;
+        while (makeSet(0.0, true, matchedSet))
+        {
+            setList.push_back(matchedSet);
+        }
+    }
+
+
+    FrameSyncStats FrameMatcher::getStats() const
+    {
+        FrameSyncStats stats;
+        stats.toleranceUs = 1.0e6*tolerance_;
+        stats.numSets = setIndex_;
+        stats.numCompleteSets = numCompleteSets_;
+        for (auto &item : cameraStatsMap_)
+        {
+            CameraSyncStats cameraStats = item.second;
+            const ErrorSums &sums = errorSumsMap_.at(item.first);
+            if (cameraStats.numMatched > 0)
+            {
+                double num = double(cameraStats.numMatched);
+                cameraStats.meanErrorUs = 1.0e6*sums.absSum/num;
+                cameraStats.rmsErrorUs = 1.0e6*std::sqrt(sums.sqSum/num);
+                cameraStats.maxErrorUs = 1.0e6*sums.absMax;
+            }
+            stats.cameraStats[item.first] = cameraStats;
+        }
+        return stats;
+    }
+
+
+    bool FrameMatcher::makeSet(double hostTime, bool force, MatchedFrameSet &matchedSet)
+    {
+        // Reference is the earliest pending frame of all cameras
+        bool haveRef = false;
+        double refTime = 0.0;
+        double refHostTime = 0.0;
+        for (auto &item : cameraStateMap_)
+        {
+            const CameraState &state = item.second;
+            if (!state.pendingList.empty() && (!haveRef || (state.pendingList.front().time < refTime)))
+            {
+                refTime = state.pendingList.front().time;
+                refHostTime = state.pendingList.front().hostTime;
+                haveRef = true;
+            }
+        }
+        if (!haveRef)
+        {
+            return false;
+        }
+        double endTime = refTime + tolerance_;
+        bool timedOut = (hostTime - refHostTime) >= maxWait_;
+
+        // Wait until every camera has a frame in the set or has passed it
+        if (!force)
+        {
+            for (auto &item : cameraStateMap_)
+            {
+                const CameraState &state = item.second;
+                bool inSet = !state.pendingList.empty() && (state.pendingList.front().time <= endTime);
+                bool passed = state.stalled || (state.haveTime && (state.lastTime > endTime));
+                if (!inSet && !passed && !timedOut)
+                {
+                    return false;
+                }
+            }
+        }
+
+        unsigned int setSize = numberOfCameras_;
+        if (!cameraStateMap_.empty())
+        {
+            setSize = std::max(setSize, cameraStateMap_.rbegin() -> first + 1);
+        }
+        matchedSet = MatchedFrameSet();
+        matchedSet.setIndex = setIndex_;
+        matchedSet.haveFrame.assign(setSize, false);
+        matchedSet.frames.assign(setSize, StampedImage());
+        matchedSet.syncError.assign(setSize, 0.0);
+
+        std::vector<double> frameTime(setSize, 0.0);
+        double timeSum = 0.0;
+        unsigned int numInSet = 0;
+
+        for (auto &item : cameraStateMap_)
+        {
+            unsigned int cameraNumber = item.first;
+            CameraState &state = item.second;
+            if (state.pendingList.empty() || (state.pendingList.front().time > endTime))
+            {
+                cameraStatsMap_[cameraNumber].numMissing++;
+                if (timedOut && !(state.haveTime && (state.lastTime > endTime)))
+                {
+                    state.stalled = true;
+                }
+                continue;
+            }
+            matchedSet.haveFrame[cameraNumber] = true;
+            matchedSet.frames[cameraNumber] = state.pendingList.front().stampedImage;
+            frameTime[cameraNumber] = state.pendingList.front().time;
+            timeSum += frameTime[cameraNumber];
+            numInSet++;
+            state.pendingList.pop_front();
+
+            while (!state.pendingList.empty() && (state.pendingList.front().time <= endTime))
+            {
+                cameraStatsMap_[cameraNumber].numDuplicate++;
+                state.pendingList.pop_front();
+            }
+        }
+
+        matchedSet.timeStamp = timeSum/double(numInSet);
+        for (auto &item : cameraStateMap_)
+        {
+            unsigned int cameraNumber = item.first;
+            if (!matchedSet.haveFrame[cameraNumber])
+            {
+                continue;
+            }
+            double error = frameTime[cameraNumber] - matchedSet.timeStamp;
+            matchedSet.syncError[cameraNumber] = error;
+            cameraStatsMap_[cameraNumber].numMatched++;
+            ErrorSums &sums = errorSumsMap_[cameraNumber];
+            sums.absSum += std::fabs(error);
+            sums.sqSum += error*error;
+            sums.absMax = std::max(sums.absMax, std::fabs(error));
+        }
+
+        setIndex_++;
+        if (numInSet == cameraStateMap_.size())
+        {
+            numCompleteSets_++;
+        }
+        haveLastSet_ = true;
+        lastSetEnd_ = endTime;
+        return true;
+    }
+
+
+    // FrameSyncService
+    // ------------------------------------------------------------------------
+
+    const double FrameSyncService::MAX_WAIT = 1.0;
+    const size_t FrameSyncService::MAX_QUEUE_SIZE_PER_CAMERA = 256;
+
+    std::atomic<bool> FrameSyncService::enabled_(false);
+    std::atomic<bool> FrameSyncService::havePlugins_(false);
+    QMutex FrameSyncService::mutex_;
+    QWaitCondition FrameSyncService::frameWaitCond_;
+    unsigned int FrameSyncService::numberOfCameras_ = 0;
+    double FrameSyncService::tolerance_ = 0.0;
+    bool FrameSyncService::running_ = false;
+    bool FrameSyncService::stopRequested_ = false;
+    std::deque<std::pair<unsigned int, StampedImage>> FrameSyncService::frameQueue_;
+    unsigned long FrameSyncService::numDropped_ = 0;
+    unsigned long FrameSyncService::startCount_ = 0;
+    std::map<unsigned int, unsigned long> FrameSyncService::cameraStartMap_;
+    std::set<unsigned int> FrameSyncService::recordingSet_;
+    QString FrameSyncService::indexFileName_;
+    std::vector<MultiCameraPluginPtr> FrameSyncService::pluginList_;
+    FrameSyncStats FrameSyncService::stats_;
+
+
+    void FrameSyncService::setEnabled(bool enabled)
+    {
+        enabled_ = enabled;
+    }
+
+
+    bool FrameSyncService::isEnabled()
+    {
+        return enabled_;
+    }
+
+
+    void FrameSyncService::setNumberOfCameras(unsigned int numberOfCameras)
+    {
+        QMutexLocker locker(&mutex_);
+        numberOfCameras_ = numberOfCameras;
+    }
+
+
+    void FrameSyncService::setTolerance(double tolerance)
+    {
+        QMutexLocker locker(&mutex_);
+        tolerance_ = tolerance;
+    }
+
+
+    double FrameSyncService::getTolerance()
+    {
+        QMutexLocker locker(&mutex_);
+        return tolerance_;
+    }
+
+
+    void FrameSyncService::startCamera(unsigned int cameraNumber)
+    {
+        if (!enabled_)
+        {
+            return;
+        }
+        QMutexLocker locker(&mutex_);
+        startCount_++;
+        cameraStartMap_[cameraNumber] = startCount_;
+        stopRequested_ = false;
+        if (!running_)
+        {
+            // The worker decides to exit while holding the mutex, so if it is
+            // still running clearing stopRequested_ keeps it going.
+            running_ = true;
+            numDropped_ = 0;
+            stats_ = FrameSyncStats();
+            FrameSyncWorker *workerPtr = new FrameSyncWorker();
+            workerPtr -> setAutoDelete(true);
+            QThreadPool::globalInstance() -> start(workerPtr);
+        }
+    }
+
+
+    void FrameSyncService::stopCamera(unsigned int cameraNumber)
+    {
+        QMutexLocker locker(&mutex_);
+        cameraStartMap_.erase(cameraNumber);
+        recordingSet_.erase(cameraNumber);
+        if (recordingSet_.empty())
+        {
+            indexFileName_ = QString("");
+        }
+        if (cameraStartMap_.empty())
+        {
+            stopRequested_ = true;
+            frameWaitCond_.wakeAll();
+        }
+    }
+
+
+    void FrameSyncService::pushFrame(unsigned int cameraNumber, const StampedImage &stampedImage)
+    {
+        if (!enabled_)
+        {
+            return;
+        }
+
+        // Images are only passed on if a plugin needs them - holding them
+        // until their set is complete would keep pooled buffers in use.
+        StampedImage syncImage;
+        if (havePlugins_)
+        {
+            syncImage.image = stampedImage.image;
+        }
+        syncImage.timeStamp = stampedImage.timeStamp;
+        syncImage.dtEstimate = stampedImage.dtEstimate;
+        syncImage.frameCount = stampedImage.frameCount;
+        syncImage.stamps = stampedImage.stamps;
+        if (syncImage.stamps.ns[PIPELINE_STAGE_GRABBED] == 0)
+        {
+            syncImage.stamps.ns[PIPELINE_STAGE_GRABBED] = PipelineStamps::now();
+        }
+
+        QMutexLocker locker(&mutex_);
+        if (cameraStartMap_.count(cameraNumber) == 0)
+        {
+            return;
+        }
+        size_t maxQueueSize = MAX_QUEUE_SIZE_PER_CAMERA*cameraStartMap_.size();
+        if (frameQueue_.size() >= maxQueueSize)
+        {
+            numDropped_++;
+            return;
+        }
+        frameQueue_.push_back(std::make_pair(cameraNumber, syncImage));
+        frameWaitCond_.wakeOne();
+    }
+
+
+    void FrameSyncService::startRecording(unsigned int cameraNumber, QString indexFileName)
+    {
+        // The first camera to start logging names the index file
+        if (!enabled_)
+        {
+            return;
+        }
+        QMutexLocker locker(&mutex_);
+        recordingSet_.insert(cameraNumber);
+        if (indexFileName_.isEmpty())
+        {
+            indexFileName_ = indexFileName;
+        }
+    }
+
+
+    void FrameSyncService::stopRecording(unsigned int cameraNumber)
+    {
+        QMutexLocker locker(&mutex_);
+        recordingSet_.erase(cameraNumber);
+        if (recordingSet_.empty())
+        {
+            indexFileName_ = QString("");
+        }
+    }
+
+
+    void FrameSyncService::addPlugin(MultiCameraPluginPtr pluginPtr)
+    {
+        QMutexLocker locker(&mutex_);
+        if (std::find(pluginList_.begin(), pluginList_.end(), pluginPtr) == pluginList_.end())
+        {
+            pluginList_.push_back(pluginPtr);
+        }
+        havePlugins_ = !pluginList_.empty();
+    }
+
+
+    void FrameSyncService::removePlugin(MultiCameraPluginPtr pluginPtr)
+    {
+        QMutexLocker locker(&mutex_);
+        pluginList_.erase(
+                std::remove(pluginList_.begin(), pluginList_.end(), pluginPtr),
+                pluginList_.end()
+                );
+        havePlugins_ = !pluginList_.empty();
+    }
+
+
+    FrameSyncStats FrameSyncService::getStats()
+    {
+        QMutexLocker locker(&mutex_);
+        FrameSyncStats stats = stats_;
+        stats.enabled = enabled_;
+        return stats;
+    }
+
+
+    QString FrameSyncService::getStatusString(unsigned int cameraNumber)
+    {
+        FrameSyncStats stats = getStats();
+        if (stats.cameraStats.count(cameraNumber) == 0)
+        {
+            return QString("");
+        }
+        CameraSyncStats &cameraStats = stats.cameraStats[cameraNumber];
+        QString statusString = QString().sprintf(
+                "sync err %1.0f/%1.0f us",
+                cameraStats.meanErrorUs,
+                cameraStats.maxErrorUs
+                );
+        if (cameraStats.numMissing > 0)
+        {
+            statusString += QString(" (missing %1)").arg(cameraStats.numMissing);
+        }
+        return statusString;
+    }
+
+
+    // FrameSyncWorker
+    // ------------------------------------------------------------------------
+
+    FrameSyncWorker::FrameSyncWorker(QObject *parent) : QObject(parent)
+    { }
+
+
+    void FrameSyncWorker::run()
+    {
+        ThreadAffinityService::assignThreadAffinity(false,0);
+
+        std::map<unsigned int, unsigned long> cameraStartMap;
+        std::map<unsigned int, ClockSync> clockSyncMap;
+        std::map<unsigned int, double> frameIntervalMap;
+        std::deque<std::pair<unsigned int, StampedImage>> frameQueue;
+        std::vector<MatchedFrameSet> setList;
+        std::vector<MultiCameraPluginPtr> pluginList;
+
+        FrameMatcher matcher;
+        matcher.setMaxWait(FrameSyncService::MAX_WAIT);
+
+        std::ofstream indexStream;
+        QString indexFileName;
+        unsigned long indexCount = 0;
+        bool haveTimeZero = false;
+        double timeZero = 0.0;
+
+        FrameSyncService::mutex_.lock();
+        pluginList = FrameSyncService::pluginList_;
+        FrameSyncService::mutex_.unlock();
+        for (MultiCameraPluginPtr pluginPtr : pluginList)
+        {
+            pluginPtr -> acquireLock();
+            pluginPtr -> reset();
+            pluginPtr -> releaseLock();
+        }
+
+        bool done = false;
+        while (!done)
+        {
+            // Take the queued frames and a copy of the service's settings
+            FrameSyncService::mutex_.lock();
+            if (FrameSyncService::frameQueue_.empty() && !FrameSyncService::stopRequested_)
+            {
+                FrameSyncService::frameWaitCond_.wait(&FrameSyncService::mutex_, FRAME_SYNC_WAIT_TIMEOUT);
+            }
+            frameQueue.swap(FrameSyncService::frameQueue_);
+            std::map<unsigned int, unsigned long> cameraStartMapNew = FrameSyncService::cameraStartMap_;
+            QString indexFileNameNew = FrameSyncService::indexFileName_;
+            double tolerance = FrameSyncService::tolerance_;
+            unsigned int numberOfCameras = FrameSyncService::numberOfCameras_;
+            unsigned long numDropped = FrameSyncService::numDropped_;
+            pluginList = FrameSyncService::pluginList_;
+            if (FrameSyncService::stopRequested_ && frameQueue.empty())
+            {
+                FrameSyncService::running_ = false;
+                FrameSyncService::stopRequested_ = false;
+                done = true;
+            }
+            FrameSyncService::mutex_.unlock();
+
+            matcher.setNumberOfCameras(numberOfCameras);
+
+            // Cameras which have been (re)started get a fresh clock fit
+            for (auto &item : cameraStartMapNew)
+            {
+                auto it = cameraStartMap.find(item.first);
+                if ((it == cameraStartMap.end()) || (it -> second != item.second))
+                {
+                    clockSyncMap[item.first].reset();
+                    frameIntervalMap.erase(item.first);
+                    matcher.removeCamera(item.first);
+                    matcher.addCamera(item.first);
+                }
+            }
+            for (auto &item : cameraStartMap)
+            {
+                if (cameraStartMapNew.count(item.first) == 0)
+                {
+                    clockSyncMap.erase(item.first);
+                    frameIntervalMap.erase(item.first);
+                    matcher.removeCamera(item.first);
+                }
+            }
+            cameraStartMap = cameraStartMapNew;
+
+            // Tolerance - given or half the shortest frame interval
+            for (auto &item : frameQueue)
+            {
+                if (item.second.dtEstimate > 0.0)
+                {
+                    frameIntervalMap[item.first] = item.second.dtEstimate;
+                }
+            }
+            if (tolerance <= 0.0)
+            {
+                tolerance = FRAME_SYNC_FALLBACK_TOLERANCE;
+                if (!frameIntervalMap.empty())
+                {
+                    double minInterval = std::numeric_limits<double>::max();
+                    for (auto &item : frameIntervalMap)
+                    {
+                        minInterval = std::min(minInterval, item.second);
+                    }
+                    tolerance = 0.5*minInterval;
+                }
+            }
+            matcher.setTolerance(tolerance);
+
+            // Map frames to the host clock and match them
+            for (auto &item : frameQueue)
+            {
+                if (cameraStartMap.count(item.first) == 0)
+                {
+                    continue;
+                }
+                StampedImage &stampedImage = item.second;
+                double hostTime = 1.0e-9*double(stampedImage.stamps.ns[PIPELINE_STAGE_GRABBED]);
+                ClockSync &clockSync = clockSyncMap[item.first];
+                clockSync.update(stampedImage.timeStamp, hostTime);
+                double time = clockSync.toHostTime(stampedImage.timeStamp);
+                matcher.addFrame(item.first, time, hostTime, stampedImage, setList);
+            }
+            frameQueue.clear();
+            matcher.update(1.0e-9*double(PipelineStamps::now()), setList);
+            if (done)
+            {
+                matcher.flush(setList);
+            }
+
+            // Shared frame index - open or close as cameras start and stop logging
+            if (indexFileNameNew != indexFileName)
+            {
+                if (indexStream.is_open())
+                {
+                    indexStream.close();
+                }
+                indexFileName = indexFileNameNew;
+                indexCount = 0;
+                if (!indexFileName.isEmpty())
+                {
+                    indexStream.open(indexFileName.toStdString());
+                    if (indexStream.is_open())
+                    {
+                        indexStream << "# BIAS synchronized frame index" << std::endl;
+                        indexStream << "# set, time (s)";
+                        for (unsigned int i=0; i<numberOfCameras; i++)
+                        {
+                            indexStream << ", cam" << i << " frame, cam" << i << " time (s)";
+                        }
+                        indexStream << std::endl;
+                        indexStream << std::fixed << std::setprecision(6);
+                    }
+                    else
+                    {
+                        std::cout << "unable to open frame sync index file: ";
+                        std::cout << indexFileName.toStdString() << std::endl;
+                    }
+                }
+            }
+
+            for (MatchedFrameSet &matchedSet : setList)
+            {
+                if (!haveTimeZero)
+                {
+                    timeZero = matchedSet.timeStamp;
+                    haveTimeZero = true;
+                }
+
+                // Frames are identified by their frame count and their camera
+                // time stamp, as written to the video files. Missing = -1.
+                if (indexStream.is_open())
+                {
+                    indexStream << indexCount << ", " << (matchedSet.timeStamp - timeZero);
+                    for (unsigned int i=0; i<numberOfCameras; i++)
+                    {
+                        if ((i < matchedSet.haveFrame.size()) && matchedSet.haveFrame[i])
+                        {
+                            indexStream << ", " << matchedSet.frames[i].frameCount;
+                            indexStream << ", " << matchedSet.frames[i].timeStamp;
+                        }
+                        else
+                        {
+                            indexStream << ", -1, -1";
+                        }
+                    }
+                    indexStream << '\n';
+                    indexCount++;
+                }
+
+                for (MultiCameraPluginPtr pluginPtr : pluginList)
+                {
+                    pluginPtr -> acquireLock();
+                    pluginPtr -> processMatchedSet(matchedSet);
+                    pluginPtr -> releaseLock();
+                }
+            }
+            setList.clear();
+
+            // Publish statistics
+            FrameSyncStats stats = matcher.getStats();
+            stats.recording = indexStream.is_open();
+            stats.numDropped = numDropped;
+            for (auto &item : clockSyncMap)
+            {
+                if (stats.cameraStats.count(item.first) > 0)
+                {
+                    stats.cameraStats[item.first].clockOffset = item.second.getOffset();
+                    stats.cameraStats[item.first].clockDriftPpm = 1.0e6*item.second.getDrift();
+                }
+            }
+            FrameSyncService::mutex_.lock();
+            FrameSyncService::stats_ = stats;
+            FrameSyncService::mutex_.unlock();
+        }
+
+        if (indexStream.is_open())
+        {
+            indexStream.close();
+        }
+        for (MultiCameraPluginPtr pluginPtr : pluginList)
+        {
+            pluginPtr -> acquireLock();
+            pluginPtr -> stop();
+            pluginPtr -> releaseLock();
+        }
+    }
+
+} // namespace bias
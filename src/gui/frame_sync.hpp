@@ -0,0 +1,271 @@
+#ifndef BIAS_FRAME_SYNC_HPP
+#define BIAS_FRAME_SYNC_HPP
+
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+#include <QVariantMap>
+#include "lockable.hpp"
+#include "stamped_image.hpp"
+#include "matched_frame_set.hpp"
+#include "multi_camera_plugin.hpp"
+
+namespace bias
+{
+
+    class ClockSync
+    {
+        // --------------------------------------------------------------------
+        // Maps a camera's time stamps onto the host's monotonic clock. The
+        // offset (host time - camera time) of each frame is the true clock
+        // offset plus the frame's transfer latency, so the lower envelope of
+        // the offsets estimates the true offset. The minimum offset is taken
+        // over windows of camera time and a line is fitted to the recent
+        // window minima to follow drift between the camera and host clocks.
+        //
+        // A refit may step the mapping backwards. Mapped times are kept
+        // increasing for frames mapped in time order: a backwards step is
+        // slewed in, at up to MAX_SLEW_RATE of the camera time elapsed, rather
+        // than applied at once.
+        // --------------------------------------------------------------------
+
+        public:
+
+            static const double WINDOW_DURATION;
+            static const unsigned int MIN_NUMBER_OF_FIT_WINDOWS;
+            static const unsigned int MAX_NUMBER_OF_WINDOWS;
+            static const double MAX_SLEW_RATE;
+
+            ClockSync();
+            void reset();
+            void update(double cameraTime, double hostTime);
+            double toHostTime(double cameraTime);
+            double getOffset() const;   // host - camera time at the latest frame (s)
+            double getDrift() const;    // relative rate of the host and camera clocks
+            bool isValid() const;
+
+        private:
+
+            struct WindowMin
+            {
+                double cameraTime;
+                double offset;
+            };
+
+            std::deque<WindowMin> windowList_;
+            WindowMin current_;
+            double windowStart_;
+            bool haveCurrent_;
+            double lastCameraTime_;
+
+            bool haveMapped_;
+            double lastMappedCameraTime_;
+            double lastMappedHostTime_;
+
+            double fitCameraTime_;
+            double fitOffset_;
+            double fitDrift_;
+
+            void fit();
+    };
+
+
+    struct CameraSyncStats
+    {
+        unsigned long numFrames;        // frames received
+        unsigned long numMatched;       // frames placed in a matched set
+        unsigned long numMissing;       // sets without a frame from the camera
+        unsigned long numDuplicate;     // extra frames within a set's tolerance - discarded
+        unsigned long numLate;          // frames arriving after their set was made - discarded
+        double meanErrorUs;             // |frame time - set time|
+        double rmsErrorUs;
+        double maxErrorUs;
+        double clockOffset;             // host - camera clock (s)
+        double clockDriftPpm;
+
+        CameraSyncStats();
+        QVariantMap toMap() const;
+    };
+
+
+    struct FrameSyncStats
+    {
+        bool enabled;
+        bool recording;
+        double toleranceUs;
+        unsigned long numSets;
+        unsigned long numCompleteSets;
+        unsigned long numDropped;       // frames dropped as the sync thread fell behind
+        std::map<unsigned int, CameraSyncStats> cameraStats;
+
+        FrameSyncStats();
+        QVariantMap toMap() const;
+    };
+
+
+    class FrameMatcher
+    {
+        // --------------------------------------------------------------------
+        // Groups frames from several cameras into matched sets. Frames must
+        // be added in time order for each camera, with times on a common
+        // clock. A set is made from the earliest pending frame and the
+        // frames of the other cameras within the tolerance of it, once every
+        // camera has either supplied such a frame or moved past it. Cameras
+        // which supply nothing for maxWait (host time) are treated as
+        // stalled, and missing from the sets, until their next frame.
+        // --------------------------------------------------------------------
+
+        public:
+
+            FrameMatcher();
+            void reset();
+
+            void setNumberOfCameras(unsigned int numberOfCameras);
+            void setTolerance(double tolerance);
+            void setMaxWait(double maxWait);
+            double getTolerance() const;
+
+            void addCamera(unsigned int cameraNumber);
+            void removeCamera(unsigned int cameraNumber);
+
+            void addFrame(
+                    unsigned int cameraNumber,
+                    double time,
+                    double hostTime,
+                    const StampedImage &stampedImage,
+                    std::vector<MatchedFrameSet> &setList
+                    );
+            void update(double hostTime, std::vector<MatchedFrameSet> &setList);
+            void flush(std::vector<MatchedFrameSet> &setList);
+
+            FrameSyncStats getStats() const;
+
+        private:
+
+            struct PendingFrame
+            {
+                double time;
+                double hostTime;
+                StampedImage stampedImage;
+            };
+
+            struct CameraState
+            {
+                std::deque<PendingFrame> pendingList;
+                bool haveTime;
+                double lastTime;
+                double lastHostTime;
+                bool stalled;
+                CameraState();
+            };
+
+            struct ErrorSums
+            {
+                double absSum;
+                double sqSum;
+                double absMax;
+                ErrorSums();
+            };
+
+            unsigned int numberOfCameras_;
+            double tolerance_;
+            double maxWait_;
+            unsigned long setIndex_;
+            unsigned long numCompleteSets_;
+            bool haveLastSet_;
+            double lastSetEnd_;
+
+            std::map<unsigned int, CameraState> cameraStateMap_;
+            std::map<unsigned int, CameraSyncStats> cameraStatsMap_;
+            std::map<unsigned int, ErrorSums> errorSumsMap_;
+
+            bool makeSet(double hostTime, bool force, MatchedFrameSet &matchedSet);
+    };
+
+
+    class FrameSyncService
+    {
+        // --------------------------------------------------------------------
+        // Process wide service which synchronizes the frames of all cameras.
+        // Each camera's dispatcher passes it every frame. The frame sync
+        // thread maps the frames' camera time stamps onto the host clock,
+        // groups them into matched sets, passes the sets to the registered
+        // multi-camera plugins and, while any camera is logging, writes them
+        // to a frame index file shared by all cameras.
+        // --------------------------------------------------------------------
+
+        public:
+
+            static const double MAX_WAIT;
+            static const size_t MAX_QUEUE_SIZE_PER_CAMERA;
+
+            static void setEnabled(bool enabled);
+            static bool isEnabled();
+            static void setNumberOfCameras(unsigned int numberOfCameras);
+
+            // Tolerance (s) for frames to belong to the same set - zero, the
+            // default, means half the cameras' shortest frame interval.
+            static void setTolerance(double tolerance);
+            static double getTolerance();
+
+            static void startCamera(unsigned int cameraNumber);
+            static void stopCamera(unsigned int cameraNumber);
+            static void pushFrame(unsigned int cameraNumber, const StampedImage &stampedImage);
+
+            static void startRecording(unsigned int cameraNumber, QString indexFileName);
+            static void stopRecording(unsigned int cameraNumber);
+
+            static void addPlugin(MultiCameraPluginPtr pluginPtr);
+            static void removePlugin(MultiCameraPluginPtr pluginPtr);
+
+            static FrameSyncStats getStats();
+            static QString getStatusString(unsigned int cameraNumber);
+
+        private:
+
+            static std::atomic<bool> enabled_;
+            static std::atomic<bool> havePlugins_;
+
+            // Use mutex_ when accessing these values
+            // --------------------------------------
+            static QMutex mutex_;
+            static QWaitCondition frameWaitCond_;
+            static unsigned int numberOfCameras_;
+            static double tolerance_;
+            static bool running_;
+            static bool stopRequested_;
+            static std::deque<std::pair<unsigned int, StampedImage>> frameQueue_;
+            static unsigned long numDropped_;
+            static unsigned long startCount_;
+            static std::map<unsigned int, unsigned long> cameraStartMap_;  // camera -> start count
+            static std::set<unsigned int> recordingSet_;
+            static QString indexFileName_;
+            static std::vector<MultiCameraPluginPtr> pluginList_;
+            static FrameSyncStats stats_;
+            // --------------------------------------
+
+            friend class FrameSyncWorker;
+    };
+
+
+    class FrameSyncWorker : public QObject, public QRunnable, public Lockable<Empty>
+    {
+        Q_OBJECT
+
+        public:
+            FrameSyncWorker(QObject *parent=0);
+
+        private:
+            void run();
+    };
+
+} // namespace bias
+
+#endif // #ifndef BIAS_FRAME_SYNC_HPP
@@ -1,18 +1,10 @@
 #include "image_dispatcher.hpp"
 #include "stamped_image.hpp"
 #include "affinity.hpp"
+#include "frame_sync.hpp"
 #include <iostream>
 #include <QThread>
 
-// DEVEL
-// ----------------------------------------------------------------------------
-#include "camera_window.hpp"
-#include <QDir>
-#include <QFileInfo>
-#include <fstream>
-#include <QtDebug>
-// ----------------------------------------------------------------------------
-
 namespace bias
 {
 
@@ -25,9 +17,9 @@ namespace bias
             bool logging,
             bool pluginEnabled,
             unsigned int cameraNumber,
-            std::shared_ptr<LockableQueue<StampedImage>> newImageQueuePtr, 
-            std::shared_ptr<LockableQueue<StampedImage>> logImageQueuePtr, 
-            std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr,
+            std::shared_ptr<SpscRingBuffer<StampedImage>> newImageQueuePtr, 
+            std::shared_ptr<SpscRingBuffer<StampedImage>> logImageQueuePtr, 
+            std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr,
             QObject *parent
             ) : QObject(parent)
     {
@@ -45,9 +37,9 @@ namespace bias
             bool logging,
             bool pluginEnabled,
             unsigned int cameraNumber,
-            std::shared_ptr<LockableQueue<StampedImage>> newImageQueuePtr,
-            std::shared_ptr<LockableQueue<StampedImage>> logImageQueuePtr,
-            std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr
+            std::shared_ptr<SpscRingBuffer<StampedImage>> newImageQueuePtr,
+            std::shared_ptr<SpscRingBuffer<StampedImage>> logImageQueuePtr,
+            std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr
             ) 
     {
         newImageQueuePtr_ = newImageQueuePtr;
@@ -74,12 +66,28 @@ namespace bias
 
         frameCount_ = 0;
         currentTimeStamp_ = 0.0;
+
+        previewImage_ = PreviewImage();
+        previewRequested_ = false; // first request made with the preview params
+        previewMaxSize_ = cv::Size(0,0);
+        previewColorMap_ = -1;
+    }
+
+    PreviewImage ImageDispatcher::getPreviewImage()
+    {
+        // Returns the latest preview (empty if there is no new one since the 
+        // last call) and requests the next. Previews are only made on request 
+        // so they are produced at the display rate, whatever the frame rate.
+        PreviewImage previewImage = previewImage_;
+        previewImage_ = PreviewImage();
+        previewRequested_ = true;
+        return previewImage;
     }
 
-    cv::Mat ImageDispatcher::getImage() const
+    void ImageDispatcher::setPreviewParams(cv::Size maxSize, int colorMap)
     {
-        cv::Mat currentImageCopy = currentImage_.clone();
-        return currentImageCopy;
+        previewMaxSize_ = maxSize;
+        previewColorMap_ = colorMap;
     }
 
     double ImageDispatcher::getTimeStamp() const
@@ -102,6 +110,36 @@ namespace bias
         stopped_ = true;
     }
 
+    void ImageDispatcher::setImagePool(ImagePoolPtr imagePoolPtr)
+    {
+        imagePoolPtr_ = imagePoolPtr;
+    }
+
+    ImagePoolStats ImageDispatcher::getImagePoolStats() const
+    {
+        // Pool statistics are internally synchronized - no lock required
+        if (imagePoolPtr_)
+        {
+            return imagePoolPtr_ -> getStats();
+        }
+        return ImagePoolStats();
+    }
+
+    void ImageDispatcher::setPipelineStats(PipelineStatsPtr pipelineStatsPtr)
+    {
+        pipelineStatsPtr_ = pipelineStatsPtr;
+    }
+
+    void ImageDispatcher::setStatusPublisher(CameraStatusPublisherPtr statusPublisherPtr)
+    {
+        statusPublisherPtr_ = statusPublisherPtr;
+    }
+
+    void ImageDispatcher::setTraceFileName(QString traceFileName)
+    {
+        traceFileName_ = traceFileName;
+    }
+
 
     void ImageDispatcher::run()
     {
@@ -125,67 +163,96 @@ namespace bias
         fpsEstimator_.reset();
         releaseLock();
 
-        // DEVEL - make this non development. Need to pass video file dir as argument
-        // ---------------------------------------------------------------------------
-        CameraWindow* cameraWindowPtr = qobject_cast<CameraWindow *>(parent());
-        QDir videoFileDir = cameraWindowPtr -> getVideoFileDir();
-        QString stampLogName = QString("stamp_log_cam%1.txt").arg(cameraNumber_);
-        QFileInfo stampFileInfo = QFileInfo(videoFileDir, stampLogName);
-        std::string stampFileName = stampFileInfo.absoluteFilePath().toStdString();
-        std::ofstream stampOutStream;
-        stampOutStream.open(stampFileName);
-        // ---------------------------------------------------------------------------
+        // Optional binary trace of frame time stamps
+        PipelineTrace trace;
+        if (!traceFileName_.isEmpty())
+        {
+            if (!trace.open(traceFileName_))
+            {
+                std::cout << "unable to open pipeline trace file: ";
+                std::cout << traceFileName_.toStdString() << std::endl;
+            }
+        }
 
         while (!done) 
         {
 
-            newImageQueuePtr_ -> acquireLock();
             newImageQueuePtr_ -> waitIfEmpty();
-            if (newImageQueuePtr_ -> empty())
+            if (!(newImageQueuePtr_ -> tryPop(newStampImage)))
             {
-                newImageQueuePtr_ -> releaseLock();
                 break;
             }
-            newStampImage = newImageQueuePtr_ -> front();
-            newImageQueuePtr_ -> pop();
-            newImageQueuePtr_ -> releaseLock();
+
+            // Stamp before the frame is copied into the log and plugin queues
+            if (pipelineStatsPtr_)
+            {
+                pipelineStatsPtr_ -> recordStage(PIPELINE_STAGE_DISPATCHED, newStampImage.stamps);
+                pipelineStatsPtr_ -> updateQueue(
+                        PIPELINE_QUEUE_NEW, 
+                        newImageQueuePtr_ -> size(), 
+                        newImageQueuePtr_ -> numDropped()
+                        );
+            }
 
             if (logging_ )
             {
-                logImageQueuePtr_ -> acquireLock();
                 logImageQueuePtr_ -> push(newStampImage);
-                logImageQueuePtr_ -> signalNotEmpty();
-                logImageQueuePtr_ -> releaseLock();
             }
 
             if (pluginEnabled_)
             {
-                pluginImageQueuePtr_ -> acquireLock();
                 pluginImageQueuePtr_ -> push(newStampImage);
-                pluginImageQueuePtr_ -> signalNotEmpty();
-                pluginImageQueuePtr_ -> releaseLock();
             }
 
+            // Multi-camera frame synchronization - no-op unless enabled
+            FrameSyncService::pushFrame(cameraNumber_, newStampImage);
+
             acquireLock();
-            currentImage_ = newStampImage.image;
             currentTimeStamp_ = newStampImage.timeStamp;
             frameCount_ = newStampImage.frameCount;
             fpsEstimator_.update(newStampImage.timeStamp);
+            double framesPerSec = fpsEstimator_.getValue();
             done = stopped_;
+            bool makePreview = previewRequested_;
+            previewRequested_ = false;
+            cv::Size previewMaxSize = previewMaxSize_;
+            int previewColorMap = previewColorMap_;
             releaseLock();
 
-            // DEVEL
-            // ----------------------------------------------------------------
-            stampOutStream << QString::number(currentTimeStamp_,'g',15).toStdString(); 
-            stampOutStream << std::endl;
-            // ----------------------------------------------------------------
+            // For status queries answered off the GUI thread
+            if (statusPublisherPtr_)
+            {
+                statusPublisherPtr_ -> publishFrame(
+                        newStampImage.frameCount, 
+                        newStampImage.timeStamp, 
+                        framesPerSec
+                        );
+            }
+
+            // Downsample, colour map and histogram the frame for display here, 
+            // rather than on the GUI thread, after it has been passed on. 
+            if (makePreview)
+            {
+                PreviewImage previewImage = createPreviewImage(
+                        newStampImage.image, 
+                        previewMaxSize, 
+                        previewColorMap
+                        );
+                previewImage.frameCount = newStampImage.frameCount;
+                previewImage.timeStamp = newStampImage.timeStamp;
+                acquireLock();
+                previewImage_ = previewImage;
+                releaseLock();
+            }
+
+            if (trace.isOpen())
+            {
+                trace.write(newStampImage.frameCount, newStampImage.timeStamp, newStampImage.stamps);
+            }
 
         }
 
-        // DEVEL
-        // --------------------------------------------------------------------
-        stampOutStream.close();
-        // --------------------------------------------------------------------
+        trace.close();
     }
 
 } // namespace bias
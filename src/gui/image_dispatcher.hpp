@@ -8,6 +8,10 @@
 #include <opencv2/core/core.hpp>
 #include "fps_estimator.hpp"
 #include "lockable.hpp"
+#include "image_pool.hpp"
+#include "pipeline_stats.hpp"
+#include "image_preview.hpp"
+#include "camera_status.hpp"
 
 namespace bias
 {
@@ -25,9 +29,9 @@ namespace bias
                     bool logging,
                     bool pluginEnabled,
                     unsigned int cameraNumber,
-                    std::shared_ptr<LockableQueue<StampedImage>> newImageQueuePtr, 
-                    std::shared_ptr<LockableQueue<StampedImage>> logImageQueuePtr, 
-                    std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr,
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> newImageQueuePtr, 
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> logImageQueuePtr, 
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr,
                     QObject *parent = 0
                     );
 
@@ -35,36 +39,55 @@ namespace bias
                     bool logging,
                     bool pluginEnabled,
                     unsigned int cameraNumber,
-                    std::shared_ptr<LockableQueue<StampedImage>> newImageQueuePtr,
-                    std::shared_ptr<LockableQueue<StampedImage>> logImageQueuePtr ,
-                    std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> newImageQueuePtr,
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> logImageQueuePtr ,
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr
                     );
 
             // Use lock when calling these methods
             // ----------------------------------
             void stop();
-            cv::Mat getImage() const;     // Note, might want to change so that we return 
-            double getTimeStamp() const;  // the stampedImage.
+            PreviewImage getPreviewImage();
+            void setPreviewParams(cv::Size maxSize, int colorMap);
+            double getTimeStamp() const;
             double getFPS() const;
             unsigned long getFrameCount() const;
             // -----------------------------------
 
+            void setImagePool(ImagePoolPtr imagePoolPtr);
+            ImagePoolStats getImagePoolStats() const;
+
+            // Set before the dispatcher is started. The trace is only written
+            // if a file name is given.
+            void setPipelineStats(PipelineStatsPtr pipelineStatsPtr);
+            void setTraceFileName(QString traceFileName);
+
+            // Set before the dispatcher is started
+            void setStatusPublisher(CameraStatusPublisherPtr statusPublisherPtr);
+
         private:
             bool ready_;
             bool logging_;
             bool pluginEnabled_;
             unsigned int cameraNumber_;
-            std::shared_ptr<LockableQueue<StampedImage>> newImageQueuePtr_;
-            std::shared_ptr<LockableQueue<StampedImage>> logImageQueuePtr_;
-            std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr_;
+            ImagePoolPtr imagePoolPtr_;
+            PipelineStatsPtr pipelineStatsPtr_;
+            CameraStatusPublisherPtr statusPublisherPtr_;
+            QString traceFileName_;
+            std::shared_ptr<SpscRingBuffer<StampedImage>> newImageQueuePtr_;
+            std::shared_ptr<SpscRingBuffer<StampedImage>> logImageQueuePtr_;
+            std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr_;
 
             // use lock when setting these values
             // -----------------------------------
             bool stopped_;
-            cv::Mat currentImage_;        // Note, might want to change so that we store
-            double currentTimeStamp_;     // the stampedImage. 
+            double currentTimeStamp_;
             FPS_Estimator fpsEstimator_;
             unsigned long frameCount_;
+            PreviewImage previewImage_;
+            bool previewRequested_;
+            cv::Size previewMaxSize_;
+            int previewColorMap_;
             // ------------------------------------
 
             void run();
@@ -8,8 +8,15 @@
 #include <QThread>
 #include <QFileInfo>
 #include <opencv2/core/core.hpp>
+#include <chrono>
 #include "video_utils.hpp"
 
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 // TEMPOERARY
 // ----------------------------------------
 #include <opencv2/highgui/highgui.hpp>
@@ -21,6 +28,8 @@ namespace bias {
     unsigned int ImageGrabber::DEFAULT_NUM_STARTUP_SKIP = 2;
     unsigned int ImageGrabber::MIN_STARTUP_SKIP = 2;
     unsigned int ImageGrabber::MAX_ERROR_COUNT = 500;
+    int ImageGrabber::BLOCKING_GRAB_TIMEOUT_MS = 5;
+    double ImageGrabber::STATS_UPDATE_INTERVAL = 1.0;
 
     ImageGrabber::ImageGrabber(QObject *parent) : QObject(parent) 
     {
@@ -30,7 +39,7 @@ namespace bias {
     ImageGrabber::ImageGrabber (
             unsigned int cameraNumber,
             std::shared_ptr<Lockable<Camera>> cameraPtr,
-            std::shared_ptr<LockableQueue<StampedImage>> newImageQueuePtr, 
+            std::shared_ptr<SpscRingBuffer<StampedImage>> newImageQueuePtr, 
             QObject *parent
             ) : QObject(parent)
     {
@@ -40,7 +49,7 @@ namespace bias {
     void ImageGrabber::initialize( 
             unsigned int cameraNumber,
             std::shared_ptr<Lockable<Camera>> cameraPtr,
-            std::shared_ptr<LockableQueue<StampedImage>> newImageQueuePtr 
+            std::shared_ptr<SpscRingBuffer<StampedImage>> newImageQueuePtr 
             ) 
     {
         capturing_ = false;
@@ -49,6 +58,8 @@ namespace bias {
         newImageQueuePtr_ = newImageQueuePtr;
         numStartUpSkip_ = DEFAULT_NUM_STARTUP_SKIP;
         cameraNumber_ = cameraNumber;
+        grabMode_ = GRAB_MODE_POLL;
+        stats_ = GrabberStats();
         if ((cameraPtr_ != NULL) && (newImageQueuePtr_ != NULL))
         {
             ready_ = true;
@@ -71,11 +82,29 @@ namespace bias {
     void ImageGrabber::setVideoFileName(QString captureVideoFileName) {
         vidFileName_ = captureVideoFileName;
     }
+    void ImageGrabber::setImagePool(ImagePoolPtr imagePoolPtr) {
+        imagePoolPtr_ = imagePoolPtr;
+    }
+    void ImageGrabber::setGrabMode(GrabMode grabMode) {
+        grabMode_ = grabMode;
+    }
+    void ImageGrabber::setPipelineStats(PipelineStatsPtr pipelineStatsPtr) {
+        pipelineStatsPtr_ = pipelineStatsPtr;
+    }
+
+    GrabberStats ImageGrabber::getStats()
+    {
+        acquireLock();
+        GrabberStats stats = stats_;
+        releaseLock();
+        return stats;
+    }
 
     void ImageGrabber::initializeVidBackend()
     {
         printf("Reading from video file %s\n", vidFileName_.toStdString().c_str());
         vidObj_ = new videoBackend(vidFileName_);
+        vidObj_->setImagePool(imagePoolPtr_);
         int vid_numFrames = vidObj_->getNumFrames();
         printf("Video has %d frames\n", vid_numFrames);
         vidObj_->checkCapOpen();
@@ -119,6 +148,27 @@ namespace bias {
 
         QString errorMsg("no message");
 
+        // In blocking mode the grab call sleeps (with timeout) until a frame is 
+        // available rather than returning immediately - no need to yield/spin.
+        bool isBlocking = (grabMode_ == GRAB_MODE_BLOCKING);
+
+        // Cpu load and latency statistics. Camera timestamps and the host clock 
+        // have an unknown offset so latency is measured relative to the minimum
+        // observed offset, i.e., it is the delay in excess of the best case. 
+        typedef std::chrono::steady_clock SteadyClock;
+        SteadyClock::time_point hostTimeInit = SteadyClock::now();
+        bool haveHostOffset = false;
+        double minHostOffset = 0.0;
+        double statsWallTimeLast = 0.0;
+        double statsCpuTimeLast = getThreadCpuTime();
+        double latencySum = 0.0;
+        double latencyMax = 0.0;
+        unsigned long latencyCount = 0;
+
+        acquireLock();
+        stats_ = GrabberStats();
+        releaseLock();
+
         if (!ready_) 
         { 
             return; 
@@ -132,11 +182,13 @@ namespace bias {
         // Start image capture
         if (isVideo_) {
             initializeVidBackend();
+            vidObj_->setRealTimePacing(isBlocking);
         }
         else {
             cameraPtr_->acquireLock();
             try
             {
+                cameraPtr_->setGrabTimeout(isBlocking ? BLOCKING_GRAB_TIMEOUT_MS : -1);
                 cameraPtr_->startCapture();
             }
             catch (RuntimeError& runtimeError)
@@ -190,7 +242,14 @@ namespace bias {
             done = stopped_;
             releaseLock();
 
-            // Grab an image
+            // Grab an image. The camera lock is held only for the grab itself -
+            // video pacing sleeps before it is taken, and blocking grabs time
+            // out after BLOCKING_GRAB_TIMEOUT_MS so the lock is released
+            // between attempts while waiting for a frame.
+            error = false;
+            if (isVideo_) {
+                vidObj_->waitForNextFrame();
+            }
             cameraPtr_->acquireLock();
             if (isVideo_) {
                 try
@@ -225,10 +284,15 @@ namespace bias {
             }
             cameraPtr_->releaseLock();
 
-            // grabImage is nonblocking - returned frame is empty is a new frame is not available.
+            // In poll mode grabImage is nonblocking - returned frame is empty if a new 
+            // frame is not available. In blocking mode an empty frame means the grab
+            // timed out and we can simply check for stop and try again.
             if (stampImg.image.empty()) 
             { 
-                QThread::yieldCurrentThread();
+                if (!isBlocking)
+                {
+                    QThread::yieldCurrentThread();
+                }
                 continue; 
             }
             
@@ -309,11 +373,51 @@ namespace bias {
                 stampImg.frameCount = frameCount;
                 stampImg.dtEstimate = dtEstimate;
                 frameCount++;
+                if (pipelineStatsPtr_)
+                {
+                    pipelineStatsPtr_ -> recordStage(PIPELINE_STAGE_GRABBED, stampImg.stamps);
+                }
 
-                newImageQueuePtr_ -> acquireLock();
+                // Bounded hand-off - if the dispatcher falls behind the frame is
+                // dropped and counted by the queue rather than blocking the grabber.
                 newImageQueuePtr_ -> push(stampImg);
-                newImageQueuePtr_ -> signalNotEmpty(); 
-                newImageQueuePtr_ -> releaseLock();
+
+                // Update latency and cpu load statistics 
+                std::chrono::duration<double> hostTime = SteadyClock::now() - hostTimeInit;
+                double hostOffset = hostTime.count() - timeStampDbl;
+                if ((!haveHostOffset) || (hostOffset < minHostOffset))
+                {
+                    minHostOffset = hostOffset;
+                    haveHostOffset = true;
+                }
+                double latency = hostOffset - minHostOffset;
+                latencySum += latency;
+                if (latency > latencyMax)
+                {
+                    latencyMax = latency;
+                }
+                latencyCount++;
+                if (pipelineStatsPtr_)
+                {
+                    pipelineStatsPtr_ -> recordLatency(PIPELINE_STAGE_GRABBED, int64_t(1.0e9*latency));
+                }
+
+                if ((hostTime.count() - statsWallTimeLast) >= STATS_UPDATE_INTERVAL)
+                {
+                    double cpuTime = getThreadCpuTime();
+                    double wallDelta = hostTime.count() - statsWallTimeLast;
+                    acquireLock();
+                    stats_.cpuLoad = (cpuTime - statsCpuTimeLast)/wallDelta;
+                    stats_.meanLatencyUs = 1.0e6*latencySum/double(latencyCount);
+                    stats_.maxLatencyUs = 1.0e6*latencyMax;
+                    stats_.numFrames = frameCount;
+                    releaseLock();
+                    statsWallTimeLast = hostTime.count();
+                    statsCpuTimeLast = cpuTime;
+                    latencySum = 0.0;
+                    latencyMax = 0.0;
+                    latencyCount = 0;
+                }
 
             }
             else
@@ -373,6 +477,32 @@ namespace bias {
         return timeStampDbl;
     }
 
+
+    double ImageGrabber::getThreadCpuTime()
+    {
+        // Returns cpu time (user + kernel) in seconds consumed by the calling thread
+#ifdef WIN32
+        FILETIME creationTime, exitTime, kernelTime, userTime;
+        if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+        {
+            return 0.0;
+        }
+        ULARGE_INTEGER kernel, user;
+        kernel.LowPart = kernelTime.dwLowDateTime;
+        kernel.HighPart = kernelTime.dwHighDateTime;
+        user.LowPart = userTime.dwLowDateTime;
+        user.HighPart = userTime.dwHighDateTime;
+        return 1.0e-7*double(kernel.QuadPart + user.QuadPart);
+#else
+        struct timespec ts;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        {
+            return 0.0;
+        }
+        return double(ts.tv_sec) + 1.0e-9*double(ts.tv_nsec);
+#endif
+    }
+
 } // namespace bias
 
 
@@ -10,12 +10,23 @@
 #include "camera_fwd.hpp"
 #include "lockable.hpp"
 #include "video_utils.hpp"
+#include "image_pool.hpp"
+#include "pipeline_stats.hpp"
 
 namespace bias
 {
 
     struct StampedImage;
 
+    struct GrabberStats
+    {
+        double cpuLoad;          // grabber thread cpu time / wall time (0-1)
+        double meanLatencyUs;    // mean frame latency over last interval
+        double maxLatencyUs;     // max frame latency over last interval
+        unsigned long numFrames; // frames pushed since capture started
+        GrabberStats() : cpuLoad(0.0), meanLatencyUs(0.0), maxLatencyUs(0.0), numFrames(0) {};
+    };
+
     class ImageGrabber : public QObject, public QRunnable, public Lockable<Empty>
     {
         Q_OBJECT
@@ -26,14 +37,14 @@ namespace bias
             ImageGrabber(
                     unsigned int cameraNumber,
                     std::shared_ptr<Lockable<Camera>> cameraPtr,
-                    std::shared_ptr<LockableQueue<StampedImage>> newImageQueuePtr, 
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> newImageQueuePtr, 
                     QObject *parent=0
                     );
 
             void initialize(
                     unsigned int cameraNumber,
                     std::shared_ptr<Lockable<Camera>> cameraPtr,
-                    std::shared_ptr<LockableQueue<StampedImage>> newImageQueuePtr 
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> newImageQueuePtr 
                     );
 
             void initializeVidBackend();
@@ -43,10 +54,16 @@ namespace bias
             void disableErrorCount();
             void setIsVideo(bool v);
             void setVideoFileName(QString captureVideoFileName);
+            void setImagePool(ImagePoolPtr imagePoolPtr);
+            void setGrabMode(GrabMode grabMode);
+            void setPipelineStats(PipelineStatsPtr pipelineStatsPtr);
+            GrabberStats getStats();
 
             static unsigned int DEFAULT_NUM_STARTUP_SKIP;
             static unsigned int MIN_STARTUP_SKIP;
             static unsigned int MAX_ERROR_COUNT;
+            static int BLOCKING_GRAB_TIMEOUT_MS;
+            static double STATS_UPDATE_INTERVAL;
 
         signals:
             void startTimer();
@@ -61,17 +78,22 @@ namespace bias
             bool errorCountEnabled_;
             unsigned int numStartUpSkip_;
             unsigned int cameraNumber_;
+            GrabMode grabMode_;
+            GrabberStats stats_;
 
             // for reading from video instead of camera
             bool isVideo_;
             QString vidFileName_;
             videoBackend* vidObj_;
+            ImagePoolPtr imagePoolPtr_;
+            PipelineStatsPtr pipelineStatsPtr_;
 
             std::shared_ptr<Lockable<Camera>> cameraPtr_;
-            std::shared_ptr<LockableQueue<StampedImage>> newImageQueuePtr_;
+            std::shared_ptr<SpscRingBuffer<StampedImage>> newImageQueuePtr_;
 
             void run();
             double convertTimeStampToDouble(TimeStamp curr, TimeStamp init);
+            static double getThreadCpuTime();
     };
 
 
@@ -3,15 +3,32 @@
 #include "exception.hpp"
 #include "stamped_image.hpp"
 #include "video_writer.hpp"
+#include "pre_trigger_buffer.hpp"
 #include "affinity.hpp"
 #include <QThread>
+#include <QThreadPool>
 #include <queue>
+#include <limits>
 #include <iostream>
 #include <opencv2/core/core.hpp>
 
 namespace bias
 {
     const unsigned int MAX_LOG_QUEUE_SIZE = 1000;
+    const unsigned int CLIP_FLUSH_FRAMES_PER_CALL = 8;
+    const unsigned long CLIP_FLUSH_WAIT_MS = 1000;
+
+    // Runs a function on a thread pool - used to finish clips
+    class ClipFinishTask : public QRunnable
+    {
+        public:
+            ClipFinishTask(std::function<void()> func) : func_(func) {}
+            void run() { func_(); }
+
+        private:
+            std::function<void()> func_;
+    };
+
 
     ImageLogger::ImageLogger(QObject *parent) : QObject(parent) 
     {
@@ -21,7 +38,7 @@ namespace bias
     ImageLogger::ImageLogger (
             unsigned int cameraNumber,
             std::shared_ptr<VideoWriter> videoWriterPtr,
-            std::shared_ptr<LockableQueue<StampedImage>> logImageQueuePtr, 
+            std::shared_ptr<SpscRingBuffer<StampedImage>> logImageQueuePtr, 
             QObject *parent
             ) : QObject(parent)
     {
@@ -31,7 +48,7 @@ namespace bias
     void ImageLogger::initialize( 
             unsigned int cameraNumber,
             std::shared_ptr<VideoWriter> videoWriterPtr,
-            std::shared_ptr<LockableQueue<StampedImage>> logImageQueuePtr 
+            std::shared_ptr<SpscRingBuffer<StampedImage>> logImageQueuePtr 
             ) 
     {
         frameCount_ = 0;
@@ -40,6 +57,20 @@ namespace bias
         videoWriterPtr_ = videoWriterPtr;
         logImageQueuePtr_ = logImageQueuePtr;
         logQueueSize_ = 0;
+        preTriggerMode_ = false;
+        clipActive_ = false;
+        clipCount_ = 0;
+        clipEndTimeStamp_ = 0.0;
+        clipWriteSec_ = 0.0;
+        lastClipWriteSec_ = 0.0;
+        preTriggerDuration_ = 0.0;
+        preTriggerBytes_ = 0;
+        triggerRequested_ = false;
+        if (clipFinishPoolPtr_.isNull())
+        {
+            clipFinishPoolPtr_ = new QThreadPool(this);
+            clipFinishPoolPtr_ -> setMaxThreadCount(1);
+        }
         if ((logImageQueuePtr_ != NULL) && (videoWriterPtr_ != NULL))
         {
             ready_ = true;
@@ -55,11 +86,80 @@ namespace bias
         stopped_ = true;
     }
 
+    void ImageLogger::setPreTrigger(PreTriggerParams params, VideoWriterFactory writerFactory)
+    {
+        preTriggerParams_ = params;
+        videoWriterFactory_ = writerFactory;
+        preTriggerMode_ = params.enabled && bool(writerFactory);
+        ready_ = (logImageQueuePtr_ != NULL) && ((videoWriterPtr_ != NULL) || preTriggerMode_);
+    }
+
+    void ImageLogger::trigger()
+    {
+        // Called from other threads - acted on when the next frame arrives
+        triggerRequested_ = true;
+    }
+
+    void ImageLogger::setPipelineStats(PipelineStatsPtr pipelineStatsPtr)
+    {
+        pipelineStatsPtr_ = pipelineStatsPtr;
+        if (videoWriterPtr_ != NULL)
+        {
+            videoWriterPtr_ -> setPipelineStats(pipelineStatsPtr_);
+        }
+    }
+
     unsigned int ImageLogger::getLogQueueSize()
     {
         return logQueueSize_;
     }
 
+    QString ImageLogger::getWriterStatusString()
+    {
+        // The writer is replaced for each clip in pre-trigger mode
+        acquireLock();
+        std::shared_ptr<VideoWriter> videoWriterPtr = videoWriterPtr_;
+        releaseLock();
+
+        if (videoWriterPtr == NULL)
+        {
+            return QString();
+        }
+        return videoWriterPtr -> getStatusString();
+    }
+
+    QString ImageLogger::getPreTriggerStatusString()
+    {
+        if (!preTriggerMode_)
+        {
+            return QString();
+        }
+
+        acquireLock();
+        bool clipActive = clipActive_;
+        unsigned int clipCount = clipCount_;
+        double lastClipWriteSec = lastClipWriteSec_;
+        double preTriggerDuration = preTriggerDuration_;
+        size_t preTriggerBytes = preTriggerBytes_;
+        releaseLock();
+
+        QString status;
+        if (clipActive)
+        {
+            status = QString("recording clip %1").arg(clipCount);
+        }
+        else
+        {
+            status = QString("pre-trigger %1 s").arg(preTriggerDuration, 0, 'f', 1);
+        }
+        status += QString(", ring %1 MB").arg(double(preTriggerBytes)/double(1 << 20), 0, 'f', 0);
+        if ((clipCount > 1) || ((clipCount == 1) && !clipActive))
+        {
+            status += QString(", clip write %1 s").arg(lastClipWriteSec, 0, 'f', 2);
+        }
+        return status;
+    }
+
     void ImageLogger::run()
     {
         bool done = false;
@@ -82,19 +182,27 @@ namespace bias
         frameCount_ = 0;
         releaseLock();
 
+        if (preTriggerMode_)
+        {
+            preTriggerBufferPtr_ = std::make_shared<PreTriggerBuffer>(
+                    preTriggerParams_.preTriggerSec,
+                    preTriggerParams_.maxMemoryMB
+                    );
+        }
+
         while (!done)
         {
-            logImageQueuePtr_ -> acquireLock();
             logImageQueuePtr_ -> waitIfEmpty();
-            if (logImageQueuePtr_ -> empty())
+            if (!(logImageQueuePtr_ -> tryPop(newStampedImage)))
             {
-                logImageQueuePtr_ -> releaseLock();
                 break;
             }
-            newStampedImage = logImageQueuePtr_ -> front();
-            logImageQueuePtr_ -> pop();
             logQueueSize =  logImageQueuePtr_ -> size();
-            logImageQueuePtr_ -> releaseLock();
+            if (pipelineStatsPtr_)
+            {
+                pipelineStatsPtr_ -> recordStage(PIPELINE_STAGE_LOGGED, newStampedImage.stamps);
+                pipelineStatsPtr_ -> updateQueue(PIPELINE_QUEUE_LOG, logQueueSize, logImageQueuePtr_ -> numDropped());
+            }
 
             frameCount_++;
             //std::cout << "logger frame count = " << frameCount_ << std::endl;
@@ -109,13 +217,29 @@ namespace bias
                     emit imageLoggingError(errorId, errorMsg);
                     errorFlag = true;
                 }
+
+                // Check if the log queue has overflowed - frames have been dropped
+                if (logImageQueuePtr_ -> numDropped() > 0)
+                {
+                    unsigned int errorId = ERROR_IMAGE_LOGGER_MAX_QUEUE_SIZE;
+                    QString errorMsg("logger image queue overflowed - frames were dropped");
+                    emit imageLoggingError(errorId, errorMsg);
+                    errorFlag = true;
+                }
                 //std::cout << "cam: " << cameraNumber_ << ", queue size: " << logQueueSize;
                 //std::cout << "/" << MAX_LOG_QUEUE_SIZE << std::endl;
 
                 // Add frame to video writer
                 try 
                 {
-                    videoWriterPtr_ -> addFrame(newStampedImage);
+                    if (preTriggerMode_)
+                    {
+                        addFramePreTrigger(newStampedImage);
+                    }
+                    else
+                    {
+                        videoWriterPtr_ -> addFrame(newStampedImage);
+                    }
                 }
                 catch (RuntimeError &runtimeError)
                 {
@@ -128,13 +252,27 @@ namespace bias
             acquireLock();
             done = stopped_;
             logQueueSize_ = logQueueSize;
+            if (preTriggerMode_)
+            {
+                preTriggerDuration_ = preTriggerBufferPtr_ -> duration();
+                preTriggerBytes_ = preTriggerBufferPtr_ -> bytesAllocated();
+            }
             releaseLock();
 
         } // while (!done)
 
         try
         {
-            videoWriterPtr_ -> finish();
+            if (preTriggerMode_)
+            {
+                // Write out a clip which is still recording - frames left in 
+                // the ring were never triggered and are discarded.
+                finishClip();
+            }
+            else
+            {
+                videoWriterPtr_ -> finish();
+            }
         }
         catch (RuntimeError &runtimeError)
         {
@@ -142,10 +280,190 @@ namespace bias
             QString errorMsg = QString::fromStdString(runtimeError.what());
             emit imageLoggingError(errorId, errorMsg);
         }
+
+        if (preTriggerMode_)
+        {
+            clipFinishPoolPtr_ -> waitForDone();
+            preTriggerBufferPtr_.reset();
+            acquireLock();
+            preTriggerDuration_ = 0.0;
+            preTriggerBytes_ = 0;
+            releaseLock();
+        }
     
     }  // void ImageLogger::run()
 
 
+    void ImageLogger::addFramePreTrigger(StampedImage stampedImg)
+    {
+        if (triggerRequested_.exchange(false))
+        {
+            if (clipActive_)
+            {
+                // Trigger during the post-trigger period extends the clip
+                clipEndTimeStamp_ = stampedImg.timeStamp + preTriggerParams_.postTriggerSec;
+            }
+            else
+            {
+                startClip(stampedImg.timeStamp);
+            }
+        }
+
+        if (clipActive_)
+        {
+            // While buffered frames remain to be written out live frames are
+            // parked in the ring behind them, and a few buffered frames are
+            // written per live frame, so the log queue keeps being drained. 
+            // Buffered frames are written first so the ring has room for the
+            // live frame. Frames after the end of the clip stay in the ring as
+            // the next clip's pre-trigger frames.
+            flushClipFrames(CLIP_FLUSH_FRAMES_PER_CALL, 0);
+            if ((preTriggerBufferPtr_ -> size() > 0) || (stampedImg.timeStamp > clipEndTimeStamp_))
+            {
+                preTriggerBufferPtr_ -> push(stampedImg);
+            }
+            else
+            {
+                videoWriterPtr_ -> addFrame(stampedImg);
+            }
+            if ((stampedImg.timeStamp >= clipEndTimeStamp_) && !haveBufferedClipFrames())
+            {
+                finishClip();
+            }
+        }
+        else
+        {
+            preTriggerBufferPtr_ -> push(stampedImg);
+        }
+    }
+
+
+    void ImageLogger::startClip(double timeStamp)
+    {
+        std::shared_ptr<VideoWriter> videoWriterPtr = videoWriterFactory_(clipCount_ + 1);
+        videoWriterPtr -> setPipelineStats(pipelineStatsPtr_);
+
+        acquireLock();
+        videoWriterPtr_ = videoWriterPtr;
+        clipActive_ = true;
+        clipCount_++;
+        releaseLock();
+        clipEndTimeStamp_ = timeStamp + preTriggerParams_.postTriggerSec;
+        clipWriteSec_ = 0.0;
+    }
+
+
+    bool ImageLogger::flushClipFrames(unsigned int maxFrames, unsigned long waitMs)
+    {
+        // Hands up to maxFrames buffered frames of the clip, oldest first, to
+        // the clip writer - only as many as it takes without skipping, or with
+        // waitMs > 0 waiting up to waitMs for each. Each buffer goes back to the
+        // ring's pool once the writer is done with it. Returns true when no 
+        // frames of the clip are left in the ring.
+        QElapsedTimer flushTimer;
+        flushTimer.start();
+
+        StampedImage bufferedImage;
+        for (unsigned int i=0; i<maxFrames; i++)
+        {
+            if (!haveBufferedClipFrames())
+            {
+                break;
+            }
+            bool canAccept = false;
+            if (waitMs > 0)
+            {
+                canAccept = videoWriterPtr_ -> waitToAcceptFrame(waitMs);
+            }
+            else
+            {
+                canAccept = videoWriterPtr_ -> canAcceptFrame();
+            }
+            if (!canAccept)
+            {
+                break;
+            }
+            preTriggerBufferPtr_ -> pop(bufferedImage);
+            videoWriterPtr_ -> addFrame(bufferedImage);
+        }
+        clipWriteSec_ += 1.0e-3*flushTimer.elapsed();
+        return !haveBufferedClipFrames();
+    }
+
+
+    bool ImageLogger::haveBufferedClipFrames() const
+    {
+        return (preTriggerBufferPtr_ -> size() > 0) && (preTriggerBufferPtr_ -> oldestTimeStamp() <= clipEndTimeStamp_);
+    }
+
+
+    void ImageLogger::finishClip()
+    {
+        if (!clipActive_)
+        {
+            return;
+        }
+
+        // When stopping, buffered frames of the clip may not all have been
+        // written out yet - those the writer doesn't take in time are dropped.
+        if (!flushClipFrames(std::numeric_limits<unsigned int>::max(), CLIP_FLUSH_WAIT_MS))
+        {
+            StampedImage droppedImage;
+            while (haveBufferedClipFrames())
+            {
+                preTriggerBufferPtr_ -> pop(droppedImage);
+            }
+        }
+
+        acquireLock();
+        clipActive_ = false;
+        releaseLock();
+
+        // The clip is finished on the clip finish thread, one at a time, while
+        // this thread goes back to filling the ring.
+        std::shared_ptr<VideoWriter> videoWriterPtr = videoWriterPtr_;
+        unsigned int clipNumber = clipCount_;
+        double clipWriteSec = clipWriteSec_;
+        clipFinishPoolPtr_ -> start(new ClipFinishTask(
+                    [this, videoWriterPtr, clipNumber, clipWriteSec]()
+                    {
+                        finishClipWriter(videoWriterPtr, clipNumber, clipWriteSec);
+                    }
+                    ));
+    }
+
+
+    void ImageLogger::finishClipWriter(
+            std::shared_ptr<VideoWriter> videoWriterPtr, 
+            unsigned int clipNumber,
+            double clipWriteSec
+            )
+    {
+        // Clip write time is that spent writing out the ring plus finishing
+        // the file - the time waiting on post-trigger frames is not counted.
+        QElapsedTimer finishTimer;
+        finishTimer.start();
+        try
+        {
+            videoWriterPtr -> finish();
+        }
+        catch (RuntimeError &runtimeError)
+        {
+            unsigned int errorId = runtimeError.id();
+            QString errorMsg = QString::fromStdString(runtimeError.what());
+            emit imageLoggingError(errorId, errorMsg);
+        }
+        clipWriteSec += 1.0e-3*finishTimer.elapsed();
+
+        acquireLock();
+        lastClipWriteSec_ = clipWriteSec;
+        releaseLock();
+
+        std::cout << "camera " << cameraNumber_ << ": clip " << clipNumber;
+        std::cout << " written in " << clipWriteSec << " s" << std::endl;
+    }
+
+
 
 } // namespace bias
 
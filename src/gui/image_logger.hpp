@@ -2,26 +2,37 @@
 #define BIAS_IMAGE_LOGGER_HPP
 
 #include <memory>
+#include <atomic>
+#include <functional>
 #include <QMutex>
 #include <QObject>
+#include <QPointer>
 #include <QRunnable>
+#include <QElapsedTimer>
 #include "camera_fwd.hpp"
 #include "lockable.hpp"
+#include "video_writer_params.hpp"
+#include "pipeline_stats.hpp"
 
 // Debugging -------------------
 //#include <opencv2/core/core.hpp>
 // -----------------------------
 
 class QString;
+class QThreadPool;
 
 
 namespace bias
 {
 
     class VideoWriter;
+    class PreTriggerBuffer;
 
     struct StampedImage;
 
+    // Creates the writer for a pre-trigger clip given the clip number
+    typedef std::function<std::shared_ptr<VideoWriter>(unsigned int)> VideoWriterFactory;
+
     class ImageLogger : public QObject, public QRunnable, public Lockable<Empty>
     {
         Q_OBJECT
@@ -32,19 +43,31 @@ namespace bias
             ImageLogger(
                     unsigned int cameraNumber,
                     std::shared_ptr<VideoWriter> videoWriterPtr,
-                    std::shared_ptr<LockableQueue<StampedImage>> logImageQueuePtr, 
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> logImageQueuePtr, 
                     QObject *parent=0
                     );
 
             void initialize(
                     unsigned int cameraNumber,
                     std::shared_ptr<VideoWriter> videoWriterPtr,
-                    std::shared_ptr<LockableQueue<StampedImage>> logImageQueuePtr 
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> logImageQueuePtr 
                     );
 
             void stop();
 
+            // Pre-trigger recording - must be set before the logger is started, 
+            // in which case videoWriterPtr may be NULL as the writers are made 
+            // per clip by writerFactory. Clips are finished on a separate 
+            // thread so frames are still buffered while a clip is written out.
+            void setPreTrigger(PreTriggerParams params, VideoWriterFactory writerFactory);
+            void trigger();
+
+            // Passed on to the video writer(s) - set before the logger is started
+            void setPipelineStats(PipelineStatsPtr pipelineStatsPtr);
+
             unsigned int getLogQueueSize();
+            QString getWriterStatusString();
+            QString getPreTriggerStatusString();
 
 
             // Debugging --------------------------
@@ -62,9 +85,34 @@ namespace bias
             unsigned int logQueueSize_;
 
             std::shared_ptr<VideoWriter> videoWriterPtr_;
-            std::shared_ptr<LockableQueue<StampedImage>> logImageQueuePtr_;
+            std::shared_ptr<SpscRingBuffer<StampedImage>> logImageQueuePtr_;
+            PipelineStatsPtr pipelineStatsPtr_;
+
+            bool preTriggerMode_;
+            bool clipActive_;
+            unsigned int clipCount_;
+            double clipEndTimeStamp_;
+            double clipWriteSec_;
+            double lastClipWriteSec_;
+            double preTriggerDuration_;
+            size_t preTriggerBytes_;
+            std::atomic<bool> triggerRequested_;
+            PreTriggerParams preTriggerParams_;
+            VideoWriterFactory videoWriterFactory_;
+            std::shared_ptr<PreTriggerBuffer> preTriggerBufferPtr_;
+            QPointer<QThreadPool> clipFinishPoolPtr_;
 
             void run();
+            void addFramePreTrigger(StampedImage stampedImg);
+            void startClip(double timeStamp);
+            bool flushClipFrames(unsigned int maxFrames, unsigned long waitMs);
+            bool haveBufferedClipFrames() const;
+            void finishClip();
+            void finishClipWriter(
+                    std::shared_ptr<VideoWriter> videoWriterPtr, 
+                    unsigned int clipNumber,
+                    double clipWriteSec
+                    );
     };
 
 } // namespace bias
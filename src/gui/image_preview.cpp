@@ -0,0 +1,161 @@
+#include "image_preview.hpp"
+#include "mat_to_qimage.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace bias
+{
+    const unsigned int PREVIEW_HISTOGRAM_NUM_BINS = 256;
+    const size_t PREVIEW_HISTOGRAM_MAX_SAMPLES = 262144;
+
+    PreviewImage::PreviewImage()
+    {
+        frameCount = 0;
+        timeStamp = 0.0;
+    }
+
+
+    bool PreviewImage::isEmpty() const
+    {
+        return image.isNull();
+    }
+
+
+    PreviewImage createPreviewImage(const cv::Mat &image, cv::Size maxSize, int colorMap)
+    {
+        PreviewImage preview;
+        if (image.empty())
+        {
+            return preview;
+        }
+        preview.sourceSize = image.size();
+        preview.histogram = calcPreviewHistogram(image);
+
+        // Note, previewMat may share the frame's buffer so must not be
+        // written to in place.
+        cv::Mat previewMat = image;
+        cv::Size previewSize = getPreviewSize(image.size(), maxSize);
+        if (previewSize != image.size())
+        {
+            areaDownsample(image, previewMat, previewSize);
+        }
+
+        if (previewMat.depth() == CV_16U)
+        {
+            cv::Mat previewMat8U;
+            previewMat.convertTo(previewMat8U, CV_8U, 1.0/256.0);
+            previewMat = previewMat8U;
+        }
+
+        if (colorMap >= 0)
+        {
+            cv::Mat colorMapMat;
+            cv::applyColorMap(previewMat, colorMapMat, colorMap);
+            previewMat = colorMapMat;
+        }
+
+        // matToQImage wraps the Mat's buffer - copy so the preview owns its data
+        preview.image = matToQImage(previewMat).copy();
+        return preview;
+    }
+
+
+    cv::Size getPreviewSize(cv::Size imageSize, cv::Size maxSize)
+    {
+        if ((maxSize.width <= 0) || (maxSize.height <= 0) || (imageSize.area() <= 0))
+        {
+            return imageSize;
+        }
+        if ((imageSize.width <= maxSize.width) && (imageSize.height <= maxSize.height))
+        {
+            return imageSize;
+        }
+        int64_t width = int64_t(maxSize.height)*int64_t(imageSize.width)/int64_t(imageSize.height);
+        if (width <= maxSize.width)
+        {
+            return cv::Size(std::max(int(width),1), maxSize.height);
+        }
+        int64_t height = int64_t(maxSize.width)*int64_t(imageSize.height)/int64_t(imageSize.width);
+        return cv::Size(maxSize.width, std::max(int(height),1));
+    }
+
+
+    void areaDownsample(const cv::Mat &image, cv::Mat &dstImage, cv::Size dstSize)
+    {
+        int factor = std::min(image.cols/dstSize.width, image.rows/dstSize.height);
+        cv::Mat reducedImage = image;
+        if (factor >= 2)
+        {
+            // Crop to a multiple of the factor so the fast path applies
+            int cropCols = (image.cols/factor)*factor;
+            int cropRows = (image.rows/factor)*factor;
+            cv::Mat croppedImage = image(cv::Rect(0, 0, cropCols, cropRows));
+            cv::resize(
+                    croppedImage,
+                    reducedImage,
+                    cv::Size(cropCols/factor, cropRows/factor),
+                    0, 0, cv::INTER_AREA
+                    );
+        }
+        if (reducedImage.size() != dstSize)
+        {
+            cv::resize(reducedImage, dstImage, dstSize, 0, 0, cv::INTER_AREA);
+        }
+        else
+        {
+            dstImage = reducedImage;
+        }
+    }
+
+
+    cv::Mat calcPreviewHistogram(const cv::Mat &image)
+    {
+        cv::Mat hist = cv::Mat::zeros(PREVIEW_HISTOGRAM_NUM_BINS, 1, CV_32F);
+        if (image.empty())
+        {
+            return hist;
+        }
+
+        int step = 1;
+        while ((image.total()/size_t(step*step)) > PREVIEW_HISTOGRAM_MAX_SAMPLES)
+        {
+            step++;
+        }
+
+        unsigned long counts[PREVIEW_HISTOGRAM_NUM_BINS] = {0};
+        int numChannels = image.channels();
+        int colStep = step*numChannels;
+        int rowLength = image.cols*numChannels;
+
+        if (image.depth() == CV_8U)
+        {
+            for (int i=0; i<image.rows; i+=step)
+            {
+                const uchar *rowPtr = image.ptr<uchar>(i);
+                for (int j=0; j<rowLength; j+=colStep)
+                {
+                    counts[rowPtr[j]]++;
+                }
+            }
+        }
+        else if (image.depth() == CV_16U)
+        {
+            for (int i=0; i<image.rows; i+=step)
+            {
+                const uint16_t *rowPtr = image.ptr<uint16_t>(i);
+                for (int j=0; j<rowLength; j+=colStep)
+                {
+                    counts[rowPtr[j] >> 8]++;
+                }
+            }
+        }
+
+        for (unsigned int i=0; i<PREVIEW_HISTOGRAM_NUM_BINS; i++)
+        {
+            hist.at<float>(i) = float(counts[i]);
+        }
+        return hist;
+    }
+
+}
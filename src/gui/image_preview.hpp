@@ -0,0 +1,48 @@
+#ifndef BIAS_IMAGE_PREVIEW_HPP
+#define BIAS_IMAGE_PREVIEW_HPP
+
+#include <QImage>
+#include <opencv2/core/core.hpp>
+
+namespace bias
+{
+
+    struct PreviewImage
+    {
+        // Display ready version of a frame, prepared off the GUI thread.
+        QImage image;           // downsampled (and colour mapped) copy of the frame
+        cv::Mat histogram;      // 256 bin histogram (CV_32F, 256x1) of the frame
+        cv::Size sourceSize;    // size of the full resolution frame
+        unsigned long frameCount;
+        double timeStamp;
+
+        PreviewImage();
+        bool isEmpty() const;
+    };
+
+
+    // Creates the preview image for a frame. The image is area downsampled
+    // so it fits within maxSize (keeping the aspect ratio) and colour mapped
+    // if colorMap is a valid cv::ColormapTypes value (negative = none). 16 bit
+    // frames are reduced to 8 bits for display.
+    PreviewImage createPreviewImage(const cv::Mat &image, cv::Size maxSize, int colorMap);
+
+    // Size of an image of imageSize scaled to fit within maxSize keeping its
+    // aspect ratio, rounded as for QSize::scale so the GUI need not rescale.
+    // Images are never upscaled.
+    cv::Size getPreviewSize(cv::Size imageSize, cv::Size maxSize);
+
+    // Box filtered downsample of image to dstSize. The bulk of the reduction
+    // is done by an integer factor, for which cv::INTER_AREA has a fast path,
+    // and the remainder by a general cv::INTER_AREA resize of the much 
+    // smaller image.
+    void areaDownsample(const cv::Mat &image, cv::Mat &dstImage, cv::Size dstSize);
+
+    // 256 bin histogram of the first channel of an 8 or 16 bit image (16 bit
+    // values are binned by their high byte). Large images are subsampled on a
+    // regular grid - enough for display.
+    cv::Mat calcPreviewHistogram(const cv::Mat &image);
+
+}
+
+#endif // #ifndef BIAS_IMAGE_PREVIEW_HPP
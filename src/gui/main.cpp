@@ -5,6 +5,7 @@
 #include "camera_window.hpp"
 #include "camera_facade.hpp"
 #include "affinity.hpp"
+#include "frame_sync.hpp"
 #include <iostream>
 #include <QCommandLineParser>
 
@@ -33,12 +34,38 @@ int main (int argc, char *argv[])
 		QStringList() << "c" << "config",
 		QString("Load configuration from <config-file>"),
 		QString("config-file")));
+    // -s or --sync 
+    // match frames across cameras on their time stamps
+    parser.addOption(QCommandLineOption(
+        QStringList() << "s" << "sync",
+        QString("Synchronize frames across cameras into matched sets")));
+    // --sync-tolerance <ms>
+    parser.addOption(QCommandLineOption(
+        QStringList() << "sync-tolerance",
+        QString("Time stamp tolerance for matched frames (default half the frame interval)"),
+        QString("ms")));
 
     parser.process(app);
     bias::CmdLineParams params;
     params.inVideoFile = parser.value("in-video");
     params.configFile = parser.value("config");
 
+    bias::FrameSyncService::setEnabled(parser.isSet("sync"));
+    if (parser.isSet("sync-tolerance"))
+    {
+        bool ok = false;
+        double syncToleranceMs = parser.value("sync-tolerance").toDouble(&ok);
+        if (!ok || (syncToleranceMs < 0.0))
+        {
+            QString msgTitle("Command Line Error");
+            QString msgText("Invalid sync tolerance: ");
+            msgText += parser.value("sync-tolerance");
+            QMessageBox::critical(0, msgTitle,msgText);
+            return 0;
+        }
+        bias::FrameSyncService::setTolerance(1.0e-3*syncToleranceMs);
+    }
+
 
     bias::GuidList guidList;
     bias::CameraFinder cameraFinder;
@@ -72,6 +99,7 @@ int main (int argc, char *argv[])
     // Get number of cameras
     unsigned int numCam = guidList.size();
     bias::ThreadAffinityService::setNumberOfCameras(numCam);
+    bias::FrameSyncService::setNumberOfCameras(numCam);
 
     // Open camera window for each camera 
     QRect baseGeom;
@@ -0,0 +1,468 @@
+#include "membership_kernel_ufmf.hpp"
+#include "simd_utils.hpp"
+#include <algorithm>
+
+namespace bias
+{
+
+    // Row operations
+    // ----------------------------------------------------------------------------------
+    // thresholdRow:  out = (lower <= image <= upper) ? 255 : 0
+    // minRow:        out[i] = min(in[i], ..., in[i+width-1])
+    // minRowsCount:  out = min over rows, returns number of nonzero (background) pixels
+
+    static void thresholdRow_scalar(
+            const uint8_t *imgPtr,
+            const uint8_t *lowPtr,
+            const uint8_t *uppPtr,
+            uint8_t *outPtr,
+            unsigned int begin,
+            unsigned int num
+            )
+    {
+        for (unsigned int i=begin; i<num; i++)
+        {
+            outPtr[i] = ((imgPtr[i] >= lowPtr[i]) && (imgPtr[i] <= uppPtr[i])) ? 255 : 0;
+        }
+    }
+
+
+    static void thresholdRow16_scalar(
+            const uint16_t *imgPtr,
+            const uint16_t *lowPtr,
+            const uint16_t *uppPtr,
+            uint8_t *outPtr,
+            unsigned int begin,
+            unsigned int num
+            )
+    {
+        for (unsigned int i=begin; i<num; i++)
+        {
+            outPtr[i] = ((imgPtr[i] >= lowPtr[i]) && (imgPtr[i] <= uppPtr[i])) ? 255 : 0;
+        }
+    }
+
+
+    static void minRow_scalar(
+            const uint8_t *inPtr,
+            uint8_t *outPtr,
+            unsigned int width,
+            unsigned int begin,
+            unsigned int num
+            )
+    {
+        for (unsigned int i=begin; i<num; i++)
+        {
+            uint8_t value = inPtr[i];
+            for (unsigned int k=1; k<width; k++)
+            {
+                value = std::min(value, inPtr[i+k]);
+            }
+            outPtr[i] = value;
+        }
+    }
+
+
+    static unsigned int minRowsCount_scalar(
+            const uint8_t * const *rowPtrs,
+            unsigned int numRows,
+            uint8_t *outPtr,
+            unsigned int begin,
+            unsigned int num
+            )
+    {
+        unsigned int count = 0;
+        for (unsigned int i=begin; i<num; i++)
+        {
+            uint8_t value = rowPtrs[0][i];
+            for (unsigned int k=1; k<numRows; k++)
+            {
+                value = std::min(value, rowPtrs[k][i]);
+            }
+            outPtr[i] = value;
+            count += (value != 0) ? 1 : 0;
+        }
+        return count;
+    }
+
+
+#ifdef BIAS_HAVE_SSE2
+    static void thresholdRow_sse2(
+            const uint8_t *imgPtr,
+            const uint8_t *lowPtr,
+            const uint8_t *uppPtr,
+            uint8_t *outPtr,
+            unsigned int num
+            )
+    {
+        unsigned int i = 0;
+        for (; i + 16 <= num; i += 16)
+        {
+            __m128i img = _mm_loadu_si128((const __m128i *) (imgPtr + i));
+            __m128i low = _mm_loadu_si128((const __m128i *) (lowPtr + i));
+            __m128i upp = _mm_loadu_si128((const __m128i *) (uppPtr + i));
+            __m128i geLow = _mm_cmpeq_epi8(_mm_max_epu8(img, low), img);
+            __m128i leUpp = _mm_cmpeq_epi8(_mm_min_epu8(img, upp), img);
+            _mm_storeu_si128((__m128i *) (outPtr + i), _mm_and_si128(geLow, leUpp));
+        }
+        thresholdRow_scalar(imgPtr, lowPtr, uppPtr, outPtr, i, num);
+    }
+
+
+    static void thresholdRow16_sse2(
+            const uint16_t *imgPtr,
+            const uint16_t *lowPtr,
+            const uint16_t *uppPtr,
+            uint8_t *outPtr,
+            unsigned int num
+            )
+    {
+        // No unsigned 16-bit compares in SSE2 - img >= low iff low -sat img == 0
+        // and img <= upp iff img -sat upp == 0.
+        const __m128i zero = _mm_setzero_si128();
+        unsigned int i = 0;
+        for (; i + 16 <= num; i += 16)
+        {
+            __m128i img0 = _mm_loadu_si128((const __m128i *) (imgPtr + i));
+            __m128i img1 = _mm_loadu_si128((const __m128i *) (imgPtr + i + 8));
+            __m128i out0 = _mm_or_si128(
+                    _mm_subs_epu16(_mm_loadu_si128((const __m128i *) (lowPtr + i)), img0),
+                    _mm_subs_epu16(img0, _mm_loadu_si128((const __m128i *) (uppPtr + i)))
+                    );
+            __m128i out1 = _mm_or_si128(
+                    _mm_subs_epu16(_mm_loadu_si128((const __m128i *) (lowPtr + i + 8)), img1),
+                    _mm_subs_epu16(img1, _mm_loadu_si128((const __m128i *) (uppPtr + i + 8)))
+                    );
+            out0 = _mm_cmpeq_epi16(out0, zero);
+            out1 = _mm_cmpeq_epi16(out1, zero);
+            _mm_storeu_si128((__m128i *) (outPtr + i), _mm_packs_epi16(out0, out1));
+        }
+        thresholdRow16_scalar(imgPtr, lowPtr, uppPtr, outPtr, i, num);
+    }
+
+
+    static void minRow_sse2(const uint8_t *inPtr, uint8_t *outPtr, unsigned int width, unsigned int num)
+    {
+        unsigned int i = 0;
+        for (; i + 16 <= num; i += 16)
+        {
+            __m128i value = _mm_loadu_si128((const __m128i *) (inPtr + i));
+            for (unsigned int k=1; k<width; k++)
+            {
+                value = _mm_min_epu8(value, _mm_loadu_si128((const __m128i *) (inPtr + i + k)));
+            }
+            _mm_storeu_si128((__m128i *) (outPtr + i), value);
+        }
+        minRow_scalar(inPtr, outPtr, width, i, num);
+    }
+
+
+    static unsigned int minRowsCount_sse2(
+            const uint8_t * const *rowPtrs,
+            unsigned int numRows,
+            uint8_t *outPtr,
+            unsigned int num
+            )
+    {
+        // Values are 0 or 255 so the byte sum / 255 is the nonzero count
+        const __m128i zero = _mm_setzero_si128();
+        __m128i sum = _mm_setzero_si128();
+        unsigned int i = 0;
+        for (; i + 16 <= num; i += 16)
+        {
+            __m128i value = _mm_loadu_si128((const __m128i *) (rowPtrs[0] + i));
+            for (unsigned int k=1; k<numRows; k++)
+            {
+                value = _mm_min_epu8(value, _mm_loadu_si128((const __m128i *) (rowPtrs[k] + i)));
+            }
+            _mm_storeu_si128((__m128i *) (outPtr + i), value);
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(value, zero));
+        }
+        uint64_t sumLanes[2];
+        _mm_storeu_si128((__m128i *) sumLanes, sum);
+        unsigned int count = (unsigned int)((sumLanes[0] + sumLanes[1])/255);
+        return count + minRowsCount_scalar(rowPtrs, numRows, outPtr, i, num);
+    }
+#endif
+
+
+#ifdef BIAS_HAVE_AVX2_DISPATCH
+    BIAS_TARGET_AVX2 static void thresholdRow_avx2(
+            const uint8_t *imgPtr,
+            const uint8_t *lowPtr,
+            const uint8_t *uppPtr,
+            uint8_t *outPtr,
+            unsigned int num
+            )
+    {
+        unsigned int i = 0;
+        for (; i + 32 <= num; i += 32)
+        {
+            __m256i img = _mm256_loadu_si256((const __m256i *) (imgPtr + i));
+            __m256i low = _mm256_loadu_si256((const __m256i *) (lowPtr + i));
+            __m256i upp = _mm256_loadu_si256((const __m256i *) (uppPtr + i));
+            __m256i geLow = _mm256_cmpeq_epi8(_mm256_max_epu8(img, low), img);
+            __m256i leUpp = _mm256_cmpeq_epi8(_mm256_min_epu8(img, upp), img);
+            _mm256_storeu_si256((__m256i *) (outPtr + i), _mm256_and_si256(geLow, leUpp));
+        }
+        thresholdRow_scalar(imgPtr, lowPtr, uppPtr, outPtr, i, num);
+    }
+
+
+    BIAS_TARGET_AVX2 static void minRow_avx2(
+            const uint8_t *inPtr,
+            uint8_t *outPtr,
+            unsigned int width,
+            unsigned int num
+            )
+    {
+        unsigned int i = 0;
+        for (; i + 32 <= num; i += 32)
+        {
+            __m256i value = _mm256_loadu_si256((const __m256i *) (inPtr + i));
+            for (unsigned int k=1; k<width; k++)
+            {
+                value = _mm256_min_epu8(value, _mm256_loadu_si256((const __m256i *) (inPtr + i + k)));
+            }
+            _mm256_storeu_si256((__m256i *) (outPtr + i), value);
+        }
+        minRow_scalar(inPtr, outPtr, width, i, num);
+    }
+
+
+    BIAS_TARGET_AVX2 static unsigned int minRowsCount_avx2(
+            const uint8_t * const *rowPtrs,
+            unsigned int numRows,
+            uint8_t *outPtr,
+            unsigned int num
+            )
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i sum = _mm256_setzero_si256();
+        unsigned int i = 0;
+        for (; i + 32 <= num; i += 32)
+        {
+            __m256i value = _mm256_loadu_si256((const __m256i *) (rowPtrs[0] + i));
+            for (unsigned int k=1; k<numRows; k++)
+            {
+                value = _mm256_min_epu8(value, _mm256_loadu_si256((const __m256i *) (rowPtrs[k] + i)));
+            }
+            _mm256_storeu_si256((__m256i *) (outPtr + i), value);
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(value, zero));
+        }
+        uint64_t sumLanes[4];
+        _mm256_storeu_si256((__m256i *) sumLanes, sum);
+        uint64_t total = sumLanes[0] + sumLanes[1] + sumLanes[2] + sumLanes[3];
+        unsigned int count = (unsigned int)(total/255);
+        return count + minRowsCount_scalar(rowPtrs, numRows, outPtr, i, num);
+    }
+#endif
+
+
+    // Dispatch
+    // ----------------------------------------------------------------------------------
+    static inline void thresholdRow(
+            bool useAvx2,
+            const uint8_t *imgPtr,
+            const uint8_t *lowPtr,
+            const uint8_t *uppPtr,
+            uint8_t *outPtr,
+            unsigned int num
+            )
+    {
+#ifdef BIAS_HAVE_AVX2_DISPATCH
+        if (useAvx2)
+        {
+            thresholdRow_avx2(imgPtr, lowPtr, uppPtr, outPtr, num);
+            return;
+        }
+#endif
+#ifdef BIAS_HAVE_SSE2
+        thresholdRow_sse2(imgPtr, lowPtr, uppPtr, outPtr, num);
+#else
+        thresholdRow_scalar(imgPtr, lowPtr, uppPtr, outPtr, 0, num);
+#endif
+    }
+
+
+    static inline void thresholdRow16(
+            const uint16_t *imgPtr,
+            const uint16_t *lowPtr,
+            const uint16_t *uppPtr,
+            uint8_t *outPtr,
+            unsigned int num
+            )
+    {
+#ifdef BIAS_HAVE_SSE2
+        thresholdRow16_sse2(imgPtr, lowPtr, uppPtr, outPtr, num);
+#else
+        thresholdRow16_scalar(imgPtr, lowPtr, uppPtr, outPtr, 0, num);
+#endif
+    }
+
+
+    static inline void thresholdImageRow(
+            bool useAvx2,
+            const cv::Mat &image,
+            const cv::Mat &lowerBound,
+            const cv::Mat &upperBound,
+            unsigned int row,
+            uint8_t *outPtr
+            )
+    {
+        // Images are CV_8UC1 or CV_16UC1, the bounds have the same type
+        if (image.depth() == CV_16U)
+        {
+            thresholdRow16(
+                    image.ptr<uint16_t>(row),
+                    lowerBound.ptr<uint16_t>(row),
+                    upperBound.ptr<uint16_t>(row),
+                    outPtr,
+                    (unsigned int)(image.cols)
+                    );
+        }
+        else
+        {
+            thresholdRow(
+                    useAvx2,
+                    image.ptr<uint8_t>(row),
+                    lowerBound.ptr<uint8_t>(row),
+                    upperBound.ptr<uint8_t>(row),
+                    outPtr,
+                    (unsigned int)(image.cols)
+                    );
+        }
+    }
+
+
+    static inline void minRow(bool useAvx2, const uint8_t *inPtr, uint8_t *outPtr, unsigned int width, unsigned int num)
+    {
+#ifdef BIAS_HAVE_AVX2_DISPATCH
+        if (useAvx2)
+        {
+            minRow_avx2(inPtr, outPtr, width, num);
+            return;
+        }
+#endif
+#ifdef BIAS_HAVE_SSE2
+        minRow_sse2(inPtr, outPtr, width, num);
+#else
+        minRow_scalar(inPtr, outPtr, width, 0, num);
+#endif
+    }
+
+
+    static inline unsigned int minRowsCount(
+            bool useAvx2,
+            const uint8_t * const *rowPtrs,
+            unsigned int numRows,
+            uint8_t *outPtr,
+            unsigned int num
+            )
+    {
+#ifdef BIAS_HAVE_AVX2_DISPATCH
+        if (useAvx2)
+        {
+            return minRowsCount_avx2(rowPtrs, numRows, outPtr, num);
+        }
+#endif
+#ifdef BIAS_HAVE_SSE2
+        return minRowsCount_sse2(rowPtrs, numRows, outPtr, num);
+#else
+        return minRowsCount_scalar(rowPtrs, numRows, outPtr, 0, num);
+#endif
+    }
+
+
+    // MembershipKernel_ufmf
+    // ----------------------------------------------------------------------------------
+    MembershipKernel_ufmf::MembershipKernel_ufmf()
+    {
+        useAvx2_ = cpuSupportsAvx2();
+        ringRadius_ = 0;
+        ringCols_ = 0;
+    }
+
+
+    bool MembershipKernel_ufmf::isUsingAvx2() const
+    {
+        return useAvx2_;
+    }
+
+
+    void MembershipKernel_ufmf::setupBuffers(unsigned int erodeRadius, unsigned int numCol)
+    {
+        // Buffers are kept between frames and only rebuilt when the erode window
+        // size or the image width changes.
+        if ((erodeRadius == ringRadius_) && (numCol == ringCols_) && (!ringBuf_.empty()))
+        {
+            return;
+        }
+        unsigned int ringSize = 2*erodeRadius + 1;
+        ringBuf_.assign(size_t(ringSize)*numCol, 0);
+        padBuf_.assign(numCol + 2*erodeRadius, 255);
+        ringPtrs_.resize(ringSize);
+        ringRadius_ = erodeRadius;
+        ringCols_ = numCol;
+    }
+
+
+    unsigned int MembershipKernel_ufmf::compute(
+            const cv::Mat &image,
+            const cv::Mat &lowerBound,
+            const cv::Mat &upperBound,
+            unsigned int erodeRadius,
+            cv::Mat &membership
+            )
+    {
+        unsigned int numRow = (unsigned int)(image.rows);
+        unsigned int numCol = (unsigned int)(image.cols);
+        unsigned int numBackground = 0;
+
+        membership.create(image.rows, image.cols, CV_8UC1);
+
+        if (erodeRadius == 0)
+        {
+            for (unsigned int row=0; row<numRow; row++)
+            {
+                uint8_t *outPtr = membership.ptr<uint8_t>(row);
+                thresholdImageRow(useAvx2_, image, lowerBound, upperBound, row, outPtr);
+                const uint8_t *rowPtr = outPtr;
+                numBackground += minRowsCount(useAvx2_, &rowPtr, 1, outPtr, numCol);
+            }
+            return numRow*numCol - numBackground;
+        }
+
+        setupBuffers(erodeRadius, numCol);
+        unsigned int ringSize = 2*erodeRadius + 1;
+        unsigned int width = 2*erodeRadius + 1;
+        uint8_t *padPtr = padBuf_.data() + erodeRadius;
+        unsigned int nextRow = 0;
+
+        for (unsigned int row=0; row<numRow; row++)
+        {
+            // Threshold and horizontally erode the rows needed for this output row.
+            // Pad borders are 255 so pixels outside the image are ignored.
+            unsigned int lastRow = std::min(row + erodeRadius, numRow - 1);
+            for (; nextRow <= lastRow; nextRow++)
+            {
+                thresholdImageRow(useAvx2_, image, lowerBound, upperBound, nextRow, padPtr);
+                uint8_t *ringPtr = ringBuf_.data() + size_t(nextRow % ringSize)*numCol;
+                minRow(useAvx2_, padBuf_.data(), ringPtr, width, numCol);
+            }
+
+            // Vertical min over the rows in the window which lie inside the image
+            unsigned int firstRow = (row >= erodeRadius) ? (row - erodeRadius) : 0;
+            unsigned int numWindowRows = 0;
+            for (unsigned int r=firstRow; r<=lastRow; r++)
+            {
+                ringPtrs_[numWindowRows] = ringBuf_.data() + size_t(r % ringSize)*numCol;
+                numWindowRows++;
+            }
+            uint8_t *outPtr = membership.ptr<uint8_t>(row);
+            numBackground += minRowsCount(useAvx2_, ringPtrs_.data(), numWindowRows, outPtr, numCol);
+        }
+        return numRow*numCol - numBackground;
+    }
+
+} // namespace bias
@@ -0,0 +1,49 @@
+#ifndef BIAS_MEMBERSHIP_KERNEL_UFMF_HPP
+#define BIAS_MEMBERSHIP_KERNEL_UFMF_HPP
+
+#include <vector>
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+
+namespace bias
+{
+    // Fused background/foreground membership calculation for UFMF compression.
+    //
+    // Equivalent to cv::inRange(image, lower, upper, membership) followed by
+    // cv::erode with a (2*erodeRadius+1) square structuring element and default
+    // border, but computed in a single streaming pass over the image. Membership
+    // is 255 for background and 0 for foreground. The erosion is separable - a
+    // horizontal running min is applied as each row is thresholded and the
+    // vertical min is taken over a ring of the last 2*erodeRadius+1 rows.
+    // Images may be CV_8UC1 or CV_16UC1, only the threshold depends on the type.
+    class MembershipKernel_ufmf
+    {
+        public:
+            MembershipKernel_ufmf();
+
+            // Returns the number of foreground pixels. An erodeRadius of 0
+            // disables erosion.
+            unsigned int compute(
+                    const cv::Mat &image,
+                    const cv::Mat &lowerBound,
+                    const cv::Mat &upperBound,
+                    unsigned int erodeRadius,
+                    cv::Mat &membership
+                    );
+
+            bool isUsingAvx2() const;
+
+        private:
+            bool useAvx2_;
+            unsigned int ringRadius_;
+            unsigned int ringCols_;
+            std::vector<uint8_t> ringBuf_;   // horizontally eroded rows
+            std::vector<uint8_t> padBuf_;    // thresholded row with 255 borders
+            std::vector<const uint8_t*> ringPtrs_;
+
+            void setupBuffers(unsigned int erodeRadius, unsigned int numCol);
+    };
+
+} // namespace bias
+
+#endif // #ifndef BIAS_MEMBERSHIP_KERNEL_UFMF_HPP
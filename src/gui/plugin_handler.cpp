@@ -19,7 +19,7 @@ namespace bias
 
     PluginHandler::PluginHandler(
             unsigned int cameraNumber,
-            std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr,
+            std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr,
             QObject *parent
             ) : QObject(parent)
     {
@@ -30,7 +30,7 @@ namespace bias
 
     PluginHandler::PluginHandler(
             unsigned int cameraNumber,
-            std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr,
+            std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr,
             BiasPlugin *pluginPtr,
             QObject *parent
             ) : QObject(parent)
@@ -44,7 +44,7 @@ namespace bias
        cameraNumber_ = cameraNumber;
     } 
 
-    void PluginHandler::setImageQueue(std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr)
+    void PluginHandler::setImageQueue(std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr)
     {
         pluginImageQueuePtr_ = pluginImageQueuePtr;
         setReadyState();
@@ -58,9 +58,15 @@ namespace bias
     }
 
 
+    void PluginHandler::setPipelineStats(PipelineStatsPtr pipelineStatsPtr)
+    {
+        pipelineStatsPtr_ = pipelineStatsPtr;
+    }
+
+
     void PluginHandler::initialize(
             unsigned int cameraNumber,
-            std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr,
+            std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr,
             BiasPlugin *pluginPtr
             )
     {
@@ -125,26 +131,40 @@ namespace bias
             QList<StampedImage> frameList;
 
             // Grab frame from image queue
-            pluginImageQueuePtr_ -> acquireLock();
+            StampedImage stampedImage;
             pluginImageQueuePtr_ -> waitIfEmpty();
-            if (pluginImageQueuePtr_ -> empty())
+            if (pipelineStatsPtr_)
             {
-                pluginImageQueuePtr_ -> releaseLock();
-                break;
+                pipelineStatsPtr_ -> updateQueue(
+                        PIPELINE_QUEUE_PLUGIN,
+                        pluginImageQueuePtr_ -> size(),
+                        pluginImageQueuePtr_ -> numDropped()
+                        );
             }
-            while ( !(pluginImageQueuePtr_ ->  empty()) )
+            while (pluginImageQueuePtr_ -> tryPop(stampedImage))
             {
-                StampedImage stampedImage = pluginImageQueuePtr_ -> front();
                 frameList.append(stampedImage);
-                pluginImageQueuePtr_ -> pop();
             }
-            pluginImageQueuePtr_ -> releaseLock();
+            if (frameList.isEmpty())
+            {
+                break;
+            }
 
             // Process Frame with plugin
             if (!pluginPtr_.isNull())
             {
                 pluginPtr_ -> processFrames(frameList);
             }
+
+            if (pipelineStatsPtr_)
+            {
+                // The plugin may hold on to the list - stamp copies so it isn't detached
+                for (int i=0; i<frameList.size(); i++)
+                {
+                    PipelineStamps stamps = frameList.at(i).stamps;
+                    pipelineStatsPtr_ -> recordStage(PIPELINE_STAGE_PLUGIN, stamps);
+                }
+            }
             
             acquireLock();
             done = stopped_;
@@ -8,6 +8,7 @@
 #include "lockable.hpp"
 #include <opencv2/core/core.hpp>
 #include "bias_plugin.hpp"
+#include "pipeline_stats.hpp"
 
 
 namespace bias
@@ -25,28 +26,29 @@ namespace bias
 
             PluginHandler(
                     unsigned int cameraNumber,
-                    std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr, 
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr, 
                     QObject *parent=0
                     );
 
             PluginHandler(
                     unsigned int cameraNumber,
-                    std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr, 
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr, 
                     BiasPlugin *pluginPtr,
                     QObject *parent=0
                     );
 
             void initialize(
                     unsigned int cameraNumber,
-                    std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr,
+                    std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr,
                     BiasPlugin *pluginPtr
                     );
 
             void stop();
 
             void setCameraNumber(unsigned int cameraNumber);
-            void setImageQueue(std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr);
+            void setImageQueue(std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr);
             void setPlugin(BiasPlugin *pluginPtr);
+            void setPipelineStats(PipelineStatsPtr pipelineStatsPtr);
             cv::Mat getImage() const;
 
         signals:
@@ -57,7 +59,8 @@ namespace bias
             bool stopped_;
             unsigned int cameraNumber_;
             QPointer<BiasPlugin> pluginPtr_;
-            std::shared_ptr<LockableQueue<StampedImage>> pluginImageQueuePtr_;
+            std::shared_ptr<SpscRingBuffer<StampedImage>> pluginImageQueuePtr_;
+            PipelineStatsPtr pipelineStatsPtr_;
 
             void run();
             void setReadyState();
@@ -0,0 +1,158 @@
+#include "pre_trigger_buffer.hpp"
+#include "image_pool.hpp"
+#include <algorithm>
+
+namespace bias
+{
+    const double PreTriggerBuffer::DEFAULT_PRE_TRIGGER_SEC = 5.0;
+    const double PreTriggerBuffer::DEFAULT_POST_TRIGGER_SEC = 5.0;
+    const unsigned int PreTriggerBuffer::DEFAULT_MAX_MEMORY_MB = 1024;
+    const unsigned int PreTriggerBuffer::MAX_ALLOWED_MEMORY_MB = 65536;
+    const double PreTriggerBuffer::DEFAULT_TIMER_INTERVAL_SEC = 0.0; // off
+    const unsigned long PreTriggerBuffer::MAX_NUMBER_OF_FRAMES = 100000;
+
+    // Extra pooled buffers for frames handed to a clip writer which are
+    // still held by it (e.g. waiting to be compressed) when the slot they
+    // came from is refilled.
+    const unsigned int PreTriggerBuffer::POOL_MARGIN = 16;
+
+
+    PreTriggerBuffer::PreTriggerBuffer(double durationSec, unsigned int maxMemoryMB)
+    {
+        durationSec_ = durationSec;
+        maxBytes_ = size_t(std::min(maxMemoryMB, MAX_ALLOWED_MEMORY_MB))*size_t(1 << 20);
+        frameBytes_ = 0;
+        head_ = 0;
+        count_ = 0;
+    }
+
+
+    void PreTriggerBuffer::push(const StampedImage &stampedImg)
+    {
+        const cv::Mat &image = stampedImg.image;
+        if (image.empty())
+        {
+            return;
+        }
+        size_t frameBytes = image.total()*image.elemSize();
+        if (frameBytes != frameBytes_)
+        {
+            setup(image);
+        }
+
+        if (count_ == slots_.size())
+        {
+            dropOldest();
+        }
+
+        StampedImage &slot = slots_[(head_ + count_)%slots_.size()];
+        slot.image.release();
+        imagePoolPtr_ -> getImage(slot.image, image.rows, image.cols, image.type());
+        image.copyTo(slot.image);
+        slot.timeStamp = stampedImg.timeStamp;
+        slot.dtEstimate = stampedImg.dtEstimate;
+        slot.frameCount = stampedImg.frameCount;
+        count_++;
+
+        // Keep only the last durationSec_ seconds
+        while ((count_ > 1) && (duration() > durationSec_))
+        {
+            dropOldest();
+        }
+    }
+
+
+    bool PreTriggerBuffer::pop(StampedImage &stampedImg)
+    {
+        // Removes the oldest frame. The slot gives up its reference so the
+        // buffer goes back to the pool once the caller is done with it.
+        if (count_ == 0)
+        {
+            return false;
+        }
+        stampedImg = slots_[head_];
+        slots_[head_].image.release();
+        head_ = (head_ + 1)%slots_.size();
+        count_--;
+        return true;
+    }
+
+
+    void PreTriggerBuffer::clear()
+    {
+        while (count_ > 0)
+        {
+            dropOldest();
+        }
+    }
+
+
+    size_t PreTriggerBuffer::size() const
+    {
+        return count_;
+    }
+
+
+    size_t PreTriggerBuffer::capacity() const
+    {
+        return slots_.size();
+    }
+
+
+    size_t PreTriggerBuffer::bytesAllocated() const
+    {
+        if (!imagePoolPtr_)
+        {
+            return 0;
+        }
+        return imagePoolPtr_ -> getStats().bytesAllocated;
+    }
+
+
+    double PreTriggerBuffer::duration() const
+    {
+        if (count_ == 0)
+        {
+            return 0.0;
+        }
+        const StampedImage &oldest = slots_[head_];
+        const StampedImage &newest = slots_[(head_ + count_ - 1)%slots_.size()];
+        return newest.timeStamp - oldest.timeStamp;
+    }
+
+
+    double PreTriggerBuffer::oldestTimeStamp() const
+    {
+        if (count_ == 0)
+        {
+            return 0.0;
+        }
+        return slots_[head_].timeStamp;
+    }
+
+
+    void PreTriggerBuffer::setup(const cv::Mat &image)
+    {
+        // Size the ring from the memory limit on the first frame (or when
+        // the image size changes). A new pool is used so buffers of the old
+        // size are freed once released.
+        frameBytes_ = image.total()*image.elemSize();
+        size_t numSlots = std::max(maxBytes_/frameBytes_, size_t(1));
+        numSlots = std::min(numSlots, size_t(MAX_NUMBER_OF_FRAMES));
+
+        slots_.clear();
+        slots_.resize(numSlots);
+        head_ = 0;
+        count_ = 0;
+        imagePoolPtr_ = std::make_shared<ImagePool>((unsigned int)(numSlots) + POOL_MARGIN);
+    }
+
+
+    void PreTriggerBuffer::dropOldest()
+    {
+        slots_[head_].image.release();
+        head_ = (head_ + 1)%slots_.size();
+        count_--;
+    }
+
+} // namespace bias
@@ -0,0 +1,65 @@
+#ifndef BIAS_PRE_TRIGGER_BUFFER_HPP
+#define BIAS_PRE_TRIGGER_BUFFER_HPP
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include "stamped_image.hpp"
+
+namespace bias
+{
+    class ImagePool;
+
+    class PreTriggerBuffer
+    {
+        // ------------------------------------------------------------------------
+        // Fixed size in-memory ring holding the most recent frames for
+        // pre-trigger recording. Frames are copied into buffers taken from a
+        // private ImagePool, so once the ring has filled, pushing a frame reuses
+        // the buffer of the frame it displaces instead of allocating. The ring
+        // keeps at most durationSec seconds of frames and at most maxMemoryMB
+        // of image data - whichever is reached first.
+        // ------------------------------------------------------------------------
+
+        public:
+
+            static const double DEFAULT_PRE_TRIGGER_SEC;
+            static const double DEFAULT_POST_TRIGGER_SEC;
+            static const unsigned int DEFAULT_MAX_MEMORY_MB;
+            static const unsigned int MAX_ALLOWED_MEMORY_MB;
+            static const double DEFAULT_TIMER_INTERVAL_SEC;
+            static const unsigned long MAX_NUMBER_OF_FRAMES;
+            static const unsigned int POOL_MARGIN;
+
+            PreTriggerBuffer(
+                    double durationSec=DEFAULT_PRE_TRIGGER_SEC,
+                    unsigned int maxMemoryMB=DEFAULT_MAX_MEMORY_MB
+                    );
+
+            void push(const StampedImage &stampedImg);
+            bool pop(StampedImage &stampedImg);
+            void clear();
+
+            size_t size() const;
+            size_t capacity() const;
+            size_t bytesAllocated() const;
+            double duration() const;
+            double oldestTimeStamp() const;
+
+        private:
+
+            double durationSec_;
+            size_t maxBytes_;
+            size_t frameBytes_;
+            size_t head_;
+            size_t count_;
+            std::vector<StampedImage> slots_;
+            std::shared_ptr<ImagePool> imagePoolPtr_;
+
+            void setup(const cv::Mat &image);
+            void dropOldest();
+    };
+
+} // namespace bias
+
+#endif // #ifndef BIAS_PRE_TRIGGER_BUFFER_HPP
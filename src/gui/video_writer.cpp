@@ -8,6 +8,8 @@ namespace bias
 {
     const unsigned int DEFAULT_FRAME_SKIP = 1;
     const QString DUMMY_FILENAME("dummy_filename");
+    const unsigned long VideoWriter::DRAIN_WAIT_TIMEOUT_MS = 100;
+    const unsigned long VideoWriter::DRAIN_STALL_TIMEOUT_MS = 30000;
 
     VideoWriter::VideoWriter(QObject *parent) 
         : VideoWriter(DUMMY_FILENAME,0, parent) 
@@ -22,6 +24,10 @@ namespace bias
         frameCount_ = 0;
         frameSkip_ = DEFAULT_FRAME_SKIP;
         addVersionNumber_ = true;
+        numSkipped_ = 0;
+        draining_ = false;
+        drainTotal_ = 0;
+        drainRemaining_ = 0;
     }
 
     VideoWriter::~VideoWriter() 
@@ -50,6 +56,11 @@ namespace bias
         addVersionNumber_ = value;
     }
 
+    void VideoWriter::setPipelineStats(PipelineStatsPtr pipelineStatsPtr)
+    {
+        pipelineStatsPtr_ = pipelineStatsPtr;
+    }
+
     void VideoWriter::addFrame(StampedImage stampedImg)
     {
         std::cout << __FUNCTION__;
@@ -66,6 +77,21 @@ namespace bias
         frameCount_++;
     } 
     
+    bool VideoWriter::canAcceptFrame()
+    {
+        // False while addFrame would skip a frame because the writer has 
+        // fallen behind. For callers which can wait for the writer, e.g. when
+        // writing out the pre-trigger ring. May write out finished frames.
+        return true;
+    }
+
+    bool VideoWriter::waitToAcceptFrame(unsigned long timeoutMs)
+    {
+        // Waits up to timeoutMs for canAcceptFrame - writers which can fall 
+        // behind wait on the progress of their worker threads.
+        return canAcceptFrame();
+    }
+
     QString VideoWriter::getFileName() const
     {
         return fileName_;
@@ -76,13 +102,78 @@ namespace bias
         return size_;
     }
 
+    QString VideoWriter::getStatusString() const
+    {
+        // Writer specific status information for display - by default only 
+        // the progress of finish
+        return getDrainStatusString();
+    }
+
     unsigned int VideoWriter::getFrameSkip() const
     {
         return frameSkip_;
     }
 
+    unsigned long VideoWriter::getNumSkipped() const
+    {
+        return numSkipped_;
+    }
+
     void VideoWriter::finish() {};
 
+
+    void VideoWriter::startDrain(unsigned long numOutstanding)
+    {
+        drainTimer_.start();
+        drainTotal_ = numOutstanding;
+        drainRemaining_ = numOutstanding;
+        draining_ = true;
+    }
+
+
+    void VideoWriter::updateDrain(unsigned long numOutstanding)
+    {
+        drainRemaining_ = numOutstanding;
+    }
+
+
+    void VideoWriter::endDrain()
+    {
+        if (!draining_)
+        {
+            return;
+        }
+        draining_ = false;
+        unsigned long total = drainTotal_;
+        if (total > 0)
+        {
+            std::cout << "camera " << cameraNumber_ << ": wrote " << total;
+            std::cout << " outstanding frames in " << 1.0e-3*drainTimer_.elapsed() << " s" << std::endl;
+        }
+    }
+
+
+    QString VideoWriter::getDrainStatusString() const
+    {
+        if (!draining_)
+        {
+            return QString();
+        }
+        unsigned long total = drainTotal_;
+        unsigned long remaining = drainRemaining_;
+        unsigned long done = (total > remaining) ? (total - remaining) : 0;
+        QString status = QString("finishing %1/%2 frames").arg(done).arg(total);
+
+        // Estimate time remaining from the rate so far
+        double elapsedSec = 1.0e-3*drainTimer_.elapsed();
+        if ((done > 0) && (elapsedSec > 0.0))
+        {
+            double etaSec = remaining*elapsedSec/done;
+            status += QString(", %1 s left").arg(etaSec, 0, 'f', 1);
+        }
+        return status;
+    }
+
     unsigned int VideoWriter::getNextVersionNumber()
     {
         unsigned int nextVerNum = 0;
@@ -130,4 +221,13 @@ namespace bias
     }
 
 
+    void VideoWriter::recordPipelineStage(PipelineStage stage, PipelineStamps &stamps)
+    {
+        if (pipelineStatsPtr_)
+        {
+            pipelineStatsPtr_ -> recordStage(stage, stamps);
+        }
+    }
+
+
 } // namespace bias
@@ -1,9 +1,12 @@
 #ifndef BIAS_VIDEO_WRITER_HPP
 #define BIAS_VIDEO_WRITER_HPP
 #include "stamped_image.hpp"
+#include "pipeline_stats.hpp"
 #include <QString>
 #include <QObject>
 #include <QFileInfo>
+#include <QElapsedTimer>
+#include <atomic>
 #include <opencv2/core/core.hpp>
 
 namespace bias
@@ -21,13 +24,21 @@ namespace bias
             virtual void setSize(cv::Size size);
             virtual void setFrameSkip(unsigned int frameSkip);
             virtual void setVersioning(bool value);
+            virtual void setPipelineStats(PipelineStatsPtr pipelineStatsPtr);
             virtual unsigned int getNextVersionNumber();
             virtual void addFrame(StampedImage stampedImg);
+            virtual bool canAcceptFrame();
+            virtual bool waitToAcceptFrame(unsigned long timeoutMs);
             virtual QString getFileName() const;
             virtual cv::Size getSize() const;
             virtual unsigned int getFrameSkip() const;
+            virtual QString getStatusString() const;
+            virtual unsigned long getNumSkipped() const;
             virtual void finish();
 
+            static const unsigned long DRAIN_WAIT_TIMEOUT_MS;
+            static const unsigned long DRAIN_STALL_TIMEOUT_MS;
+
         signals:
             void imageLoggingError(unsigned int errorId, QString errorMsg);
 
@@ -39,9 +50,29 @@ namespace bias
             unsigned int frameSkip_;
             unsigned int cameraNumber_;
             bool addVersionNumber_;
+            PipelineStatsPtr pipelineStatsPtr_;
+
+            // Frames dropped because the writer could not keep up
+            std::atomic<unsigned long> numSkipped_;
+
+            // Progress writing out frames which were still being compressed 
+            // when finish was called. Updated by the logger thread and read 
+            // for the status string by the gui thread.
+            std::atomic<bool> draining_;
+            std::atomic<unsigned long> drainTotal_;
+            std::atomic<unsigned long> drainRemaining_;
+            QElapsedTimer drainTimer_;
 
             QString getUniqueFileName();
             QFileInfo getFileInfo(unsigned int verNum);
+
+            void startDrain(unsigned long numOutstanding);
+            void updateDrain(unsigned long numOutstanding);
+            void endDrain();
+            QString getDrainStatusString() const;
+
+            // Compressor threads are given pipelineStatsPtr_ directly
+            void recordPipelineStage(PipelineStage stage, PipelineStamps &stamps);
     };
 
 } // namespace bias
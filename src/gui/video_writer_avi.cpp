@@ -64,6 +64,7 @@ namespace bias
         {
             //std::cout << "add frame: " << frameCount_ << std::endl;
             videoWriter_ << stampedImg.image;
+            recordPipelineStage(PIPELINE_STAGE_WRITTEN, stampedImg.stamps);
         }
         frameCount_++;
     }
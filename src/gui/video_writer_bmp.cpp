@@ -3,7 +3,10 @@
 #include "exception.hpp"
 #include <iostream>
 #include <QFileInfo>
+#include <QThreadPool>
+#include <QElapsedTimer>
 #include <stdexcept>
+#include <algorithm>
 #include <opencv2/highgui/highgui.hpp>
 #include <QtDebug>
 
@@ -12,8 +15,15 @@ namespace bias
 
     const QString VideoWriter_bmp::IMAGE_FILE_BASE = QString("image_");
     const QString VideoWriter_bmp::IMAGE_FILE_EXT = QString(".bmp");
+    const QString VideoWriter_bmp::SHARD_DIR_BASE = QString("images_");
     const QString DUMMY_FILENAME("dummy.bmp");
+    const unsigned int VideoWriter_bmp::FRAMES_TODO_MAX_QUEUE_SIZE = 250;
+    const unsigned int VideoWriter_bmp::FRAMES_FINISHED_RING_SIZE = 256;
     const unsigned int VideoWriter_bmp::DEFAULT_FRAME_SKIP = 1;
+    const ImageFileFormat_bmp VideoWriter_bmp::DEFAULT_IMAGE_FORMAT = IMAGE_FILE_FORMAT_BMP;
+    const unsigned int VideoWriter_bmp::DEFAULT_PNG_COMPRESSION_LEVEL = 1;
+    const unsigned int VideoWriter_bmp::DEFAULT_NUMBER_OF_COMPRESSORS = 4;
+    const unsigned long VideoWriter_bmp::DEFAULT_FILES_PER_DIRECTORY = 10000;
     const VideoWriterParams_bmp VideoWriter_bmp::DEFAULT_PARAMS = 
         VideoWriterParams_bmp();
 
@@ -30,10 +40,30 @@ namespace bias
             ) : VideoWriter(fileName,cameraNumber,parent) 
     {
         isFirst_ = true;
+        skipReported_ = false;
         setFrameSkip(params.frameSkip);
+
+        if (!CompressedFrame_bmp::getFormatFromString(params.imageFormat, imageFormat_))
+        {
+            imageFormat_ = DEFAULT_IMAGE_FORMAT;
+        }
+        imageFileExt_ = CompressedFrame_bmp::getFileExtension(imageFormat_);
+        pngCompressionLevel_ = params.pngCompressionLevel;
+        numberOfCompressors_ = std::max(params.numberOfCompressors, 1u);
+        filesPerDirectory_ = params.filesPerDirectory;
+        shardIndex_ = 0;
+        haveShardDir_ = false;
+
+        threadPoolPtr_ = new QThreadPool(this);
+        threadPoolPtr_ -> setMaxThreadCount(numberOfCompressors_);
+        framesToDoQueuePtr_ = std::make_shared<CompressedFrameQueue_bmp>();
+        framesFinishedRingPtr_ = std::make_shared<CompressedFrameRing_bmp>(FRAMES_FINISHED_RING_SIZE);
     }
 
-    VideoWriter_bmp::~VideoWriter_bmp() {}
+    VideoWriter_bmp::~VideoWriter_bmp() 
+    {
+        stopCompressors();
+    }
 
 
     void VideoWriter_bmp::setFileName(QString fileName)
@@ -46,35 +76,137 @@ namespace bias
 
     void VideoWriter_bmp::addFrame(StampedImage stampedImg)
     {
+        bool skipFrame = false;
+        bool ringFull = false;
+
         if (isFirst_)
         {
             setupOutput();
+            startCompressors();
             isFirst_= false;
         }
 
-        QString imageFileName = IMAGE_FILE_BASE;  
-        imageFileName += QString::number(frameCount_);
-        imageFileName += IMAGE_FILE_EXT;
-        QFileInfo imageFileInfo(logDir_,imageFileName);
-        QString fullPathName = imageFileInfo.absoluteFilePath();
         if (frameCount_%frameSkip_==0) 
         {
-            try
+            QString imageFileName = IMAGE_FILE_BASE;  
+            imageFileName += QString::number(frameCount_);
+            imageFileName += imageFileExt_;
+            QFileInfo imageFileInfo(getShardDir(frameCount_),imageFileName);
+            QString fullPathName = imageFileInfo.absoluteFilePath();
+
+            // Files are written by the compressors. The frame's slot in the 
+            // finished frames ring records when it is done so finish can wait 
+            // for the files still being written.
+            size_t sequence = 0;
+            if (framesFinishedRingPtr_ -> reserve(sequence))
             {
-                cv::imwrite(fullPathName.toStdString(), stampedImg.image);
+                framesToDoQueuePtr_ -> acquireLock();
+                if (framesToDoQueuePtr_ -> size() < FRAMES_TODO_MAX_QUEUE_SIZE)
+                {
+                    CompressedFrame_bmp compressedFrame(fullPathName, stampedImg);
+                    compressedFrame.setImageFormat(imageFormat_);
+                    compressedFrame.setPngCompressionLevel(pngCompressionLevel_);
+                    compressedFrame.setSequenceNumber(sequence);
+                    framesToDoQueuePtr_ -> push(compressedFrame);
+                    framesToDoQueuePtr_ -> wakeOne();
+                }
+                else
+                {
+                    skipFrame = true;
+                }
+                framesToDoQueuePtr_ -> releaseLock();
+
+                if (skipFrame)
+                {
+                    framesFinishedRingPtr_ -> markSkipped(sequence);
+                }
             }
-            catch (cv::Exception &exc)
+            else
             {
-                unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
-                std::string errorMsg("adding frame failed - "); 
-                errorMsg += exc.what();
-                throw RuntimeError(errorId, errorMsg);
+                skipFrame = true;
+                ringFull = true;
+            }
+        }
+
+        if (skipFrame)
+        {
+            numSkipped_++;
+        }
+
+        if ((skipFrame) && (!skipReported_))
+        { 
+            std::cout << "warning: logging overflow - skipped frame -" << std::endl;
+            unsigned int errorId = ERROR_FRAMES_TODO_MAX_QUEUE_SIZE;
+            QString errorMsg("logger framesToDoQueue has exceeded the maximum allowed size");
+            if (ringFull)
+            {
+                errorId = ERROR_FRAMES_FINISHED_MAX_SET_SIZE;
+                errorMsg = QString("image frames finished ring has exceeded the maximum allowed size");
             }
+            emit imageLoggingError(errorId, errorMsg);
+            skipReported_ = true;
         }
 
+        clearFinishedFrames();
         frameCount_++;
     }
 
+
+    bool VideoWriter_bmp::canAcceptFrame()
+    {
+        // Room for the frame in the finished frames ring and the "to do" queue
+        clearFinishedFrames();
+        if (framesFinishedRingPtr_ -> numOutstanding() >= framesFinishedRingPtr_ -> capacity())
+        {
+            return false;
+        }
+        framesToDoQueuePtr_ -> acquireLock();
+        bool haveRoom = (framesToDoQueuePtr_ -> size() < FRAMES_TODO_MAX_QUEUE_SIZE);
+        framesToDoQueuePtr_ -> releaseLock();
+        return haveRoom;
+    }
+
+
+    bool VideoWriter_bmp::waitToAcceptFrame(unsigned long timeoutMs)
+    {
+        // Every queued frame holds a slot in the ring - room is made as the 
+        // next frame in sequence is delivered.
+        if (canAcceptFrame())
+        {
+            return true;
+        }
+        framesFinishedRingPtr_ -> waitForNext(timeoutMs);
+        return canAcceptFrame();
+    }
+
+
+    void VideoWriter_bmp::finish()
+    {
+        // Wait for the compressors to write the outstanding frames, sleeping 
+        // on the ring in between deliveries.
+        startDrain(framesFinishedRingPtr_ -> numOutstanding());
+        QElapsedTimer stallTimer;
+        stallTimer.start();
+        while (framesFinishedRingPtr_ -> numOutstanding() > 0)
+        {
+            if (framesFinishedRingPtr_ -> waitForNext(DRAIN_WAIT_TIMEOUT_MS))
+            {
+                clearFinishedFrames();
+                updateDrain(framesFinishedRingPtr_ -> numOutstanding());
+                stallTimer.restart();
+            }
+            else if (stallTimer.elapsed() > qint64(DRAIN_STALL_TIMEOUT_MS))
+            {
+                endDrain();
+                unsigned int errorId = ERROR_VIDEO_WRITER_FINISH;
+                std::string errorMsg("image writer timed out waiting for compressors to finish");
+                throw RuntimeError(errorId, errorMsg);
+            }
+        }
+        endDrain();
+    }
+
+
     unsigned int VideoWriter_bmp::getNextVersionNumber()
     {
         unsigned int nextVerNum = 0;
@@ -169,4 +301,100 @@ namespace bias
         return logDir;
     }
 
+
+    QDir VideoWriter_bmp::getShardDir(unsigned long frameCount)
+    {
+        // Frames are split into subdirectories of filesPerDirectory frames 
+        // (images_000000, images_000001, ...) so no directory gets too big. The
+        // subdirectory for a frame is frameCount/filesPerDirectory.
+        if (filesPerDirectory_ == 0)
+        {
+            return logDir_;
+        }
+        unsigned long shardIndex = frameCount/filesPerDirectory_;
+        if ((!haveShardDir_) || (shardIndex != shardIndex_))
+        {
+            QString shardDirName = SHARD_DIR_BASE + QString("%1").arg(shardIndex,6,10,QChar('0'));
+            if (!logDir_.exists(shardDirName) && !logDir_.mkdir(shardDirName))
+            {
+                unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
+                std::string errorMsg("unable to create image directory, "); 
+                errorMsg += logDir_.absoluteFilePath(shardDirName).toStdString();
+                throw RuntimeError(errorId, errorMsg);
+            }
+            shardDir_ = QDir(logDir_.absoluteFilePath(shardDirName));
+            shardIndex_ = shardIndex;
+            haveShardDir_ = true;
+        }
+        return shardDir_;
+    }
+
+
+    void VideoWriter_bmp::startCompressors()
+    {
+        framesToDoQueuePtr_ -> clear();
+        framesFinishedRingPtr_ -> clear();
+        compressorPtrVec_.resize(numberOfCompressors_);
+        for (unsigned int i=0; i<compressorPtrVec_.size(); i++)
+        {
+            compressorPtrVec_[i] = new Compressor_bmp(
+                    framesToDoQueuePtr_, 
+                    framesFinishedRingPtr_, 
+                    cameraNumber_
+                    );
+            compressorPtrVec_[i] -> setPipelineStats(pipelineStatsPtr_);
+            threadPoolPtr_ -> start(compressorPtrVec_[i]);
+            connect(
+                    compressorPtrVec_[i],
+                    SIGNAL(imageLoggingError(unsigned int, QString)),
+                    this,
+                    SLOT(onCompressorError(unsigned int, QString))
+                   );
+        }
+    }
+
+
+    void VideoWriter_bmp::stopCompressors()
+    {
+        // Send all compressor threads a stop signal 
+        for (unsigned int i=0; i<compressorPtrVec_.size(); i++)
+        {
+            if (!(compressorPtrVec_[i].isNull()))
+            { 
+                compressorPtrVec_[i] -> acquireLock();
+                compressorPtrVec_[i] -> stop();
+                compressorPtrVec_[i] -> releaseLock();
+            }
+        }
+
+        // Wait until all compressor threads are null
+        for (unsigned int i=0; i<compressorPtrVec_.size(); i++)
+        {
+            while (!(compressorPtrVec_[i].isNull()))
+            {
+                framesToDoQueuePtr_ -> acquireLock();
+                framesToDoQueuePtr_ -> wakeOne();
+                framesToDoQueuePtr_ -> releaseLock();
+            }
+        }
+    }
+
+
+    unsigned int VideoWriter_bmp::clearFinishedFrames()
+    {
+        // Frames are written by the compressors - just retire their slots
+        CompressedFrame_bmp compressedFrame;
+        bool skipped = false;
+        while (framesFinishedRingPtr_ -> tryPopNext(compressedFrame, skipped)) {}
+        return (unsigned int)(framesFinishedRingPtr_ -> numReady());
+    }
+
+
+    // Private slots
+    // ----------------------------------------------------------------------------------
+    void VideoWriter_bmp::onCompressorError(unsigned int errorId, QString errorMsg)
+    {
+        emit imageLoggingError(errorId, errorMsg);
+    }
+
 } // namespace bias
@@ -2,10 +2,15 @@
 #define BIAS_VIDEO_WRITER_BMP_HPP
 #include "video_writer.hpp"
 #include "video_writer_params.hpp"
+#include "compressed_frame_bmp.hpp"
+#include "compressor_bmp.hpp"
+#include <QPointer>
 #include <QDir>
 #include <QString>
 #include <vector>
 
+class QThreadPool;
+
 namespace bias
 {
     class VideoWriter_bmp : public VideoWriter
@@ -24,23 +29,57 @@ namespace bias
             virtual ~VideoWriter_bmp();
             virtual void setFileName(QString fileName);
             virtual void addFrame(StampedImage stampedImg);
+            virtual bool canAcceptFrame();
+            virtual bool waitToAcceptFrame(unsigned long timeoutMs);
             virtual unsigned int getNextVersionNumber();
+            virtual void finish();
 
             static const QString IMAGE_FILE_BASE;
             static const QString IMAGE_FILE_EXT;
+            static const QString SHARD_DIR_BASE;
+            static const unsigned int FRAMES_TODO_MAX_QUEUE_SIZE;
+            static const unsigned int FRAMES_FINISHED_RING_SIZE;
             static const unsigned int DEFAULT_FRAME_SKIP;
+            static const ImageFileFormat_bmp DEFAULT_IMAGE_FORMAT;
+            static const unsigned int DEFAULT_PNG_COMPRESSION_LEVEL;
+            static const unsigned int DEFAULT_NUMBER_OF_COMPRESSORS;
+            static const unsigned long DEFAULT_FILES_PER_DIRECTORY;
             static const VideoWriterParams_bmp DEFAULT_PARAMS;
 
         protected:
 
             bool isFirst_;
+            bool skipReported_;
             QDir baseDir_;
             QDir logDir_;
             QString baseName_;
+
+            ImageFileFormat_bmp imageFormat_;
+            QString imageFileExt_;
+            unsigned int pngCompressionLevel_;
+            unsigned int numberOfCompressors_;
+            unsigned long filesPerDirectory_;
+            unsigned long shardIndex_;
+            bool haveShardDir_;
+            QDir shardDir_;
+
+            std::vector<QPointer<Compressor_bmp>> compressorPtrVec_;
+            CompressedFrameQueuePtr_bmp framesToDoQueuePtr_;
+            CompressedFrameRingPtr_bmp framesFinishedRingPtr_;
+            QPointer<QThreadPool> threadPoolPtr_;
+
             void setupOutput();
             QString getUniqueDirName();
             QString getLogDirName(unsigned int verNum);
             QDir getLogDir(unsigned int verNum);
+            QDir getShardDir(unsigned long frameCount);
+
+            void startCompressors();
+            void stopCompressors();
+            unsigned int clearFinishedFrames();
+
+        private slots:
+            void onCompressorError(unsigned int errorId, QString errorMsg);
 
     };
    
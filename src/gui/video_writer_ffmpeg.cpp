@@ -0,0 +1,244 @@
+#include "video_writer_ffmpeg.hpp"
+#include "encoder_ffmpeg.hpp"
+#include "basic_types.hpp"
+#include "exception.hpp"
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <iostream>
+
+namespace bias
+{
+    // Static constants
+    // -----------------------------------------------------------------
+    const QString DUMMY_FILENAME("dummy.mkv");
+    const unsigned int VideoWriter_ffmpeg::DEFAULT_FRAME_SKIP = 1;
+    const QString VideoWriter_ffmpeg::DEFAULT_CODEC = QString("ffv1");
+    const unsigned int VideoWriter_ffmpeg::DEFAULT_CRF = 18;
+    const unsigned int VideoWriter_ffmpeg::MAX_CRF = 51;
+    const QString VideoWriter_ffmpeg::DEFAULT_PRESET = QString("veryfast");
+    const unsigned int VideoWriter_ffmpeg::DEFAULT_NUMBER_OF_THREADS = 0; // one per core
+    const unsigned int VideoWriter_ffmpeg::DEFAULT_MAX_QUEUE_SIZE = 250;
+    const unsigned int VideoWriter_ffmpeg::MIN_MAX_QUEUE_SIZE = 1;
+    const double VideoWriter_ffmpeg::DEFAULT_FPS = 30.0;
+    const double VideoWriter_ffmpeg::MIN_ALLOWED_DT_ESTIMATE = 0.00001;
+    const VideoWriterParams_ffmpeg VideoWriter_ffmpeg::DEFAULT_PARAMS =
+        VideoWriterParams_ffmpeg();
+
+
+    VideoWriter_ffmpeg::VideoWriter_ffmpeg(QObject *parent)
+        : VideoWriter_ffmpeg(DEFAULT_PARAMS,DUMMY_FILENAME,0,parent)
+    {}
+
+
+    VideoWriter_ffmpeg::VideoWriter_ffmpeg(
+            VideoWriterParams_ffmpeg params,
+            QString fileName,
+            unsigned int cameraNumber,
+            QObject *parent
+            )
+        : VideoWriter(fileName,cameraNumber,parent)
+    {
+        isFirst_ = true;
+        skipReported_ = false;
+        encoderStarted_ = false;
+        params_ = params;
+        setFrameSkip(params.frameSkip);
+
+        threadPoolPtr_ = new QThreadPool(this);
+        threadPoolPtr_ -> setMaxThreadCount(1);
+
+        encoderPtr_ = std::make_shared<Encoder_ffmpeg>(cameraNumber);
+        connect(
+                encoderPtr_.get(),
+                SIGNAL(imageLoggingError(unsigned int, QString)),
+                this,
+                SLOT(onEncoderError(unsigned int, QString))
+               );
+    }
+
+
+    VideoWriter_ffmpeg::~VideoWriter_ffmpeg()
+    {
+        stopEncoder();
+    }
+
+
+    void VideoWriter_ffmpeg::addFrame(StampedImage stampedImg)
+    {
+        if (isFirst_)
+        {
+            setupOutput(stampedImg);
+            isFirst_ = false;
+        }
+
+        if (frameCount_%frameSkip_==0)
+        {
+            if (!(encoderPtr_ -> push(stampedImg)))
+            {
+                // Encode queue is full - skip frame
+                numSkipped_++;
+                if (!skipReported_)
+                {
+                    std::cout << "warning: logging overflow - skipped frame -" << std::endl;
+                    unsigned int errorId = ERROR_FRAMES_TODO_MAX_QUEUE_SIZE;
+                    QString errorMsg("ffmpeg encode queue has exceeded the maximum allowed size");
+                    emit imageLoggingError(errorId, errorMsg);
+                    skipReported_ = true;
+                }
+            }
+        }
+        frameCount_++;
+    }
+
+
+    void VideoWriter_ffmpeg::setPipelineStats(PipelineStatsPtr pipelineStatsPtr)
+    {
+        // Frames are written out by the encoder thread
+        VideoWriter::setPipelineStats(pipelineStatsPtr);
+        encoderPtr_ -> setPipelineStats(pipelineStatsPtr);
+    }
+
+
+    bool VideoWriter_ffmpeg::canAcceptFrame()
+    {
+        return encoderPtr_ -> numQueued() < params_.maxQueueSize;
+    }
+
+
+    bool VideoWriter_ffmpeg::waitToAcceptFrame(unsigned long timeoutMs)
+    {
+        if (canAcceptFrame())
+        {
+            return true;
+        }
+        encoderPtr_ -> waitForProgress(timeoutMs);
+        return canAcceptFrame();
+    }
+
+
+    QString VideoWriter_ffmpeg::getStatusString() const
+    {
+        QStringList statusList;
+        QString drainStatus = getDrainStatusString();
+        if (!drainStatus.isEmpty())
+        {
+            statusList << drainStatus;
+        }
+        statusList << QString("encode queue %1/%2").arg(encoderPtr_ -> numQueued()).arg(params_.maxQueueSize);
+        statusList << QString("%1 MB").arg(1.0e-6*double(encoderPtr_ -> bytesWritten()), 0, 'f', 1);
+        unsigned long numSkipped = numSkipped_;
+        if (numSkipped > 0)
+        {
+            statusList << QString("skipped %1").arg(numSkipped);
+        }
+        return statusList.join(", ");
+    }
+
+
+    void VideoWriter_ffmpeg::finish()
+    {
+        if (!encoderStarted_)
+        {
+            return;
+        }
+
+        // Encode what is left in the queue and flush the codec, waking on each
+        // encoded frame to update the progress, then close the file.
+        encoderPtr_ -> stop();
+        startDrain(encoderPtr_ -> numQueued());
+        QElapsedTimer stallTimer;
+        stallTimer.start();
+        while (!(encoderPtr_ -> isDone()))
+        {
+            if (encoderPtr_ -> waitForProgress(DRAIN_WAIT_TIMEOUT_MS))
+            {
+                updateDrain(encoderPtr_ -> numQueued());
+                stallTimer.restart();
+            }
+            else if (stallTimer.elapsed() > qint64(DRAIN_STALL_TIMEOUT_MS))
+            {
+                endDrain();
+                unsigned int errorId = ERROR_VIDEO_WRITER_FINISH;
+                std::string errorMsg("ffmpeg writer timed out waiting for the encoder to finish");
+                throw RuntimeError(errorId, errorMsg);
+            }
+        }
+        endDrain();
+        threadPoolPtr_ -> waitForDone();
+        encoderStarted_ = false;
+    }
+
+
+    void VideoWriter_ffmpeg::setupOutput(StampedImage stampedImg)
+    {
+        QString incrFileName = getUniqueFileName();
+        setSize(stampedImg.image.size());
+
+        double fps = DEFAULT_FPS;
+        if (stampedImg.dtEstimate > MIN_ALLOWED_DT_ESTIMATE)
+        {
+            fps = 1.0/(stampedImg.dtEstimate*frameSkip_);
+        }
+
+        try
+        {
+            encoderPtr_ -> open(incrFileName, params_, stampedImg, fps);
+        }
+        catch (RuntimeError &runtimeError)
+        {
+            isFirst_ = false;
+            throw;
+        }
+        threadPoolPtr_ -> start(encoderPtr_.get());
+        encoderStarted_ = true;
+    }
+
+
+    void VideoWriter_ffmpeg::stopEncoder()
+    {
+        if (encoderStarted_)
+        {
+            encoderPtr_ -> stop();
+            threadPoolPtr_ -> waitForDone();
+            encoderStarted_ = false;
+        }
+    }
+
+
+    void VideoWriter_ffmpeg::onEncoderError(unsigned int errorId, QString errorMsg)
+    {
+        emit imageLoggingError(errorId, errorMsg);
+    }
+
+
+    QStringList VideoWriter_ffmpeg::getListOfAllowedCodecs()
+    {
+        QStringList codecList;
+        codecList << QString("ffv1") << QString("h264") << QString("h265");
+        return codecList;
+    }
+
+
+    bool VideoWriter_ffmpeg::isAllowedCodec(QString codecString)
+    {
+        return getListOfAllowedCodecs().contains(codecString);
+    }
+
+
+    QStringList VideoWriter_ffmpeg::getListOfAllowedPresets()
+    {
+        // x264/x265 speed presets
+        QStringList presetList;
+        presetList << QString("ultrafast") << QString("superfast") << QString("veryfast");
+        presetList << QString("faster") << QString("fast") << QString("medium");
+        presetList << QString("slow") << QString("slower") << QString("veryslow");
+        return presetList;
+    }
+
+
+    bool VideoWriter_ffmpeg::isAllowedPreset(QString presetString)
+    {
+        return getListOfAllowedPresets().contains(presetString);
+    }
+
+} // namespace bias
@@ -0,0 +1,79 @@
+#ifndef BIAS_VIDEO_WRITER_FFMPEG_HPP
+#define BIAS_VIDEO_WRITER_FFMPEG_HPP
+
+#include "video_writer.hpp"
+#include "video_writer_params.hpp"
+#include <memory>
+#include <QString>
+#include <QStringList>
+#include <QPointer>
+
+class QThreadPool;
+
+namespace bias
+{
+    class Encoder_ffmpeg;
+
+    // Writes matroska (.mkv) files encoded with libavcodec - ffv1 (lossless),
+    // h264 (x264) or h265 (x265) at a constant rate factor. Encoding is done
+    // by an Encoder_ffmpeg thread fed through a bounded queue - frames which
+    // don't fit are skipped and reported like the ufmf writer does.
+    class VideoWriter_ffmpeg : public VideoWriter
+    {
+        Q_OBJECT
+
+        public:
+
+            VideoWriter_ffmpeg(QObject *parent=0);
+            VideoWriter_ffmpeg(
+                    VideoWriterParams_ffmpeg params,
+                    QString fileName,
+                    unsigned int cameraNumber,
+                    QObject *parent=0
+                    );
+            virtual ~VideoWriter_ffmpeg();
+            virtual void addFrame(StampedImage stampedImg);
+            virtual bool canAcceptFrame();
+            virtual bool waitToAcceptFrame(unsigned long timeoutMs);
+            virtual void setPipelineStats(PipelineStatsPtr pipelineStatsPtr);
+            virtual QString getStatusString() const;
+            virtual void finish();
+
+            // Static variables
+            static const unsigned int DEFAULT_FRAME_SKIP;
+            static const QString DEFAULT_CODEC;
+            static const unsigned int DEFAULT_CRF;
+            static const unsigned int MAX_CRF;
+            static const QString DEFAULT_PRESET;
+            static const unsigned int DEFAULT_NUMBER_OF_THREADS;
+            static const unsigned int DEFAULT_MAX_QUEUE_SIZE;
+            static const unsigned int MIN_MAX_QUEUE_SIZE;
+            static const double DEFAULT_FPS;
+            static const double MIN_ALLOWED_DT_ESTIMATE;
+            static const VideoWriterParams_ffmpeg DEFAULT_PARAMS;
+
+            // Static methods
+            static QStringList getListOfAllowedCodecs();
+            static bool isAllowedCodec(QString codecString);
+            static QStringList getListOfAllowedPresets();
+            static bool isAllowedPreset(QString presetString);
+
+        protected:
+
+            bool isFirst_;
+            bool skipReported_;
+            bool encoderStarted_;
+            VideoWriterParams_ffmpeg params_;
+            std::shared_ptr<Encoder_ffmpeg> encoderPtr_;
+            QPointer<QThreadPool> threadPoolPtr_;
+
+            void setupOutput(StampedImage stampedImg);
+            void stopEncoder();
+
+        private slots:
+            void onEncoderError(unsigned int errorId, QString errorMsg);
+    };
+
+}
+
+#endif // #ifndef BIAS_VIDEO_WRITER_FFMPEG_HPP
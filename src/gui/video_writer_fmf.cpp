@@ -1,6 +1,9 @@
 #include "video_writer_fmf.hpp"
 #include "basic_types.hpp"
 #include "exception.hpp"
+#include "async_file_writer.hpp"
+#include "pack12.hpp"
+#include <QThreadPool>
 #include <iostream>
 #include <stdint.h>
 #include <stdexcept>
@@ -9,6 +12,13 @@ namespace bias
 {
     const unsigned int VideoWriter_fmf::DEFAULT_FRAME_SKIP = 1;
     const unsigned int VideoWriter_fmf::FMF_VERSION = 1;
+    const unsigned int VideoWriter_fmf::FMF_VERSION_FORMAT = 3;
+    const uint64_t VideoWriter_fmf::FMF_NUM_FRAMES_OFFSET = 20;
+    const bool VideoWriter_fmf::DEFAULT_ASYNC_WRITE = true;
+    const bool VideoWriter_fmf::DEFAULT_DIRECT_IO = false;
+    const unsigned int VideoWriter_fmf::DEFAULT_EXPECTED_DURATION = 0;
+    const double VideoWriter_fmf::DEFAULT_EXPECTED_FRAME_RATE = 0.0;
+    const bool VideoWriter_fmf::DEFAULT_PACKED12 = false;
     const QString DUMMY_FILENAME("dummy.fmf");
     const VideoWriterParams_fmf VideoWriter_fmf::DEFAULT_PARAMS =
         VideoWriterParams_fmf();
@@ -25,32 +35,75 @@ namespace bias
             ) : VideoWriter(fileName, cameraNumber, parent)
     {
         numWritten_ = 0;
+        numFramesOffset_ = FMF_NUM_FRAMES_OFFSET;
+        bytesPerFrame_ = 0;
         isFirst_ = true;
         setFrameSkip(params.frameSkip);
+        asyncWrite_ = params.asyncWrite;
+        expectedDuration_ = params.expectedDuration;
+        expectedFrameRate_ = params.expectedFrameRate;
+        packed12_ = params.packed12;
+
+        // Frames are copied into large aligned buffers which are written to
+        // disk by a background thread so disk latency doesn't stall the logger.
+        fileWriterPtr_ = std::make_shared<AsyncFileWriter>();
+        fileWriterPtr_ -> setDirectIo(params.directIo);
+        fileWriterPtr_ -> setCameraNumber(cameraNumber);
+
+        threadPoolPtr_ = new QThreadPool(this);
+        threadPoolPtr_ -> setMaxThreadCount(1);
     }
 
     VideoWriter_fmf::~VideoWriter_fmf()
     {
-        file_.close();
+        fileWriterPtr_ -> finish();
+        threadPoolPtr_ -> waitForDone();
+        closeOutput();
     }
 
     void VideoWriter_fmf::finish()
     {
-        try
+        if (!fileWriterPtr_ -> isOpen())
         {
-            file_.seekp(20);
-            file_.write((char*) &numWritten_, sizeof(uint64_t));
+            return;
         }
-        catch (std::ifstream::failure &exc)
+
+        // Wait for buffered frames to reach the disk and then patch the
+        // number of frames into the header.
+        fileWriterPtr_ -> finish();
+        fileWriterPtr_ -> writeAt(numFramesOffset_, &numWritten_, sizeof(uint64_t));
+
+        std::cout << "fmf writer: " << getStatusString().toStdString() << std::endl;
+
+        if (fileWriterPtr_ -> haveError())
         {
             unsigned int errorId = ERROR_VIDEO_WRITER_FINISH;
-            std::string errorMsg("video writer finish - failed");
+            std::string errorMsg("video writer finish - failed ");
             errorMsg +=  "to write number frames:\n\n"; 
-            errorMsg += exc.what();
+            errorMsg += fileWriterPtr_ -> getErrorMsg();
             throw RuntimeError(errorId, errorMsg); 
         }
     }
 
+    QString VideoWriter_fmf::getStatusString() const
+    {
+        if (!fileWriterPtr_ -> isOpen())
+        {
+            return QString();
+        }
+        AsyncFileWriterStats stats = fileWriterPtr_ -> getStats();
+        double rateMBps = 0.0;
+        if (stats.elapsedTimeMs > 0.0)
+        {
+            rateMBps = 1.0e3*double(stats.bytesWritten)/(1024.0*1024.0*stats.elapsedTimeMs);
+        }
+        QString statusString = QString("disk %1 MB/s, max stall %2 ms, max write %3 ms")
+            .arg(rateMBps, 0, 'f', 1)
+            .arg(stats.maxStallMs, 0, 'f', 0)
+            .arg(stats.maxWriteMs, 0, 'f', 0);
+        return statusString;
+    }
+
     void VideoWriter_fmf::addFrame(StampedImage stampedImg)
     {
         if (isFirst_)
@@ -62,10 +115,20 @@ namespace bias
         {
             try
             {
-                file_.write((char*) &stampedImg.timeStamp, sizeof(double));
-                file_.write((char*) stampedImg.image.data, size_.width*size_.height*sizeof(char)); 
+                fileWriterPtr_ -> write(&stampedImg.timeStamp, sizeof(double));
+                if (packed12_)
+                {
+                    // Pack into a staging buffer which is reused from frame to frame
+                    cv::Mat image = stampedImg.image.isContinuous() ? stampedImg.image : stampedImg.image.clone();
+                    packMono12p(image.ptr<uint16_t>(0), packBuf_.data(), size_t(size_.width)*size_.height);
+                    fileWriterPtr_ -> write(packBuf_.data(), bytesPerFrame_);
+                }
+                else
+                {
+                    fileWriterPtr_ -> write(stampedImg.image.data, bytesPerFrame_); 
+                }
             }
-            catch (std::ifstream::failure &exc)
+            catch (RuntimeError &exc)
             {
                 unsigned int errorId = ERROR_VIDEO_WRITER_ADD_FRAME;
                 std::string errorMsg("video writer add frame failed:\n\n"); 
@@ -73,6 +136,7 @@ namespace bias
                 throw RuntimeError(errorId, errorMsg); 
             }
             numWritten_++;
+            recordPipelineStage(PIPELINE_STAGE_WRITTEN, stampedImg.stamps);
         }
         else 
         {
@@ -83,7 +147,7 @@ namespace bias
 
     void VideoWriter_fmf::setupOutput(StampedImage stampedImg)
     {
-        // Check image format - must be CV_8UC1
+        // Check image format - must be CV_8UC1 or CV_16UC1
         if (stampedImg.image.channels() != 1)
         {
             unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
@@ -92,59 +156,86 @@ namespace bias
             throw RuntimeError(errorId,errorMsg);
         }
 
-        if (stampedImg.image.depth() != CV_8U)
+        if ((stampedImg.image.depth() != CV_8U) && (stampedImg.image.depth() != CV_16U))
         {
             unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
             std::string errorMsg("video writer fmf setup failed:\n\n"); 
-            errorMsg += "image depth must be CV_8U";
+            errorMsg += "image depth must be CV_8U or CV_16U";
             throw RuntimeError(errorId,errorMsg);
         }
 
-        // Set error control state, set exceptions mask
-        file_.clear();
-        file_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-       
-        // Get unique name for file and open for reading
-        QString incrFileName = getUniqueFileName();
+        setSize(stampedImg.image.size());
+        size_t numPix = size_t(size_.width)*size_t(size_.height);
 
-        try
+        // Mono8 keeps the original version 1 header, 16-bit images need the 
+        // version 3 header which carries the pixel format.
+        std::string format("MONO8");
+        uint32_t bitsPerPixel = 8;
+        packed12_ = packed12_ && (stampedImg.image.depth() == CV_16U);
+        if (packed12_)
         {
-            file_.open(incrFileName.toStdString(), std::ios::binary | std::ios::out);
+            format = std::string("MONO12p");
+            bitsPerPixel = 12;
+            bytesPerFrame_ = getMono12pSize(numPix);
+            packBuf_.resize(bytesPerFrame_);
         }
-        catch (std::ifstream::failure &exc)
+        else if (stampedImg.image.depth() == CV_16U)
         {
-            unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
-            std::string errorMsg("video writer unable to open file:\n\n"); 
-            errorMsg += exc.what();
-            throw RuntimeError(errorId, errorMsg); 
+            format = std::string("MONO16");
+            bitsPerPixel = 16;
+            bytesPerFrame_ = numPix*sizeof(uint16_t);
         }
-
-        if (!file_.is_open())
+        else
         {
-            unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
-            std::string errorMsg("video writer unable to open file:\n\n"); 
-            errorMsg += "no exception thrown";
-            throw RuntimeError(errorId, errorMsg); 
+            bytesPerFrame_ = numPix;
         }
 
-        setSize(stampedImg.image.size());
-
         // Cast values to integers with specific widths
-        uint32_t fmfVersion = uint32_t(FMF_VERSION);
+        uint32_t fmfVersion = uint32_t((bitsPerPixel == 8) ? FMF_VERSION : FMF_VERSION_FORMAT);
+        uint32_t formatLength = uint32_t(format.size());
         uint32_t width = uint32_t(size_.width);
         uint32_t height = uint32_t(size_.height);
-        uint64_t bytesPerChunk = uint64_t(width)*uint64_t(height) + sizeof(double);
+        uint64_t bytesPerChunk = uint64_t(bytesPerFrame_) + sizeof(double);
+
+        // Preallocate space for the expected recording so the file system
+        // doesn't have to extend the file as it grows. 
+        if ((expectedDuration_ > 0) && (expectedFrameRate_ > 0.0))
+        {
+            double numFrames = double(expectedDuration_)*expectedFrameRate_/double(frameSkip_);
+            uint64_t numBytes = FMF_NUM_FRAMES_OFFSET + sizeof(uint64_t);
+            if (fmfVersion == FMF_VERSION_FORMAT)
+            {
+                numBytes += 2*sizeof(uint32_t) + formatLength;
+            }
+            numBytes += uint64_t(numFrames + 1.0)*bytesPerChunk;
+            fileWriterPtr_ -> setPreallocateSize(numBytes);
+        }
+
+        // Get unique name for file and open for writing
+        QString incrFileName = getUniqueFileName();
+        fileWriterPtr_ -> open(incrFileName.toStdString());
+        if (asyncWrite_)
+        {
+            fileWriterPtr_ -> start(threadPoolPtr_);
+        }
 
         // Add fmf header to file
         try 
         {
-            file_.write((char*) &fmfVersion, sizeof(uint32_t));
-            file_.write((char*) &height, sizeof(uint32_t));
-            file_.write((char*) &width, sizeof(uint32_t));
-            file_.write((char*) &bytesPerChunk, sizeof(uint64_t));
-            file_.write((char*) &numWritten_, sizeof(uint64_t));
+            fileWriterPtr_ -> write(&fmfVersion, sizeof(uint32_t));
+            if (fmfVersion == FMF_VERSION_FORMAT)
+            {
+                fileWriterPtr_ -> write(&formatLength, sizeof(uint32_t));
+                fileWriterPtr_ -> write(format.data(), formatLength*sizeof(char));
+                fileWriterPtr_ -> write(&bitsPerPixel, sizeof(uint32_t));
+            }
+            fileWriterPtr_ -> write(&height, sizeof(uint32_t));
+            fileWriterPtr_ -> write(&width, sizeof(uint32_t));
+            fileWriterPtr_ -> write(&bytesPerChunk, sizeof(uint64_t));
+            numFramesOffset_ = fileWriterPtr_ -> tellp();
+            fileWriterPtr_ -> write(&numWritten_, sizeof(uint64_t));
         }
-        catch (std::ifstream::failure &exc)
+        catch (RuntimeError &exc)
         {
             unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
             std::string errorMsg("video writer unable to write fmf header:\n\n"); 
@@ -154,5 +245,15 @@ namespace bias
 
     }
 
+    void VideoWriter_fmf::closeOutput()
+    {
+        if (!fileWriterPtr_ -> isOpen())
+        {
+            return;
+        }
+        fileWriterPtr_ -> writeAt(numFramesOffset_, &numWritten_, sizeof(uint64_t));
+        fileWriterPtr_ -> close();
+    }
+
 
 } // namespace bias
@@ -3,10 +3,21 @@
 
 #include "video_writer.hpp"
 #include "video_writer_params.hpp"
-#include <fstream>
+#include <memory>
+#include <cstdint>
+#include <vector>
+#include <QPointer>
+
+class QThreadPool;
 
 namespace bias 
 {
+    class AsyncFileWriter;
+
+    // Writes fmf files. Mono8 images are written as version 1 files. Mono16
+    // images are written as version 3 files with format MONO16 or, when
+    // packed12 is set, MONO12p (the 12 most significant bits of each pixel,
+    // two pixels per three bytes).
     class VideoWriter_fmf : public VideoWriter
     {
         Q_OBJECT
@@ -22,16 +33,33 @@ namespace bias
             ~VideoWriter_fmf();
             virtual void finish();
             virtual void addFrame(StampedImage stampedImg);
+            virtual QString getStatusString() const;
 
             static const unsigned int DEFAULT_FRAME_SKIP;
             static const unsigned int FMF_VERSION;
+            static const unsigned int FMF_VERSION_FORMAT;
+            static const uint64_t FMF_NUM_FRAMES_OFFSET;
+            static const bool DEFAULT_ASYNC_WRITE;
+            static const bool DEFAULT_DIRECT_IO;
+            static const unsigned int DEFAULT_EXPECTED_DURATION;
+            static const double DEFAULT_EXPECTED_FRAME_RATE;
+            static const bool DEFAULT_PACKED12;
             static const VideoWriterParams_fmf DEFAULT_PARAMS;
 
         private:
             bool isFirst_;
-            std::fstream file_;
+            bool asyncWrite_;
+            bool packed12_;
+            unsigned int expectedDuration_;
+            double expectedFrameRate_;
             uint64_t numWritten_;
+            uint64_t numFramesOffset_;
+            size_t bytesPerFrame_;
+            std::vector<uint8_t> packBuf_;
+            std::shared_ptr<AsyncFileWriter> fileWriterPtr_;
+            QPointer<QThreadPool> threadPoolPtr_;
             void setupOutput(StampedImage stampImg);
+            void closeOutput();
     };
 
 } // namespace bias
@@ -23,7 +23,7 @@ namespace bias
     const std::string VideoWriter_jpg::MJPG_BOUNDARY_MARKER = std::string("--boundary\r\n");
     const QString DUMMY_FILENAME("dummy.jpg");
     const unsigned int VideoWriter_jpg::FRAMES_TODO_MAX_QUEUE_SIZE = 250;
-    const unsigned int VideoWriter_jpg::FRAMES_FINISHED_MAX_SET_SIZE = 250;
+    const unsigned int VideoWriter_jpg::FRAMES_FINISHED_RING_SIZE = 256;
     const unsigned int VideoWriter_jpg::DEFAULT_FRAME_SKIP = 1;
     const unsigned int VideoWriter_jpg::DEFAULT_QUALITY = 90;
     const unsigned int VideoWriter_jpg::MIN_QUALITY = 0;
@@ -33,6 +33,8 @@ namespace bias
     const bool VideoWriter_jpg::DEFAULT_MJPG_MAX_FRAME_PER_FILE_FLAG = false;
     const unsigned long VideoWriter_jpg::DEFAULT_MJPG_MAX_FRAME_PER_FILE = 5000000;
     const unsigned long VideoWriter_jpg::MJPG_MINVAL_MAX_FRAME_PER_FILE = 10;
+    const unsigned int VideoWriter_jpg::DEFAULT_CHROMA_SUBSAMPLING = 420;
+    const bool VideoWriter_jpg::DEFAULT_FAST_DCT = false;
     const VideoWriterParams_jpg VideoWriter_jpg::DEFAULT_PARAMS = VideoWriterParams_jpg();
 
     // VideoWriter_jpg methods
@@ -51,7 +53,6 @@ namespace bias
 
         isFirst_ = true;
         skipReported_ = false;;
-        nextFrameToWrite_ = 0;
 
         movieFileCount_ = 0;
         movieFileFrameCount_ = 0;
@@ -62,12 +63,14 @@ namespace bias
         mjpgMaxFramePerFileFlag_ = params.mjpgMaxFramePerFileFlag;
         mjpgMaxFramePerFile_ = params.mjpgMaxFramePerFile;
         numberOfCompressors_ = params.numberOfCompressors; 
+        chromaSubsampling_ = params.chromaSubsampling;
+        fastDct_ = params.fastDct;
 
         threadPoolPtr_ = new QThreadPool(this);
         threadPoolPtr_ -> setMaxThreadCount(numberOfCompressors_);
         framesToDoQueuePtr_ = std::make_shared<CompressedFrameQueue_jpg>();
-        framesFinishedSetPtr_ = std::make_shared<CompressedFrameSet_jpg>();
-        framesSkippedIndexListPtr_ = std::make_shared<Lockable<std::list<unsigned long>>>();
+        framesFinishedRingPtr_ = std::make_shared<CompressedFrameRing_jpg>(FRAMES_FINISHED_RING_SIZE);
+        spareBuffersPtr_ = std::make_shared<EncodedBufferQueue_jpg>();
     }
 
 
@@ -93,6 +96,7 @@ namespace bias
     void VideoWriter_jpg::addFrame(StampedImage stampedImg)
     {
         bool skipFrame = false;
+        bool ringFull = false;
 
         if (isFirst_)
         {
@@ -112,37 +116,55 @@ namespace bias
 
         if (frameCount_%frameSkip_==0) 
         {
-            framesToDoQueuePtr_ -> acquireLock();
-            unsigned int framesToDoQueueSize = framesToDoQueuePtr_ -> size();
-            if (framesToDoQueueSize < FRAMES_TODO_MAX_QUEUE_SIZE)
+            // Every frame gets a slot in the finished frames reorder ring. Mjpg
+            // frames are written by this thread from the ring in order. Individual
+            // jpg files are written directly by the compressors and their slot 
+            // only records completion so finish knows when they are all done.
+            size_t sequence = 0;
+            if (framesFinishedRingPtr_ -> reserve(sequence))
             {
-                CompressedFrame_jpg compressedFrame(fullPathName, stampedImg, quality_, mjpgFlag_);
-                framesToDoQueuePtr_ -> push(compressedFrame);
-                framesToDoQueuePtr_ -> wakeOne();
+                framesToDoQueuePtr_ -> acquireLock();
+                unsigned int framesToDoQueueSize = framesToDoQueuePtr_ -> size();
+                if (framesToDoQueueSize < FRAMES_TODO_MAX_QUEUE_SIZE)
+                {
+                    CompressedFrame_jpg compressedFrame(fullPathName, stampedImg, quality_, mjpgFlag_);
+                    compressedFrame.setSequenceNumber(sequence);
+                    framesToDoQueuePtr_ -> push(compressedFrame);
+                    framesToDoQueuePtr_ -> wakeOne();
+                }
+                else
+                { 
+                    skipFrame = true;
+                }
+                framesToDoQueuePtr_ -> releaseLock();
+
+                if (skipFrame)
+                {
+                    framesFinishedRingPtr_ -> markSkipped(sequence);
+                }
             }
             else
-            { 
-                skipFrame = true;
-            }
-            framesToDoQueuePtr_ -> releaseLock();
-
-            if (skipFrame)
             {
-                framesSkippedIndexListPtr_ -> acquireLock();
-                framesSkippedIndexListPtr_ -> push_back(stampedImg.frameCount);
-                framesSkippedIndexListPtr_ -> releaseLock();
+                skipFrame = true;
+                ringFull = true;
             }
         }
 
-        framesSkippedIndexListPtr_ -> acquireLock();
-        unsigned int framesSkippedIndexListSize = framesSkippedIndexListPtr_ -> size();
-        framesSkippedIndexListPtr_ -> releaseLock();
+        if (skipFrame)
+        {
+            numSkipped_++;
+        }
 
         if ((skipFrame) && (!skipReported_))
         { 
             std::cout << "warning: logging overflow - skipped frame -" << std::endl;
             unsigned int errorId = ERROR_FRAMES_TODO_MAX_QUEUE_SIZE;
             QString errorMsg("logger framesToDoQueue has exceeded the maximum allowed size");
+            if (ringFull)
+            {
+                errorId = ERROR_FRAMES_FINISHED_MAX_SET_SIZE;
+                errorMsg = QString("jpg frames finished ring has exceeded the maximum allowed size");
+            }
             emit imageLoggingError(errorId, errorMsg);
             skipReported_ = true;
             // Note this will not trigger stop of image acquisition ... just display a warning.
@@ -153,19 +175,58 @@ namespace bias
     }
 
 
+    bool VideoWriter_jpg::canAcceptFrame()
+    {
+        // Room for the frame in the finished frames ring and the "to do" queue
+        clearFinishedFrames();
+        if (framesFinishedRingPtr_ -> numOutstanding() >= framesFinishedRingPtr_ -> capacity())
+        {
+            return false;
+        }
+        framesToDoQueuePtr_ -> acquireLock();
+        bool haveRoom = (framesToDoQueuePtr_ -> size() < FRAMES_TODO_MAX_QUEUE_SIZE);
+        framesToDoQueuePtr_ -> releaseLock();
+        return haveRoom;
+    }
+
+
+    bool VideoWriter_jpg::waitToAcceptFrame(unsigned long timeoutMs)
+    {
+        // Every queued frame holds a slot in the ring - room is made as the 
+        // next frame in sequence is delivered.
+        if (canAcceptFrame())
+        {
+            return true;
+        }
+        framesFinishedRingPtr_ -> waitForNext(timeoutMs);
+        return canAcceptFrame();
+    }
+
+
     void VideoWriter_jpg::finish()
     {
-        bool finished = false;
-        while (!finished)
+        // Write out frames as the compressors deliver them, sleeping on the ring
+        // in between, until every frame handed out has been accounted for.
+        startDrain(framesFinishedRingPtr_ -> numOutstanding());
+        QElapsedTimer stallTimer;
+        stallTimer.start();
+        while (framesFinishedRingPtr_ -> numOutstanding() > 0)
         {
-            framesToDoQueuePtr_ -> acquireLock();
-            if ( (framesToDoQueuePtr_ -> size()) == 0)
+            if (framesFinishedRingPtr_ -> waitForNext(DRAIN_WAIT_TIMEOUT_MS))
             {
-                finished = true;
+                clearFinishedFrames();
+                updateDrain(framesFinishedRingPtr_ -> numOutstanding());
+                stallTimer.restart();
+            }
+            else if (stallTimer.elapsed() > qint64(DRAIN_STALL_TIMEOUT_MS))
+            {
+                endDrain();
+                unsigned int errorId = ERROR_VIDEO_WRITER_FINISH;
+                std::string errorMsg("jpg writer timed out waiting for compressors to finish");
+                throw RuntimeError(errorId, errorMsg);
             }
-            framesToDoQueuePtr_ -> releaseLock();
         }
-        while (clearFinishedFrames() > 0);
+        endDrain();
     }
 
 
@@ -309,15 +370,18 @@ namespace bias
     void VideoWriter_jpg::startCompressors()
     {
         framesToDoQueuePtr_ -> clear();
+        framesFinishedRingPtr_ -> clear();
         compressorPtrVec_.resize(numberOfCompressors_);
         for (unsigned int i=0; i<compressorPtrVec_.size(); i++)
         {
             compressorPtrVec_[i] = new Compressor_jpg(
                     framesToDoQueuePtr_, 
-                    framesFinishedSetPtr_, 
-                    framesSkippedIndexListPtr_, 
+                    framesFinishedRingPtr_, 
                     cameraNumber_
                     );
+            compressorPtrVec_[i] -> setEncoderOptions(chromaSubsampling_, fastDct_);
+            compressorPtrVec_[i] -> setSpareBufferQueue(spareBuffersPtr_);
+            compressorPtrVec_[i] -> setPipelineStats(pipelineStatsPtr_);
             threadPoolPtr_ -> start(compressorPtrVec_[i]);
             connect(
                     compressorPtrVec_[i],
@@ -356,97 +420,49 @@ namespace bias
 
     unsigned int VideoWriter_jpg::clearFinishedFrames()
     {
-        framesFinishedSetPtr_ -> acquireLock();
-        bool framesFinishedSetEmpty = framesFinishedSetPtr_ -> empty();
-        framesFinishedSetPtr_ -> releaseLock();
+        // Write encoded frames to the mjpg file in order. Frames which were 
+        // skipped, and individual jpg frames (already written), are marked in 
+        // their slot so they are passed over.
+        CompressedFrame_jpg compressedFrame;
+        bool skipped = false;
 
-        if (!framesFinishedSetEmpty)
+        while (framesFinishedRingPtr_ -> tryPopNext(compressedFrame, skipped))
         {
-            bool writeDone = false;
-            while ( (!writeDone) && (!framesFinishedSetEmpty) ) 
+            if ((skipped) || (!mjpgFlag_))
             {
-                // Handle skipped frames. 
-                // --------------------------------------------------------------------------------
-                framesSkippedIndexListPtr_ -> acquireLock();
-                if (framesSkippedIndexListPtr_ -> size() > 0)
-
-                {
-                    std::list<unsigned long>::iterator skippedIndexIt = framesSkippedIndexListPtr_ -> begin();
-                    bool done = false;
-
-                    while (!done)
-                    {
-                        if (*skippedIndexIt == nextFrameToWrite_)
-                        {
-                            nextFrameToWrite_ += frameSkip_;
-                        }
-                        else if (*skippedIndexIt < nextFrameToWrite_)
-                        {
-                            if (framesSkippedIndexListPtr_ -> size() > 1)
-                            {
-                                skippedIndexIt++;
-                            }
-                            else
-                            {
-                                done = true;
-                            }
-                            framesSkippedIndexListPtr_ -> pop_front();
-                        }
-                        else
-                        {
-                            done = true;
-                        }
-                    }
-                }
-                framesSkippedIndexListPtr_ -> releaseLock();
-
-                // Write next frame to file
-                // --------------------------------------------------------------------------------
-                framesFinishedSetPtr_ -> acquireLock();
-                CompressedFrameSet_jpg::iterator frameIt = framesFinishedSetPtr_ -> begin();
-                CompressedFrame_jpg compressedFrame = *frameIt;
-
-                if (compressedFrame.getFrameCount() == nextFrameToWrite_)
-                {
-                    framesFinishedSetPtr_ -> erase(frameIt);
-                    nextFrameToWrite_ += frameSkip_;
-                    writeCompressedMjpgFrame(compressedFrame);
-
-                    movieFileFrameCount_ += 1;
-                    if ((mjpgMaxFramePerFileFlag_) && (movieFileFrameCount_ >= mjpgMaxFramePerFile_)) { 
-                        movieFile_.close();
-                        indexFile_.close();
-                        movieFileCount_ += 1;
-                        movieFileFrameCount_ = 0;
-                        QString movieFileName = getMovieFileName(); 
-                        QString indexFileName = getIndexFileName();
-                        movieFile_.open(movieFileName.toStdString(), std::ios::out | std::ios::binary);
-                        indexFile_.open(indexFileName.toStdString(), std::ios::out);
-                    }
-                }
-                else
-                {
-                    writeDone = true;
-                }
-                framesFinishedSetEmpty = framesFinishedSetPtr_ -> empty();
-                framesFinishedSetPtr_ -> releaseLock();
-
-            } // while ( (!writeDone) && (!framesFinishedSetEmpty) ) 
-
-        } // if (!(framesFinishedSetPtr_ 
+                continue;
+            }
+            writeCompressedMjpgFrame(compressedFrame);
 
-        framesFinishedSetPtr_ -> acquireLock();
-        unsigned int framesFinishedSetSize = framesFinishedSetPtr_ -> size();
-        framesFinishedSetPtr_ -> releaseLock();
-        return framesFinishedSetSize;
+            // Hand the encoded buffer back so a compressor can reuse it 
+            spareBuffersPtr_ -> acquireLock();
+            if (spareBuffersPtr_ -> size() < FRAMES_FINISHED_RING_SIZE)
+            {
+                spareBuffersPtr_ -> push(std::move(compressedFrame.getEncodedJpgBuffer()));
+            }
+            spareBuffersPtr_ -> releaseLock();
+
+            movieFileFrameCount_ += 1;
+            if ((mjpgMaxFramePerFileFlag_) && (movieFileFrameCount_ >= mjpgMaxFramePerFile_)) { 
+                movieFile_.close();
+                indexFile_.close();
+                movieFileCount_ += 1;
+                movieFileFrameCount_ = 0;
+                QString movieFileName = getMovieFileName(); 
+                QString indexFileName = getIndexFileName();
+                movieFile_.open(movieFileName.toStdString(), std::ios::out | std::ios::binary);
+                indexFile_.open(indexFileName.toStdString(), std::ios::out);
+            }
+        }
+        return (unsigned int)(framesFinishedRingPtr_ -> numReady());
     }
 
-    void VideoWriter_jpg::writeCompressedMjpgFrame(CompressedFrame_jpg frame)
+    void VideoWriter_jpg::writeCompressedMjpgFrame(CompressedFrame_jpg &frame)
     {
         if (frame.haveEncoding())
         {
             movieFile_.write(MJPG_BOUNDARY_MARKER.c_str(),MJPG_BOUNDARY_MARKER.size());
-            std::vector<uchar> jpgBuffer = frame.getEncodedJpgBuffer();
+            const std::vector<uchar> &jpgBuffer = frame.getEncodedJpgBuffer();
             std::ofstream::pos_type frameBeginPos = movieFile_.tellp();
             movieFile_.write((const char *) &jpgBuffer[0],jpgBuffer.size());
             std::ofstream::pos_type frameEndPos = movieFile_.tellp();
@@ -459,6 +475,7 @@ namespace bias
             ss << frameEndPos            << std::endl;;
             std::string indexData = ss.str();
             indexFile_.write(indexData.c_str(), indexData.size());
+            recordPipelineStage(PIPELINE_STAGE_WRITTEN, frame.getPipelineStamps());
         }
     }
 
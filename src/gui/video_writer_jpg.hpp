@@ -36,6 +36,8 @@ namespace bias
             virtual void setFileName(QString fileName);
             virtual unsigned int getNextVersionNumber();
             virtual void addFrame(StampedImage stampedImg);
+            virtual bool canAcceptFrame();
+            virtual bool waitToAcceptFrame(unsigned long timeoutMs);
             virtual void finish();
 
             static const QString IMAGE_FILE_BASE;
@@ -46,7 +48,7 @@ namespace bias
             static const QString MJPG_INDEX_NAME;
             static const std::string MJPG_BOUNDARY_MARKER;
             static const unsigned int FRAMES_TODO_MAX_QUEUE_SIZE;
-            static const unsigned int FRAMES_FINISHED_MAX_SET_SIZE;
+            static const unsigned int FRAMES_FINISHED_RING_SIZE;
             static const unsigned int DEFAULT_FRAME_SKIP;
             static const unsigned int DEFAULT_QUALITY;
             static const unsigned int MIN_QUALITY;
@@ -56,6 +58,8 @@ namespace bias
             static const bool DEFAULT_MJPG_MAX_FRAME_PER_FILE_FLAG;
             static const unsigned long DEFAULT_MJPG_MAX_FRAME_PER_FILE;
             static const unsigned long MJPG_MINVAL_MAX_FRAME_PER_FILE;
+            static const unsigned int DEFAULT_CHROMA_SUBSAMPLING;
+            static const bool DEFAULT_FAST_DCT;
             static const VideoWriterParams_jpg DEFAULT_PARAMS;
 
 
@@ -71,7 +75,8 @@ namespace bias
             QString baseName_;
             QDir logDir_;
             unsigned int numberOfCompressors_;
-            unsigned long nextFrameToWrite_;
+            unsigned int chromaSubsampling_;
+            bool fastDct_;
 
             std::ofstream movieFile_;
             std::ofstream indexFile_;
@@ -82,8 +87,8 @@ namespace bias
             std::vector<QPointer<Compressor_jpg>> compressorPtrVec_;
 
             CompressedFrameQueuePtr_jpg framesToDoQueuePtr_;
-            CompressedFrameSetPtr_jpg framesFinishedSetPtr_;
-            std::shared_ptr<Lockable<std::list<unsigned long>>> framesSkippedIndexListPtr_;
+            CompressedFrameRingPtr_jpg framesFinishedRingPtr_;
+            EncodedBufferQueuePtr_jpg spareBuffersPtr_;
 
             QPointer<QThreadPool> threadPoolPtr_;
 
@@ -97,7 +102,7 @@ namespace bias
             void startCompressors();
             void stopCompressors();
             unsigned int clearFinishedFrames();
-            void writeCompressedMjpgFrame(CompressedFrame_jpg frame);
+            void writeCompressedMjpgFrame(CompressedFrame_jpg &frame);
 
 
         private slots:
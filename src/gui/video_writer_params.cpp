@@ -4,7 +4,10 @@
 #include "video_writer_avi.hpp"
 #include "video_writer_fmf.hpp"
 #include "video_writer_ufmf.hpp"
+#include "video_writer_ffmpeg.hpp"
 #include "background_histogram_ufmf.hpp"
+#include "background_median_ufmf.hpp"
+#include "pre_trigger_buffer.hpp"
 #include <sstream>
 
 namespace bias
@@ -15,12 +18,20 @@ namespace bias
     VideoWriterParams_bmp::VideoWriterParams_bmp()
     {
         frameSkip = VideoWriter_bmp::DEFAULT_FRAME_SKIP;
+        imageFormat = CompressedFrame_bmp::getFormatString(VideoWriter_bmp::DEFAULT_IMAGE_FORMAT);
+        pngCompressionLevel = VideoWriter_bmp::DEFAULT_PNG_COMPRESSION_LEVEL;
+        numberOfCompressors = VideoWriter_bmp::DEFAULT_NUMBER_OF_COMPRESSORS;
+        filesPerDirectory = VideoWriter_bmp::DEFAULT_FILES_PER_DIRECTORY;
     }
 
     std::string VideoWriterParams_bmp::toString()
     {
         std::stringstream ss;
         ss << "frameSkip: " << frameSkip << std::endl;
+        ss << "imageFormat: " << imageFormat.toStdString() << std::endl;
+        ss << "pngCompressionLevel: " << pngCompressionLevel << std::endl;
+        ss << "numberOfCompressors: " << numberOfCompressors << std::endl;
+        ss << "filesPerDirectory: " << filesPerDirectory << std::endl;
         return ss.str();
     }
 
@@ -35,6 +46,8 @@ namespace bias
         mjpgFlag = VideoWriter_jpg::DEFAULT_MJPG_FLAG;
         mjpgMaxFramePerFileFlag = VideoWriter_jpg::DEFAULT_MJPG_MAX_FRAME_PER_FILE_FLAG;
         mjpgMaxFramePerFile = VideoWriter_jpg::DEFAULT_MJPG_MAX_FRAME_PER_FILE;
+        chromaSubsampling = VideoWriter_jpg::DEFAULT_CHROMA_SUBSAMPLING;
+        fastDct = VideoWriter_jpg::DEFAULT_FAST_DCT;
     }
 
     
@@ -47,6 +60,8 @@ namespace bias
         ss << "mjpgFlag: " << std::boolalpha << mjpgFlag << std::noboolalpha << std::endl;
         ss << "mjpgMaxFramePerFileFlag: " << std::boolalpha << mjpgMaxFramePerFileFlag << std::noboolalpha << std::endl;
         ss << "mjpgMaxFramePerFile: " << mjpgMaxFramePerFile << std::endl;
+        ss << "chromaSubsampling: " << chromaSubsampling << std::endl;
+        ss << "fastDct: " << std::boolalpha << fastDct << std::noboolalpha << std::endl;
         return ss.str();
     }
 
@@ -75,6 +90,11 @@ namespace bias
     VideoWriterParams_fmf::VideoWriterParams_fmf()
     {
         frameSkip = VideoWriter_fmf::DEFAULT_FRAME_SKIP;
+        asyncWrite = VideoWriter_fmf::DEFAULT_ASYNC_WRITE;
+        directIo = VideoWriter_fmf::DEFAULT_DIRECT_IO;
+        expectedDuration = VideoWriter_fmf::DEFAULT_EXPECTED_DURATION;
+        expectedFrameRate = VideoWriter_fmf::DEFAULT_EXPECTED_FRAME_RATE;
+        packed12 = VideoWriter_fmf::DEFAULT_PACKED12;
     }
 
 
@@ -82,6 +102,11 @@ namespace bias
     {
         std::stringstream ss;
         ss << "frameSkip: " << frameSkip << std::endl;
+        ss << "asyncWrite: " << std::boolalpha << asyncWrite << std::noboolalpha << std::endl;
+        ss << "directIo: " << std::boolalpha << directIo << std::noboolalpha << std::endl;
+        ss << "expectedDuration: " << expectedDuration << std::endl;
+        ss << "expectedFrameRate: " << expectedFrameRate << std::endl;
+        ss << "packed12: " << std::boolalpha << packed12 << std::noboolalpha << std::endl;
         return ss.str();
     }
 
@@ -95,9 +120,13 @@ namespace bias
         boxLength = VideoWriter_ufmf::DEFAULT_BOX_LENGTH;
         medianUpdateCount = BackgroundHistogram_ufmf::DEFAULT_MEDIAN_UPDATE_COUNT; 
         medianUpdateInterval = BackgroundHistogram_ufmf::DEFAULT_MEDIAN_UPDATE_INTERVAL;
+        numberOfMedianWorkers = BackgroundMedian_ufmf::DEFAULT_NUMBER_OF_WORKERS;
+        medianIncremental = BackgroundMedian_ufmf::DEFAULT_INCREMENTAL;
         numberOfCompressors = VideoWriter_ufmf::DEFAULT_NUMBER_OF_COMPRESSORS;
         dilateState = VideoWriter_ufmf::DEFAULT_DILATE_STATE;
         dilateWindowSize = VideoWriter_ufmf::DEFAULT_DILATE_WINDOW_SIZE;
+        directIo = VideoWriter_ufmf::DEFAULT_DIRECT_IO;
+        preallocateMB = VideoWriter_ufmf::DEFAULT_PREALLOCATE_MB;
     }
 
 
@@ -108,9 +137,63 @@ namespace bias
         ss << "backgroundThreshold: " << backgroundThreshold << std::endl;
         ss << "boxLength: " << boxLength << std::endl;
         ss << "meidanUpdateCount: " << medianUpdateCount << std::endl;
+        ss << "numberOfMedianWorkers: " << numberOfMedianWorkers << std::endl;
+        ss << "medianIncremental: " << std::boolalpha << medianIncremental << std::noboolalpha << std::endl;
         ss << "numberOfCompressors: " << numberOfCompressors << std::endl;
         ss << "dilateState: " << std::boolalpha << dilateState << std::noboolalpha << std::endl;
         ss << "dilateWindowSize: " << dilateWindowSize << std::endl;
+        ss << "directIo: " << std::boolalpha << directIo << std::noboolalpha << std::endl;
+        ss << "preallocateMB: " << preallocateMB << std::endl;
+        return ss.str();
+    }
+
+
+    // ffmpeg
+    // ------------------------------------------------------------------------
+    VideoWriterParams_ffmpeg::VideoWriterParams_ffmpeg()
+    {
+        frameSkip = VideoWriter_ffmpeg::DEFAULT_FRAME_SKIP;
+        codec = VideoWriter_ffmpeg::DEFAULT_CODEC;
+        crf = VideoWriter_ffmpeg::DEFAULT_CRF;
+        preset = VideoWriter_ffmpeg::DEFAULT_PRESET;
+        numberOfThreads = VideoWriter_ffmpeg::DEFAULT_NUMBER_OF_THREADS;
+        maxQueueSize = VideoWriter_ffmpeg::DEFAULT_MAX_QUEUE_SIZE;
+    }
+
+
+    std::string VideoWriterParams_ffmpeg::toString()
+    {
+        std::stringstream ss;
+        ss << "frameSkip: " << frameSkip << std::endl;
+        ss << "codec: " << codec.toStdString() << std::endl;
+        ss << "crf: " << crf << std::endl;
+        ss << "preset: " << preset.toStdString() << std::endl;
+        ss << "numberOfThreads: " << numberOfThreads << std::endl;
+        ss << "maxQueueSize: " << maxQueueSize << std::endl;
+        return ss.str();
+    }
+
+
+    // pre-trigger
+    // ------------------------------------------------------------------------
+    PreTriggerParams::PreTriggerParams()
+    {
+        enabled = false;
+        preTriggerSec = PreTriggerBuffer::DEFAULT_PRE_TRIGGER_SEC;
+        postTriggerSec = PreTriggerBuffer::DEFAULT_POST_TRIGGER_SEC;
+        maxMemoryMB = PreTriggerBuffer::DEFAULT_MAX_MEMORY_MB;
+        timerIntervalSec = PreTriggerBuffer::DEFAULT_TIMER_INTERVAL_SEC;
+    }
+
+
+    std::string PreTriggerParams::toString()
+    {
+        std::stringstream ss;
+        ss << "enabled: " << std::boolalpha << enabled << std::noboolalpha << std::endl;
+        ss << "preTriggerSec: " << preTriggerSec << std::endl;
+        ss << "postTriggerSec: " << postTriggerSec << std::endl;
+        ss << "maxMemoryMB: " << maxMemoryMB << std::endl;
+        ss << "timerIntervalSec: " << timerIntervalSec << std::endl;
         return ss.str();
     }
 
@@ -141,6 +224,14 @@ namespace bias
         ss << sepString << std::endl;
         ss << ufmf.toString() << std::endl;
 
+        ss << "ffmpeg" << std::endl;
+        ss << sepString << std::endl;
+        ss << ffmpeg.toString() << std::endl;
+
+        ss << "preTrigger" << std::endl;
+        ss << sepString << std::endl;
+        ss << preTrigger.toString() << std::endl;
+
         return ss.str();
 
     }
@@ -10,6 +10,10 @@ namespace bias
     struct VideoWriterParams_bmp
     {
         unsigned int frameSkip;
+        QString imageFormat;
+        unsigned int pngCompressionLevel;
+        unsigned int numberOfCompressors;
+        unsigned long filesPerDirectory;
         VideoWriterParams_bmp();
         std::string toString();
     };
@@ -22,6 +26,8 @@ namespace bias
         bool mjpgFlag; 
         bool mjpgMaxFramePerFileFlag;
         unsigned long mjpgMaxFramePerFile;
+        unsigned int chromaSubsampling;
+        bool fastDct;
         VideoWriterParams_jpg();
         std::string toString();
     };
@@ -38,6 +44,11 @@ namespace bias
     struct VideoWriterParams_fmf
     {
         unsigned int frameSkip;
+        bool asyncWrite;
+        bool directIo;
+        unsigned int expectedDuration;
+        double expectedFrameRate;
+        bool packed12;
         VideoWriterParams_fmf();
         std::string toString();
     };
@@ -51,13 +62,45 @@ namespace bias
         unsigned int numberOfCompressors;
         unsigned int medianUpdateCount;
         unsigned int medianUpdateInterval;
+        unsigned int numberOfMedianWorkers;
+        bool medianIncremental;
         unsigned int dilateWindowSize;
         bool dilateState;
+        bool directIo;
+        unsigned int preallocateMB;
         VideoWriterParams_ufmf();
         std::string toString();
     };
 
 
+    struct VideoWriterParams_ffmpeg
+    {
+        unsigned int frameSkip;
+        QString codec;
+        unsigned int crf;
+        QString preset;
+        unsigned int numberOfThreads;
+        unsigned int maxQueueSize;
+        VideoWriterParams_ffmpeg();
+        std::string toString();
+    };
+
+
+    // Pre-trigger recording - the logger keeps the last preTriggerSec seconds
+    // of frames in memory and on a trigger writes them plus postTriggerSec
+    // seconds after the trigger to a new clip in the current format.
+    struct PreTriggerParams
+    {
+        bool enabled;
+        double preTriggerSec;
+        double postTriggerSec;
+        unsigned int maxMemoryMB;
+        double timerIntervalSec;
+        PreTriggerParams();
+        std::string toString();
+    };
+
+
     struct VideoWriterParams
     {
         VideoWriterParams_bmp bmp;
@@ -65,6 +108,8 @@ namespace bias
         VideoWriterParams_avi avi;
         VideoWriterParams_fmf fmf;
         VideoWriterParams_ufmf ufmf;
+        VideoWriterParams_ffmpeg ffmpeg;
+        PreTriggerParams preTrigger;
         std::string toString();
     };
 
@@ -5,9 +5,11 @@
 #include "background_data_ufmf.hpp"
 #include "background_histogram_ufmf.hpp"
 #include "background_median_ufmf.hpp"
+#include "async_file_writer.hpp"
 #include <QThreadPool>
 #include <QFileInfo>
 #include <QDir>
+#include <QStringList>
 #include <iostream>
 
 namespace bias
@@ -15,7 +17,7 @@ namespace bias
     // Static Constants
     // ----------------------------------------------------------------------------------
     const unsigned int VideoWriter_ufmf::FRAMES_TODO_MAX_QUEUE_SIZE   = 250;
-    const unsigned int VideoWriter_ufmf::FRAMES_FINISHED_MAX_SET_SIZE = 250;
+    const unsigned int VideoWriter_ufmf::FRAMES_FINISHED_RING_SIZE    = 256;
     const unsigned int VideoWriter_ufmf::FRAMES_WAIT_MAX_QUEUE_SIZE   =  50;
 
     const unsigned int VideoWriter_ufmf::DEFAULT_FRAME_SKIP = 1;
@@ -37,10 +39,15 @@ namespace bias
     const unsigned int VideoWriter_ufmf::MIN_DILATE_WINDOW_SIZE = 1;
     const unsigned int VideoWriter_ufmf::MAX_DILATE_WINDOW_SIZE = 20;
 
+    const bool VideoWriter_ufmf::DEFAULT_DIRECT_IO = false;
+    const unsigned int VideoWriter_ufmf::DEFAULT_PREALLOCATE_MB = 0;
+
     const VideoWriterParams_ufmf VideoWriter_ufmf::DEFAULT_PARAMS = 
         VideoWriterParams_ufmf();
 
     const QString VideoWriter_ufmf::DEFAULT_COLOR_CODING("MONO8");
+    const QString VideoWriter_ufmf::MONO16_COLOR_CODING("MONO16");
+    const unsigned int VideoWriter_ufmf::MONO16_THRESHOLD_SCALE = 256;
     const QString VideoWriter_ufmf::DUMMY_FILENAME("dummy.ufmf");
     const QString VideoWriter_ufmf::UFMF_HEADER_STRING("ufmf");
     const unsigned int VideoWriter_ufmf::UFMF_VERSION_NUMBER = 4;
@@ -54,6 +61,7 @@ namespace bias
 
     const char VideoWriter_ufmf::CHAR_FOR_DTYPE_FLOAT  = 'f'; 
     const char VideoWriter_ufmf::CHAR_FOR_DTYPE_UINT8  = 'B';
+    const char VideoWriter_ufmf::CHAR_FOR_DTYPE_UINT16 = 'H';
     const char VideoWriter_ufmf::CHAR_FOR_DTYPE_UINT64 = 'q';
     const char VideoWriter_ufmf::CHAR_FOR_DTYPE_DOUBLE = 'd';
 
@@ -79,6 +87,9 @@ namespace bias
         backgroundThreshold_ = params.backgroundThreshold;
         medianUpdateCount_ = params.medianUpdateCount;
         medianUpdateInterval_ = params.medianUpdateInterval;
+        numberOfMedianWorkers_ = params.numberOfMedianWorkers;
+        medianIncremental_ = params.medianIncremental;
+        bgMedianUpdateTimeMs_ = 0.0;
         boxLength_ = params.boxLength;
         setFrameSkip(params.frameSkip);
         numberOfCompressors_ = params.numberOfCompressors;
@@ -89,32 +100,40 @@ namespace bias
         //std::cout << params.toString() << std::endl;
         // -----------------------------------------------------------------------------
 
-        // Create thread pool for background modelling
+        // Create thread pool for background modelling, median tiles, compressors
+        // and the disk writer
         threadPoolPtr_ = new QThreadPool(this);
         unsigned int maxThreadCount = numberOfCompressors_ + BASE_NUMBER_OF_THREADS;
+        maxThreadCount += numberOfMedianWorkers_ + 1;
         threadPoolPtr_ -> setMaxThreadCount(maxThreadCount);
 
         // Create queue for images sent to background modeler
         bgImageQueuePtr_ = std::make_shared<LockableQueue<StampedImage>>();
         bgNewDataQueuePtr_ = std::make_shared<LockableQueue<BackgroundData_ufmf>>();
         bgOldDataQueuePtr_ = std::make_shared<LockableQueue<BackgroundData_ufmf>>();
-        medianMatQueuePtr_ = std::make_shared<LockableQueue<cv::Mat>>();
+        medianMatQueuePtr_ = std::make_shared<LockableQueue<BackgroundMedianTile_ufmf>>();
 
-        // Create "to do" queue and "finished" set for frame compressors
+        // Create "to do" queue and "finished" reorder ring for frame compressors
         framesToDoQueuePtr_ = std::make_shared<CompressedFrameQueue_ufmf>();
         framesWaitQueuePtr_ = std::make_shared<CompressedFrameQueue_ufmf>();
-        framesFinishedSetPtr_ = std::make_shared<CompressedFrameSet_ufmf>();
-        framesSkippedIndexListPtr_ = std::make_shared<Lockable<std::list<unsigned long>>>();
+        framesFinishedRingPtr_ = std::make_shared<CompressedFrameRing_ufmf>(FRAMES_FINISHED_RING_SIZE);
+
+        // Create asynchronous writer for output file 
+        fileWriterPtr_ = std::make_shared<AsyncFileWriter>();
+        fileWriterPtr_ -> setDirectIo(params.directIo);
+        fileWriterPtr_ -> setPreallocateSize(uint64_t(params.preallocateMB)*1024*1024);
+        fileWriterPtr_ -> setCameraNumber(cameraNumber);
 
         isFixedSize_ = false;
         colorCoding_ = QString(DEFAULT_COLOR_CODING);
+        bytesPerPixel_ = 1;
 
         indexLocation_ = 0;
-        nextFrameToWrite_ = 0;
         numKeyFramesWritten_ = 0;
         bgUpdateCount_ = 0;
         bgModelFrameCount_ = 0;
         bgModelTimeStamp_ = 0.0;
+        bgMedianRowsUpdated_ = 0;
 
     }
 
@@ -123,6 +142,7 @@ namespace bias
     {
         stopBackgroundModeling();
         stopCompressors();
+        fileWriterPtr_ -> finish();
         threadPoolPtr_ -> waitForDone();
         finishWriting();
     } 
@@ -131,6 +151,7 @@ namespace bias
     void VideoWriter_ufmf::addFrame(StampedImage stampedImg) 
     {
         bool skipFrame = false;
+        bool ringFull = false;
         bool haveNewMedianImage = false;
 
         currentImage_ = stampedImg;
@@ -144,8 +165,9 @@ namespace bias
             setupOutputFile(stampedImg);
             writeHeader();
 
-            // Set initial bg median image - just use current image.
-            bgMedianImage_ = stampedImg.image;
+            // Set initial bg median image - just use a copy of the current image as 
+            // incremental median updates are written into it in place.
+            bgMedianImage_ = stampedImg.image.clone();
             bgMembershipImage_.create(stampedImg.image.rows, stampedImg.image.cols,CV_8UC1);
             cv::add(bgMedianImage_,  backgroundThreshold_, bgUpperBoundImage_);
             cv::subtract(bgMedianImage_, backgroundThreshold_, bgLowerBoundImage_); 
@@ -172,19 +194,51 @@ namespace bias
             }
             bgImageQueuePtr_ -> releaseLock();
 
-            // Get median image if available
+            // Get median image (or incrementally published median tiles) if available
+            std::list<BackgroundMedianTile_ufmf> medianTileList;
             medianMatQueuePtr_ -> acquireLock();
-            if (!(medianMatQueuePtr_ -> empty()))
+            while (!(medianMatQueuePtr_ -> empty()))
             {
-                bgMedianImage_ = medianMatQueuePtr_ -> front();
+                medianTileList.push_back(medianMatQueuePtr_ -> front());
                 medianMatQueuePtr_ -> pop();
-                haveNewMedianImage = true;
             }
             medianMatQueuePtr_ -> releaseLock();
 
-            // When new median image available re-calculate thresholds
+            // Incrementally published tiles are copied into the median as they 
+            // arrive, but the model (bounds and key frame) only changes once per 
+            // median update: when the update's last tile lands, or when its 
+            // complete median arrives if some tile didn't. Until then frames are
+            // still compressed against the bounds of the last key frame written.
+            unsigned int numRows = (unsigned int)(bgMedianImage_.rows);
+            for (auto &medianTile : medianTileList)
+            {
+                if (medianTile.isComplete)
+                {
+                    if (bgMedianRowsUpdated_ < numRows)
+                    {
+                        haveNewMedianImage = true;
+                    }
+                    bgMedianImage_ = medianTile.image;
+                    bgMedianUpdateTimeMs_ = medianTile.updateTimeMs;
+                    bgMedianRowsUpdated_ = 0;
+                }
+                else if (bgMedianRowsUpdated_ < numRows)
+                {
+                    if (updateBgMedianRows(medianTile) && (bgMedianRowsUpdated_ >= numRows))
+                    {
+                        haveNewMedianImage = true;
+                    }
+                }
+            }
+
+            // When the median has changed re-calculate thresholds and write a 
+            // key frame.
             if (haveNewMedianImage)
             {
+                // Compressed frames in flight keep references to the old bounds 
+                // so release them and allocate new ones rather than overwrite.
+                bgUpperBoundImage_.release();
+                bgLowerBoundImage_.release();
                 cv::add(bgMedianImage_,  backgroundThreshold_, bgUpperBoundImage_);
                 cv::subtract(bgMedianImage_, backgroundThreshold_, bgLowerBoundImage_); 
 
@@ -213,34 +267,45 @@ namespace bias
                     bgUpdateCount_
                     );
 
-            framesToDoQueuePtr_ -> acquireLock();
-            unsigned int framesToDoQueueSize = framesToDoQueuePtr_ -> size();
-            if (framesToDoQueueSize < FRAMES_TODO_MAX_QUEUE_SIZE)
+            // Reserve the frame's slot in the finished frames reorder ring. This 
+            // only fails when the oldest outstanding frame is still being 
+            // compressed and the ring has wrapped around to it.
+            size_t sequence = 0;
+            if (framesFinishedRingPtr_ -> reserve(sequence))
             {
-                // Insert new (uncalculated) compressed frame into "to do" queue.
-                framesToDoQueuePtr_ -> push(compressedFrame);
-                framesToDoQueuePtr_ -> wakeOne();
+                compressedFrame.setSequenceNumber(sequence);
+
+                framesToDoQueuePtr_ -> acquireLock();
+                unsigned int framesToDoQueueSize = framesToDoQueuePtr_ -> size();
+                if (framesToDoQueueSize < FRAMES_TODO_MAX_QUEUE_SIZE)
+                {
+                    // Insert new (uncalculated) compressed frame into "to do" queue.
+                    framesToDoQueuePtr_ -> push(compressedFrame);
+                    framesToDoQueuePtr_ -> wakeOne();
+                }
+                else
+                {
+                    skipFrame = true;
+                }
+                framesToDoQueuePtr_ -> releaseLock();
+
+                if (skipFrame)
+                {
+                    // Queue is full - skip frame
+                    framesFinishedRingPtr_ -> markSkipped(sequence);
+                    skipReported_ = true;
+                }
             }
             else
             {
                 skipFrame = true;
-            }
-            framesToDoQueuePtr_ -> releaseLock();
-
-            if (skipFrame)
-            {
-                // Queue is full - skip frame
-                framesSkippedIndexListPtr_ -> acquireLock();
-                framesSkippedIndexListPtr_ -> push_back(stampedImg.frameCount);
-                framesSkippedIndexListPtr_ -> releaseLock();
-                skipReported_ = true;
+                ringFull = true;
             }
 
 
         } // if (frameCount_%frameSkip_==0) 
 
-        // Remove frames from compressed frames "finished" set and write to disk 
-        //framesFinishedSetSize = clearFinishedFrames();
+        // Remove frames from compressed frames "finished" ring and write to disk 
         clearFinishedFrames();
         frameCount_++;
 
@@ -256,97 +321,149 @@ namespace bias
         }
 
         // Report skipped frame
+        if (skipFrame)
+        {
+            numSkipped_++;
+        }
         if ((skipFrame)  && (!skipReported_))
         { 
             std::cout << "warning: logging overflow - skipped frame -" << std::endl;
             unsigned int errorId = ERROR_FRAMES_TODO_MAX_QUEUE_SIZE;
             QString errorMsg("logger framesToDoQueue has exceeded the maximum allowed size");
+            if (ringFull)
+            {
+                errorId = ERROR_FRAMES_FINISHED_MAX_SET_SIZE;
+                errorMsg = QString("ufmf frames finished ring has exceeded the maximum allowed size");
+            }
             emit imageLoggingError(errorId, errorMsg);
             skipReported_ = true;
         }
     }
 
 
-    void VideoWriter_ufmf::finish()
+    QString VideoWriter_ufmf::getStatusString() const
     {
-        while (clearFinishedFrames() > 0);
+        QStringList statusList;
+        QString drainStatus = getDrainStatusString();
+        if (!drainStatus.isEmpty())
+        {
+            statusList << drainStatus;
+        }
+        double updateTimeMs = bgMedianUpdateTimeMs_;
+        if (updateTimeMs > 0.0)
+        {
+            statusList << QString("bg median update %1 ms").arg(updateTimeMs, 0, 'f', 0);
+        }
+        if (fileWriterPtr_ -> isOpen())
+        {
+            AsyncFileWriterStats stats = fileWriterPtr_ -> getStats();
+            QString diskStatus = QString("disk stall %1 ms (max %2 ms), backlog %3/%4")
+                .arg(stats.stallTimeMs, 0, 'f', 0)
+                .arg(stats.maxStallMs, 0, 'f', 0)
+                .arg(stats.backlog)
+                .arg(stats.maxBacklog);
+            statusList << diskStatus;
+        }
+        return statusList.join(", ");
     }
 
 
-    unsigned int VideoWriter_ufmf::clearFinishedFrames()
+    bool VideoWriter_ufmf::updateBgMedianRows(const BackgroundMedianTile_ufmf &tile)
     {
-        framesFinishedSetPtr_ -> acquireLock();
-        bool framesFinishedSetEmpty = framesFinishedSetPtr_ -> empty();
-        framesFinishedSetPtr_ -> releaseLock();
+        // Copy a tile of a partially updated median into the median image. The
+        // median is only referenced by the writer, key frames are copied when 
+        // written, so it is updated in place. The caller recalculates the bounds
+        // and writes the key frame once all of the update's rows have landed. 
+        // Returns false if the tile doesn't fit.
+        unsigned int rowBegin = tile.rowBegin;
+        unsigned int rowEnd = rowBegin + tile.image.rows;
+        if ((tile.image.empty()) || (rowEnd > (unsigned int)(bgMedianImage_.rows)))
+        {
+            return false;
+        }
+        if (tile.image.cols != bgMedianImage_.cols)
+        {
+            return false;
+        }
+
+        cv::Mat medianRows = bgMedianImage_.rowRange(rowBegin, rowEnd);
+        tile.image.copyTo(medianRows);
+        bgMedianRowsUpdated_ += tile.image.rows;
+        return true;
+    }
 
-        if (!framesFinishedSetEmpty)
+
+    bool VideoWriter_ufmf::canAcceptFrame()
+    {
+        // Room for the frame in the finished frames ring and the "to do" queue
+        clearFinishedFrames();
+        if (framesFinishedRingPtr_ -> numOutstanding() >= framesFinishedRingPtr_ -> capacity())
         {
-            bool writeDone = false;
-            while ( (!writeDone) && (!framesFinishedSetEmpty) ) 
-            {
-                // Handle skipped frames. 
-                // --------------------------------------------------------------------------------
-                framesSkippedIndexListPtr_ -> acquireLock();
-                if (framesSkippedIndexListPtr_ -> size() > 0)
+            return false;
+        }
+        framesToDoQueuePtr_ -> acquireLock();
+        bool haveRoom = (framesToDoQueuePtr_ -> size() < FRAMES_TODO_MAX_QUEUE_SIZE);
+        framesToDoQueuePtr_ -> releaseLock();
+        return haveRoom;
+    }
 
-                {
-                    std::list<unsigned long>::iterator skippedIndexIt = framesSkippedIndexListPtr_ -> begin();
-                    bool done = false;
 
-                    while (!done)
-                    {
-                        if (*skippedIndexIt == nextFrameToWrite_)
-                        {
-                            nextFrameToWrite_ += frameSkip_;
-                        }
-                        else if (*skippedIndexIt < nextFrameToWrite_)
-                        {
-                            if (framesSkippedIndexListPtr_ -> size() > 1)
-                            {
-                                skippedIndexIt++;
-                            }
-                            else
-                            {
-                                done = true;
-                            }
-                            framesSkippedIndexListPtr_ -> pop_front();
-                        }
-                        else
-                        {
-                            done = true;
-                        }
-                    }
-                }
-                framesSkippedIndexListPtr_ -> releaseLock();
+    bool VideoWriter_ufmf::waitToAcceptFrame(unsigned long timeoutMs)
+    {
+        // Every queued frame holds a slot in the ring - room is made as the 
+        // next frame in sequence is delivered.
+        if (canAcceptFrame())
+        {
+            return true;
+        }
+        framesFinishedRingPtr_ -> waitForNext(timeoutMs);
+        return canAcceptFrame();
+    }
 
-                // Write next frame to file
-                // --------------------------------------------------------------------------------
-                framesFinishedSetPtr_ -> acquireLock();
-                CompressedFrameSet_ufmf::iterator frameIt = framesFinishedSetPtr_ -> begin();
-                CompressedFrame_ufmf compressedFrame = *frameIt;
 
-                if (compressedFrame.getFrameCount() == nextFrameToWrite_)
-                {
-                    framesWaitQueuePtr_ -> push(compressedFrame);
-                    framesFinishedSetPtr_ -> erase(frameIt);
-                    nextFrameToWrite_ += frameSkip_;
-                    writeCompressedFrame(compressedFrame);
-                }
-                else
-                {
-                    writeDone = true;
-                }
-                framesFinishedSetEmpty = framesFinishedSetPtr_ -> empty();
-                framesFinishedSetPtr_ -> releaseLock();
+    void VideoWriter_ufmf::finish()
+    {
+        // Write out compressed frames as the compressors deliver them, sleeping
+        // on the ring in between, until every frame handed out is accounted for.
+        startDrain(framesFinishedRingPtr_ -> numOutstanding());
+        QElapsedTimer stallTimer;
+        stallTimer.start();
+        while (framesFinishedRingPtr_ -> numOutstanding() > 0)
+        {
+            if (framesFinishedRingPtr_ -> waitForNext(DRAIN_WAIT_TIMEOUT_MS))
+            {
+                clearFinishedFrames();
+                updateDrain(framesFinishedRingPtr_ -> numOutstanding());
+                stallTimer.restart();
+            }
+            else if (stallTimer.elapsed() > qint64(DRAIN_STALL_TIMEOUT_MS))
+            {
+                endDrain();
+                unsigned int errorId = ERROR_VIDEO_WRITER_FINISH;
+                std::string errorMsg("ufmf writer timed out waiting for compressors to finish");
+                throw RuntimeError(errorId, errorMsg);
+            }
+        }
+        endDrain();
+    }
 
-            } // while ( (!writeDone) && (!framesFinishedSetEmpty) ) 
 
-        } // if (!(framesFinishedSetPtr_ 
+    unsigned int VideoWriter_ufmf::clearFinishedFrames()
+    {
+        // Write compressed frames to disk in order. Frames which were skipped 
+        // are marked in their slot so they are passed over rather than waited on.
+        CompressedFrame_ufmf compressedFrame;
+        bool skipped = false;
 
-        framesFinishedSetPtr_ -> acquireLock();
-        unsigned int framesFinishedSetSize = framesFinishedSetPtr_ -> size();
-        framesFinishedSetPtr_ -> releaseLock();
-        return framesFinishedSetSize;
+        while (framesFinishedRingPtr_ -> tryPopNext(compressedFrame, skipped))
+        {
+            if (!skipped)
+            {
+                writeCompressedFrame(compressedFrame);
+                framesWaitQueuePtr_ -> push(compressedFrame);
+            }
+        }
+        return (unsigned int)(framesFinishedRingPtr_ -> numReady());
     }
 
 
@@ -360,47 +477,34 @@ namespace bias
             throw RuntimeError(errorId,errorMsg);
         }
 
-        if (stampedImg.image.depth() != CV_8U)
+        if ((stampedImg.image.depth() != CV_8U) && (stampedImg.image.depth() != CV_16U))
         {
             unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
             std::string errorMsg("video writer ufmf setup failed:\n\n"); 
-            errorMsg += "image depth must be CV_8U";
+            errorMsg += "image depth must be CV_8U or CV_16U";
             throw RuntimeError(errorId,errorMsg);
         }
+
+        // 16-bit images are written as MONO16 with 16-bit boxes and key frames.
+        // The background threshold is given in 8-bit units so it keeps its 
+        // meaning when the camera is switched to a high bit depth format.
+        if (stampedImg.image.depth() == CV_16U)
+        {
+            colorCoding_ = MONO16_COLOR_CODING;
+            bytesPerPixel_ = 2;
+            backgroundThreshold_ *= MONO16_THRESHOLD_SCALE;
+        }
     }
 
 
     void VideoWriter_ufmf::setupOutputFile(StampedImage stampedImg) 
     {
-
-        // Set error control state, set exceptions mask
-        file_.clear();
-        file_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-        // Get unique name for file and open for reading
+        // Get unique name for file and open for writing. The writer thread 
+        // takes care of the disk I/O from here on.
         QString incrFileName = getUniqueFileName();
-
-        try
-        {
-            file_.open(incrFileName.toStdString(), std::ios::binary | std::ios::out);
-        }
-        catch (std::ifstream::failure &exc)
-        {
-            unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
-            std::string errorMsg("video writer unable to open file:\n\n"); 
-            errorMsg += exc.what();
-            throw RuntimeError(errorId, errorMsg); 
-        }
-
-        if (!file_.is_open())
-        {
-            unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
-            std::string errorMsg("video writer unable to open file:\n\n"); 
-            errorMsg += "no exception thrown";
-            throw RuntimeError(errorId, errorMsg); 
-        }
+        fileWriterPtr_ -> open(incrFileName.toStdString());
+        fileWriterPtr_ -> start(threadPoolPtr_);
         setSize(stampedImg.image.size());
-
     }
 
 
@@ -411,40 +515,40 @@ namespace bias
             
             QByteArray headerStrArray = UFMF_HEADER_STRING.toLatin1();
             unsigned int headerStrLen = UFMF_HEADER_STRING.size();
-            file_.write((char*) headerStrArray.data(), headerStrLen*sizeof(char));
+            fileWriterPtr_ -> write(headerStrArray.data(), headerStrLen*sizeof(char));
 
             uint32_t ufmf_version = uint32_t(UFMF_VERSION_NUMBER);
-            file_.write((char*) &ufmf_version, sizeof(uint32_t));
+            fileWriterPtr_ -> write(&ufmf_version, sizeof(uint32_t));
 
-            indexLocationPtr_ = file_.tellp();
-            uint64_t indexLocation_uint64 = uint64_t(indexLocation_);
-            file_.write((char*) &indexLocation_uint64, sizeof(uint64_t));
+            indexLocationPtr_ = fileWriterPtr_ -> tellp();
+            uint64_t indexLocation_uint64 = indexLocation_;
+            fileWriterPtr_ -> write(&indexLocation_uint64, sizeof(uint64_t));
 
             if (isFixedSize_)
             {
                 uint16_t boxLength_uint16 = uint16_t(boxLength_);
-                file_.write((char*) &boxLength_uint16, sizeof(uint16_t)); 
-                file_.write((char*) &boxLength_uint16, sizeof(uint16_t));
+                fileWriterPtr_ -> write(&boxLength_uint16, sizeof(uint16_t)); 
+                fileWriterPtr_ -> write(&boxLength_uint16, sizeof(uint16_t));
             }
             else
             {
                 uint16_t width = uint16_t(size_.width);
-                file_.write((char*) &width, sizeof(uint16_t));
+                fileWriterPtr_ -> write(&width, sizeof(uint16_t));
 
                 uint16_t height = uint16_t(size_.height);
-                file_.write((char*) &height, sizeof(uint16_t));
+                fileWriterPtr_ -> write(&height, sizeof(uint16_t));
             }
 
             uint8_t isFixedSize_uint8 = uint8_t(isFixedSize_);
-            file_.write((char*) &isFixedSize_uint8, sizeof(uint8_t));
+            fileWriterPtr_ -> write(&isFixedSize_uint8, sizeof(uint8_t));
 
             uint8_t colorCodingLength = uint8_t(colorCoding_.size());
-            file_.write((char*) &colorCodingLength, sizeof(uint8_t));
+            fileWriterPtr_ -> write(&colorCodingLength, sizeof(uint8_t));
 
             QByteArray colorCodingArray = colorCoding_.toLatin1();
-            file_.write((char*) colorCodingArray.data(), colorCodingLength*sizeof(char));
+            fileWriterPtr_ -> write(colorCodingArray.data(), colorCodingLength*sizeof(char));
         }
-        catch (std::ifstream::failure &exc)
+        catch (RuntimeError &exc)
         {
             unsigned int errorId = ERROR_VIDEO_WRITER_INITIALIZE;
             std::string errorMsg("video writer unable to write ufmf header:\n\n"); 
@@ -455,21 +559,49 @@ namespace bias
 
     void VideoWriter_ufmf::finishWriting()
     {
-        // Move to end of filed
-        file_.seekp(0, std::ios_base::end);
+        // Nothing to do if no frames were ever added
+        if (!fileWriterPtr_ -> isOpen())
+        {
+            return;
+        }
+
+        try
+        {
+            writeIndex();
+        }
+        catch (RuntimeError &exc)
+        {
+            std::cout << "error: " << exc.what() << std::endl;
+        }
+
+        // Flush remaining data, write the index location into the header 
+        // and close the file
+        fileWriterPtr_ -> finish();
+        uint64_t indexLocation_uint64 = indexLocation_;
+        fileWriterPtr_ -> writeAt(indexLocationPtr_, &indexLocation_uint64, sizeof(uint64_t));
+        fileWriterPtr_ -> close();
+        if (fileWriterPtr_ -> haveError())
+        {
+            std::cout << "error: video writer unable to write file: "; 
+            std::cout << fileWriterPtr_ -> getErrorMsg() << std::endl;
+        }
+    }
 
+
+    void VideoWriter_ufmf::writeIndex()
+    {
         // Write index
         // --------------------------------------------------------------------
 
         // Write index chunk identifier and save index location
         uint8_t chunkId = uint8_t(INDEX_DICT_CHUNK_ID);
-        file_.write((char*) &chunkId, sizeof(uint8_t));
-        indexLocation_ = file_.tellp();
+        fileWriterPtr_ -> write(&chunkId, sizeof(uint8_t));
+        indexLocation_ = fileWriterPtr_ -> tellp();
 
         // Write char for dict and number of keys
-        file_.write((char*) &CHAR_FOR_DICT, sizeof(char));
+        fileWriterPtr_ -> write(&CHAR_FOR_DICT, sizeof(char));
         uint8_t numKeys = 2;
-        file_.write((char*) &numKeys, sizeof(uint8_t));
+        fileWriterPtr_ -> write(&numKeys, sizeof(uint8_t));
 
         // Write index -> frame
         // --------------------------------------------------------------------
@@ -477,13 +609,13 @@ namespace bias
         // Write length of key and key for frame
         const char frameString[] = "frame"; 
         uint16_t frameStringLength = uint16_t(sizeof(frameString)-1);
-        file_.write((char*) &frameStringLength, sizeof(uint16_t));
-        file_.write((char*) frameString, frameStringLength*sizeof(char));
+        fileWriterPtr_ -> write(&frameStringLength, sizeof(uint16_t));
+        fileWriterPtr_ -> write(frameString, frameStringLength*sizeof(char));
 
         // Write char for dict and number of keys
-        file_.write((char*) &CHAR_FOR_DICT, sizeof(char));
+        fileWriterPtr_ -> write(&CHAR_FOR_DICT, sizeof(char));
         numKeys = 2;
-        file_.write((char*) &numKeys, sizeof(uint8_t));
+        fileWriterPtr_ -> write(&numKeys, sizeof(uint8_t));
 
         // Write index -> frame -> location
         // --------------------------------------------------------------------
@@ -491,24 +623,24 @@ namespace bias
         // Write length of key and key for location
         const char locString[] = "loc";
         uint16_t locStringLength = uint16_t(sizeof(locString) - 1);
-        file_.write((char*) &locStringLength, sizeof(uint16_t));
-        file_.write((char*) locString, locStringLength*sizeof(char));
+        fileWriterPtr_ -> write(&locStringLength, sizeof(uint16_t));
+        fileWriterPtr_ -> write(locString, locStringLength*sizeof(char));
 
         // Write char for array and data type
-        file_.write((char*) &CHAR_FOR_ARRAY, sizeof(char));
-        file_.write((char*) &CHAR_FOR_DTYPE_UINT64, sizeof(char));
+        fileWriterPtr_ -> write(&CHAR_FOR_ARRAY, sizeof(char));
+        fileWriterPtr_ -> write(&CHAR_FOR_DTYPE_UINT64, sizeof(char));
 
         // Write number of bytes and frame positions
         uint32_t numBytes = uint32_t(framePosList_.size()*sizeof(uint64_t)); 
-        file_.write((char*) &numBytes, sizeof(uint32_t));
+        fileWriterPtr_ -> write(&numBytes, sizeof(uint32_t));
         for ( 
-                std::list<std::streampos>::iterator it=framePosList_.begin(); 
+                std::list<uint64_t>::iterator it=framePosList_.begin(); 
                 it!=framePosList_.end(); 
                 it++
             )
         {
             uint64_t pos = *it;
-            file_.write((char*) &pos, sizeof(uint64_t));
+            fileWriterPtr_ -> write(&pos, sizeof(uint64_t));
         }
         // End write index -> frame -> location
         // --------------------------------------------------------------------
@@ -519,16 +651,16 @@ namespace bias
         // Write key length and key for timestamp
         const char timeStampString[] = "timestamp";
         uint16_t timeStampStringLength = uint16_t(sizeof(timeStampString)-1);
-        file_.write((char*) &timeStampStringLength, sizeof(uint16_t));
-        file_.write((char*) timeStampString, timeStampStringLength*sizeof(char));
+        fileWriterPtr_ -> write(&timeStampStringLength, sizeof(uint16_t));
+        fileWriterPtr_ -> write(timeStampString, timeStampStringLength*sizeof(char));
 
         // Write char for array and data type
-        file_.write((char*) &CHAR_FOR_ARRAY, sizeof(char));
-        file_.write((char*) &CHAR_FOR_DTYPE_DOUBLE, sizeof(char));
+        fileWriterPtr_ -> write(&CHAR_FOR_ARRAY, sizeof(char));
+        fileWriterPtr_ -> write(&CHAR_FOR_DTYPE_DOUBLE, sizeof(char));
 
         // Write number of bytes and time stamps
         numBytes = uint32_t(frameTimeStampList_.size()*sizeof(double));
-        file_.write((char*) &numBytes, sizeof(uint32_t));
+        fileWriterPtr_ -> write(&numBytes, sizeof(uint32_t));
         for (
                 std::list<double>::iterator it=frameTimeStampList_.begin(); 
                 it!=frameTimeStampList_.end(); 
@@ -536,7 +668,7 @@ namespace bias
             )
         { 
             double ts = *it;
-            file_.write((char*) &ts, sizeof(double));
+            fileWriterPtr_ -> write(&ts, sizeof(double));
         }
         // End write index -> frame -> timestamp
         // --------------------------------------------------------------------
@@ -550,13 +682,13 @@ namespace bias
         // Write key length and key for keyframe
         const char keyFrameString[] = "keyframe";
         uint16_t keyFrameStringLength = uint16_t(sizeof(keyFrameString)-1);
-        file_.write((char*) &keyFrameStringLength, sizeof(uint16_t)); 
-        file_.write((char*) keyFrameString, keyFrameStringLength*sizeof(char));
+        fileWriterPtr_ -> write(&keyFrameStringLength, sizeof(uint16_t)); 
+        fileWriterPtr_ -> write(keyFrameString, keyFrameStringLength*sizeof(char));
 
         // Write char for dict and number of keys
-        file_.write((char*) &CHAR_FOR_DICT, sizeof(char)); 
+        fileWriterPtr_ -> write(&CHAR_FOR_DICT, sizeof(char)); 
         numKeys = 1;
-        file_.write((char*) &numKeys, sizeof(uint8_t));
+        fileWriterPtr_ -> write(&numKeys, sizeof(uint8_t));
 
         // Write index -> keyframe -> mean
         // --------------------------------------------------------------------
@@ -564,36 +696,36 @@ namespace bias
         // Write length of key and key for mean
         const char meanString[] = "mean";
         uint16_t meanStringLength = uint16_t(sizeof(meanString)-1);
-        file_.write((char*) &meanStringLength, sizeof(uint16_t));
-        file_.write((char*) meanString, meanStringLength*sizeof(char));
+        fileWriterPtr_ -> write(&meanStringLength, sizeof(uint16_t));
+        fileWriterPtr_ -> write(meanString, meanStringLength*sizeof(char));
 
         // Write char for dict and number of keys
-        file_.write((char*) &CHAR_FOR_DICT, sizeof(char));
+        fileWriterPtr_ -> write(&CHAR_FOR_DICT, sizeof(char));
         numKeys = 2;
-        file_.write((char*) &numKeys, sizeof(uint8_t));
+        fileWriterPtr_ -> write(&numKeys, sizeof(uint8_t));
 
         // Write index -> keyframe -> mean -> loc
         // --------------------------------------------------------------------
 
         // Write key length and key for location
-        file_.write((char*) &locStringLength, sizeof(uint16_t));
-        file_.write((char*) locString, locStringLength*sizeof(char));
+        fileWriterPtr_ -> write(&locStringLength, sizeof(uint16_t));
+        fileWriterPtr_ -> write(locString, locStringLength*sizeof(char));
 
         // Write char for array and data type
-        file_.write((char*) &CHAR_FOR_ARRAY, sizeof(char));
-        file_.write((char*) &CHAR_FOR_DTYPE_UINT64, sizeof(char));
+        fileWriterPtr_ -> write(&CHAR_FOR_ARRAY, sizeof(char));
+        fileWriterPtr_ -> write(&CHAR_FOR_DTYPE_UINT64, sizeof(char));
 
         // Write number of bytes and keyframe positions
         numBytes = uint32_t(bgKeyFramePosList_.size()*sizeof(uint64_t));
-        file_.write((char*) &numBytes, sizeof(uint32_t));
+        fileWriterPtr_ -> write(&numBytes, sizeof(uint32_t));
         for (
-                std::list<std::streampos>::iterator it = bgKeyFramePosList_.begin();
+                std::list<uint64_t>::iterator it = bgKeyFramePosList_.begin();
                 it != bgKeyFramePosList_.end();
                 it++
             )
         {
             uint64_t pos = *it;
-            file_.write((char*) &pos, sizeof(uint64_t));
+            fileWriterPtr_ -> write(&pos, sizeof(uint64_t));
         }
         // End write index -> keyframe -> mean -> loc
         // --------------------------------------------------------------------
@@ -602,16 +734,16 @@ namespace bias
         // --------------------------------------------------------------------
 
         // write key length and key for time stamp
-        file_.write((char*) &timeStampStringLength, sizeof(uint16_t));
-        file_.write((char*) timeStampString, timeStampStringLength*sizeof(char));
+        fileWriterPtr_ -> write(&timeStampStringLength, sizeof(uint16_t));
+        fileWriterPtr_ -> write(timeStampString, timeStampStringLength*sizeof(char));
 
         // Write char for array and data type
-        file_.write((char*) &CHAR_FOR_ARRAY, sizeof(char));
-        file_.write((char*) &CHAR_FOR_DTYPE_DOUBLE, sizeof(char));
+        fileWriterPtr_ -> write(&CHAR_FOR_ARRAY, sizeof(char));
+        fileWriterPtr_ -> write(&CHAR_FOR_DTYPE_DOUBLE, sizeof(char));
 
         // Write number of bytes and keyframe time stamps
         numBytes = uint32_t(bgKeyFrameTimeStampList_.size()*sizeof(double));
-        file_.write((char*) &numBytes, sizeof(uint32_t));
+        fileWriterPtr_ -> write(&numBytes, sizeof(uint32_t));
         for (
                 std::list<double>::iterator it = bgKeyFrameTimeStampList_.begin(); 
                 it != bgKeyFrameTimeStampList_.end();
@@ -619,7 +751,7 @@ namespace bias
             )
         {
             double ts = *it;
-            file_.write((char*) &ts, sizeof(double));
+            fileWriterPtr_ -> write(&ts, sizeof(double));
         }
         // End write index -> keyframe -> mean -> timestamp
         // --------------------------------------------------------------------
@@ -632,14 +764,6 @@ namespace bias
 
         // End index
         // --------------------------------------------------------------------
-
-        // Write the index location
-        file_.seekp(indexLocationPtr_, std::ios_base::beg);
-        uint64_t indexLocation_uint64 = uint64_t(indexLocation_);
-        file_.write((char*) &indexLocation_uint64, sizeof(uint64_t));
-
-        // Close the file
-        file_.close();
     }
 
 
@@ -649,21 +773,21 @@ namespace bias
 
         // Get position and time stamp for index
         double timeStamp = frame.getTimeStamp();
-        std::streampos filePosBegin = file_.tellp();
+        uint64_t filePosBegin = fileWriterPtr_ -> tellp();
 
         framePosList_.push_back(filePosBegin);
         frameTimeStampList_.push_back(timeStamp);
 
         // Write keyframe chunk identifier
         uint8_t chunkId = uint8_t(FRAME_CHUNK_ID);
-        file_.write((char*) &chunkId, sizeof(uint8_t));
+        fileWriterPtr_ -> write(&chunkId, sizeof(uint8_t));
 
         // Write time stamp
-        file_.write((char*) &timeStamp, sizeof(double));
+        fileWriterPtr_ -> write(&timeStamp, sizeof(double));
 
         // Write number of connected components
         uint32_t numConnectedComp = uint32_t(frame.getNumConnectedComp());
-        file_.write((char*) &numConnectedComp, sizeof(uint32_t));
+        fileWriterPtr_ -> write(&numConnectedComp, sizeof(uint32_t));
 
         // Write each box
         std::shared_ptr<std::vector<uint16_t>> writeColBufPtr;
@@ -688,54 +812,57 @@ namespace bias
             uint16_t hgt = (*writeHgtBufPtr)[cc];
             unsigned int boxArea = (*writeHgtBufPtr)[cc]*(*writeWdtBufPtr)[cc];
 
-            file_.write((char*) &col, sizeof(uint16_t));
-            file_.write((char*) &row, sizeof(uint16_t));
-            file_.write((char*) &wdt, sizeof(uint16_t));
-            file_.write((char*) &hgt, sizeof(uint16_t));
-            file_.write((char*) &(*imageDataPtr)[dataPos], boxArea*sizeof(uint8_t));
-            dataPos += boxArea;
+            // Box position and size go out as a single write
+            uint16_t boxHeader[4] = {col, row, wdt, hgt};
+            fileWriterPtr_ -> write(boxHeader, sizeof(boxHeader));
+            fileWriterPtr_ -> write(&(*imageDataPtr)[dataPos], boxArea*bytesPerPixel_);
+            dataPos += boxArea*bytesPerPixel_;
         }
-
-        // Calculate frame size
-        std::streampos filePosEnd = file_.tellp();
-        unsigned long frameSize = (unsigned long)(filePosEnd) - (unsigned long)(filePosBegin);
+        recordPipelineStage(PIPELINE_STAGE_WRITTEN, frame.getPipelineStamps());
     }
 
 
     void VideoWriter_ufmf::writeKeyFrame()
     {
         // Get position and time stamp for index
-        bgKeyFramePosList_.push_back(file_.tellp());
+        bgKeyFramePosList_.push_back(fileWriterPtr_ -> tellp());
         bgKeyFrameTimeStampList_.push_back(bgModelTimeStamp_);
 
         // Write keyframe chunk identifier
         uint8_t chunkId = uint8_t(KEYFRAME_CHUNK_ID);
-        file_.write((char*) &chunkId, sizeof(uint8_t));
+        fileWriterPtr_ -> write(&chunkId, sizeof(uint8_t));
 
         // Write keyframe type
         const char keyFrameType[] = "mean";
         uint8_t keyFrameTypeLength = sizeof(keyFrameType)-1;
-        file_.write((char*) &keyFrameTypeLength, sizeof(uint8_t));
-        file_.write((char*) keyFrameType, keyFrameTypeLength*sizeof(char));
+        fileWriterPtr_ -> write(&keyFrameTypeLength, sizeof(uint8_t));
+        fileWriterPtr_ -> write(keyFrameType, keyFrameTypeLength*sizeof(char));
 
         // Discrepancy ... what about number of points/boxes
 
         // Write char specifying data type
-        file_.write((char*) &CHAR_FOR_DTYPE_UINT8, sizeof(char));
+        if (bytesPerPixel_ == 2)
+        {
+            fileWriterPtr_ -> write(&CHAR_FOR_DTYPE_UINT16, sizeof(char));
+        }
+        else
+        {
+            fileWriterPtr_ -> write(&CHAR_FOR_DTYPE_UINT8, sizeof(char));
+        }
 
         // Write width and height
         uint16_t width = uint16_t(bgMedianImage_.cols);
-        file_.write((char*) &width, sizeof(uint16_t));
+        fileWriterPtr_ -> write(&width, sizeof(uint16_t));
 
         uint16_t height = uint16_t(bgMedianImage_.rows);
-        file_.write((char*) &height, sizeof(uint16_t));
+        fileWriterPtr_ -> write(&height, sizeof(uint16_t));
 
         // Write timestamp
-        file_.write((char*) &bgModelTimeStamp_, sizeof(double));
+        fileWriterPtr_ -> write(&bgModelTimeStamp_, sizeof(double));
 
         // Write the frame data
         unsigned int numPixel = bgMedianImage_.rows*bgMedianImage_.cols;
-        file_.write((char*) bgMedianImage_.data, numPixel*sizeof(char));
+        fileWriterPtr_ -> write(bgMedianImage_.data, numPixel*bytesPerPixel_);
 
     }
 
@@ -763,6 +890,8 @@ namespace bias
                 medianMatQueuePtr_,
                 cameraNumber_ 
                 );
+        bgMedianPtr_ -> setThreadPool(threadPoolPtr_, numberOfMedianWorkers_);
+        bgMedianPtr_ -> setIncremental(medianIncremental_);
 
         threadPoolPtr_ -> start(bgHistogramPtr_);
         threadPoolPtr_ -> start(bgMedianPtr_);
@@ -799,7 +928,7 @@ namespace bias
     void VideoWriter_ufmf::startCompressors()
     {
         framesToDoQueuePtr_ -> clear();
-        framesFinishedSetPtr_ -> clear();
+        framesFinishedRingPtr_ -> clear();
 
         // Create compressor threads and start on thread pool
         compressorPtrVec_.resize(numberOfCompressors_);
@@ -807,10 +936,10 @@ namespace bias
         {
             compressorPtrVec_[i] = new Compressor_ufmf(
                     framesToDoQueuePtr_,
-                    framesFinishedSetPtr_,
-                    framesSkippedIndexListPtr_,
+                    framesFinishedRingPtr_,
                     cameraNumber_
                     );
+            compressorPtrVec_[i] -> setPipelineStats(pipelineStatsPtr_);
             threadPoolPtr_ -> start(compressorPtrVec_[i]);
             connect(
                     compressorPtrVec_[i],
@@ -10,7 +10,8 @@
 #include <list>
 #include <QPointer>
 #include <opencv2/core/core.hpp>
-#include <fstream>
+#include <atomic>
+#include <cstdint>
 
 class QThreadPool;
 
@@ -19,6 +20,8 @@ namespace bias
     class BackgroundData_ufmf;
     class BackgroundHistogram_ufmf;
     class BackgroundMedian_ufmf;
+    struct BackgroundMedianTile_ufmf;
+    class AsyncFileWriter;
     template <class T> class Lockable;
     template <class T> class LockableQueue;
 
@@ -39,11 +42,14 @@ namespace bias
 
             virtual ~VideoWriter_ufmf();
             virtual void addFrame(StampedImage stampedImg);
+            virtual bool canAcceptFrame();
+            virtual bool waitToAcceptFrame(unsigned long timeoutMs);
+            virtual QString getStatusString() const;
             virtual void finish();
 
             // Static members
             static const unsigned int FRAMES_TODO_MAX_QUEUE_SIZE;
-            static const unsigned int FRAMES_FINISHED_MAX_SET_SIZE;
+            static const unsigned int FRAMES_FINISHED_RING_SIZE;
             static const unsigned int FRAMES_WAIT_MAX_QUEUE_SIZE;
 
             static const unsigned int DEFAULT_FRAME_SKIP;
@@ -65,10 +71,15 @@ namespace bias
             static const unsigned int MIN_DILATE_WINDOW_SIZE;
             static const unsigned int MAX_DILATE_WINDOW_SIZE;
 
+            static const bool DEFAULT_DIRECT_IO;
+            static const unsigned int DEFAULT_PREALLOCATE_MB;
+
             static const VideoWriterParams_ufmf DEFAULT_PARAMS;
             static const unsigned int UFMF_VERSION_NUMBER;
 
             static const QString DEFAULT_COLOR_CODING;
+            static const QString MONO16_COLOR_CODING;
+            static const unsigned int MONO16_THRESHOLD_SCALE;
             static const QString DUMMY_FILENAME;
             static const QString UFMF_HEADER_STRING;
 
@@ -81,6 +92,7 @@ namespace bias
 
             static const char CHAR_FOR_DTYPE_FLOAT; 
             static const char CHAR_FOR_DTYPE_UINT8;
+            static const char CHAR_FOR_DTYPE_UINT16;
             static const char CHAR_FOR_DTYPE_UINT64;
             static const char CHAR_FOR_DTYPE_DOUBLE;
 
@@ -91,27 +103,31 @@ namespace bias
             unsigned int backgroundThreshold_;
             unsigned int medianUpdateCount_;
             unsigned int medianUpdateInterval_;
+            unsigned int numberOfMedianWorkers_;
+            bool medianIncremental_;
+            std::atomic<double> bgMedianUpdateTimeMs_;
             unsigned int boxLength_;
             unsigned int numberOfCompressors_;
             bool isFixedSize_;
             QString colorCoding_;
+            unsigned int bytesPerPixel_;
 
             bool dilateState_;
             unsigned int dilateWindowSize_;
 
-            std::fstream file_;
-            std::streampos indexLocation_;
-            std::streampos indexLocationPtr_;
+            std::shared_ptr<AsyncFileWriter> fileWriterPtr_;
+            uint64_t indexLocation_;
+            uint64_t indexLocationPtr_;
 
-            unsigned long nextFrameToWrite_;
             unsigned long numKeyFramesWritten_;
 
             double bgModelTimeStamp_;
             unsigned long bgUpdateCount_;
             unsigned long bgModelFrameCount_;
+            unsigned int bgMedianRowsUpdated_;  // by tiles of the current median update
 
-            std::list<std::streampos> framePosList_;
-            std::list<std::streampos> bgKeyFramePosList_; 
+            std::list<uint64_t> framePosList_;
+            std::list<uint64_t> bgKeyFramePosList_; 
 
             std::list<double> frameTimeStampList_;
             std::list<double> bgKeyFrameTimeStampList_;
@@ -132,12 +148,11 @@ namespace bias
             std::shared_ptr<LockableQueue<StampedImage>> bgImageQueuePtr_;
             std::shared_ptr<LockableQueue<BackgroundData_ufmf>> bgNewDataQueuePtr_;
             std::shared_ptr<LockableQueue<BackgroundData_ufmf>> bgOldDataQueuePtr_;
-            std::shared_ptr<LockableQueue<cv::Mat>> medianMatQueuePtr_;
+            std::shared_ptr<LockableQueue<BackgroundMedianTile_ufmf>> medianMatQueuePtr_;
 
             CompressedFrameQueuePtr_ufmf framesToDoQueuePtr_;
             CompressedFrameQueuePtr_ufmf framesWaitQueuePtr_;
-            CompressedFrameSetPtr_ufmf framesFinishedSetPtr_;
-            std::shared_ptr<Lockable<std::list<unsigned long>>> framesSkippedIndexListPtr_;
+            CompressedFrameRingPtr_ufmf framesFinishedRingPtr_;
 
             unsigned int clearFinishedFrames();
             void checkImageFormat(StampedImage stampedImg);
@@ -145,7 +160,9 @@ namespace bias
             void writeHeader();
             void writeKeyFrame();
             void writeCompressedFrame(CompressedFrame_ufmf frame);
+            bool updateBgMedianRows(const BackgroundMedianTile_ufmf &tile);
             void finishWriting();
+            void writeIndex();
 
             void startBackgroundModeling();
             void stopBackgroundModeling();
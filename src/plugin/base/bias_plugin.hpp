@@ -60,6 +60,9 @@ namespace bias
 
             void setCaptureDurationRequest(unsigned long);
 
+            // Asks the camera window to save a pre-trigger recording clip
+            void recordTriggerRequest();
+
         protected:
 
             bool active_;
@@ -0,0 +1,28 @@
+#include "multi_camera_plugin.hpp"
+
+namespace bias
+{
+
+    const QString MultiCameraPlugin::PLUGIN_NAME = QString("baseMultiCameraPlugin");
+
+    MultiCameraPlugin::MultiCameraPlugin()
+    { }
+
+    MultiCameraPlugin::~MultiCameraPlugin()
+    { }
+
+    void MultiCameraPlugin::reset()
+    { }
+
+    void MultiCameraPlugin::stop()
+    { }
+
+    void MultiCameraPlugin::processMatchedSet(const MatchedFrameSet &matchedSet)
+    { }
+
+    QString MultiCameraPlugin::getName()
+    {
+        return PLUGIN_NAME;
+    }
+
+}
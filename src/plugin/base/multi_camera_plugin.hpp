@@ -0,0 +1,38 @@
+#ifndef BIAS_MULTI_CAMERA_PLUGIN_HPP
+#define BIAS_MULTI_CAMERA_PLUGIN_HPP
+#include <memory>
+#include <QString>
+#include "lockable.hpp"
+#include "matched_frame_set.hpp"
+
+namespace bias
+{
+
+    class MultiCameraPlugin : public Lockable<Empty>
+    {
+        // --------------------------------------------------------------------
+        // Base class for plugins which process frames from several cameras
+        // together, e.g. for 3D tracking. Plugins are registered with the
+        // FrameSyncService and are passed each matched set of frames, in
+        // order, from the frame sync thread - not the GUI thread. Sets may
+        // be incomplete if a camera's frame was missing.
+        // --------------------------------------------------------------------
+
+        public:
+
+            static const QString PLUGIN_NAME;
+
+            MultiCameraPlugin();
+            virtual ~MultiCameraPlugin();
+
+            virtual void reset();
+            virtual void stop();
+            virtual void processMatchedSet(const MatchedFrameSet &matchedSet);
+            virtual QString getName();
+    };
+
+    typedef std::shared_ptr<MultiCameraPlugin> MultiCameraPluginPtr;
+
+}
+
+#endif // #ifndef BIAS_MULTI_CAMERA_PLUGIN_HPP
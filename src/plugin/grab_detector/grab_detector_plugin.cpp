@@ -972,6 +972,7 @@ namespace bias
             {
                 pulseDevice_.startPulse();
             }
+            emit recordTriggerRequest();
             config_.triggerArmedState = false;
             if (loggingEnabled_)
             {
@@ -0,0 +1,471 @@
+// Load test for the external control http server of running camera windows.
+//
+// Usage: bench_ext_ctl_http [options] (--help for the list)
+//
+// Each client polls a camera window's server at a fixed rate, the way an
+// orchestration script does, and times each request from just before it is
+// sent to when the full response has been read. Several clients may poll
+// each server and several servers (one per camera) may be polled at once.
+// Requests reuse a keep-alive connection unless --close is given, send the
+// commands as a GET query or, with --post, as a JSON batch and put all the
+// commands in one request or, with --single, one request per command.
+//
+// Reports the requests made, errors (failed requests, http errors and
+// commands which did not succeed), ticks missed because a request took
+// longer than the polling interval and the request latency percentiles for
+// each server. --csv prints the same as comma separated values.
+//
+// Exit status is 1 if any request failed.
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QStringList>
+#include <QByteArray>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QUrl>
+
+#include "json.hpp"
+
+const QString DEFAULT_HOST = QString("127.0.0.1");
+const QString DEFAULT_PORTS = QString("5010");
+const QString DEFAULT_COMMANDS = QString("get-frame-count,get-time-stamp");
+const double DEFAULT_RATE = 50.0;
+const double DEFAULT_DURATION = 10.0;
+const unsigned int DEFAULT_NUM_CLIENTS = 1;
+const int CONNECT_TIMEOUT_MS = 2000;
+const int RESPONSE_TIMEOUT_MS = 5000;
+
+
+struct ClientParams
+{
+    QString host;
+    quint16 port;
+    QStringList commands;
+    double rate;
+    double duration;
+    bool post;
+    bool single;
+    bool close;
+};
+
+
+struct ClientResult
+{
+    quint16 port;
+    unsigned long numRequests;
+    unsigned long numErrors;
+    unsigned long numMissedTicks;
+    std::vector<double> latencyUs;
+    std::string lastError;
+
+    ClientResult() : port(0), numRequests(0), numErrors(0), numMissedTicks(0) {}
+};
+
+
+class HttpClient
+{
+    // Blocking http/1.1 client - one request at a time on one connection
+    public:
+
+        HttpClient(QString host, quint16 port) : host_(host), port_(port) {}
+
+        bool request(QByteArray req, int &statusCode, QByteArray &body, std::string &errorMsg)
+        {
+            if (socket_.state() != QAbstractSocket::ConnectedState)
+            {
+                socket_.abort();
+                socket_.connectToHost(host_, port_);
+                if (!socket_.waitForConnected(CONNECT_TIMEOUT_MS))
+                {
+                    errorMsg = "connect: " + socket_.errorString().toStdString();
+                    return false;
+                }
+                socket_.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+                buffer_.clear();
+            }
+
+            socket_.write(req);
+            if (!socket_.waitForBytesWritten(RESPONSE_TIMEOUT_MS))
+            {
+                errorMsg = "write: " + socket_.errorString().toStdString();
+                socket_.abort();
+                return false;
+            }
+
+            // Header
+            int headerEnd = -1;
+            while ((headerEnd = buffer_.indexOf("\r\n\r\n")) == -1)
+            {
+                if (!readMore(errorMsg))
+                {
+                    return false;
+                }
+            }
+            QList<QByteArray> lineList = buffer_.left(headerEnd).split('\n');
+            QList<QByteArray> statusTokens = lineList[0].trimmed().split(' ');
+            statusCode = (statusTokens.size() > 1) ? statusTokens[1].toInt() : 0;
+
+            int contentLength = -1;
+            bool keepAlive = true;
+            for (int i=1; i<lineList.size(); i++)
+            {
+                QByteArray line = lineList[i].trimmed().toLower();
+                if (line.startsWith("content-length:"))
+                {
+                    contentLength = line.mid(15).trimmed().toInt();
+                }
+                else if (line.startsWith("connection:") && line.contains("close"))
+                {
+                    keepAlive = false;
+                }
+            }
+            buffer_.remove(0, headerEnd + 4);
+
+            // Body - read to the end of the connection without a length
+            if (contentLength >= 0)
+            {
+                while (buffer_.size() < contentLength)
+                {
+                    if (!readMore(errorMsg))
+                    {
+                        return false;
+                    }
+                }
+                body = buffer_.left(contentLength);
+                buffer_.remove(0, contentLength);
+            }
+            else
+            {
+                std::string ignored;
+                while (readMore(ignored)) {}
+                body = buffer_;
+                buffer_.clear();
+                keepAlive = false;
+            }
+
+            if (!keepAlive)
+            {
+                socket_.disconnectFromHost();
+                socket_.abort();
+            }
+            return true;
+        }
+
+    private:
+
+        QString host_;
+        quint16 port_;
+        QTcpSocket socket_;
+        QByteArray buffer_;
+
+        bool readMore(std::string &errorMsg)
+        {
+            if ((socket_.bytesAvailable() == 0) && !socket_.waitForReadyRead(RESPONSE_TIMEOUT_MS))
+            {
+                errorMsg = "read: " + socket_.errorString().toStdString();
+                socket_.abort();
+                return false;
+            }
+            buffer_.append(socket_.readAll());
+            return true;
+        }
+};
+
+
+QByteArray makeRequest(const ClientParams &params, QStringList commands)
+{
+    QByteArray req;
+    QByteArray hostHeader = "Host: " + params.host.toUtf8() + ":" + QByteArray::number(params.port) + "\r\n";
+    QByteArray connectionHeader = params.close ? "Connection: close\r\n" : "";
+
+    if (params.post)
+    {
+        QVariantList cmdList;
+        for (int i=0; i<commands.size(); i++)
+        {
+            QVariantMap cmdMap;
+            cmdMap.insert("command", commands[i]);
+            cmdList.append(cmdMap);
+        }
+        QByteArray body = QtJson::serialize(cmdList);
+        req += "POST / HTTP/1.1\r\n";
+        req += hostHeader + connectionHeader;
+        req += "Content-Type: application/json\r\n";
+        req += "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n";
+        req += body;
+    }
+    else
+    {
+        QByteArray query;
+        for (int i=0; i<commands.size(); i++)
+        {
+            if (i > 0)
+            {
+                query += "&";
+            }
+            query += QUrl::toPercentEncoding(commands[i]);
+        }
+        req += "GET /?" + query + " HTTP/1.1\r\n";
+        req += hostHeader + connectionHeader + "\r\n";
+    }
+    return req;
+}
+
+
+bool checkResponse(int statusCode, QByteArray body, unsigned int numCommands, std::string &errorMsg)
+{
+    if (statusCode != 200)
+    {
+        errorMsg = "http status " + std::to_string(statusCode);
+        return false;
+    }
+    bool ok = false;
+    QVariantList respList = QtJson::parse(QString::fromUtf8(body), ok).toList();
+    if (!ok || (respList.size() != int(numCommands)))
+    {
+        errorMsg = "unexpected response: " + body.left(200).toStdString();
+        return false;
+    }
+    for (int i=0; i<respList.size(); i++)
+    {
+        QVariantMap respMap = respList[i].toMap();
+        if (!respMap["success"].toBool())
+        {
+            errorMsg = respMap["command"].toString().toStdString() + ": " + respMap["message"].toString().toStdString();
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void runClient(ClientParams params, ClientResult &result)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    HttpClient client(params.host, params.port);
+    result.port = params.port;
+
+    std::vector<QByteArray> reqList;
+    std::vector<unsigned int> reqNumCommands;
+    if (params.single)
+    {
+        for (int i=0; i<params.commands.size(); i++)
+        {
+            reqList.push_back(makeRequest(params, QStringList() << params.commands[i]));
+            reqNumCommands.push_back(1);
+        }
+    }
+    else
+    {
+        reqList.push_back(makeRequest(params, params.commands));
+        reqNumCommands.push_back(params.commands.size());
+    }
+
+    Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0/params.rate));
+    Clock::time_point startTime = Clock::now();
+    Clock::time_point stopTime = startTime + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(params.duration));
+    Clock::time_point tickTime = startTime;
+
+    while (tickTime < stopTime)
+    {
+        std::this_thread::sleep_until(tickTime);
+
+        for (size_t i=0; i<reqList.size(); i++)
+        {
+            int statusCode = 0;
+            QByteArray body;
+            std::string errorMsg;
+
+            Clock::time_point t0 = Clock::now();
+            bool ok = client.request(reqList[i], statusCode, body, errorMsg);
+            Clock::time_point t1 = Clock::now();
+
+            result.numRequests++;
+            if (ok)
+            {
+                result.latencyUs.push_back(std::chrono::duration<double,std::micro>(t1 - t0).count());
+                ok = checkResponse(statusCode, body, reqNumCommands[i], errorMsg);
+            }
+            if (!ok)
+            {
+                result.numErrors++;
+                result.lastError = errorMsg;
+            }
+        }
+
+        // Ticks are not made up once missed - polling continues at the rate
+        tickTime += period;
+        Clock::time_point now = Clock::now();
+        while (tickTime < now)
+        {
+            tickTime += period;
+            result.numMissedTicks++;
+        }
+    }
+}
+
+
+double getPercentile(const std::vector<double> &sortedList, double percent)
+{
+    if (sortedList.empty())
+    {
+        return 0.0;
+    }
+    size_t index = size_t(percent/100.0*double(sortedList.size() - 1) + 0.5);
+    return sortedList[std::min(index, sortedList.size() - 1)];
+}
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("bench_ext_ctl_http");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Load test for the BIAS external control server");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(
+        QStringList() << "host", QString("Server host (default %1)").arg(DEFAULT_HOST), "host", DEFAULT_HOST));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "p" << "ports",
+        QString("Comma separated server ports, one per camera (default %1)").arg(DEFAULT_PORTS),
+        "ports", DEFAULT_PORTS));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "c" << "commands",
+        QString("Comma separated commands to send (default %1)").arg(DEFAULT_COMMANDS),
+        "commands", DEFAULT_COMMANDS));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "r" << "rate",
+        QString("Polling rate per client in Hz (default %1)").arg(DEFAULT_RATE),
+        "rate", QString::number(DEFAULT_RATE)));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "d" << "duration",
+        QString("Duration in seconds (default %1)").arg(DEFAULT_DURATION),
+        "duration", QString::number(DEFAULT_DURATION)));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "n" << "clients",
+        QString("Clients per server (default %1)").arg(DEFAULT_NUM_CLIENTS),
+        "clients", QString::number(DEFAULT_NUM_CLIENTS)));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "post", QString("Send the commands as a JSON batch in a POST request")));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "single", QString("Send one request per command")));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "close", QString("Open a new connection for each request")));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "csv", QString("Print results as comma separated values")));
+    parser.process(app);
+
+    double rate = parser.value("rate").toDouble();
+    double duration = parser.value("duration").toDouble();
+    unsigned int numClients = parser.value("clients").toUInt();
+    QStringList portList = parser.value("ports").split(",", QString::SkipEmptyParts);
+    QStringList commands = parser.value("commands").split(",", QString::SkipEmptyParts);
+    if ((rate <= 0.0) || (duration <= 0.0) || (numClients == 0) || portList.isEmpty() || commands.isEmpty())
+    {
+        std::cerr << "error: rate, duration, clients, ports and commands must be given" << std::endl;
+        return 1;
+    }
+
+    std::vector<ClientParams> paramsList;
+    for (int i=0; i<portList.size(); i++)
+    {
+        for (unsigned int j=0; j<numClients; j++)
+        {
+            ClientParams params;
+            params.host = parser.value("host");
+            params.port = quint16(portList[i].toUInt());
+            params.commands = commands;
+            params.rate = rate;
+            params.duration = duration;
+            params.post = parser.isSet("post");
+            params.single = parser.isSet("single");
+            params.close = parser.isSet("close");
+            paramsList.push_back(params);
+        }
+    }
+
+    std::vector<ClientResult> resultList(paramsList.size());
+    std::vector<std::thread> threadList;
+    for (size_t i=0; i<paramsList.size(); i++)
+    {
+        threadList.push_back(std::thread(runClient, paramsList[i], std::ref(resultList[i])));
+    }
+    for (size_t i=0; i<threadList.size(); i++)
+    {
+        threadList[i].join();
+    }
+
+    // Combine the clients of each server
+    bool csv = parser.isSet("csv");
+    bool anyErrors = false;
+    if (csv)
+    {
+        std::cout << "port, requests, errors, missed ticks, p50 (ms), p90 (ms), p99 (ms), p99.9 (ms), max (ms)" << std::endl;
+    }
+    for (int i=0; i<portList.size(); i++)
+    {
+        ClientResult total;
+        total.port = quint16(portList[i].toUInt());
+        for (size_t j=0; j<resultList.size(); j++)
+        {
+            const ClientResult &result = resultList[j];
+            if (result.port != total.port)
+            {
+                continue;
+            }
+            total.numRequests += result.numRequests;
+            total.numErrors += result.numErrors;
+            total.numMissedTicks += result.numMissedTicks;
+            total.latencyUs.insert(total.latencyUs.end(), result.latencyUs.begin(), result.latencyUs.end());
+            if (!result.lastError.empty())
+            {
+                total.lastError = result.lastError;
+            }
+        }
+        std::sort(total.latencyUs.begin(), total.latencyUs.end());
+        anyErrors |= (total.numErrors > 0);
+
+        double p50 = 1.0e-3*getPercentile(total.latencyUs, 50.0);
+        double p90 = 1.0e-3*getPercentile(total.latencyUs, 90.0);
+        double p99 = 1.0e-3*getPercentile(total.latencyUs, 99.0);
+        double p999 = 1.0e-3*getPercentile(total.latencyUs, 99.9);
+        double max = total.latencyUs.empty() ? 0.0 : 1.0e-3*total.latencyUs.back();
+
+        if (csv)
+        {
+            std::cout << total.port << ", " << total.numRequests << ", " << total.numErrors << ", ";
+            std::cout << total.numMissedTicks << ", " << p50 << ", " << p90 << ", " << p99 << ", ";
+            std::cout << p999 << ", " << max << std::endl;
+        }
+        else
+        {
+            std::cout << std::fixed << std::setprecision(3);
+            std::cout << "port " << total.port << std::endl;
+            std::cout << "  requests:     " << total.numRequests << " (";
+            std::cout << double(total.numRequests)/duration << "/s)" << std::endl;
+            std::cout << "  errors:       " << total.numErrors << std::endl;
+            std::cout << "  missed ticks: " << total.numMissedTicks << std::endl;
+            std::cout << "  latency (ms): p50 " << p50 << ", p90 " << p90 << ", p99 " << p99;
+            std::cout << ", p99.9 " << p999 << ", max " << max << std::endl;
+            if (!total.lastError.empty())
+            {
+                std::cout << "  last error:   " << total.lastError << std::endl;
+            }
+        }
+    }
+
+    return anyErrors ? 1 : 0;
+}
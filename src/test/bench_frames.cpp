@@ -0,0 +1,141 @@
+#include "bench_frames.hpp"
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+const double PI = 3.14159265358979323846;
+
+
+std::vector<cv::Mat> loadFrames(std::string fileName, unsigned int numFrames, bool color)
+{
+    std::vector<cv::Mat> frames;
+    cv::VideoCapture capture(fileName);
+    if (!capture.isOpened())
+    {
+        std::cerr << "unable to open video file " << fileName << std::endl;
+        return frames;
+    }
+    cv::Mat frame;
+    while ((frames.size() < numFrames) && capture.read(frame))
+    {
+        cv::Mat image;
+        if ((frame.channels() > 1) && !color)
+        {
+            cv::cvtColor(frame, image, cv::COLOR_BGR2GRAY);
+        }
+        else if ((frame.channels() == 1) && color)
+        {
+            cv::cvtColor(frame, image, cv::COLOR_GRAY2BGR);
+        }
+        else
+        {
+            image = frame.clone();
+        }
+        frames.push_back(image);
+    }
+    return frames;
+}
+
+
+std::vector<cv::Mat> syntheticFrames(unsigned int numFrames, SyntheticFrameParams params)
+{
+    const int numRow = params.numRow;
+    const int numCol = params.numCol;
+    std::mt19937 rng(0);
+    std::normal_distribution<double> noise(0.0, 4.0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    cv::Mat background(numRow, numCol, CV_8UC1);
+    for (int row=0; row<numRow; row++)
+    {
+        uchar *ptr = background.ptr<uchar>(row);
+        for (int col=0; col<numCol; col++)
+        {
+            double value = 180.0 + 20.0*double(col)/numCol;
+            if (params.textured)
+            {
+                value += 15.0*std::sin(0.05*col)*std::cos(0.03*row) - 10.0;
+            }
+            if (params.staticNoise)
+            {
+                value += noise(rng);
+            }
+            ptr[col] = cv::saturate_cast<uchar>(value);
+        }
+    }
+
+    // Closed paths are ellipses traversed a whole number of turns over the
+    // frames, so cycling the frames looks like continuous motion.
+    struct Blob { double cx, cy, rx, ry, phase; int turns; };
+    std::vector<Blob> blobs;
+    if (params.closedPaths)
+    {
+        for (unsigned int j=0; j<params.numBlobs; j++)
+        {
+            Blob blob;
+            blob.cx = numCol*(0.25 + 0.5*uniform(rng));
+            blob.cy = numRow*(0.25 + 0.5*uniform(rng));
+            blob.rx = 0.2*numCol*uniform(rng);
+            blob.ry = 0.2*numRow*uniform(rng);
+            blob.phase = 2.0*PI*uniform(rng);
+            blob.turns = 1 + int(3*uniform(rng));
+            blobs.push_back(blob);
+        }
+    }
+    cv::Size axes(int(params.blobSize), int(std::max(2*params.blobSize/5, 1u)));
+
+    std::vector<cv::Mat> frames;
+    for (unsigned int i=0; i<numFrames; i++)
+    {
+        cv::Mat frame = background.clone();
+        if (!params.staticNoise)
+        {
+            for (int row=0; row<numRow; row++)
+            {
+                uchar *ptr = frame.ptr<uchar>(row);
+                for (int col=0; col<numCol; col++)
+                {
+                    ptr[col] = cv::saturate_cast<uchar>(ptr[col] + noise(rng));
+                }
+            }
+        }
+
+        for (unsigned int j=0; j<params.numBlobs; j++)
+        {
+            cv::Point center;
+            double orientation = 0.0;
+            if (params.closedPaths)
+            {
+                const Blob &blob = blobs[j];
+                double angle = blob.phase + 2.0*PI*blob.turns*double(i)/double(numFrames);
+                center = cv::Point(
+                        int(blob.cx + blob.rx*std::cos(angle)),
+                        int(blob.cy + blob.ry*std::sin(angle))
+                        );
+                orientation = 180.0*angle/PI;
+            }
+            else
+            {
+                double phase = 0.02*i + j;
+                center = cv::Point(
+                        int(numCol/2 + 0.4*numCol*std::cos(phase*(1.0 + 0.1*j))),
+                        int(numRow/2 + 0.4*numRow*std::sin(phase))
+                        );
+                orientation = 30.0*phase;
+            }
+            cv::ellipse(frame, center, axes, orientation, 0.0, 360.0, cv::Scalar(40), -1);
+        }
+
+        if (params.color)
+        {
+            cv::Mat colorFrame;
+            cv::applyColorMap(frame, colorFrame, cv::COLORMAP_BONE);
+            frame = colorFrame;
+        }
+        frames.push_back(frame);
+    }
+    return frames;
+}
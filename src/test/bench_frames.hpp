@@ -0,0 +1,45 @@
+#ifndef BIAS_BENCH_FRAMES_HPP
+#define BIAS_BENCH_FRAMES_HPP
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+// ----------------------------------------------------------------------------
+// Frame sources shared by the benchmarks: frames read from a recorded video
+// or synthetic footage of dark blobs moving over a bright, noisy background.
+// ----------------------------------------------------------------------------
+
+struct SyntheticFrameParams
+{
+    int numCol;
+    int numRow;
+    unsigned int numBlobs;
+    unsigned int blobSize;    // semi-major axis in pixels
+    bool textured;            // add a sinusoidal texture to the background
+    bool staticNoise;         // noise is part of the background, same every frame
+    bool closedPaths;         // random closed blob paths repeating every numFrames
+    bool color;               // bgr frames (bone color map) instead of mono8
+
+    SyntheticFrameParams()
+        : numCol(1024),
+          numRow(1024),
+          numBlobs(10),
+          blobSize(25),
+          textured(false),
+          staticNoise(false),
+          closedPaths(false),
+          color(false)
+    {};
+};
+
+// Reads up to numFrames frames converted to mono8 - or to bgr when color is set.
+// Returns no frames if the video can't be opened.
+std::vector<cv::Mat> loadFrames(std::string fileName, unsigned int numFrames, bool color=false);
+
+std::vector<cv::Mat> syntheticFrames(
+        unsigned int numFrames,
+        SyntheticFrameParams params=SyntheticFrameParams()
+        );
+
+#endif // #ifndef BIAS_BENCH_FRAMES_HPP
@@ -0,0 +1,200 @@
+// Throughput benchmark for the image sequence writer's file formats.
+//
+// Usage: bench_image_writer [output_dir] [video_file] [num_frames] [num_threads] [files_per_directory]
+//
+// Frames are read from a recorded video (any format OpenCV can read) and
+// converted to mono8. Without a video file (or with "-") synthetic footage is
+// used. Each format - bmp, png at a few compression levels and uncompressed
+// tiff - is written with CompressedFrame_bmp::write by num_threads threads, as
+// the writer's compressors would, into sharded subdirectories of output_dir.
+// Reports frames/s, frames/s per thread, MB/s written and the size on disk.
+// The files are removed afterwards.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <cstdlib>
+#include <cmath>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+#include <QDir>
+#include <QFileInfo>
+
+#include "stamped_image.hpp"
+#include "compressed_frame_bmp.hpp"
+#include "exception.hpp"
+#include "bench_frames.hpp"
+
+using namespace bias;
+
+const QString DEFAULT_OUTPUT_DIR = QString("bench_image_writer_output");
+const unsigned int DEFAULT_NUM_FRAMES = 500;
+const unsigned int DEFAULT_NUM_THREADS = 4;
+const unsigned long DEFAULT_FILES_PER_DIRECTORY = 10000;
+
+
+struct FormatConfig
+{
+    ImageFileFormat_bmp format;
+    unsigned int pngCompressionLevel;
+};
+
+
+QString getFileName(QDir outputDir, unsigned long frameCount, unsigned long filesPerDirectory, QString ext)
+{
+    // Same layout as VideoWriter_bmp
+    QString imageFileName = QString("image_%1%2").arg(frameCount).arg(ext);
+    if (filesPerDirectory == 0)
+    {
+        return outputDir.absoluteFilePath(imageFileName);
+    }
+    QString shardDirName = QString("images_%1").arg(frameCount/filesPerDirectory,6,10,QChar('0'));
+    return outputDir.absoluteFilePath(shardDirName + "/" + imageFileName);
+}
+
+
+bool runFormat(
+        const std::vector<cv::Mat> &frames,
+        FormatConfig config,
+        QDir outputDir,
+        unsigned int numThreads,
+        unsigned long filesPerDirectory
+        )
+{
+    QString ext = CompressedFrame_bmp::getFileExtension(config.format);
+    QString name = CompressedFrame_bmp::getFormatString(config.format);
+    if (config.format == IMAGE_FILE_FORMAT_PNG)
+    {
+        name += QString(" (level %1)").arg(config.pngCompressionLevel);
+    }
+
+    // Create the subdirectories up front - the writer does it on its own thread
+    if (filesPerDirectory > 0)
+    {
+        for (unsigned long i=0; i<frames.size(); i+=filesPerDirectory)
+        {
+            outputDir.mkpath(QString("images_%1").arg(i/filesPerDirectory,6,10,QChar('0')));
+        }
+    }
+
+    std::atomic<unsigned long> numErrors(0);
+    std::vector<std::thread> threads;
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned int i=0; i<numThreads; i++)
+    {
+        threads.push_back(std::thread([&,i]()
+        {
+            for (size_t j=i; j<frames.size(); j+=numThreads)
+            {
+                StampedImage stampedImg;
+                stampedImg.image = frames[j];
+                stampedImg.frameCount = j;
+                CompressedFrame_bmp compressedFrame(getFileName(outputDir, j, filesPerDirectory, ext), stampedImg);
+                compressedFrame.setImageFormat(config.format);
+                compressedFrame.setPngCompressionLevel(config.pngCompressionLevel);
+                try
+                {
+                    compressedFrame.write();
+                }
+                catch (RuntimeError &runtimeError)
+                {
+                    numErrors++;
+                }
+            }
+        }));
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    double numBytes = 0.0;
+    for (size_t j=0; j<frames.size(); j++)
+    {
+        numBytes += QFileInfo(getFileName(outputDir, j, filesPerDirectory, ext)).size();
+    }
+
+    double fps = frames.size()/seconds;
+    std::cout << name.toStdString() << ": " << fps << " fps, " << fps/numThreads << " fps/thread, ";
+    std::cout << 1.0e-6*numBytes/seconds << " MB/s, " << 1.0e-3*numBytes/frames.size() << " kB/frame";
+    if (numErrors > 0)
+    {
+        std::cout << ", write errors: " << numErrors;
+    }
+    std::cout << std::endl;
+
+    // Clean up for the next format
+    QStringList nameFilters;
+    nameFilters << QString("images_*") << QString("image_*");
+    for (QString entry : outputDir.entryList(nameFilters, QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot))
+    {
+        QFileInfo entryInfo(outputDir, entry);
+        if (entryInfo.isDir())
+        {
+            QDir(entryInfo.absoluteFilePath()).removeRecursively();
+        }
+        else
+        {
+            outputDir.remove(entry);
+        }
+    }
+    return (numErrors == 0);
+}
+
+
+int main(int argc, char *argv[])
+{
+    QString outputDirName = (argc > 1) ? QString(argv[1]) : DEFAULT_OUTPUT_DIR;
+    std::string fileName = (argc > 2) ? std::string(argv[2]) : std::string("");
+    unsigned int numFrames = (argc > 3) ? (unsigned int)(std::atoi(argv[3])) : DEFAULT_NUM_FRAMES;
+    unsigned int numThreads = (argc > 4) ? (unsigned int)(std::atoi(argv[4])) : DEFAULT_NUM_THREADS;
+    unsigned long filesPerDirectory = (argc > 5) ? std::strtoul(argv[5],nullptr,10) : DEFAULT_FILES_PER_DIRECTORY;
+    numThreads = (numThreads > 0) ? numThreads : 1;
+
+    std::vector<cv::Mat> frames;
+    if (fileName.empty() || (fileName == "-"))
+    {
+        std::cout << "using synthetic footage" << std::endl;
+        frames = syntheticFrames(numFrames);
+    }
+    else
+    {
+        frames = loadFrames(fileName, numFrames);
+    }
+    if (frames.empty())
+    {
+        return 1;
+    }
+
+    QDir outputDir(outputDirName);
+    if (!outputDir.exists() && !QDir().mkpath(outputDirName))
+    {
+        std::cerr << "unable to create output directory " << outputDirName.toStdString() << std::endl;
+        return 1;
+    }
+
+    std::cout << "frames: " << frames.size() << ", size: " << frames[0].cols << "x" << frames[0].rows;
+    std::cout << ", threads: " << numThreads << ", files per directory: " << filesPerDirectory;
+    std::cout << ", output: " << outputDir.absolutePath().toStdString() << std::endl;
+
+    std::vector<FormatConfig> configs = {
+        {IMAGE_FILE_FORMAT_BMP,  0},
+        {IMAGE_FILE_FORMAT_PNG,  0},
+        {IMAGE_FILE_FORMAT_PNG,  1},
+        {IMAGE_FILE_FORMAT_PNG,  3},
+        {IMAGE_FILE_FORMAT_TIFF, 0},
+    };
+
+    bool ok = true;
+    for (auto config : configs)
+    {
+        ok = runFormat(frames, config, outputDir, numThreads, filesPerDirectory) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+// Throughput benchmark for jpg encoding of logged frames.
+//
+// Usage: bench_jpg_encode [video_file] [num_frames] [quality] [num_threads] [chroma_subsampling] [fast_dct] [color]
+//
+// Frames are read from a recorded video (any format OpenCV can read) and, unless
+// color is 1, converted to mono8. Without a video file synthetic footage is
+// used. The same frames are encoded by num_threads threads, as the jpg writer's
+// compressors would, first with the previous OpenCV path (a new CompressedFrame_jpg
+// and cv::imencode per frame) and then with a persistent Encoder_jpg per thread.
+// Reports fps and fps per thread for both, the mean encoded size and the PSNR of
+// the decoded frames against the originals.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "stamped_image.hpp"
+#include "compressed_frame_jpg.hpp"
+#include "encoder_jpg.hpp"
+#include "bench_frames.hpp"
+
+using namespace bias;
+
+const unsigned int DEFAULT_NUM_FRAMES = 500;
+const unsigned int DEFAULT_QUALITY = 90;
+const unsigned int DEFAULT_NUM_THREADS = 1;
+const unsigned int NUM_PASSES = 3;
+const unsigned int NUM_PSNR_SAMPLES = 20;
+
+
+struct EncodeResult
+{
+    double seconds;
+    double numBytes;
+};
+
+
+// Encodes every numThreads'th frame, starting at frame offset, with the
+// previous OpenCV path
+void encodeOpenCvThread(
+        const std::vector<cv::Mat> &frames,
+        unsigned int quality,
+        unsigned int offset,
+        unsigned int numThreads,
+        double &numBytes
+        )
+{
+    numBytes = 0.0;
+    for (size_t i=offset; i<frames.size(); i+=numThreads)
+    {
+        StampedImage stampedImg;
+        stampedImg.image = frames[i];
+        stampedImg.frameCount = i;
+        CompressedFrame_jpg compressedFrame(QString("bench.jpg"), stampedImg, quality, true);
+        compressedFrame.encode();
+        numBytes += compressedFrame.getEncodedJpgBuffer().size();
+    }
+}
+
+
+// As above with one persistent encoder for the thread
+void encodeEncoderThread(
+        const std::vector<cv::Mat> &frames,
+        unsigned int quality,
+        unsigned int chromaSubsampling,
+        bool fastDct,
+        unsigned int offset,
+        unsigned int numThreads,
+        double &numBytes
+        )
+{
+    numBytes = 0.0;
+    Encoder_jpg encoder;
+    encoder.setChromaSubsampling(chromaSubsampling);
+    encoder.setFastDct(fastDct);
+    CompressedFrame_jpg compressedFrame(QString("bench.jpg"));
+    compressedFrame.setQuality(quality);
+    compressedFrame.setMjpgFlag(true);
+    for (size_t i=offset; i<frames.size(); i+=numThreads)
+    {
+        StampedImage stampedImg;
+        stampedImg.image = frames[i];
+        stampedImg.frameCount = i;
+        compressedFrame.setStampedImage(stampedImg);
+        compressedFrame.encode(encoder);
+        numBytes += compressedFrame.getEncodedJpgBuffer().size();
+    }
+}
+
+
+template <class Function>
+EncodeResult runThreads(const std::vector<cv::Mat> &frames, unsigned int numThreads, Function encodeFunc)
+{
+    typedef std::chrono::steady_clock Clock;
+    EncodeResult result;
+    result.seconds = 0.0;
+    result.numBytes = 0.0;
+
+    for (unsigned int pass=0; pass<NUM_PASSES; pass++)
+    {
+        std::vector<double> numBytes(numThreads, 0.0);
+        std::vector<std::thread> threads;
+        Clock::time_point t0 = Clock::now();
+        for (unsigned int i=0; i<numThreads; i++)
+        {
+            threads.push_back(std::thread(encodeFunc, i, numThreads, std::ref(numBytes[i])));
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+        // Best of the passes
+        if ((pass == 0) || (seconds < result.seconds))
+        {
+            result.seconds = seconds;
+        }
+        result.numBytes = 0.0;
+        for (auto value : numBytes)
+        {
+            result.numBytes += value;
+        }
+    }
+    return result;
+}
+
+
+double meanPsnr(
+        const std::vector<cv::Mat> &frames,
+        unsigned int numSamples,
+        std::function<void(const cv::Mat &, std::vector<uchar> &)> encodeFunc
+        )
+{
+    double psnrSum = 0.0;
+    std::vector<uchar> buffer;
+    for (unsigned int i=0; i<numSamples; i++)
+    {
+        encodeFunc(frames[i], buffer);
+        cv::Mat decoded = cv::imdecode(buffer, cv::IMREAD_UNCHANGED);
+        if ((decoded.size() != frames[i].size()) || (decoded.type() != frames[i].type()))
+        {
+            return -1.0;
+        }
+        psnrSum += cv::PSNR(frames[i], decoded);
+    }
+    return psnrSum/numSamples;
+}
+
+
+void printResult(std::string name, const EncodeResult &result, size_t numFrames, unsigned int numThreads, double psnr)
+{
+    double fps = numFrames/result.seconds;
+    std::cout << name << fps << " fps, " << fps/numThreads << " fps/thread, ";
+    std::cout << result.numBytes/numFrames*1.0e-3 << " kB/frame, ";
+    std::cout << "psnr " << psnr << " dB" << std::endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+    std::string fileName = (argc > 1) ? std::string(argv[1]) : std::string("");
+    unsigned int numFrames = (argc > 2) ? (unsigned int)(std::atoi(argv[2])) : DEFAULT_NUM_FRAMES;
+    unsigned int quality = (argc > 3) ? (unsigned int)(std::atoi(argv[3])) : DEFAULT_QUALITY;
+    unsigned int numThreads = (argc > 4) ? (unsigned int)(std::atoi(argv[4])) : DEFAULT_NUM_THREADS;
+    unsigned int chromaSubsampling = (argc > 5) ? (unsigned int)(std::atoi(argv[5])) : Encoder_jpg::DEFAULT_CHROMA_SUBSAMPLING;
+    bool fastDct = (argc > 6) ? (std::atoi(argv[6]) != 0) : Encoder_jpg::DEFAULT_FAST_DCT;
+    bool color = (argc > 7) ? (std::atoi(argv[7]) != 0) : false;
+
+    numThreads = std::max(numThreads, 1u);
+    if (!Encoder_jpg::isValidChromaSubsampling(chromaSubsampling))
+    {
+        std::cerr << "chroma subsampling must be 444, 422 or 420" << std::endl;
+        return 1;
+    }
+
+    std::vector<cv::Mat> frames;
+    if (fileName.empty() || (fileName == "-"))
+    {
+        std::cout << "using synthetic footage" << std::endl;
+        SyntheticFrameParams frameParams;
+        frameParams.textured = true;
+        frameParams.color = color;
+        frames = syntheticFrames(numFrames, frameParams);
+    }
+    else
+    {
+        frames = loadFrames(fileName, numFrames, color);
+    }
+    if (frames.empty())
+    {
+        return 1;
+    }
+
+    Encoder_jpg encoder;
+    encoder.setChromaSubsampling(chromaSubsampling);
+    encoder.setFastDct(fastDct);
+
+    std::cout << "frames: " << frames.size() << ", size: " << frames[0].cols << "x" << frames[0].rows;
+    std::cout << ", channels: " << frames[0].channels() << ", quality: " << quality;
+    std::cout << ", threads: " << numThreads << std::endl;
+    std::cout << "encoder: " << (encoder.isUsingTurboJpeg() ? "libjpeg-turbo" : "opencv");
+    std::cout << ", chroma subsampling: " << chromaSubsampling;
+    std::cout << ", fast dct: " << std::boolalpha << fastDct << std::noboolalpha << std::endl;
+
+    EncodeResult openCvResult = runThreads(frames, numThreads,
+            [&](unsigned int offset, unsigned int step, double &numBytes)
+            {
+                encodeOpenCvThread(frames, quality, offset, step, numBytes);
+            });
+
+    EncodeResult encoderResult = runThreads(frames, numThreads,
+            [&](unsigned int offset, unsigned int step, double &numBytes)
+            {
+                encodeEncoderThread(frames, quality, chromaSubsampling, fastDct, offset, step, numBytes);
+            });
+
+    unsigned int numSamples = std::min(NUM_PSNR_SAMPLES, (unsigned int)(frames.size()));
+    double openCvPsnr = meanPsnr(frames, numSamples,
+            [&](const cv::Mat &image, std::vector<uchar> &buffer)
+            {
+                std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, int(quality)};
+                cv::imencode(".jpg", image, buffer, params);
+            });
+    double encoderPsnr = meanPsnr(frames, numSamples,
+            [&](const cv::Mat &image, std::vector<uchar> &buffer)
+            {
+                encoder.encode(image, quality, buffer);
+            });
+
+    printResult("opencv:  ", openCvResult, frames.size(), numThreads, openCvPsnr);
+    printResult("encoder: ", encoderResult, frames.size(), numThreads, encoderPsnr);
+    std::cout << "speedup: " << openCvResult.seconds/encoderResult.seconds << "x" << std::endl;
+
+    if ((openCvPsnr < 0.0) || (encoderPsnr < 0.0))
+    {
+        std::cout << "decoded frames don't match the originals" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+// Throughput benchmark for the Mono12p pack/unpack used by the fmf writer and
+// reader.
+//
+// Usage: bench_pack12 [width] [height] [num_frames]
+//
+// Packs and unpacks synthetic 16-bit frames (12-bit data in the upper bits,
+// as delivered by the camera backends) with the scalar code and with the
+// dispatched (SSSE3 where available) code, checks that the round trip is
+// exact and reports frames/s and input MB/s for each.
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cstdint>
+
+#include "pack12.hpp"
+
+using namespace bias;
+
+const unsigned int DEFAULT_WIDTH = 2048;
+const unsigned int DEFAULT_HEIGHT = 2048;
+const unsigned int DEFAULT_NUM_FRAMES = 200;
+
+
+template <class Func> double timeFrames(unsigned int numFrames, Func func)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned int i=0; i<numFrames; i++)
+    {
+        func();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+void report(std::string name, unsigned int numFrames, size_t numPix, double seconds)
+{
+    double fps = numFrames/seconds;
+    std::cout << name << ": " << fps << " fps, ";
+    std::cout << 1.0e-6*fps*numPix*sizeof(uint16_t) << " MB/s" << std::endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+    unsigned int width = (argc > 1) ? (unsigned int)(std::atoi(argv[1])) : DEFAULT_WIDTH;
+    unsigned int height = (argc > 2) ? (unsigned int)(std::atoi(argv[2])) : DEFAULT_HEIGHT;
+    unsigned int numFrames = (argc > 3) ? (unsigned int)(std::atoi(argv[3])) : DEFAULT_NUM_FRAMES;
+    size_t numPix = size_t(width)*size_t(height);
+    if (numPix == 0)
+    {
+        std::cerr << "image size must be nonzero" << std::endl;
+        return 1;
+    }
+
+    std::mt19937 rng(0);
+    std::vector<uint16_t> image(numPix);
+    for (size_t i=0; i<numPix; i++)
+    {
+        image[i] = uint16_t((rng() & 0x0fff) << 4);
+    }
+    std::vector<uint8_t> packed(getMono12pSize(numPix));
+    std::vector<uint16_t> unpacked(numPix);
+
+    std::cout << "size: " << width << "x" << height << ", frames: " << numFrames;
+    std::cout << ", ssse3: " << (cpuSupportsSsse3() ? "yes" : "no") << std::endl;
+
+    double seconds = timeFrames(numFrames, [&]() { packMono12p_scalar(image.data(), packed.data(), 0, numPix); });
+    report("pack scalar", numFrames, numPix, seconds);
+    seconds = timeFrames(numFrames, [&]() { packMono12p(image.data(), packed.data(), numPix); });
+    report("pack", numFrames, numPix, seconds);
+
+    seconds = timeFrames(numFrames, [&]() { unpackMono12p_scalar(packed.data(), unpacked.data(), 0, numPix); });
+    report("unpack scalar", numFrames, numPix, seconds);
+    seconds = timeFrames(numFrames, [&]() { unpackMono12p(packed.data(), unpacked.data(), numPix); });
+    report("unpack", numFrames, numPix, seconds);
+
+    if (unpacked != image)
+    {
+        std::cerr << "round trip mismatch" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,290 @@
+// Throughput benchmark for UFMF frame compression (box extraction).
+//
+// Usage: bench_ufmf_compress [video_file] [num_frames] [box_length] [threshold]
+//
+// Frames are read from a recorded video (any format OpenCV can read) and
+// converted to mono8. Without a video file synthetic footage of moving blobs on
+// a noisy background is used. The background model is the per-pixel median of
+// frames sampled from the footage. Each frame is compressed with the current
+// CompressedFrame_ufmf kernel and with a copy of the previous per-pixel kernel,
+// the outputs are checked to be identical and the throughput of both reported.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+#include <QThread>
+
+#include "stamped_image.hpp"
+#include "compressed_frame_ufmf.hpp"
+#include "bench_frames.hpp"
+
+using namespace bias;
+
+const unsigned int DEFAULT_NUM_FRAMES = 500;
+const unsigned int DEFAULT_BOX_LENGTH = 30;
+const unsigned int DEFAULT_THRESHOLD = 40;
+const unsigned int NUM_BACKGROUND_SAMPLES = 25;
+const unsigned int DILATE_WINDOW_SIZE = 1;
+
+
+struct BoxData
+{
+    std::vector<uint16_t> row;
+    std::vector<uint16_t> col;
+    std::vector<uint16_t> hgt;
+    std::vector<uint16_t> wdt;
+    std::vector<uint8_t> data;
+};
+
+
+// Previous compression kernel - kept here as the reference for output and speed
+void referenceCompress(
+        cv::Mat image,
+        cv::Mat lowerBound,
+        cv::Mat upperBound,
+        unsigned int boxLength,
+        BoxData &boxData
+        )
+{
+    unsigned int numRow = (unsigned int)(image.rows);
+    unsigned int numCol = (unsigned int)(image.cols);
+    unsigned int numPix = numRow*numCol;
+
+    static std::vector<uint16_t> numWriteBuf;
+    numWriteBuf.resize(numPix);
+    boxData.row.resize(numPix);
+    boxData.col.resize(numPix);
+    boxData.hgt.resize(numPix);
+    boxData.wdt.resize(numPix);
+    boxData.data.resize(numPix);
+
+    std::fill_n(boxData.row.begin(), numPix, 0);
+    std::fill_n(boxData.col.begin(), numPix, 0);
+    std::fill_n(boxData.hgt.begin(), numPix, 0);
+    std::fill_n(boxData.wdt.begin(), numPix, 0);
+    std::fill_n(numWriteBuf.begin(), numPix, 0);
+    std::fill_n(boxData.data.begin(), numPix, 0);
+
+    cv::Mat membershipImage;
+    cv::inRange(image, lowerBound, upperBound, membershipImage);
+    cv::Size structElemSize = cv::Size(2*DILATE_WINDOW_SIZE+1,2*DILATE_WINDOW_SIZE+1);
+    cv::Mat structElem = cv::getStructuringElement(cv::MORPH_RECT,structElemSize,cv::Point(-1,-1));
+    cv::erode(membershipImage, membershipImage, structElem, cv::Point(-1,-1),1);
+    cv::countNonZero(membershipImage);
+
+    QThread *thisThread = QThread::currentThread();
+    for (unsigned int i=0; i<numPix; i++) { numWriteBuf[i] = 0; }
+
+    unsigned int numBox = 0;
+    unsigned int imageDatInd = 0;
+    for (unsigned int row=0; row<numRow; row++)
+    {
+        for (unsigned int col=0; col<numCol; col++)
+        {
+            if (membershipImage.at<uchar>(row,col) == CompressedFrame_ufmf::BACKGROUND_MEMBER_VALUE)
+            {
+                continue;
+            }
+            boxData.row[numBox] = row;
+            boxData.col[numBox] = col;
+            boxData.hgt[numBox] = std::min(boxLength, numRow-row);
+            boxData.wdt[numBox] = std::min(boxLength, numCol-col);
+            unsigned int rowPlusHeight = row + boxData.hgt[numBox];
+
+            for (unsigned int rowEnd=row; rowEnd < rowPlusHeight; rowEnd++)
+            {
+                bool stopEarly = false;
+                unsigned int colEnd = col;
+                unsigned int numWriteInd = rowEnd*numCol + col;
+                unsigned int colPlusWidth = col + boxData.wdt[numBox];
+                for (colEnd=col; colEnd < colPlusWidth; colEnd++)
+                {
+                    if (numWriteBuf[numWriteInd] > 0)
+                    {
+                        stopEarly = true;
+                        break;
+                    }
+                    numWriteInd += 1;
+                }
+                if (stopEarly)
+                {
+                    if (rowEnd == row)
+                    {
+                        boxData.wdt[numBox] = colEnd - col;
+                    }
+                    else
+                    {
+                        boxData.hgt[numBox] = rowEnd - row;
+                        break;
+                    }
+                }
+                colPlusWidth = col + boxData.wdt[numBox];
+                numWriteInd = rowEnd*numCol + col;
+                for (colEnd=col; colEnd < colPlusWidth; colEnd++)
+                {
+                    numWriteBuf[numWriteInd] += 1;
+                    numWriteInd += 1;
+                    boxData.data[imageDatInd] = (uint8_t) image.at<uchar>(rowEnd,colEnd);
+                    imageDatInd += 1;
+                    membershipImage.at<uchar>(rowEnd,colEnd) = CompressedFrame_ufmf::BACKGROUND_MEMBER_VALUE;
+                }
+            }
+            numBox++;
+            thisThread -> yieldCurrentThread();
+        }
+    }
+    boxData.row.resize(numBox);
+    boxData.col.resize(numBox);
+    boxData.hgt.resize(numBox);
+    boxData.wdt.resize(numBox);
+    boxData.data.resize(imageDatInd);
+}
+
+
+bool sameOutput(CompressedFrame_ufmf &frame, const BoxData &boxData)
+{
+    unsigned int numBox = frame.getNumConnectedComp();
+    if (numBox != boxData.row.size())
+    {
+        return false;
+    }
+    size_t numData = 0;
+    for (unsigned int i=0; i<numBox; i++)
+    {
+        if (
+                ((*frame.getWriteRowBufPtr())[i] != boxData.row[i]) ||
+                ((*frame.getWriteColBufPtr())[i] != boxData.col[i]) ||
+                ((*frame.getWriteHgtBufPtr())[i] != boxData.hgt[i]) ||
+                ((*frame.getWriteWdtBufPtr())[i] != boxData.wdt[i])
+           )
+        {
+            return false;
+        }
+        numData += size_t(boxData.hgt[i])*boxData.wdt[i];
+    }
+    if (numData != boxData.data.size())
+    {
+        return false;
+    }
+    return std::equal(boxData.data.begin(), boxData.data.end(), frame.getImageDataPtr() -> begin());
+}
+
+
+cv::Mat medianBackground(const std::vector<cv::Mat> &frames)
+{
+    unsigned int numSamples = std::min(NUM_BACKGROUND_SAMPLES, (unsigned int)(frames.size()));
+    unsigned int step = (unsigned int)(frames.size())/numSamples;
+    cv::Mat median(frames[0].size(), CV_8UC1);
+    std::vector<uchar> values(numSamples);
+    for (int row=0; row<median.rows; row++)
+    {
+        for (int col=0; col<median.cols; col++)
+        {
+            for (unsigned int i=0; i<numSamples; i++)
+            {
+                values[i] = frames[i*step].at<uchar>(row,col);
+            }
+            std::nth_element(values.begin(), values.begin() + numSamples/2, values.end());
+            median.at<uchar>(row,col) = values[numSamples/2];
+        }
+    }
+    return median;
+}
+
+
+int main(int argc, char *argv[])
+{
+    std::string fileName = (argc > 1) ? std::string(argv[1]) : std::string("");
+    unsigned int numFrames = (argc > 2) ? (unsigned int)(std::atoi(argv[2])) : DEFAULT_NUM_FRAMES;
+    unsigned int boxLength = (argc > 3) ? (unsigned int)(std::atoi(argv[3])) : DEFAULT_BOX_LENGTH;
+    unsigned int threshold = (argc > 4) ? (unsigned int)(std::atoi(argv[4])) : DEFAULT_THRESHOLD;
+
+    std::vector<cv::Mat> frames;
+    if (fileName.empty() || (fileName == "-"))
+    {
+        std::cout << "using synthetic footage" << std::endl;
+        frames = syntheticFrames(numFrames);
+    }
+    else
+    {
+        frames = loadFrames(fileName, numFrames);
+    }
+    if (frames.empty())
+    {
+        return 1;
+    }
+    std::cout << "frames: " << frames.size() << ", size: " << frames[0].cols << "x" << frames[0].rows;
+    std::cout << ", box length: " << boxLength << ", threshold: " << threshold << std::endl;
+
+    cv::Mat background = medianBackground(frames);
+    cv::Mat upperBound;
+    cv::Mat lowerBound;
+    cv::add(background, threshold, upperBound);
+    cv::subtract(background, threshold, lowerBound);
+
+    typedef std::chrono::steady_clock Clock;
+    double refSeconds = 0.0;
+    double newSeconds = 0.0;
+    unsigned long numBoxes = 0;
+    unsigned long numMismatch = 0;
+    unsigned long numUncompressed = 0;
+
+    MembershipKernel_ufmf membershipKernel;
+    CompressedFrame_ufmf compressedFrame(boxLength);
+    compressedFrame.dilateEnabled(true);
+    compressedFrame.setDilateWindowSize(DILATE_WINDOW_SIZE);
+    BoxData boxData;
+
+    for (size_t i=0; i<frames.size(); i++)
+    {
+        StampedImage stampedImg;
+        stampedImg.image = frames[i];
+        stampedImg.frameCount = i;
+        stampedImg.timeStamp = double(i);
+        stampedImg.dtEstimate = 0.0;
+
+        Clock::time_point t0 = Clock::now();
+        compressedFrame.setData(stampedImg, lowerBound, upperBound, 0);
+        compressedFrame.compress(membershipKernel);
+        Clock::time_point t1 = Clock::now();
+        referenceCompress(frames[i], lowerBound, upperBound, boxLength, boxData);
+        Clock::time_point t2 = Clock::now();
+
+        newSeconds += std::chrono::duration<double>(t1 - t0).count();
+        refSeconds += std::chrono::duration<double>(t2 - t1).count();
+        numBoxes += compressedFrame.getNumConnectedComp();
+
+        // Frames with too much foreground are stored uncompressed - not comparable
+        bool isUncompressed = (compressedFrame.getNumConnectedComp() == 1) &&
+            ((*compressedFrame.getWriteHgtBufPtr())[0] == frames[i].rows) &&
+            ((*compressedFrame.getWriteWdtBufPtr())[0] == frames[i].cols);
+        if (isUncompressed)
+        {
+            numUncompressed++;
+        }
+        else if (!sameOutput(compressedFrame, boxData))
+        {
+            numMismatch++;
+        }
+    }
+
+    double numMPix = double(frames.size())*frames[0].total()*1.0e-6;
+    std::cout << "boxes/frame: " << double(numBoxes)/frames.size();
+    std::cout << ", uncompressed frames: " << numUncompressed << std::endl;
+    std::cout << "reference: " << frames.size()/refSeconds << " fps, ";
+    std::cout << numMPix/refSeconds << " Mpix/s" << std::endl;
+    std::cout << "current:   " << frames.size()/newSeconds << " fps, ";
+    std::cout << numMPix/newSeconds << " Mpix/s" << std::endl;
+    std::cout << "speedup:   " << refSeconds/newSeconds << "x" << std::endl;
+    std::cout << "output mismatches: " << numMismatch << std::endl;
+
+    return (numMismatch == 0) ? 0 : 1;
+}
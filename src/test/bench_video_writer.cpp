@@ -0,0 +1,494 @@
+// Benchmark for the logging video writers, run outside of the camera window.
+//
+// Usage: bench_video_writer [options] (--help for the list)
+//
+// Each selected writer - bmp, jpg, avi, fmf, ufmf and mkv - is fed frames the
+// way the image logger feeds it, either as fast as possible or paced at a
+// target frame rate. Frames come from a recorded video (any format OpenCV can
+// read, converted to mono8) or from a synthetic generator: a static noisy
+// background with moving dark blobs. A set of unique frames is prepared up
+// front and cycled so frame generation isn't part of the measurement.
+//
+// For each writer reports the sustained rate (frames fed / time including
+// finish), the time spent in addFrame as latency percentiles, the time to
+// finish, the peak resident memory above that before the writer was made, the
+// bytes written and the frames the writer skipped because it could not keep
+// up. --csv prints the same as comma separated values for collecting from
+// scripts, e.g. when qualifying a new acquisition PC.
+//
+// Exit status is 1 if a writer reported an error or, when a target rate is
+// given, skipped frames - i.e. it could not sustain the rate.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QStringList>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "stamped_image.hpp"
+#include "basic_types.hpp"
+#include "exception.hpp"
+#include "video_writer.hpp"
+#include "video_writer_params.hpp"
+#include "video_writer_bmp.hpp"
+#include "video_writer_jpg.hpp"
+#include "video_writer_avi.hpp"
+#include "video_writer_fmf.hpp"
+#include "video_writer_ufmf.hpp"
+#include "video_writer_ffmpeg.hpp"
+#include "bench_frames.hpp"
+
+using namespace bias;
+
+const QString DEFAULT_FORMATS = QString("bmp,jpg,avi,fmf,ufmf");
+const QString DEFAULT_OUTPUT_DIR = QString("bench_video_writer_output");
+const unsigned int DEFAULT_NUM_FRAMES = 1000;
+const unsigned int DEFAULT_NUM_UNIQUE = 100;
+const unsigned int DEFAULT_WIDTH = 1024;
+const unsigned int DEFAULT_HEIGHT = 1024;
+const unsigned int DEFAULT_NUM_BLOBS = 10;
+const unsigned int DEFAULT_BLOB_SIZE = 25;
+const double UNPACED_DT_ESTIMATE = 0.01;   // frame interval given to writers when unpaced
+const unsigned int MEMORY_SAMPLE_MS = 10;
+const unsigned int PROCESS_EVENTS_INTERVAL = 100;
+
+
+struct BenchResult
+{
+    QString format;
+    unsigned long numFrames;
+    double feedSec;
+    double finishSec;
+    std::vector<double> latencyUs;
+    double peakMemoryMB;
+    double bytesWritten;
+    unsigned long numSkipped;
+    unsigned long numErrors;
+
+    BenchResult() : numFrames(0), feedSec(0.0), finishSec(0.0), peakMemoryMB(0.0),
+        bytesWritten(0.0), numSkipped(0), numErrors(0) {}
+};
+
+
+double getResidentMB()
+{
+#if defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    unsigned long totalPages = 0;
+    unsigned long residentPages = 0;
+    if (statm >> totalPages >> residentPages)
+    {
+        return double(residentPages)*double(sysconf(_SC_PAGESIZE))/double(1 << 20);
+    }
+#endif
+    return 0.0;
+}
+
+
+class MemorySampler
+{
+    // Tracks the peak resident memory while a writer runs
+    public:
+
+        MemorySampler() : stop_(false), peakMB_(0.0)
+        {
+            thread_ = std::thread([this]()
+            {
+                while (!stop_)
+                {
+                    peakMB_ = std::max(double(peakMB_), getResidentMB());
+                    std::this_thread::sleep_for(std::chrono::milliseconds(MEMORY_SAMPLE_MS));
+                }
+            });
+        }
+
+        double stop()
+        {
+            stop_ = true;
+            thread_.join();
+            return std::max(double(peakMB_), getResidentMB());
+        }
+
+    private:
+
+        std::atomic<bool> stop_;
+        std::atomic<double> peakMB_;
+        std::thread thread_;
+};
+
+
+std::shared_ptr<VideoWriter> createVideoWriter(
+        QString format,
+        VideoWriterParams params,
+        QString fileName
+        )
+{
+    std::shared_ptr<VideoWriter> videoWriterPtr;
+    if (format == QString("bmp"))
+    {
+        videoWriterPtr = std::make_shared<VideoWriter_bmp>(params.bmp, fileName, 0);
+    }
+    else if (format == QString("jpg"))
+    {
+        videoWriterPtr = std::make_shared<VideoWriter_jpg>(params.jpg, fileName, 0);
+    }
+    else if (format == QString("avi"))
+    {
+        videoWriterPtr = std::make_shared<VideoWriter_avi>(params.avi, fileName, 0);
+    }
+    else if (format == QString("fmf"))
+    {
+        videoWriterPtr = std::make_shared<VideoWriter_fmf>(params.fmf, fileName, 0);
+    }
+    else if (format == QString("ufmf"))
+    {
+        videoWriterPtr = std::make_shared<VideoWriter_ufmf>(params.ufmf, fileName, 0);
+    }
+    else if (format == QString("mkv"))
+    {
+        videoWriterPtr = std::make_shared<VideoWriter_ffmpeg>(params.ffmpeg, fileName, 0);
+    }
+    if (videoWriterPtr)
+    {
+        videoWriterPtr -> setFileName(fileName);
+        videoWriterPtr -> setVersioning(false);
+    }
+    return videoWriterPtr;
+}
+
+
+double getBytesInDir(QDir dir)
+{
+    double numBytes = 0.0;
+    QDirIterator dirIt(dir.absolutePath(), QDir::Files, QDirIterator::Subdirectories);
+    while (dirIt.hasNext())
+    {
+        dirIt.next();
+        numBytes += double(dirIt.fileInfo().size());
+    }
+    return numBytes;
+}
+
+
+double getPercentile(std::vector<double> values, double percent)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = size_t(std::ceil(0.01*percent*values.size()));
+    index = std::min(std::max(index, size_t(1)), values.size()) - 1;
+    return values[index];
+}
+
+
+BenchResult runWriter(
+        QString format,
+        VideoWriterParams params,
+        const std::vector<cv::Mat> &frames,
+        unsigned int numFrames,
+        double frameRate,
+        QDir outputDir
+        )
+{
+    BenchResult result;
+    result.format = format;
+
+    // Each writer gets its own subdirectory so everything it wrote can be
+    // counted and removed.
+    QDir writerDir(outputDir.absoluteFilePath(format));
+    if (writerDir.exists())
+    {
+        writerDir.removeRecursively();
+    }
+    outputDir.mkpath(format);
+    QString fileName = writerDir.absoluteFilePath(QString("bench.") + format);
+
+    double baseMemoryMB = getResidentMB();
+    MemorySampler memorySampler;
+
+    // Errors may be emitted by the writer's compressor threads - the context
+    // object queues them to this thread, where they are delivered by
+    // processEvents.
+    std::shared_ptr<VideoWriter> videoWriterPtr = createVideoWriter(format, params, fileName);
+    QObject::connect(
+            videoWriterPtr.get(),
+            &VideoWriter::imageLoggingError,
+            QCoreApplication::instance(),
+            [&result](unsigned int errorId, QString errorMsg)
+            {
+                // Skipped frames are counted by the writer
+                if ((errorId != ERROR_FRAMES_TODO_MAX_QUEUE_SIZE) && (errorId != ERROR_FRAMES_FINISHED_MAX_SET_SIZE))
+                {
+                    std::cerr << "error " << errorId << ": " << errorMsg.toStdString() << std::endl;
+                    result.numErrors++;
+                }
+            }
+            );
+
+    double dtEstimate = (frameRate > 0.0) ? 1.0/frameRate : UNPACED_DT_ESTIMATE;
+    result.latencyUs.reserve(numFrames);
+
+    auto t0 = std::chrono::steady_clock::now();
+    try
+    {
+        for (unsigned int i=0; i<numFrames; i++)
+        {
+            if (frameRate > 0.0)
+            {
+                std::this_thread::sleep_until(t0 + std::chrono::duration<double>(i/frameRate));
+            }
+
+            StampedImage stampedImg;
+            stampedImg.image = frames[i%frames.size()];
+            stampedImg.frameCount = i;
+            stampedImg.timeStamp = i*dtEstimate;
+            stampedImg.dtEstimate = dtEstimate;
+
+            auto tFrame = std::chrono::steady_clock::now();
+            videoWriterPtr -> addFrame(stampedImg);
+            auto tDone = std::chrono::steady_clock::now();
+            result.latencyUs.push_back(std::chrono::duration<double,std::micro>(tDone - tFrame).count());
+            result.numFrames++;
+
+            // Deliver errors emitted by the writer's compressor threads
+            if (i%PROCESS_EVENTS_INTERVAL == 0)
+            {
+                QCoreApplication::processEvents();
+            }
+        }
+        auto tFeed = std::chrono::steady_clock::now();
+        result.feedSec = std::chrono::duration<double>(tFeed - t0).count();
+
+        videoWriterPtr -> finish();
+        result.finishSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - tFeed).count();
+    }
+    catch (RuntimeError &runtimeError)
+    {
+        std::cerr << format.toStdString() << " error " << runtimeError.id() << ": ";
+        std::cerr << runtimeError.what() << std::endl;
+        result.numErrors++;
+    }
+    QCoreApplication::processEvents();
+    result.numSkipped = videoWriterPtr -> getNumSkipped();
+
+    // Destroying the writer waits for its threads
+    videoWriterPtr.reset();
+    result.peakMemoryMB = std::max(memorySampler.stop() - baseMemoryMB, 0.0);
+    result.bytesWritten = getBytesInDir(writerDir);
+    return result;
+}
+
+
+void printResult(const BenchResult &result, bool csv)
+{
+    double totalSec = result.feedSec + result.finishSec;
+    double fps = (totalSec > 0.0) ? result.numFrames/totalSec : 0.0;
+    double feedFps = (result.feedSec > 0.0) ? result.numFrames/result.feedSec : 0.0;
+    double mbWritten = 1.0e-6*result.bytesWritten;
+    double mbPerSec = (totalSec > 0.0) ? mbWritten/totalSec : 0.0;
+    double p50 = getPercentile(result.latencyUs, 50.0);
+    double p90 = getPercentile(result.latencyUs, 90.0);
+    double p99 = getPercentile(result.latencyUs, 99.0);
+    double pMax = getPercentile(result.latencyUs, 100.0);
+
+    if (csv)
+    {
+        std::cout << result.format.toStdString() << "," << result.numFrames << "," << fps << ",";
+        std::cout << feedFps << "," << p50 << "," << p90 << "," << p99 << "," << pMax << ",";
+        std::cout << result.finishSec << "," << result.peakMemoryMB << "," << mbWritten << ",";
+        std::cout << mbPerSec << "," << result.numSkipped << "," << result.numErrors << std::endl;
+        return;
+    }
+
+    std::cout << result.format.toStdString() << ": " << fps << " fps (fed at " << feedFps << " fps), ";
+    std::cout << "addFrame p50/p90/p99/max " << p50 << "/" << p90 << "/" << p99 << "/" << pMax << " us, ";
+    std::cout << "finish " << result.finishSec << " s, ";
+    std::cout << "peak mem +" << result.peakMemoryMB << " MB, ";
+    std::cout << mbWritten << " MB written (" << mbPerSec << " MB/s), ";
+    std::cout << "skipped " << result.numSkipped;
+    if (result.numErrors > 0)
+    {
+        std::cout << ", errors " << result.numErrors;
+    }
+    std::cout << std::endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("bench_video_writer");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Throughput benchmark for the BIAS video writers");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(
+        QStringList() << "f" << "formats",
+        QString("Comma separated writers to run: bmp, jpg, avi, fmf, ufmf, mkv (default %1)").arg(DEFAULT_FORMATS),
+        QString("formats"), DEFAULT_FORMATS));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "i" << "in-video",
+        QString("Read frames from <in-video-file> instead of generating them"),
+        QString("in-video-file")));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "n" << "frames",
+        QString("Number of frames given to each writer (default %1)").arg(DEFAULT_NUM_FRAMES),
+        QString("frames"), QString::number(DEFAULT_NUM_FRAMES)));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "u" << "unique",
+        QString("Number of distinct frames loaded or generated and cycled (default %1)").arg(DEFAULT_NUM_UNIQUE),
+        QString("unique"), QString::number(DEFAULT_NUM_UNIQUE)));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "r" << "rate",
+        QString("Target frame rate in frames/s, 0 for as fast as possible (default 0)"),
+        QString("rate"), QString("0")));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "o" << "output",
+        QString("Output directory (default %1)").arg(DEFAULT_OUTPUT_DIR),
+        QString("output-dir"), DEFAULT_OUTPUT_DIR));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "width",
+        QString("Synthetic frame width (default %1)").arg(DEFAULT_WIDTH),
+        QString("width"), QString::number(DEFAULT_WIDTH)));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "height",
+        QString("Synthetic frame height (default %1)").arg(DEFAULT_HEIGHT),
+        QString("height"), QString::number(DEFAULT_HEIGHT)));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "blobs",
+        QString("Number of moving blobs in synthetic frames (default %1)").arg(DEFAULT_NUM_BLOBS),
+        QString("blobs"), QString::number(DEFAULT_NUM_BLOBS)));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "blob-size",
+        QString("Blob half length in pixels (default %1)").arg(DEFAULT_BLOB_SIZE),
+        QString("pixels"), QString::number(DEFAULT_BLOB_SIZE)));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "threads",
+        QString("Compression/encoder threads for bmp, jpg, ufmf and mkv (default: writer defaults)"),
+        QString("threads")));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "csv",
+        QString("Print results as comma separated values")));
+    parser.addOption(QCommandLineOption(
+        QStringList() << "keep",
+        QString("Keep the files written")));
+    parser.process(app);
+
+    QStringList formatList = parser.value("formats").split(",", QString::SkipEmptyParts);
+    unsigned int numFrames = parser.value("frames").toUInt();
+    unsigned int numUnique = std::max(parser.value("unique").toUInt(), 1u);
+    double frameRate = std::max(parser.value("rate").toDouble(), 0.0);
+    bool csv = parser.isSet("csv");
+
+    QStringList allowedFormats;
+    allowedFormats << "bmp" << "jpg" << "avi" << "fmf" << "ufmf" << "mkv";
+    for (QString format : formatList)
+    {
+        if (!allowedFormats.contains(format))
+        {
+            std::cerr << "unknown format " << format.toStdString() << std::endl;
+            return 1;
+        }
+    }
+
+    VideoWriterParams params;
+    if (parser.isSet("threads"))
+    {
+        unsigned int numThreads = std::max(parser.value("threads").toUInt(), 1u);
+        params.bmp.numberOfCompressors = numThreads;
+        params.jpg.numberOfCompressors = numThreads;
+        params.ufmf.numberOfCompressors = numThreads;
+        params.ffmpeg.numberOfThreads = numThreads;
+    }
+
+    std::vector<cv::Mat> frames;
+    if (parser.isSet("in-video"))
+    {
+        frames = loadFrames(parser.value("in-video").toStdString(), numUnique);
+    }
+    else
+    {
+        // Static background with blobs on closed paths so that cycling the
+        // frames looks like continuous motion to the ufmf background model.
+        SyntheticFrameParams frameParams;
+        frameParams.numCol = parser.value("width").toInt();
+        frameParams.numRow = parser.value("height").toInt();
+        frameParams.numBlobs = parser.value("blobs").toUInt();
+        frameParams.blobSize = parser.value("blob-size").toUInt();
+        frameParams.staticNoise = true;
+        frameParams.closedPaths = true;
+        frames = syntheticFrames(numUnique, frameParams);
+    }
+    if (frames.empty() || frames[0].empty())
+    {
+        std::cerr << "no frames to write" << std::endl;
+        return 1;
+    }
+
+    QString outputDirName = parser.value("output");
+    QDir outputDir(outputDirName);
+    if (!outputDir.exists() && !QDir().mkpath(outputDirName))
+    {
+        std::cerr << "unable to create output directory " << outputDirName.toStdString() << std::endl;
+        return 1;
+    }
+    outputDir = QDir(QFileInfo(outputDirName).absoluteFilePath());
+
+    if (csv)
+    {
+        std::cout << "format,frames,fps,feed_fps,latency_p50_us,latency_p90_us,latency_p99_us,";
+        std::cout << "latency_max_us,finish_s,peak_memory_mb,mb_written,mb_per_s,skipped,errors" << std::endl;
+    }
+    else
+    {
+        std::cout << "frames: " << numFrames << " (" << frames.size() << " unique), size: ";
+        std::cout << frames[0].cols << "x" << frames[0].rows << ", rate: ";
+        if (frameRate > 0.0)
+        {
+            std::cout << frameRate << " fps";
+        }
+        else
+        {
+            std::cout << "unpaced";
+        }
+        std::cout << ", output: " << outputDir.absolutePath().toStdString() << std::endl;
+    }
+
+    bool ok = true;
+    for (QString format : formatList)
+    {
+        BenchResult result = runWriter(format, params, frames, numFrames, frameRate, outputDir);
+        printResult(result, csv);
+        if ((result.numErrors > 0) || ((frameRate > 0.0) && (result.numSkipped > 0)))
+        {
+            ok = false;
+        }
+        if (!parser.isSet("keep"))
+        {
+            QDir(outputDir.absoluteFilePath(format)).removeRecursively();
+        }
+    }
+    return ok ? 0 : 1;
+}
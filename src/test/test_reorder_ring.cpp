@@ -0,0 +1,273 @@
+// Stress test for ReorderRingBuffer (lockable.hpp).
+//
+// Usage: test_reorder_ring [num_frames] [num_workers] [ring_capacity] [frame_period_us]
+//
+// Mimics the way the multi-threaded video writers use the ring. The main thread
+// plays the writer: for each frame it reserves a sequence number, hands the
+// frame to a pool of worker threads through a LockableQueue and then drains
+// whatever is ready from the ring. Workers hold frames for random amounts of
+// time so they finish out of order, and randomly drop frames by marking them
+// skipped. The writer also drops frames when its queue is full (marked skipped)
+// and when the ring is full (no sequence number handed out). Checks that frames
+// come out of the ring strictly in order, that every reserved sequence number
+// comes out exactly once and that payloads arrive intact. At the end the writer
+// blocks on the ring until the frames still in flight are delivered - a
+// delivery which fails to wake it shows up as a wait timeout.
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+
+#include "lockable.hpp"
+
+using namespace bias;
+
+const unsigned long DEFAULT_NUM_FRAMES = 100000;
+const unsigned int DEFAULT_FRAME_PERIOD_US = 10;
+const unsigned int DEFAULT_NUM_WORKERS = 8;
+const unsigned int DEFAULT_RING_CAPACITY = 64;
+const unsigned int TODO_MAX_QUEUE_SIZE = 48;
+const unsigned int WORKER_DROP_PERCENT = 2;
+const unsigned int WORKER_DELAY_PERCENT = 5;
+const unsigned int WORKER_MAX_DELAY_US = 200;
+const unsigned long DRAIN_WAIT_TIMEOUT_MS = 1000;
+
+
+struct TestFrame
+{
+    unsigned long frameCount;
+    size_t sequence;
+    std::shared_ptr<std::vector<unsigned long>> dataPtr;
+
+    TestFrame() : frameCount(0), sequence(0) {};
+};
+
+typedef LockableQueue<TestFrame> TestFrameQueue;
+
+
+void workerLoop(
+        unsigned int id,
+        TestFrameQueue &toDoQueue,
+        ReorderRingBuffer<TestFrame> &ring,
+        std::atomic<bool> &stopped
+        )
+{
+    std::mt19937 rng(1234 + id);
+    std::uniform_int_distribution<unsigned int> percent(0,99);
+    std::uniform_int_distribution<unsigned int> delay(0,WORKER_MAX_DELAY_US);
+
+    while (true)
+    {
+        TestFrame frame;
+        bool haveFrame = false;
+
+        toDoQueue.acquireLock();
+        if (!stopped.load())
+        {
+            toDoQueue.waitIfEmpty();
+        }
+        if (!toDoQueue.empty())
+        {
+            frame = toDoQueue.front();
+            toDoQueue.pop();
+            haveFrame = true;
+        }
+        toDoQueue.releaseLock();
+
+        if (!haveFrame)
+        {
+            if (stopped.load())
+            {
+                return;
+            }
+            continue;
+        }
+
+        if (percent(rng) < WORKER_DELAY_PERCENT)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(delay(rng)));
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+
+        if (percent(rng) < WORKER_DROP_PERCENT)
+        {
+            ring.markSkipped(frame.sequence);
+        }
+        else
+        {
+            // "Process" the frame
+            frame.dataPtr = std::make_shared<std::vector<unsigned long>>(16, frame.frameCount);
+            size_t sequence = frame.sequence;
+            ring.publish(sequence, std::move(frame));
+        }
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    unsigned long numFrames = (argc > 1) ? std::strtoul(argv[1],nullptr,10) : DEFAULT_NUM_FRAMES;
+    unsigned int numWorkers = (argc > 2) ? (unsigned int)(std::atoi(argv[2])) : DEFAULT_NUM_WORKERS;
+    unsigned int capacity = (argc > 3) ? (unsigned int)(std::atoi(argv[3])) : DEFAULT_RING_CAPACITY;
+    unsigned int framePeriodUs = (argc > 4) ? (unsigned int)(std::atoi(argv[4])) : DEFAULT_FRAME_PERIOD_US;
+
+    ReorderRingBuffer<TestFrame> ring(capacity);
+    TestFrameQueue toDoQueue;
+    std::atomic<bool> stopped(false);
+
+    std::cout << "frames: " << numFrames << ", workers: " << numWorkers;
+    std::cout << ", ring capacity: " << ring.capacity() << ", frame period: " << framePeriodUs << " us" << std::endl;
+
+    std::vector<std::thread> workers;
+    for (unsigned int i=0; i<numWorkers; i++)
+    {
+        workers.push_back(std::thread(workerLoop, i, std::ref(toDoQueue), std::ref(ring), std::ref(stopped)));
+    }
+
+    unsigned long numReserved = 0;
+    unsigned long numRingFull = 0;
+    unsigned long numQueueFull = 0;
+    unsigned long numWritten = 0;
+    unsigned long numSkipped = 0;
+    unsigned long numErrors = 0;
+    bool haveLastFrame = false;
+    unsigned long lastFrameCount = 0;
+    size_t expectedSequence = 0;
+
+    auto drain = [&]()
+    {
+        TestFrame frame;
+        bool skipped = false;
+        while (ring.tryPopNext(frame, skipped))
+        {
+            size_t sequence = expectedSequence;
+            expectedSequence++;
+            if (skipped)
+            {
+                numSkipped++;
+                continue;
+            }
+            bool dataOk = (frame.sequence == sequence);
+            dataOk = dataOk && (frame.dataPtr != nullptr) && (frame.dataPtr -> size() == 16);
+            if (dataOk)
+            {
+                for (auto value : *(frame.dataPtr))
+                {
+                    dataOk = dataOk && (value == frame.frameCount);
+                }
+            }
+            if (!dataOk || (haveLastFrame && (frame.frameCount <= lastFrameCount)))
+            {
+                numErrors++;
+            }
+            haveLastFrame = true;
+            lastFrameCount = frame.frameCount;
+            numWritten++;
+        }
+    };
+
+    auto startTime = std::chrono::steady_clock::now();
+    auto frameTime = startTime;
+
+    for (unsigned long frameCount=0; frameCount<numFrames; frameCount++)
+    {
+        // Frames arrive at a fixed rate as from a camera
+        frameTime += std::chrono::microseconds(framePeriodUs);
+        while (std::chrono::steady_clock::now() < frameTime)
+        {
+            std::this_thread::yield();
+        }
+
+        size_t sequence = 0;
+        if (!ring.reserve(sequence))
+        {
+            numRingFull++;
+        }
+        else
+        {
+            numReserved++;
+            TestFrame frame;
+            frame.frameCount = frameCount;
+            frame.sequence = sequence;
+
+            bool queueFull = false;
+            toDoQueue.acquireLock();
+            if (toDoQueue.size() < TODO_MAX_QUEUE_SIZE)
+            {
+                toDoQueue.push(frame);
+                toDoQueue.wakeOne();
+            }
+            else
+            {
+                queueFull = true;
+            }
+            toDoQueue.releaseLock();
+
+            if (queueFull)
+            {
+                ring.markSkipped(sequence);
+                numQueueFull++;
+            }
+        }
+        drain();
+    }
+
+    // Wait for everything in flight, sleeping on the ring between deliveries 
+    // as the writers' finish does
+    unsigned long numWaitTimeouts = 0;
+    while (ring.numOutstanding() > 0)
+    {
+        if (!ring.waitForNext(DRAIN_WAIT_TIMEOUT_MS))
+        {
+            numWaitTimeouts++;
+        }
+        drain();
+    }
+
+    stopped.store(true);
+    toDoQueue.acquireLock();
+    toDoQueue.signalNotEmpty();
+    toDoQueue.releaseLock();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    if (numWritten + numSkipped != numReserved)
+    {
+        numErrors++;
+    }
+    if ((ring.numReady() != 0) || (ring.nextSequence() != numReserved))
+    {
+        numErrors++;
+    }
+    if (numWaitTimeouts > 0)
+    {
+        numErrors++;
+    }
+
+    std::cout << "reserved:   " << numReserved << std::endl;
+    std::cout << "written:    " << numWritten << std::endl;
+    std::cout << "skipped:    " << numSkipped << " (queue full: " << numQueueFull << ")" << std::endl;
+    std::cout << "ring full:  " << numRingFull << std::endl;
+    std::cout << "wait timeouts: " << numWaitTimeouts << std::endl;
+    std::cout << "rate:       " << double(numFrames)/dt << " frames/s" << std::endl;
+    std::cout << "errors:     " << numErrors << std::endl;
+
+    if (numErrors > 0)
+    {
+        std::cout << "FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << "PASSED" << std::endl;
+    return 0;
+}
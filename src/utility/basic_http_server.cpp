@@ -1,191 +1,186 @@
 #include "basic_http_server.hpp"
 #include <QMap>
+#include <QThread>
 #include <QTcpSocket>
+#include <QHostAddress>
 #include <QStringList>
 #include <QDateTime>
 #include <QVariantList>
 #include <iostream>
-//#include "camera_window.hpp"
 #include "json.hpp"
 
 namespace bias
 {
     // Constants
     // ------------------------------------------------------------------------
-    static QMap<QString,QString> createEscapeToCharMap()
+    const int BasicHttpServer::MAX_HEADER_SIZE = 64*1024;
+    const int BasicHttpServer::MAX_BODY_SIZE = 16*1024*1024;
+
+
+    HttpRequest::HttpRequest()
     {
-        QMap<QString,QString> map;
-        map[QString("%20")] = QString(" ");
-        map[QString("%24")] = QString("$");
-        map[QString("%26")] = QString("&");
-        map[QString("%60")] = QString("`");
-        map[QString("%3A")] = QString(":");
-        map[QString("%3C")] = QString("<");
-        map[QString("%3E")] = QString(">");
-        map[QString("%5B")] = QString("[");
-        map[QString("%5D")] = QString("]");
-        map[QString("%7B")] = QString("{");
-        map[QString("%7D")] = QString("}");
-        map[QString("%22")] = QString("\"");
-        map[QString("%23")] = QString("#");
-        map[QString("%25")] = QString("%");
-        map[QString("%40")] = QString("@");
-        map[QString("%2F")] = QString("/");
-        map[QString("%3B")] = QString(";");
-        map[QString("%3D")] = QString("=");
-        map[QString("%3F")] = QString("?");
-        map[QString("%5C")] = QString("\\"); 
-        map[QString("%5E")] = QString("^");
-        map[QString("%7C")] = QString("|");
-        map[QString("%7E")] = QString("~"); 
-        map[QString("%27")] = QString("'");
-        map[QString("%5C")] = QString("\\"); 
-        map[QString("%2C")] = QString(",");
-        return map;
+        keepAlive = false;
     }
-    QMap<QString,QString> ESCAPE_TO_CHAR_MAP = createEscapeToCharMap();
 
 
     // Methods - public
     // -------------------------------------------------------------------------
     BasicHttpServer::BasicHttpServer(QObject *parent)
         : QTcpServer(parent)
-    { 
+    {
+        threadPtr_ = NULL;
+        nextConnectionId_ = 0;
+        qRegisterMetaType<HttpCommandList>();
+        qRegisterMetaType<HttpCommandList>("HttpCommandList");
     }
 
-    void BasicHttpServer::incomingConnection(qintptr socket) 
-    { 
-        QTcpSocket* s = new QTcpSocket(this); 
+
+    void BasicHttpServer::incomingConnection(qintptr socket)
+    {
+        quint64 connectionId = nextConnectionId_++;
+
+        QTcpSocket* s = new QTcpSocket(this);
+        s -> setProperty("connectionId", connectionId);
         connect(s, SIGNAL(readyRead()), this, SLOT(readClient()));
         connect(s, SIGNAL(disconnected()), this, SLOT(discardClient()));
         s->setSocketDescriptor(socket);
-    }
 
+        // Responses are small and clients wait on each one
+        s -> setSocketOption(QAbstractSocket::LowDelayOption, 1);
 
-    // Protected methods
-    // ------------------------------------------------------------------------
-    void BasicHttpServer::handleGetRequest(QTcpSocket *socketPtr, QStringList &tokens)
-    { 
-        QTextStream os(socketPtr);
-        os.setAutoDetectUnicode(true);
+        Connection connection;
+        connection.socketPtr = s;
+        connection.keepAlive = false;
+        connection.busy = false;
+        connection.processing = false;
+        connection.continueSent = false;
+        connection.closing = false;
+        connectionMap_.insert(connectionId, connection);
+    }
 
-        // Examine tokens
-        if (tokens.size() < 2)
+
+    void BasicHttpServer::startThread()
+    {
+        if (threadPtr_ != NULL)
         {
-            sendBadRequestResp(os,"not enought tokens");
             return;
         }
+        threadPtr_ = new QThread();
+        moveToThread(threadPtr_);
+        connect(threadPtr_, SIGNAL(finished()), this, SLOT(deleteLater()));
+        threadPtr_ -> start();
+    }
 
-        // Parse tokens
-        QString paramsString = tokens[1];
-        paramsString = replaceEscapeChars(paramsString);
 
-        if (paramsString.length() == 1)
+    void BasicHttpServer::stopThread()
+    {
+        // The server, and its connections, are deleted as the thread finishes
+        QThread *threadPtr = threadPtr_;
+        if (threadPtr == NULL)
         {
-            sendRunningResp(os);
             return;
         }
-        else if (paramsString.length() > 1)
+        threadPtr -> quit();
+        threadPtr -> wait();
+        delete threadPtr;
+    }
+
+
+    void BasicHttpServer::startListening(quint16 port)
+    {
+        QMetaObject::invokeMethod(this, "onStartListening", Qt::QueuedConnection, Q_ARG(quint16, port));
+    }
+
+
+    void BasicHttpServer::stopListening()
+    {
+        QMetaObject::invokeMethod(this, "onStopListening", Qt::QueuedConnection);
+    }
+
+
+    // Protected methods
+    // ------------------------------------------------------------------------
+    void BasicHttpServer::handleRequest(quint64 connectionId, const HttpRequest &request)
+    {
+        HttpCommandList cmdList;
+
+        if (request.method == "GET")
         {
-            // Check for request parameters character '?'
-            QChar secondChar = paramsString[1];
-            if (secondChar != QChar('?'))
+            if (request.query.isEmpty())
             {
-                sendBadRequestResp(os, "no ? character preceeding parameters");
+                if (request.path == QString("/"))
+                {
+                    sendRunningResp(connectionId);
+                }
+                else if (!handlePathRequest(connectionId, request.path))
+                {
+                    sendBadRequestResp(connectionId, "no ? character preceeding parameters");
+                }
                 return;
             }
-
-            paramsString.remove(0,2);
-            QStringList paramsList = paramsString.split("&",QString::SkipEmptyParts);
-            if (!paramsList.isEmpty())
+            if (request.path != QString("/"))
             {
-                // We have some parameters - send appropriate response
-                handleParamsRequest(os, paramsList);
+                sendBadRequestResp(connectionId, "parameters must follow /?");
                 return;
             }
-            else
+            cmdList = parseQueryCommands(request.query);
+            if (cmdList.isEmpty())
             {
-                // No parameters follow '?' character
-                sendBadRequestResp(os,"not parameters following ? char");
+                sendBadRequestResp(connectionId, "not parameters following ? char");
                 return;
             }
         }
-    }
-    
-
-    void BasicHttpServer::handleParamsRequest(QTextStream &os, QStringList &paramsList)
-    { 
-        os << "HTTP/1.0 200 Ok\r\n";
-        os << "Content-Type: application/json; charset=\"utf-8\"\r\n\r\n";
-
-        // Handle requests
-        QVariantList respList;
-        QVariantMap cmdMap;
-        for (unsigned int i=0; i<paramsList.size(); i++)
+        else if (request.method == "POST")
         {
-            QString name;
-            QString value;
-
-            QStringList parts = paramsList[i].split("=",QString::SkipEmptyParts);
-            if (parts.size() == 0)
-            {
-                // Nothing here - just skip it
-                continue;
-            }
-            name = parts[0];
-
-            if (parts.size() == 1)
+            QByteArray contentType = request.headers.value("content-type");
+            if (contentType.startsWith("application/x-www-form-urlencoded"))
             {
-                // Just command name 
-                cmdMap = paramsRequestSwitchYard(name, QString(""));
+                cmdList = parseQueryCommands(request.body);
             }
-            else if (parts.size() == 2)
+            else
             {
-                // Command name + parameters
-                cmdMap = paramsRequestSwitchYard(name,parts[1]);
+                bool ok = false;
+                QString errorMsg;
+                cmdList = parseJsonCommands(request.body, ok, errorMsg);
+                if (!ok)
+                {
+                    sendBadRequestResp(connectionId, errorMsg);
+                    return;
+                }
             }
-            else
+            if (cmdList.isEmpty())
             {
-                // Error unable to parse command
-                cmdMap = QVariantMap();
-                cmdMap.insert("success", false);
-                cmdMap.insert("message", "unable to parse command");
+                sendBadRequestResp(connectionId, "no commands in request body");
+                return;
             }
-            //respMap.insert(name,cmdMap);
-            respList.append(cmdMap);
+        }
+        else
+        {
+            sendBadRequestResp(connectionId, QString("unsupported method ") + QString(request.method));
+            return;
         }
 
-        // Send response
-        bool ok;
-        //QByteArray jsonResp = QtJson::serialize(respMap,ok);
-        QByteArray jsonResp = QtJson::serialize(respList,ok);
-        os << QString(jsonResp) << "\n";
+        handleCommandRequest(connectionId, cmdList);
     }
 
 
-    void BasicHttpServer::sendBadRequestResp(QTextStream &os, QString msg)
-    { 
-        os << "HTTP/1.0 400 Bad Request\r\n";
-        os << "Content-Type: text/html; charset=\"utf-8\"\r\n\r\n";
-        os << "<html>\n";
-        os << "<body>\n";
-        os << "<h1>BIAS External Control Server</h1>\n";
-        os << "Bad request: " << msg << "\n";
-        os << "</body>\n";
-        os << "</html>\n";
+    void BasicHttpServer::handleCommandRequest(quint64 connectionId, const HttpCommandList &cmdList)
+    {
+        // Handle requests
+        QVariantList respList;
+        for (int i=0; i<cmdList.size(); i++)
+        {
+            respList.append(paramsRequestSwitchYard(cmdList[i].name, cmdList[i].value));
+        }
+        sendCommandResp(connectionId, respList);
     }
 
 
-    void BasicHttpServer::sendRunningResp(QTextStream &os)
-    { 
-        os << "HTTP/1.0 200 Ok\r\n";
-        os << "Content-Type: text/html; charset=\"utf-8\"\r\n\r\n";
-        os << "<html>\n";
-        os << "<body>\n";
-        os << "<h1>BIAS Server Running</h1>\n";
-        os << QDateTime::currentDateTime().toString() << "\n";
-        os << "</body>\n";
-        os << "</html>\n";
+    bool BasicHttpServer::handlePathRequest(quint64 connectionId, QString path)
+    {
+        // Requests for a path rather than parameters, e.g. "/metrics". Returns
+        // true if the path was handled and a response sent.
+        return false;
     }
 
 
@@ -200,72 +195,424 @@ namespace bias
     }
 
 
+    void BasicHttpServer::sendResponse(
+            quint64 connectionId,
+            int statusCode,
+            QByteArray reason,
+            QByteArray contentType,
+            QByteArray body
+            )
+    {
+        QMap<quint64, Connection>::iterator it = connectionMap_.find(connectionId);
+        if ((it == connectionMap_.end()) || it.value().closing)
+        {
+            // Client has gone away
+            return;
+        }
+        Connection &connection = it.value();
+
+        QByteArray version = connection.version.isEmpty() ? QByteArray("HTTP/1.1") : connection.version;
+        QByteArray resp;
+        resp += version + " " + QByteArray::number(statusCode) + " " + reason + "\r\n";
+        resp += "Content-Type: " + contentType + "\r\n";
+        resp += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+        if (connection.keepAlive)
+        {
+            resp += "Connection: keep-alive\r\n\r\n";
+        }
+        else
+        {
+            resp += "Connection: close\r\n\r\n";
+        }
+        resp += body;
+
+        // Send headers and body in a single write
+        connection.socketPtr -> write(resp);
+        connection.busy = false;
+
+        if (!connection.keepAlive)
+        {
+            connection.closing = true;
+            connection.socketPtr -> disconnectFromHost();
+            return;
+        }
+
+        // Answer any requests which arrived while waiting on this one
+        if ((!connection.processing) && (!connection.buffer.isEmpty()))
+        {
+            processBuffer(connectionId);
+        }
+    }
+
+
+    void BasicHttpServer::sendCommandResp(quint64 connectionId, QVariantList respList)
+    {
+        bool ok;
+        QByteArray jsonResp = QtJson::serialize(respList,ok);
+        jsonResp += "\n";
+        sendResponse(connectionId, 200, "Ok", "application/json; charset=\"utf-8\"", jsonResp);
+    }
+
+
+    void BasicHttpServer::sendBadRequestResp(quint64 connectionId, QString msg)
+    {
+        QString html;
+        html += "<html>\n";
+        html += "<body>\n";
+        html += "<h1>BIAS External Control Server</h1>\n";
+        html += "Bad request: " + msg + "\n";
+        html += "</body>\n";
+        html += "</html>\n";
+        sendResponse(connectionId, 400, "Bad Request", "text/html; charset=\"utf-8\"", html.toUtf8());
+    }
+
+
+    void BasicHttpServer::sendRunningResp(quint64 connectionId)
+    {
+        QString html;
+        html += "<html>\n";
+        html += "<body>\n";
+        html += "<h1>BIAS Server Running</h1>\n";
+        html += QDateTime::currentDateTime().toString() + "\n";
+        html += "</body>\n";
+        html += "</html>\n";
+        sendResponse(connectionId, 200, "Ok", "text/html; charset=\"utf-8\"", html.toUtf8());
+    }
+
+
+    void BasicHttpServer::flushConnection(quint64 connectionId)
+    {
+        QMap<quint64, Connection>::iterator it = connectionMap_.find(connectionId);
+        if (it != connectionMap_.end())
+        {
+            it.value().socketPtr -> flush();
+        }
+    }
+
+
     // Protected slots
     // ------------------------------------------------------------------------
     void BasicHttpServer::readClient()
     {
-        QTcpSocket* socketPtr = (QTcpSocket*) sender();
-        if (socketPtr->canReadLine()) 
+        QTcpSocket* socketPtr = qobject_cast<QTcpSocket*>(sender());
+        if (socketPtr == NULL)
+        {
+            return;
+        }
+        quint64 connectionId = socketPtr -> property("connectionId").toULongLong();
+        QMap<quint64, Connection>::iterator it = connectionMap_.find(connectionId);
+        if (it == connectionMap_.end())
+        {
+            return;
+        }
+        it.value().buffer.append(socketPtr -> readAll());
+        processBuffer(connectionId);
+    }
+
+
+    void BasicHttpServer::discardClient()
+    {
+        QTcpSocket* socketPtr = qobject_cast<QTcpSocket*>(sender());
+        if (socketPtr == NULL)
+        {
+            return;
+        }
+        connectionMap_.remove(socketPtr -> property("connectionId").toULongLong());
+        socketPtr->deleteLater();
+    }
+
+
+    // Private slots
+    // ------------------------------------------------------------------------
+    void BasicHttpServer::onStartListening(quint16 port)
+    {
+        if (isListening())
         {
-            QString requestString = QString(socketPtr->readLine());
-            QStringList tokens = splitRequestString(requestString);
-            if (!tokens.isEmpty()) 
+            if (serverPort() == port)
             {
-                if (tokens[0] == "GET") 
+                return;
+            }
+            close();
+        }
+        if (!listen(QHostAddress::Any, port))
+        {
+            std::cerr << "http server unable to listen on port " << port << ": ";
+            std::cerr << errorString().toStdString() << std::endl;
+        }
+    }
+
+
+    void BasicHttpServer::onStopListening()
+    {
+        // Stops accepting connections - open connections are left to the
+        // clients to close, which also lets a command which disabled the
+        // server be answered.
+        close();
+    }
+
+
+    // Private methods
+    // ------------------------------------------------------------------------
+    void BasicHttpServer::processBuffer(quint64 connectionId)
+    {
+        // Requests are answered one at a time and in order. The connection is
+        // looked up on each pass as sending a response may remove it.
+        while (true)
+        {
+            QMap<quint64, Connection>::iterator it = connectionMap_.find(connectionId);
+            if (it == connectionMap_.end())
+            {
+                return;
+            }
+            Connection &connection = it.value();
+            if (connection.busy || connection.processing || connection.closing)
+            {
+                return;
+            }
+
+            HttpRequest request;
+            QString errorMsg;
+            if (!parseRequest(connection, request, errorMsg))
+            {
+                if (!errorMsg.isEmpty())
                 {
-                    handleGetRequest(socketPtr, tokens);
-                } 
+                    connection.busy = true;
+                    connection.keepAlive = false;
+                    sendBadRequestResp(connectionId, errorMsg);
+                }
+                return;
             }
-            socketPtr -> close();
-            if (socketPtr -> state() == QTcpSocket::UnconnectedState)
+
+            connection.busy = true;
+            connection.processing = true;
+            connection.version = request.version;
+            connection.keepAlive = request.keepAlive;
+            handleRequest(connectionId, request);
+
+            it = connectionMap_.find(connectionId);
+            if (it == connectionMap_.end())
             {
-                delete socketPtr;
+                return;
             }
-        } 
+            it.value().processing = false;
+        }
     }
 
 
-    void BasicHttpServer::discardClient()
+    bool BasicHttpServer::parseRequest(Connection &connection, HttpRequest &request, QString &errorMsg)
     {
-        QTcpSocket* socketPtr = (QTcpSocket*)sender(); 
-        socketPtr->deleteLater();
+        // Returns true and removes the request from the connection's buffer
+        // if a complete request has been received. Returns false, with an
+        // error message if the request is malformed, otherwise.
+        QByteArray &buffer = connection.buffer;
+
+        // Ignore empty lines before the request line
+        int start = 0;
+        while ((start < buffer.size()) && ((buffer[start] == '\r') || (buffer[start] == '\n')))
+        {
+            start++;
+        }
+        if (start > 0)
+        {
+            buffer.remove(0,start);
+        }
+
+        int headerEnd = buffer.indexOf("\r\n\r\n");
+        int separatorSize = 4;
+        int lfHeaderEnd = buffer.indexOf("\n\n");
+        if ((lfHeaderEnd != -1) && ((headerEnd == -1) || (lfHeaderEnd < headerEnd)))
+        {
+            headerEnd = lfHeaderEnd;
+            separatorSize = 2;
+        }
+        if (headerEnd == -1)
+        {
+            if (buffer.size() > MAX_HEADER_SIZE)
+            {
+                errorMsg = QString("request header too large");
+            }
+            return false;
+        }
+
+        QList<QByteArray> lineList = buffer.left(headerEnd).split('\n');
+        QList<QByteArray> tokens = lineList[0].trimmed().split(' ');
+        if ((tokens.size() != 3) || (!tokens[2].startsWith("HTTP/")))
+        {
+            errorMsg = QString("malformed request line");
+            return false;
+        }
+        request.method = tokens[0];
+        request.version = tokens[2];
+
+        QByteArray target = tokens[1];
+        int queryPos = target.indexOf('?');
+        if (queryPos != -1)
+        {
+            request.path = decodeUrlComponent(target.left(queryPos));
+            request.query = target.mid(queryPos+1);
+        }
+        else
+        {
+            request.path = decodeUrlComponent(target);
+        }
+
+        for (int i=1; i<lineList.size(); i++)
+        {
+            QByteArray line = lineList[i];
+            int colonPos = line.indexOf(':');
+            if (colonPos <= 0)
+            {
+                continue;
+            }
+            QByteArray name = line.left(colonPos).trimmed().toLower();
+            QByteArray value = line.mid(colonPos+1).trimmed();
+            request.headers.insert(name, value);
+        }
+
+        if (request.headers.contains("transfer-encoding"))
+        {
+            errorMsg = QString("transfer encoding not supported, send Content-Length");
+            return false;
+        }
+
+        int contentLength = 0;
+        if (request.headers.contains("content-length"))
+        {
+            bool ok = false;
+            contentLength = request.headers.value("content-length").toInt(&ok);
+            if ((!ok) || (contentLength < 0) || (contentLength > MAX_BODY_SIZE))
+            {
+                errorMsg = QString("invalid Content-Length");
+                return false;
+            }
+        }
+
+        int requestSize = headerEnd + separatorSize + contentLength;
+        if (buffer.size() < requestSize)
+        {
+            // Clients which wait before sending the body, e.g. curl for large
+            // POST requests, wait for 100 Continue
+            QByteArray expect = request.headers.value("expect").toLower();
+            if ((expect == "100-continue") && (!connection.continueSent))
+            {
+                connection.socketPtr -> write(request.version + " 100 Continue\r\n\r\n");
+                connection.continueSent = true;
+            }
+            return false;
+        }
+
+        request.body = buffer.mid(headerEnd + separatorSize, contentLength);
+        buffer.remove(0, requestSize);
+        connection.continueSent = false;
+
+        QByteArray connectionHeader = request.headers.value("connection").toLower();
+        if (request.version == "HTTP/1.0")
+        {
+            request.keepAlive = connectionHeader.contains("keep-alive");
+        }
+        else
+        {
+            request.keepAlive = !connectionHeader.contains("close");
+        }
+        return true;
     }
 
 
     // Utility functions
     // ------------------------------------------------------------------------
-    QStringList splitRequestString(QString reqString)
+    HttpCommandList parseQueryCommands(QByteArray query)
     {
-        QStringList reqList;
-        if (reqString.isEmpty())
-        {
-            return reqList;
-        }
-        int len = reqString.length();
-        int n0 = reqString.indexOf(' ');
-        int n1 = reqString.lastIndexOf(' ');
-        if ((n0 == -1) || (n1 == -1) || (n0==n1))
+        // Commands are separated by '&' and the value, if any, follows the
+        // first '='. Names and values are url decoded after they are split
+        // so encoded '&' and '=' may be used in values. A '+' is left as is
+        // rather than decoded as a space.
+        HttpCommandList cmdList;
+        QList<QByteArray> paramsList = query.split('&');
+        for (int i=0; i<paramsList.size(); i++)
         {
-            return reqList;
+            QByteArray param = paramsList[i];
+            if (param.isEmpty())
+            {
+                continue;
+            }
+            HttpCommand cmd;
+            int equalsPos = param.indexOf('=');
+            if (equalsPos == -1)
+            {
+                cmd.name = decodeUrlComponent(param);
+            }
+            else
+            {
+                cmd.name = decodeUrlComponent(param.left(equalsPos));
+                cmd.value = decodeUrlComponent(param.mid(equalsPos+1));
+            }
+            if (!cmd.name.isEmpty())
+            {
+                cmdList.append(cmd);
+            }
         }
-        QString token0 = reqString.left(n0); 
-        QString token1 = reqString.mid(n0+1,n1-n0-1).trimmed();
-        QString token2 = reqString.right(len-n1-1);
-        reqList.append(token0);
-        reqList.append(token1);
-        reqList.append(token2);
-        return reqList;
+        return cmdList;
     }
 
-    QString replaceEscapeChars(QString input)
+
+    HttpCommandList parseJsonCommands(QByteArray json, bool &ok, QString &errorMsg)
     {
-        QString output(input);
-        QMap<QString,QString>::iterator it;
-        for (it=ESCAPE_TO_CHAR_MAP.begin(); it!=ESCAPE_TO_CHAR_MAP.end(); it++)
+        // A command object, {"command": name, "value": value}, or a list of
+        // them. Values which are objects or lists are passed on as json.
+        HttpCommandList cmdList;
+        QVariant data = QtJson::parse(QString::fromUtf8(json), ok);
+        if (!ok)
+        {
+            errorMsg = QString("unable to parse json body");
+            return cmdList;
+        }
+
+        QVariantList itemList;
+        if (data.type() == QVariant::List)
+        {
+            itemList = data.toList();
+        }
+        else
+        {
+            itemList.append(data);
+        }
+
+        for (int i=0; i<itemList.size(); i++)
         {
-            output.replace(it.key(), it.value());
+            if (itemList[i].type() != QVariant::Map)
+            {
+                ok = false;
+                errorMsg = QString("commands must be json objects");
+                return HttpCommandList();
+            }
+            QVariantMap itemMap = itemList[i].toMap();
+            if (!itemMap.contains("command"))
+            {
+                ok = false;
+                errorMsg = QString("command name not present");
+                return HttpCommandList();
+            }
+
+            HttpCommand cmd;
+            cmd.name = itemMap["command"].toString();
+            QVariant value = itemMap.value("value");
+            if ((value.type() == QVariant::Map) || (value.type() == QVariant::List))
+            {
+                cmd.value = QString::fromUtf8(QtJson::serialize(value));
+            }
+            else if (value.isValid() && !value.isNull())
+            {
+                cmd.value = value.toString();
+            }
+            cmdList.append(cmd);
         }
-        return output;
+        return cmdList;
+    }
+
+
+    QString decodeUrlComponent(QByteArray component)
+    {
+        return QString::fromUtf8(QByteArray::fromPercentEncoding(component));
     }
 
 } // namespace bias
@@ -5,41 +5,142 @@
 #include <QPointer>
 #include <QString>
 #include <QStringList>
-#include <QTextStream>
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QMetaType>
 #include <QVariantMap>
+#include <QVariantList>
 
-class QTcpSockect;
+class QTcpSocket;
+class QThread;
 
 namespace bias
 {
 
+    struct HttpRequest
+    {
+        QByteArray method;
+        QByteArray version;                     // e.g. "HTTP/1.1"
+        QString path;                           // decoded
+        QByteArray query;                       // still url encoded
+        QMap<QByteArray,QByteArray> headers;    // lower case names
+        QByteArray body;
+        bool keepAlive;
+
+        HttpRequest();
+    };
+
+
+    struct HttpCommand
+    {
+        QString name;
+        QString value;
+    };
+
+    typedef QList<HttpCommand> HttpCommandList;
+
 
     class BasicHttpServer : public QTcpServer
     {
+        // --------------------------------------------------------------------
+        // Minimal HTTP/1.1 server for the external control interface.
+        // Connections are kept alive, and pipelined requests answered in
+        // order, unless the client asks otherwise. Commands are given either
+        // in the query string of a GET request, e.g.
+        //
+        //   GET /?get-frame-count&set-video-file=/data/fly%2001
+        //
+        // or as a batch in the JSON body of a POST request, e.g.
+        //
+        //   [{"command": "get-frame-count"},
+        //    {"command": "set-configuration", "value": {...}}]
+        //
+        // and are answered with a JSON list of results, one per command, in
+        // the same order.
+        //
+        // The server may be run on its own thread with startThread. Responses
+        // may then be sent asynchronously: handleCommandRequest need not
+        // answer before it returns, and later requests on the connection
+        // wait until sendCommandResp is called for it.
+        // --------------------------------------------------------------------
 
         Q_OBJECT
 
         public:
+
+            static const int MAX_HEADER_SIZE;
+            static const int MAX_BODY_SIZE;
+
             BasicHttpServer(QObject *parent=0);
             virtual void incomingConnection(qintptr socket);
 
+            // Thread management - call from the thread which created the
+            // server. The server must not have a parent to be run on its own
+            // thread, it is deleted when the thread finishes.
+            void startThread();
+            void stopThread();
+
+            // Thread safe - the server listens, or stops, once its thread
+            // gets to the request.
+            void startListening(quint16 port);
+            void stopListening();
+
         protected:
-            virtual void handleGetRequest(QTcpSocket *socket, QStringList &tokens);
-            virtual void handleParamsRequest(QTextStream &os, QStringList &paramsList);
-            virtual void sendBadRequestResp(QTextStream &os, QString msg);
-            virtual void sendRunningResp(QTextStream &os);
+
+            virtual void handleRequest(quint64 connectionId, const HttpRequest &request);
+            virtual void handleCommandRequest(quint64 connectionId, const HttpCommandList &cmdList);
+            virtual bool handlePathRequest(quint64 connectionId, QString path);
             virtual QVariantMap paramsRequestSwitchYard(QString name, QString value);
 
+            void sendResponse(
+                    quint64 connectionId,
+                    int statusCode,
+                    QByteArray reason,
+                    QByteArray contentType,
+                    QByteArray body
+                    );
+            void sendCommandResp(quint64 connectionId, QVariantList respList);
+            void sendBadRequestResp(quint64 connectionId, QString msg);
+            void sendRunningResp(quint64 connectionId);
+            void flushConnection(quint64 connectionId);
+
         protected slots:
             virtual void readClient();
             virtual void discardClient();
-    };
 
-    QStringList splitRequestString(QString reqString);
-    QString replaceEscapeChars(QString input);
+        private slots:
+            void onStartListening(quint16 port);
+            void onStopListening();
+
+        private:
+
+            struct Connection
+            {
+                QTcpSocket *socketPtr;
+                QByteArray buffer;
+                QByteArray version;         // of the request being answered
+                bool keepAlive;             // ditto
+                bool busy;                  // waiting for a response
+                bool processing;            // in processBuffer
+                bool continueSent;          // 100 Continue sent for the request
+                bool closing;
+            };
+
+            QThread *threadPtr_;
+            quint64 nextConnectionId_;
+            QMap<quint64, Connection> connectionMap_;
+
+            void processBuffer(quint64 connectionId);
+            bool parseRequest(Connection &connection, HttpRequest &request, QString &errorMsg);
+    };
 
+    HttpCommandList parseQueryCommands(QByteArray query);
+    HttpCommandList parseJsonCommands(QByteArray json, bool &ok, QString &errorMsg);
+    QString decodeUrlComponent(QByteArray component);
 
 } // namespace bias
 
+Q_DECLARE_METATYPE(bias::HttpCommandList)
 
 #endif // #ifndef BIAS_BASIC_HTTP_SERVER_HPP
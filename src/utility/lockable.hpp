@@ -5,6 +5,12 @@
 #include <QWaitCondition>
 #include <queue>
 #include <set>
+#include <atomic>
+#include <memory>
+#include <climits>
+#include <cstddef>
+#include <utility>
+#include <chrono>
 
 namespace bias
 {
@@ -158,6 +164,475 @@ namespace bias
         QWaitCondition emptyWaitCond_;
     };
 
+    enum RingBufferOverflowPolicy
+    {
+        RING_BUFFER_BLOCK,        // producer waits until the consumer frees a slot
+        RING_BUFFER_DROP_OLDEST,  // oldest queued item is discarded to make room
+        RING_BUFFER_DROP_NEWEST   // item being pushed is discarded
+    };
+
+    const size_t RING_BUFFER_CACHE_LINE_SIZE = 64;
+
+
+    template <class T>
+    class SpscRingBuffer
+    {
+        // Bounded single-producer/single-consumer ring buffer. 
+        //
+        // Hand-off between producer and consumer is lock free. Each slot carries
+        // a sequence number so that, under RING_BUFFER_DROP_OLDEST, the producer 
+        // can safely claim and discard the oldest item as if it were a second 
+        // consumer. The mutex and wait conditions are only touched when a thread
+        // actually has to sleep (consumer on empty, producer on full with 
+        // RING_BUFFER_BLOCK).
+
+        public:
+
+            explicit SpscRingBuffer(
+                    size_t capacity, 
+                    RingBufferOverflowPolicy policy=RING_BUFFER_DROP_NEWEST
+                    ) 
+            {
+                capacity_ = 2;
+                while (capacity_ < capacity)
+                {
+                    capacity_ <<= 1;
+                }
+                mask_ = capacity_ - 1;
+                policy_ = policy;
+
+                slotPtr_ = std::unique_ptr<Slot[]>(new Slot[capacity_]);
+                for (size_t i=0; i<capacity_; i++)
+                {
+                    slotPtr_[i].sequence.store(i, std::memory_order_relaxed);
+                }
+                writePos_.store(0, std::memory_order_relaxed);
+                readPos_.store(0, std::memory_order_relaxed);
+                numDropped_.store(0, std::memory_order_relaxed);
+                consumerWaiting_.store(false);
+                producerWaiting_.store(false);
+            };
+
+            // Producer side
+            // ----------------------------------------------------------------
+
+            bool push(const T &item)
+            {
+                // Returns false if the item was not queued (RING_BUFFER_DROP_NEWEST). 
+                // Under RING_BUFFER_DROP_OLDEST the item is always queued, but the
+                // discarded item is still counted in numDropped().
+                size_t pos = writePos_.load(std::memory_order_relaxed);
+                Slot &slot = slotPtr_[pos & mask_];
+
+                while (slot.sequence.load(std::memory_order_acquire) != pos)
+                {
+                    switch (policy_)
+                    {
+                        case RING_BUFFER_DROP_NEWEST:
+                            numDropped_.fetch_add(1, std::memory_order_relaxed);
+                            return false;
+
+                        case RING_BUFFER_DROP_OLDEST:
+                            // Only discard if the slot is still occupied by the oldest 
+                            // item, otherwise the consumer is mid-pop and will free it.
+                            if (readPos_.load(std::memory_order_relaxed) + capacity_ == pos)
+                            {
+                                T discard;
+                                if (popInternal(discard))
+                                {
+                                    numDropped_.fetch_add(1, std::memory_order_relaxed);
+                                }
+                            }
+                            break;
+
+                        default:
+                            waitIfFull(pos);
+                            break;
+                    }
+                }
+
+                slot.value = item;
+                slot.sequence.store(pos+1, std::memory_order_release);
+                writePos_.store(pos+1, std::memory_order_release);
+
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (consumerWaiting_.load(std::memory_order_relaxed))
+                {
+                    signalNotEmpty();
+                }
+                return true;
+            }
+
+            // Consumer side
+            // ----------------------------------------------------------------
+
+            bool tryPop(T &item)
+            {
+                bool rtnVal = popInternal(item);
+                if (rtnVal && (policy_ == RING_BUFFER_BLOCK))
+                {
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (producerWaiting_.load(std::memory_order_relaxed))
+                    {
+                        signalNotFull();
+                    }
+                }
+                return rtnVal;
+            }
+
+            bool waitIfEmpty(unsigned long timeout=ULONG_MAX)
+            {
+                // Returns true if an item is available. May also return on 
+                // signalNotEmpty() or timeout with the buffer still empty.
+                if (!empty())
+                {
+                    return true;
+                }
+                waitMutex_.lock();
+                consumerWaiting_.store(true);
+                if (empty())
+                {
+                    notEmptyWaitCond_.wait(&waitMutex_, timeout);
+                }
+                consumerWaiting_.store(false);
+                waitMutex_.unlock();
+                return !empty();
+            }
+
+            void signalNotEmpty()
+            {
+                waitMutex_.lock();
+                notEmptyWaitCond_.wakeAll();
+                waitMutex_.unlock();
+            }
+
+            // Either side
+            // ----------------------------------------------------------------
+
+            void clear()
+            {
+                // Only call when producer and consumer threads are stopped.
+                T discard;
+                while (popInternal(discard)) {};
+            }
+
+            size_t size() const
+            {
+                size_t readPos = readPos_.load();
+                size_t writePos = writePos_.load();
+                size_t num = (writePos > readPos) ? (writePos - readPos) : 0;
+                return (num < capacity_) ? num : capacity_;
+            }
+
+            bool empty() const
+            {
+                return size() == 0;
+            }
+
+            size_t capacity() const
+            {
+                return capacity_;
+            }
+
+            RingBufferOverflowPolicy overflowPolicy() const
+            {
+                return policy_;
+            }
+
+            unsigned long numDropped() const
+            {
+                return numDropped_.load(std::memory_order_relaxed);
+            }
+
+        protected:
+
+            struct Slot
+            {
+                std::atomic<size_t> sequence;
+                T value;
+            };
+
+            // Indices written by the producer and consumer live on separate
+            // cache lines to avoid false sharing.
+            char padBegin_[RING_BUFFER_CACHE_LINE_SIZE];
+            std::atomic<size_t> writePos_;
+            char padWrite_[RING_BUFFER_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+            std::atomic<size_t> readPos_;
+            char padRead_[RING_BUFFER_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+            std::atomic<unsigned long> numDropped_;
+            std::atomic<bool> consumerWaiting_;
+            std::atomic<bool> producerWaiting_;
+            char padEnd_[RING_BUFFER_CACHE_LINE_SIZE];
+
+            size_t capacity_;
+            size_t mask_;
+            RingBufferOverflowPolicy policy_;
+            std::unique_ptr<Slot[]> slotPtr_;
+
+            QMutex waitMutex_;
+            QWaitCondition notEmptyWaitCond_;
+            QWaitCondition notFullWaitCond_;
+
+            bool popInternal(T &item)
+            {
+                size_t pos = readPos_.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    Slot &slot = slotPtr_[pos & mask_];
+                    size_t seq = slot.sequence.load(std::memory_order_acquire);
+                    if (seq == pos+1)
+                    {
+                        if (readPos_.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+                        {
+                            item = std::move(slot.value);
+                            slot.value = T();
+                            slot.sequence.store(pos+capacity_, std::memory_order_release);
+                            return true;
+                        }
+                    }
+                    else if (seq == pos)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = readPos_.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            void waitIfFull(size_t pos)
+            {
+                Slot &slot = slotPtr_[pos & mask_];
+                waitMutex_.lock();
+                producerWaiting_.store(true);
+                if (slot.sequence.load() != pos)
+                {
+                    notFullWaitCond_.wait(&waitMutex_, RING_BUFFER_FULL_WAIT_TIMEOUT);
+                }
+                producerWaiting_.store(false);
+                waitMutex_.unlock();
+            }
+
+            void signalNotFull()
+            {
+                waitMutex_.lock();
+                notFullWaitCond_.wakeAll();
+                waitMutex_.unlock();
+            }
+
+            static const unsigned long RING_BUFFER_FULL_WAIT_TIMEOUT = 10; // msec
+    };
+
+
+    template <class T>
+    class ReorderRingBuffer
+    {
+        // Sequence indexed buffer for restoring the order of items processed by
+        // a pool of worker threads.
+        //
+        // The owning thread reserves consecutive sequence numbers as it hands out
+        // work (reserve). Workers deliver each item, from any thread and in any 
+        // order, by publishing it or marking it as skipped in place in its slot 
+        // (slot = sequence mod capacity). The owning thread drains the items in 
+        // sequence order (tryPopNext). A sequence number is only handed out once
+        // its slot has been drained so delivery never waits and takes no lock.
+        // The owner can block until the next item is delivered (waitForNext) - 
+        // only then does delivery take a lock, to wake it.
+
+        public:
+
+            explicit ReorderRingBuffer(size_t capacity)
+            {
+                capacity_ = 2;
+                while (capacity_ < capacity)
+                {
+                    capacity_ <<= 1;
+                }
+                mask_ = capacity_ - 1;
+
+                slotPtr_ = std::unique_ptr<Slot[]>(new Slot[capacity_]);
+                for (size_t i=0; i<capacity_; i++)
+                {
+                    slotPtr_[i].sequence.store(i, std::memory_order_relaxed);
+                    slotPtr_[i].skipped = false;
+                }
+                reservePos_.store(0, std::memory_order_relaxed);
+                readPos_.store(0, std::memory_order_relaxed);
+                numReady_.store(0, std::memory_order_relaxed);
+                ownerWaiting_.store(false, std::memory_order_relaxed);
+            };
+
+            // Owner side
+            // ----------------------------------------------------------------
+
+            bool reserve(size_t &sequence)
+            {
+                // Returns false if the next slot has not been drained yet, i.e. 
+                // capacity items are already outstanding.
+                size_t pos = reservePos_.load(std::memory_order_relaxed);
+                Slot &slot = slotPtr_[pos & mask_];
+                if (slot.sequence.load(std::memory_order_acquire) != pos)
+                {
+                    return false;
+                }
+                sequence = pos;
+                reservePos_.store(pos+1, std::memory_order_release);
+                return true;
+            }
+
+            bool tryPopNext(T &item, bool &skipped)
+            {
+                // Returns false if the next item in sequence has not been delivered.
+                size_t pos = readPos_.load(std::memory_order_relaxed);
+                Slot &slot = slotPtr_[pos & mask_];
+                if (slot.sequence.load(std::memory_order_acquire) != pos+1)
+                {
+                    return false;
+                }
+                skipped = slot.skipped;
+                item = std::move(slot.value);
+                slot.value = T();
+                slot.sequence.store(pos+capacity_, std::memory_order_release);
+                readPos_.store(pos+1, std::memory_order_release);
+                numReady_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            bool waitForNext(unsigned long timeoutMs)
+            {
+                // Blocks until the next item in sequence has been delivered or
+                // timeoutMs has passed. Returns true if the item is ready to pop.
+                size_t pos = readPos_.load(std::memory_order_relaxed);
+                Slot &slot = slotPtr_[pos & mask_];
+                std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() 
+                    + std::chrono::milliseconds(timeoutMs);
+                waitMutex_.lock();
+                ownerWaiting_.store(true);
+                bool ready = (slot.sequence.load() == pos+1);
+                while (!ready)
+                {
+                    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                    if (now >= deadline)
+                    {
+                        break;
+                    }
+                    unsigned long waitMs = (unsigned long)(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                deadline - now).count()) + 1;
+                    nextWaitCond_.wait(&waitMutex_, waitMs);
+                    ready = (slot.sequence.load() == pos+1);
+                }
+                ownerWaiting_.store(false);
+                waitMutex_.unlock();
+                return ready;
+            }
+
+            void clear()
+            {
+                // Only call when worker threads are stopped. Drops everything 
+                // still outstanding and restarts the sequence at zero.
+                for (size_t i=0; i<capacity_; i++)
+                {
+                    slotPtr_[i].value = T();
+                    slotPtr_[i].skipped = false;
+                    slotPtr_[i].sequence.store(i, std::memory_order_relaxed);
+                }
+                reservePos_.store(0, std::memory_order_relaxed);
+                readPos_.store(0, std::memory_order_relaxed);
+                numReady_.store(0);
+            }
+
+            // Worker side
+            // ----------------------------------------------------------------
+
+            void publish(size_t sequence, T &&item)
+            {
+                Slot &slot = slotPtr_[sequence & mask_];
+                slot.value = std::move(item);
+                slot.skipped = false;
+                deliver(slot, sequence);
+            }
+
+            void publish(size_t sequence, const T &item)
+            {
+                Slot &slot = slotPtr_[sequence & mask_];
+                slot.value = item;
+                slot.skipped = false;
+                deliver(slot, sequence);
+            }
+
+            void markSkipped(size_t sequence)
+            {
+                Slot &slot = slotPtr_[sequence & mask_];
+                slot.skipped = true;
+                deliver(slot, sequence);
+            }
+
+            // Either side
+            // ----------------------------------------------------------------
+
+            size_t numOutstanding() const
+            {
+                // Reserved but not yet drained
+                return reservePos_.load() - readPos_.load();
+            }
+
+            size_t numReady() const
+            {
+                // Delivered but not yet drained
+                return numReady_.load(std::memory_order_relaxed);
+            }
+
+            size_t nextSequence() const
+            {
+                return readPos_.load(std::memory_order_relaxed);
+            }
+
+            size_t capacity() const
+            {
+                return capacity_;
+            }
+
+        protected:
+
+            struct Slot
+            {
+                std::atomic<size_t> sequence;   // == seq free, == seq+1 delivered
+                bool skipped;
+                T value;
+            };
+
+            char padBegin_[RING_BUFFER_CACHE_LINE_SIZE];
+            std::atomic<size_t> reservePos_;
+            std::atomic<size_t> readPos_;
+            char padRead_[RING_BUFFER_CACHE_LINE_SIZE - 2*sizeof(std::atomic<size_t>)];
+            std::atomic<size_t> numReady_;
+            char padEnd_[RING_BUFFER_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+            size_t capacity_;
+            size_t mask_;
+            std::unique_ptr<Slot[]> slotPtr_;
+
+            std::atomic<bool> ownerWaiting_;
+            QMutex waitMutex_;
+            QWaitCondition nextWaitCond_;
+
+            void deliver(Slot &slot, size_t sequence)
+            {
+                numReady_.fetch_add(1, std::memory_order_relaxed);
+                slot.sequence.store(sequence+1, std::memory_order_seq_cst);
+                if ((ownerWaiting_.load()) && (sequence == readPos_.load()))
+                {
+                    // The owner is waiting for this item. Taking the lock means 
+                    // it is either waiting on the condition or hasn't yet 
+                    // checked the slot.
+                    waitMutex_.lock();
+                    nextWaitCond_.wakeAll();
+                    waitMutex_.unlock();
+                }
+            }
+    };
+
 } // namespace bias
 
 #endif // #ifndef BIAS_LOCKABLE_HPP
@@ -0,0 +1,43 @@
+#ifndef BIAS_MATCHED_FRAME_SET_HPP
+#define BIAS_MATCHED_FRAME_SET_HPP
+
+#include <vector>
+#include "stamped_image.hpp"
+
+namespace bias
+{
+    struct MatchedFrameSet
+    {
+        // Frames from several cameras which were exposed at the same time,
+        // matched on their time stamps mapped to a common clock. Indexed by
+        // camera number - haveFrame is false for cameras whose frame is
+        // missing from the set. Images are only included if the set is
+        // passed to a multi-camera plugin.
+        unsigned long setIndex;
+        double timeStamp;                   // common clock time of the set (s)
+        std::vector<bool> haveFrame;
+        std::vector<StampedImage> frames;
+        std::vector<double> syncError;      // frame time - set time (s)
+
+        MatchedFrameSet()
+        {
+            setIndex = 0;
+            timeStamp = 0.0;
+        };
+
+        bool isComplete() const
+        {
+            for (bool value : haveFrame)
+            {
+                if (!value)
+                {
+                    return false;
+                }
+            }
+            return !haveFrame.empty();
+        };
+    };
+
+} // namespace bias
+
+#endif // #ifndef BIAS_MATCHED_FRAME_SET_HPP
@@ -0,0 +1,159 @@
+#ifndef BIAS_PACK12_HPP
+#define BIAS_PACK12_HPP
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "simd_utils.hpp"
+
+#if defined(BIAS_HAVE_SSSE3_DISPATCH)
+#include <tmmintrin.h>
+#endif
+
+// Conversion between 16-bit pixels and the 12-bit packed Mono12p layout used
+// for high bit depth fmf files. Two pixels take three bytes:
+//
+//   byte 0 = p0[7:0], byte 1 = p0[11:8] | p1[3:0] << 4, byte 2 = p1[11:4]
+//
+// The camera backends deliver 12-bit pixel formats as MONO16 with the data in
+// the most significant bits, so packing keeps bits [15:4] of each pixel and
+// unpacking shifts them back up. An odd last pixel is padded with zeros.
+
+namespace bias
+{
+
+    // Number of bytes needed for numPix packed pixels
+    inline size_t getMono12pSize(size_t numPix)
+    {
+        return (3*numPix + 1)/2;
+    }
+
+
+    inline void packMono12p_scalar(const uint16_t *src, uint8_t *dst, size_t begin, size_t numPix)
+    {
+        // begin must be even
+        uint8_t *dstPtr = dst + 3*(begin/2);
+        size_t i = begin;
+        for (; i + 2 <= numPix; i += 2)
+        {
+            unsigned int p0 = src[i] >> 4;
+            unsigned int p1 = src[i+1] >> 4;
+            dstPtr[0] = uint8_t(p0);
+            dstPtr[1] = uint8_t((p0 >> 8) | (p1 << 4));
+            dstPtr[2] = uint8_t(p1 >> 4);
+            dstPtr += 3;
+        }
+        if (i < numPix)
+        {
+            unsigned int p0 = src[i] >> 4;
+            dstPtr[0] = uint8_t(p0);
+            dstPtr[1] = uint8_t(p0 >> 8);
+        }
+    }
+
+
+    inline void unpackMono12p_scalar(const uint8_t *src, uint16_t *dst, size_t begin, size_t numPix)
+    {
+        // begin must be even
+        const uint8_t *srcPtr = src + 3*(begin/2);
+        size_t i = begin;
+        for (; i + 2 <= numPix; i += 2)
+        {
+            dst[i]   = uint16_t((srcPtr[0] | ((srcPtr[1] & 0x0f) << 8)) << 4);
+            dst[i+1] = uint16_t(((srcPtr[1] >> 4) | (srcPtr[2] << 4)) << 4);
+            srcPtr += 3;
+        }
+        if (i < numPix)
+        {
+            dst[i] = uint16_t((srcPtr[0] | ((srcPtr[1] & 0x0f) << 8)) << 4);
+        }
+    }
+
+
+#if defined(BIAS_HAVE_SSSE3_DISPATCH)
+    // 8 pixels (16 bytes) <-> 12 packed bytes per iteration. Loads and stores
+    // are split into 8 + 4 bytes so nothing outside the buffers is touched.
+    BIAS_TARGET_SSSE3 inline size_t packMono12p_ssse3(const uint16_t *src, uint8_t *dst, size_t numPix)
+    {
+        // Each 32-bit lane holds a pixel pair x0 | x1 << 16 which becomes the
+        // 24-bit value (x0 >> 4) | (x1 >> 4) << 12, then the low 3 bytes of
+        // each lane are gathered into the bottom 12 bytes.
+        const __m128i mask0 = _mm_set1_epi32(0x00000fff);
+        const __m128i mask1 = _mm_set1_epi32(0x00fff000);
+        const __m128i gather = _mm_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+        size_t i = 0;
+        for (; i + 8 <= numPix; i += 8)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *) (src + i));
+            __m128i v = _mm_or_si128(
+                    _mm_and_si128(_mm_srli_epi32(x, 4), mask0),
+                    _mm_and_si128(_mm_srli_epi32(x, 8), mask1)
+                    );
+            v = _mm_shuffle_epi8(v, gather);
+            uint8_t *dstPtr = dst + 3*(i/2);
+            _mm_storel_epi64((__m128i *) dstPtr, v);
+            uint32_t tail = uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(v, 8)));
+            std::memcpy(dstPtr + 8, &tail, sizeof(uint32_t));
+        }
+        return i;
+    }
+
+
+    BIAS_TARGET_SSSE3 inline size_t unpackMono12p_ssse3(const uint8_t *src, uint16_t *dst, size_t numPix)
+    {
+        // Inverse of the above - spread each 3 byte group into a 32-bit lane
+        // and move the two 12-bit values to the top of their 16-bit halves.
+        const __m128i mask0 = _mm_set1_epi32(0x0000fff0);
+        const __m128i mask1 = _mm_set1_epi32(int(0xfff00000));
+        const __m128i spread = _mm_setr_epi8(0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1);
+        size_t i = 0;
+        for (; i + 8 <= numPix; i += 8)
+        {
+            const uint8_t *srcPtr = src + 3*(i/2);
+            uint32_t tail;
+            std::memcpy(&tail, srcPtr + 8, sizeof(uint32_t));
+            __m128i v = _mm_unpacklo_epi64(
+                    _mm_loadl_epi64((const __m128i *) srcPtr),
+                    _mm_cvtsi32_si128(int(tail))
+                    );
+            v = _mm_shuffle_epi8(v, spread);
+            v = _mm_or_si128(
+                    _mm_and_si128(_mm_slli_epi32(v, 4), mask0),
+                    _mm_and_si128(_mm_slli_epi32(v, 8), mask1)
+                    );
+            _mm_storeu_si128((__m128i *) (dst + i), v);
+        }
+        return i;
+    }
+#endif
+
+
+    // Packs numPix 16-bit pixels into getMono12pSize(numPix) bytes of dst
+    inline void packMono12p(const uint16_t *src, uint8_t *dst, size_t numPix)
+    {
+        size_t i = 0;
+#if defined(BIAS_HAVE_SSSE3_DISPATCH)
+        if (cpuSupportsSsse3())
+        {
+            i = packMono12p_ssse3(src, dst, numPix);
+        }
+#endif
+        packMono12p_scalar(src, dst, i, numPix);
+    }
+
+
+    // Unpacks numPix pixels from getMono12pSize(numPix) bytes of src
+    inline void unpackMono12p(const uint8_t *src, uint16_t *dst, size_t numPix)
+    {
+        size_t i = 0;
+#if defined(BIAS_HAVE_SSSE3_DISPATCH)
+        if (cpuSupportsSsse3())
+        {
+            i = unpackMono12p_ssse3(src, dst, numPix);
+        }
+#endif
+        unpackMono12p_scalar(src, dst, i, numPix);
+    }
+
+} // namespace bias
+
+#endif // #ifndef BIAS_PACK12_HPP
@@ -0,0 +1,55 @@
+#ifndef BIAS_PIPELINE_STAMPS_HPP
+#define BIAS_PIPELINE_STAMPS_HPP
+
+#include <cstdint>
+#include <chrono>
+
+namespace bias
+{
+    enum PipelineStage
+    {
+        PIPELINE_STAGE_GRABBED = 0,     // pushed onto the new image queue by the grabber
+        PIPELINE_STAGE_DISPATCHED,      // popped from the new image queue by the dispatcher
+        PIPELINE_STAGE_LOGGED,          // popped from the log queue by the logger
+        PIPELINE_STAGE_COMPRESSED,      // compressed by the video writer (if it compresses)
+        PIPELINE_STAGE_WRITTEN,         // written to file by the video writer
+        PIPELINE_STAGE_PLUGIN,          // processed by the plugin
+        NUMBER_OF_PIPELINE_STAGE
+    };
+
+    struct PipelineStamps
+    {
+        // Monotonic clock time (ns) at which the frame passed each stage of
+        // the pipeline - zero if it has not (yet) passed the stage.
+        int64_t ns[NUMBER_OF_PIPELINE_STAGE];
+
+        PipelineStamps()
+        {
+            clear();
+        };
+
+        void clear()
+        {
+            for (int i=0; i<NUMBER_OF_PIPELINE_STAGE; i++)
+            {
+                ns[i] = 0;
+            }
+        };
+
+        int64_t mark(PipelineStage stage)
+        {
+            ns[stage] = now();
+            return ns[stage];
+        };
+
+        static int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()
+                    ).count();
+        };
+    };
+
+} // namespace bias
+
+#endif // #ifndef BIAS_PIPELINE_STAMPS_HPP
@@ -0,0 +1,458 @@
+#include "pipeline_stats.hpp"
+#include <cstring>
+#include <cmath>
+#include <QTextStream>
+
+namespace bias
+{
+    const unsigned int LatencyHistogram::LINEAR_LIMIT_US;
+    const unsigned int LatencyHistogram::SUB_BUCKET_BITS;
+    const unsigned int LatencyHistogram::NUMBER_OF_BUCKETS;
+
+    const char PipelineTrace::MAGIC[8] = {'B','I','A','S','T','R','C','1'};
+    const uint32_t PipelineTrace::VERSION = 1;
+    const size_t PipelineTrace::BUFFER_SIZE = 1 << 20;
+
+    QString getPipelineStageName(PipelineStage stage)
+    {
+        switch (stage)
+        {
+            case PIPELINE_STAGE_GRABBED:
+                return QString("grabbed");
+            case PIPELINE_STAGE_DISPATCHED:
+                return QString("dispatched");
+            case PIPELINE_STAGE_LOGGED:
+                return QString("logged");
+            case PIPELINE_STAGE_COMPRESSED:
+                return QString("compressed");
+            case PIPELINE_STAGE_WRITTEN:
+                return QString("written");
+            case PIPELINE_STAGE_PLUGIN:
+                return QString("plugin");
+            default:
+                return QString("unknown");
+        }
+    }
+
+
+    QString getPipelineQueueName(PipelineQueue queue)
+    {
+        switch (queue)
+        {
+            case PIPELINE_QUEUE_NEW:
+                return QString("new");
+            case PIPELINE_QUEUE_LOG:
+                return QString("log");
+            case PIPELINE_QUEUE_PLUGIN:
+                return QString("plugin");
+            default:
+                return QString("unknown");
+        }
+    }
+
+
+    // LatencySummary
+    // ------------------------------------------------------------------------
+    LatencySummary::LatencySummary()
+    {
+        count = 0;
+        meanUs = 0.0;
+        p50Us = 0.0;
+        p90Us = 0.0;
+        p99Us = 0.0;
+        maxUs = 0.0;
+    }
+
+
+    QVariantMap LatencySummary::toMap() const
+    {
+        QVariantMap summaryMap;
+        summaryMap.insert("count", qulonglong(count));
+        summaryMap.insert("meanUs", meanUs);
+        summaryMap.insert("p50Us", p50Us);
+        summaryMap.insert("p90Us", p90Us);
+        summaryMap.insert("p99Us", p99Us);
+        summaryMap.insert("maxUs", maxUs);
+        return summaryMap;
+    }
+
+
+    // LatencyHistogram
+    // ------------------------------------------------------------------------
+    LatencyHistogram::LatencyHistogram()
+    {
+        reset();
+    }
+
+
+    void LatencyHistogram::record(int64_t latencyNs)
+    {
+        if (latencyNs < 0)
+        {
+            latencyNs = 0;
+        }
+        unsigned int bucket = getBucket(uint64_t(latencyNs)/1000);
+        buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+        sumNs_.fetch_add(uint64_t(latencyNs), std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+
+        int64_t maxNs = maxNs_.load(std::memory_order_relaxed);
+        while ((latencyNs > maxNs) && !maxNs_.compare_exchange_weak(maxNs, latencyNs, std::memory_order_relaxed)) {}
+    }
+
+
+    void LatencyHistogram::reset()
+    {
+        for (unsigned int i=0; i<NUMBER_OF_BUCKETS; i++)
+        {
+            buckets_[i].store(0, std::memory_order_relaxed);
+        }
+        count_.store(0, std::memory_order_relaxed);
+        sumNs_.store(0, std::memory_order_relaxed);
+        maxNs_.store(0, std::memory_order_relaxed);
+    }
+
+
+    LatencySummary LatencyHistogram::getSummary() const
+    {
+        // Buckets are read one at a time while they may still be updated so
+        // the percentiles are taken from the bucket counts rather than count_.
+        LatencySummary summary;
+        uint64_t counts[NUMBER_OF_BUCKETS];
+        uint64_t total = 0;
+        for (unsigned int i=0; i<NUMBER_OF_BUCKETS; i++)
+        {
+            counts[i] = buckets_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total == 0)
+        {
+            return summary;
+        }
+
+        uint64_t count = count_.load(std::memory_order_relaxed);
+        summary.count = (unsigned long)(count);
+        summary.meanUs = 1.0e-3*double(sumNs_.load(std::memory_order_relaxed))/double(count > 0 ? count : 1);
+        summary.maxUs = 1.0e-3*double(maxNs_.load(std::memory_order_relaxed));
+
+        const double quantiles[] = {0.5, 0.9, 0.99};
+        double *values[] = {&summary.p50Us, &summary.p90Us, &summary.p99Us};
+        for (unsigned int j=0; j<3; j++)
+        {
+            uint64_t target = uint64_t(std::ceil(quantiles[j]*double(total)));
+            uint64_t cumulative = 0;
+            for (unsigned int i=0; i<NUMBER_OF_BUCKETS; i++)
+            {
+                cumulative += counts[i];
+                if (cumulative >= target)
+                {
+                    *values[j] = std::min(getBucketMidpoint(i), summary.maxUs);
+                    break;
+                }
+            }
+        }
+        return summary;
+    }
+
+
+    unsigned int LatencyHistogram::getBucket(uint64_t latencyUs)
+    {
+        if (latencyUs < LINEAR_LIMIT_US)
+        {
+            return (unsigned int)(latencyUs);
+        }
+        unsigned int exponent = 0;
+        while ((latencyUs >> (exponent + 1)) != 0)
+        {
+            exponent++;
+        }
+        unsigned int subBucket = (unsigned int)(latencyUs >> (exponent - SUB_BUCKET_BITS)) & ((1u << SUB_BUCKET_BITS) - 1);
+        unsigned int linearBits = 4; // log2(LINEAR_LIMIT_US)
+        unsigned int bucket = LINEAR_LIMIT_US + ((exponent - linearBits) << SUB_BUCKET_BITS) + subBucket;
+        return std::min(bucket, NUMBER_OF_BUCKETS - 1);
+    }
+
+
+    double LatencyHistogram::getBucketMidpoint(unsigned int bucket)
+    {
+        if (bucket < LINEAR_LIMIT_US)
+        {
+            return double(bucket) + 0.5;
+        }
+        unsigned int linearBits = 4; // log2(LINEAR_LIMIT_US)
+        unsigned int exponent = linearBits + ((bucket - LINEAR_LIMIT_US) >> SUB_BUCKET_BITS);
+        unsigned int subBucket = (bucket - LINEAR_LIMIT_US) & ((1u << SUB_BUCKET_BITS) - 1);
+        double width = std::ldexp(1.0, int(exponent - SUB_BUCKET_BITS));
+        double lower = double((1u << SUB_BUCKET_BITS) + subBucket)*width;
+        return lower + 0.5*width;
+    }
+
+
+    // PipelineStats
+    // ------------------------------------------------------------------------
+    PipelineStats::PipelineStats(unsigned int cameraNumber)
+    {
+        cameraNumber_ = cameraNumber;
+        reset();
+    }
+
+
+    void PipelineStats::recordStage(PipelineStage stage, PipelineStamps &stamps)
+    {
+        if (stage == PIPELINE_STAGE_GRABBED)
+        {
+            // Start of the pipeline - the grabber reuses its image struct
+            stamps.clear();
+        }
+        int64_t stampNs = stamps.mark(stage);
+        stageCount_[stage].fetch_add(1, std::memory_order_relaxed);
+
+        if (stage == PIPELINE_STAGE_GRABBED)
+        {
+            return;
+        }
+
+        // Frames without stamps from earlier stages (e.g. those held back in
+        // the pre-trigger buffer) are counted but have no latency.
+        PipelineStage previousStage = getPreviousStage(stage, stamps);
+        if (stamps.ns[previousStage] != 0)
+        {
+            stageLatency_[stage].record(stampNs - stamps.ns[previousStage]);
+        }
+        if (stamps.ns[PIPELINE_STAGE_GRABBED] != 0)
+        {
+            totalLatency_[stage].record(stampNs - stamps.ns[PIPELINE_STAGE_GRABBED]);
+        }
+    }
+
+
+    void PipelineStats::recordLatency(PipelineStage stage, int64_t latencyNs)
+    {
+        // For latencies measured by the stage itself, e.g., camera to host
+        // for the grabber.
+        stageLatency_[stage].record(latencyNs);
+    }
+
+
+    void PipelineStats::updateQueue(PipelineQueue queue, size_t depth, unsigned long numDropped)
+    {
+        queueDepth_[queue].store(depth, std::memory_order_relaxed);
+        uint64_t depthMax = queueDepthMax_[queue].load(std::memory_order_relaxed);
+        while ((depth > depthMax) && !queueDepthMax_[queue].compare_exchange_weak(depthMax, depth, std::memory_order_relaxed)) {}
+        queueDropped_[queue].store(numDropped, std::memory_order_relaxed);
+    }
+
+
+    void PipelineStats::reset()
+    {
+        startNs_.store(PipelineStamps::now(), std::memory_order_relaxed);
+        for (int i=0; i<NUMBER_OF_PIPELINE_STAGE; i++)
+        {
+            stageCount_[i].store(0, std::memory_order_relaxed);
+            stageLatency_[i].reset();
+            totalLatency_[i].reset();
+        }
+        for (int i=0; i<NUMBER_OF_PIPELINE_QUEUE; i++)
+        {
+            queueDepth_[i].store(0, std::memory_order_relaxed);
+            queueDepthMax_[i].store(0, std::memory_order_relaxed);
+            queueDropped_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+
+    unsigned int PipelineStats::getCameraNumber() const
+    {
+        return cameraNumber_;
+    }
+
+
+    QVariantMap PipelineStats::toMap() const
+    {
+        double elapsedSec = 1.0e-9*double(PipelineStamps::now() - startNs_.load(std::memory_order_relaxed));
+
+        QVariantMap stagesMap;
+        for (int i=0; i<NUMBER_OF_PIPELINE_STAGE; i++)
+        {
+            PipelineStage stage = PipelineStage(i);
+            uint64_t count = stageCount_[i].load(std::memory_order_relaxed);
+
+            QVariantMap stageMap;
+            stageMap.insert("count", qulonglong(count));
+            stageMap.insert("framesPerSec", elapsedSec > 0.0 ? double(count)/elapsedSec : 0.0);
+            stageMap.insert("latency", stageLatency_[i].getSummary().toMap());
+            if (stage != PIPELINE_STAGE_GRABBED)
+            {
+                stageMap.insert("sinceGrabbed", totalLatency_[i].getSummary().toMap());
+            }
+            stagesMap.insert(getPipelineStageName(stage), stageMap);
+        }
+
+        QVariantMap queuesMap;
+        for (int i=0; i<NUMBER_OF_PIPELINE_QUEUE; i++)
+        {
+            QVariantMap queueMap;
+            queueMap.insert("depth", qulonglong(queueDepth_[i].load(std::memory_order_relaxed)));
+            queueMap.insert("maxDepth", qulonglong(queueDepthMax_[i].load(std::memory_order_relaxed)));
+            queueMap.insert("dropped", qulonglong(queueDropped_[i].load(std::memory_order_relaxed)));
+            queuesMap.insert(getPipelineQueueName(PipelineQueue(i)), queueMap);
+        }
+
+        QVariantMap statsMap;
+        statsMap.insert("cameraNumber", cameraNumber_);
+        statsMap.insert("elapsedSec", elapsedSec);
+        statsMap.insert("stages", stagesMap);
+        statsMap.insert("queues", queuesMap);
+        return statsMap;
+    }
+
+
+    QString PipelineStats::toPrometheus() const
+    {
+        // Prometheus text exposition format (version 0.0.4)
+        QString text;
+        QTextStream os(&text);
+        QString camera = QString("camera=\"%1\"").arg(cameraNumber_);
+
+        os << "# HELP bias_pipeline_frames_total Frames which have passed each pipeline stage.\n";
+        os << "# TYPE bias_pipeline_frames_total counter\n";
+        for (int i=0; i<NUMBER_OF_PIPELINE_STAGE; i++)
+        {
+            os << "bias_pipeline_frames_total{" << camera << ",stage=\"" << getPipelineStageName(PipelineStage(i)) << "\"} ";
+            os << qulonglong(stageCount_[i].load(std::memory_order_relaxed)) << "\n";
+        }
+
+        const char *latencyNames[] = {"bias_pipeline_stage_latency_seconds", "bias_pipeline_latency_seconds"};
+        const char *latencyHelp[] = {"Latency since the preceding pipeline stage.", "Latency since the frame was grabbed."};
+        const LatencyHistogram *histograms[] = {stageLatency_, totalLatency_};
+        for (int j=0; j<2; j++)
+        {
+            os << "# HELP " << latencyNames[j] << " " << latencyHelp[j] << "\n";
+            os << "# TYPE " << latencyNames[j] << " summary\n";
+            for (int i=0; i<NUMBER_OF_PIPELINE_STAGE; i++)
+            {
+                if ((j == 1) && (i == PIPELINE_STAGE_GRABBED))
+                {
+                    continue;
+                }
+                LatencySummary summary = histograms[j][i].getSummary();
+                QString labels = camera + QString(",stage=\"%1\"").arg(getPipelineStageName(PipelineStage(i)));
+                os << latencyNames[j] << "{" << labels << ",quantile=\"0.5\"} " << 1.0e-6*summary.p50Us << "\n";
+                os << latencyNames[j] << "{" << labels << ",quantile=\"0.9\"} " << 1.0e-6*summary.p90Us << "\n";
+                os << latencyNames[j] << "{" << labels << ",quantile=\"0.99\"} " << 1.0e-6*summary.p99Us << "\n";
+                os << latencyNames[j] << "_sum{" << labels << "} " << 1.0e-6*summary.meanUs*double(summary.count) << "\n";
+                os << latencyNames[j] << "_count{" << labels << "} " << qulonglong(summary.count) << "\n";
+            }
+        }
+
+        os << "# HELP bias_pipeline_queue_depth Frames waiting in each pipeline queue.\n";
+        os << "# TYPE bias_pipeline_queue_depth gauge\n";
+        for (int i=0; i<NUMBER_OF_PIPELINE_QUEUE; i++)
+        {
+            os << "bias_pipeline_queue_depth{" << camera << ",queue=\"" << getPipelineQueueName(PipelineQueue(i)) << "\"} ";
+            os << qulonglong(queueDepth_[i].load(std::memory_order_relaxed)) << "\n";
+        }
+        os << "# HELP bias_pipeline_queue_depth_max Largest depth seen for each pipeline queue.\n";
+        os << "# TYPE bias_pipeline_queue_depth_max gauge\n";
+        for (int i=0; i<NUMBER_OF_PIPELINE_QUEUE; i++)
+        {
+            os << "bias_pipeline_queue_depth_max{" << camera << ",queue=\"" << getPipelineQueueName(PipelineQueue(i)) << "\"} ";
+            os << qulonglong(queueDepthMax_[i].load(std::memory_order_relaxed)) << "\n";
+        }
+        os << "# HELP bias_pipeline_queue_dropped_total Frames dropped because a pipeline queue was full.\n";
+        os << "# TYPE bias_pipeline_queue_dropped_total counter\n";
+        for (int i=0; i<NUMBER_OF_PIPELINE_QUEUE; i++)
+        {
+            os << "bias_pipeline_queue_dropped_total{" << camera << ",queue=\"" << getPipelineQueueName(PipelineQueue(i)) << "\"} ";
+            os << qulonglong(queueDropped_[i].load(std::memory_order_relaxed)) << "\n";
+        }
+        os.flush();
+        return text;
+    }
+
+
+    PipelineStage PipelineStats::getPreviousStage(PipelineStage stage, const PipelineStamps &stamps)
+    {
+        switch (stage)
+        {
+            case PIPELINE_STAGE_LOGGED:
+                return PIPELINE_STAGE_DISPATCHED;
+            case PIPELINE_STAGE_COMPRESSED:
+                return PIPELINE_STAGE_LOGGED;
+            case PIPELINE_STAGE_WRITTEN:
+                // Writers which don't compress write the frame straight from the logger
+                if (stamps.ns[PIPELINE_STAGE_COMPRESSED] != 0)
+                {
+                    return PIPELINE_STAGE_COMPRESSED;
+                }
+                return PIPELINE_STAGE_LOGGED;
+            case PIPELINE_STAGE_PLUGIN:
+                return PIPELINE_STAGE_DISPATCHED;
+            default:
+                return PIPELINE_STAGE_GRABBED;
+        }
+    }
+
+
+    // PipelineTrace
+    // ------------------------------------------------------------------------
+    PipelineTrace::PipelineTrace()
+    {
+        buffer_.resize(BUFFER_SIZE);
+    }
+
+
+    PipelineTrace::~PipelineTrace()
+    {
+        close();
+    }
+
+
+    bool PipelineTrace::open(QString fileName)
+    {
+        close();
+        stream_.rdbuf() -> pubsetbuf(buffer_.data(), buffer_.size());
+        stream_.open(fileName.toStdString(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!stream_.is_open())
+        {
+            return false;
+        }
+        uint32_t version = VERSION;
+        uint32_t recordSize = sizeof(PipelineTraceRecord);
+        stream_.write(MAGIC, sizeof(MAGIC));
+        stream_.write((const char *) &version, sizeof(uint32_t));
+        stream_.write((const char *) &recordSize, sizeof(uint32_t));
+        return stream_.good();
+    }
+
+
+    void PipelineTrace::write(unsigned long frameCount, double timeStamp, const PipelineStamps &stamps)
+    {
+        if (!stream_.is_open())
+        {
+            return;
+        }
+        PipelineTraceRecord record;
+        record.frameCount = frameCount;
+        record.timeStamp = timeStamp;
+        record.grabbedNs = stamps.ns[PIPELINE_STAGE_GRABBED];
+        record.dispatchedNs = stamps.ns[PIPELINE_STAGE_DISPATCHED];
+        stream_.write((const char *) &record, sizeof(PipelineTraceRecord));
+    }
+
+
+    void PipelineTrace::close()
+    {
+        if (stream_.is_open())
+        {
+            stream_.close();
+        }
+    }
+
+
+    bool PipelineTrace::isOpen() const
+    {
+        return stream_.is_open();
+    }
+
+} // namespace bias
@@ -0,0 +1,159 @@
+#ifndef BIAS_PIPELINE_STATS_HPP
+#define BIAS_PIPELINE_STATS_HPP
+
+#include <memory>
+#include <atomic>
+#include <fstream>
+#include <vector>
+#include <cstdint>
+#include <QString>
+#include <QVariantMap>
+#include "pipeline_stamps.hpp"
+
+namespace bias
+{
+
+    enum PipelineQueue
+    {
+        PIPELINE_QUEUE_NEW = 0,
+        PIPELINE_QUEUE_LOG,
+        PIPELINE_QUEUE_PLUGIN,
+        NUMBER_OF_PIPELINE_QUEUE
+    };
+
+    QString getPipelineStageName(PipelineStage stage);
+    QString getPipelineQueueName(PipelineQueue queue);
+
+
+    struct LatencySummary
+    {
+        unsigned long count;
+        double meanUs;
+        double p50Us;
+        double p90Us;
+        double p99Us;
+        double maxUs;
+        LatencySummary();
+        QVariantMap toMap() const;
+    };
+
+
+    class LatencyHistogram
+    {
+        // --------------------------------------------------------------------
+        // Lock-free latency histogram which may be updated from several
+        // threads at once. Buckets are in microseconds - one per microsecond
+        // below LINEAR_LIMIT_US and then four per power of two, so percentiles
+        // are within ~12% of the true value.
+        // --------------------------------------------------------------------
+
+        public:
+
+            static const unsigned int LINEAR_LIMIT_US = 16;
+            static const unsigned int SUB_BUCKET_BITS = 2;
+            static const unsigned int NUMBER_OF_BUCKETS = 128;
+
+            LatencyHistogram();
+            void record(int64_t latencyNs);
+            void reset();
+            LatencySummary getSummary() const;
+
+        private:
+
+            std::atomic<uint64_t> buckets_[NUMBER_OF_BUCKETS];
+            std::atomic<uint64_t> count_;
+            std::atomic<uint64_t> sumNs_;
+            std::atomic<int64_t> maxNs_;
+
+            static unsigned int getBucket(uint64_t latencyUs);
+            static double getBucketMidpoint(unsigned int bucket);
+    };
+
+
+    class PipelineStats
+    {
+        // --------------------------------------------------------------------
+        // Per-stage frame counts and latency histograms and queue depth
+        // gauges for a camera's capture pipeline. Each thread of the pipeline
+        // stamps the frames passing through it with recordStage, which also
+        // records the latency since the preceding stage and since the frame
+        // was grabbed. Updates are lock-free and may be made from any thread.
+        // --------------------------------------------------------------------
+
+        public:
+
+            PipelineStats(unsigned int cameraNumber=0);
+
+            void recordStage(PipelineStage stage, PipelineStamps &stamps);
+            void recordLatency(PipelineStage stage, int64_t latencyNs);
+            void updateQueue(PipelineQueue queue, size_t depth, unsigned long numDropped);
+
+            // Not thread safe - only call when the pipeline is stopped
+            void reset();
+
+            unsigned int getCameraNumber() const;
+            QVariantMap toMap() const;
+            QString toPrometheus() const;
+
+        private:
+
+            unsigned int cameraNumber_;
+            std::atomic<int64_t> startNs_;
+
+            std::atomic<uint64_t> stageCount_[NUMBER_OF_PIPELINE_STAGE];
+            LatencyHistogram stageLatency_[NUMBER_OF_PIPELINE_STAGE];
+            LatencyHistogram totalLatency_[NUMBER_OF_PIPELINE_STAGE];
+
+            std::atomic<uint64_t> queueDepth_[NUMBER_OF_PIPELINE_QUEUE];
+            std::atomic<uint64_t> queueDepthMax_[NUMBER_OF_PIPELINE_QUEUE];
+            std::atomic<uint64_t> queueDropped_[NUMBER_OF_PIPELINE_QUEUE];
+
+            static PipelineStage getPreviousStage(PipelineStage stage, const PipelineStamps &stamps);
+    };
+
+    typedef std::shared_ptr<PipelineStats> PipelineStatsPtr;
+
+
+    class PipelineTrace
+    {
+        // --------------------------------------------------------------------
+        // Opt-in binary trace of the frames passing through the dispatcher.
+        // Records are fixed size and buffered in memory so writing them
+        // costs next to nothing per frame. The file starts with the 8 byte
+        // magic string "BIASTRC1" followed by the version and record size
+        // (uint32 each) and then one PipelineTraceRecord per frame.
+        // --------------------------------------------------------------------
+
+        public:
+
+            static const char MAGIC[8];
+            static const uint32_t VERSION;
+            static const size_t BUFFER_SIZE;
+
+            PipelineTrace();
+            ~PipelineTrace();
+
+            bool open(QString fileName);
+            void write(unsigned long frameCount, double timeStamp, const PipelineStamps &stamps);
+            void close();
+            bool isOpen() const;
+
+        private:
+
+            std::ofstream stream_;
+            std::vector<char> buffer_;
+    };
+
+#pragma pack(push, 1)
+    struct PipelineTraceRecord
+    {
+        uint64_t frameCount;
+        double timeStamp;     // camera time stamp (s)
+        int64_t grabbedNs;    // monotonic clock (ns)
+        int64_t dispatchedNs; // monotonic clock (ns)
+    };
+#pragma pack(pop)
+
+} // namespace bias
+
+#endif // #ifndef BIAS_PIPELINE_STATS_HPP
@@ -0,0 +1,135 @@
+#ifndef BIAS_SIMD_UTILS_HPP
+#define BIAS_SIMD_UTILS_HPP
+#include <cstddef>
+#include <cstdint>
+
+// SSE2 is part of the x86-64 baseline - scalar fallbacks are used elsewhere.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define BIAS_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// AVX2 code paths are compiled with a target attribute (gcc/clang) and only
+// used when cpuSupportsAvx2() is true at runtime. 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BIAS_HAVE_AVX2_DISPATCH
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define BIAS_TARGET_AVX2
+#else
+#define BIAS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Same for SSSE3 (pshufb), which isn't part of the x86-64 baseline either.
+#if defined(BIAS_HAVE_AVX2_DISPATCH)
+#define BIAS_HAVE_SSSE3_DISPATCH
+#if defined(_MSC_VER)
+#define BIAS_TARGET_SSSE3
+#else
+#define BIAS_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#endif
+
+namespace bias
+{
+
+    // Index of the lowest set bit, mask must be nonzero
+    inline unsigned int lowestSetBit(uint32_t mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return (unsigned int)(index);
+#else
+        return (unsigned int)(__builtin_ctz(mask));
+#endif
+    }
+
+
+    // True if the cpu (and os) support AVX2 instructions
+    inline bool cpuSupportsAvx2()
+    {
+#if defined(BIAS_HAVE_AVX2_DISPATCH) && defined(_MSC_VER)
+        static const bool hasAvx2 = []() 
+        {
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) 
+            { 
+                return false; 
+            }
+            __cpuid(info, 1);
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            if (!(osxsave && avx) || ((_xgetbv(0) & 0x6) != 0x6)) 
+            { 
+                return false; 
+            }
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+        }();
+        return hasAvx2;
+#elif defined(BIAS_HAVE_AVX2_DISPATCH)
+        static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+        return hasAvx2;
+#else
+        return false;
+#endif
+    }
+
+
+    // True if the cpu supports SSSE3 instructions
+    inline bool cpuSupportsSsse3()
+    {
+#if defined(BIAS_HAVE_SSSE3_DISPATCH) && defined(_MSC_VER)
+        static const bool hasSsse3 = []() 
+        {
+            int info[4];
+            __cpuid(info, 1);
+            return (info[2] & (1 << 9)) != 0;
+        }();
+        return hasSsse3;
+#elif defined(BIAS_HAVE_SSSE3_DISPATCH)
+        static const bool hasSsse3 = __builtin_cpu_supports("ssse3");
+        return hasSsse3;
+#else
+        return false;
+#endif
+    }
+
+
+    // Returns the index of the first byte in ptr[0,num) equal to value or num 
+    // if there is no such byte.
+    inline size_t findFirstEqual(const uint8_t *ptr, size_t num, uint8_t value)
+    {
+        size_t i = 0;
+#ifdef BIAS_HAVE_SSE2
+        const __m128i valueVec = _mm_set1_epi8(char(value));
+        for (; i + 16 <= num; i += 16)
+        {
+            __m128i data = _mm_loadu_si128((const __m128i *) (ptr + i));
+            uint32_t mask = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(data, valueVec)));
+            if (mask != 0)
+            {
+                return i + lowestSetBit(mask);
+            }
+        }
+#endif
+        for (; i < num; i++)
+        {
+            if (ptr[i] == value)
+            {
+                return i;
+            }
+        }
+        return num;
+    }
+
+} // namespace bias
+
+#endif // #ifndef BIAS_SIMD_UTILS_HPP
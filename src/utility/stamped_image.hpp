@@ -2,6 +2,7 @@
 #define BIAS_STAMPED_IMAGE_HPP 
 
 #include <opencv2/core/core.hpp>
+#include "pipeline_stamps.hpp"
 
 namespace bias
 {
@@ -11,6 +12,7 @@ namespace bias
         double timeStamp;
         double dtEstimate;
         unsigned long frameCount;
+        PipelineStamps stamps;
     };
 
 }